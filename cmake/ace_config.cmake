@@ -3,6 +3,7 @@ set(ACE_LIBRARY_KINDS "OBJECT" "STATIC")
 set_property(CACHE ACE_LIBRARY_KIND PROPERTY STRINGS ${ACE_LIBRARY_KINDS})
 set(ACE_DEBUG OFF CACHE BOOL "Build with ACE-specific debug/safety functionality.")
 set(ACE_DEBUG_UAE OFF CACHE BOOL "With ACE_DEBUG enabled, output log to UAE console.")
+set(ACE_PROFILER OFF CACHE BOOL "Build with zone profiler, also in non-debug builds.")
 set(ACE_BOB_WRAP_Y ON CACHE BOOL "Conrols Y-wrapping support in bob manager. Disable for extra performance in simple buffer scenarios.")
 set(ACE_BOB_PRISTINE_BUFFER OFF CACHE BOOL "When enabled, uses pristine buffer for bob undraw instead of allocating restore buffers.")
 set(ACE_USE_ECS_FEATURES OFF CACHE BOOL "Enable ECS feature sets, makes ACE OCS-incompatible.")
@@ -17,6 +18,7 @@ set(ACE_FILE_USE_ONLY_DISK OFF CACHE BOOL "If enabled, only diskFile functions w
 message(STATUS "[ACE] ACE_LIBRARY_KIND: '${ACE_LIBRARY_KIND}'")
 message(STATUS "[ACE] ACE_DEBUG: '${ACE_DEBUG}'")
 message(STATUS "[ACE] ACE_DEBUG_UAE: '${ACE_DEBUG_UAE}'")
+message(STATUS "[ACE] ACE_PROFILER: '${ACE_PROFILER}'")
 message(STATUS "[ACE] ACE_BOB_WRAP_Y: '${ACE_BOB_WRAP_Y}'")
 message(STATUS "[ACE] ACE_BOB_PRISTINE_BUFFER: '${ACE_BOB_PRISTINE_BUFFER}'")
 message(STATUS "[ACE] ACE_USE_ECS_FEATURES: '${ACE_USE_ECS_FEATURES}'")
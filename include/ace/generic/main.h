@@ -36,6 +36,10 @@ extern "C" {
 #define GENERIC_MAIN_LOG_PATH 0
 #endif
 
+// Define this macro before including this file to write binary log using
+// RAM buffer of given size, which can be converted to text with log_decode tool
+// #define GENERIC_MAIN_LOG_BINARY_SIZE 16384
+
 //--------------------------------------------------------- USER FUNCTIONS BEGIN
 // Those functions must be defined by the user in some other file (e.g. main.c)!
 
@@ -105,7 +109,11 @@ void __stack_chk_fail(void) {
 
 int main(void) {
 	systemCreate();
+#if defined(GENERIC_MAIN_LOG_BINARY_SIZE)
+	logOpenBinary(GENERIC_MAIN_LOG_PATH, GENERIC_MAIN_LOG_BINARY_SIZE);
+#else
 	logOpen(GENERIC_MAIN_LOG_PATH);
+#endif
 	memCreate();
 #if !defined(GENERIC_MAIN_NO_TIMER)
 	timerCreate();
@@ -0,0 +1,146 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_MANAGERS_CHIP_HEAP_H_
+#define _ACE_MANAGERS_CHIP_HEAP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Relocatable CHIP memory heap.
+ * Reserves one big CHIP block when created and serves handle-based
+ * allocations from it. Since each allocation has its owner which gets
+ * notified when its memory moves, the heap can be compacted with the blitter
+ * e.g. during loading screens, so that repeated state changes on 512KB CHIP
+ * machines don't leave memory too fragmented for big allocations.
+ *
+ * Bitmaps created with BMF_RELOCATABLE and CHIP sfx loaded while the heap
+ * exists are allocated from it and their pointers are updated on compaction.
+ *
+ * Nothing can access memory of movable blocks during compaction, so before
+ * calling chipHeapCompact() make sure that no sfx is played on hardware
+ * channels and lock blocks which are currently displayed or used by DMA
+ * using chipHeapSetLocked(). Copper lists referencing moved bitmaps need
+ * to be rebuilt afterwards.
+ */
+
+#include <ace/types.h>
+
+/* Types */
+
+/**
+ * @brief Handle of relocatable allocation. Zero is never a valid handle.
+ */
+typedef UWORD tChipHandle;
+
+/**
+ * @brief Callback notifying allocation's owner that its memory has moved.
+ * Memory is already in new location when it's called.
+ *
+ * @param pOwner Owner pointer passed to chipHeapAlloc().
+ * @param pOld Previous allocation address.
+ * @param pNew New allocation address.
+ */
+typedef void (*tCbChipRelocate)(void *pOwner, UBYTE *pOld, UBYTE *pNew);
+
+typedef struct _tChipHeapStats {
+	ULONG ulFree; ///< Total free memory in heap, in bytes.
+	ULONG ulLargestFree; ///< Largest contiguous free area, in bytes.
+	UWORD uwFreeAreas; ///< Number of disjoint free areas.
+	UWORD uwBlocks; ///< Number of live allocations.
+	UBYTE ubFragmentation; ///< Percent of free memory outside largest area.
+} tChipHeapStats;
+
+/* Functions */
+
+/**
+ * @brief Creates chip heap, reserving its memory up front. Do this early,
+ * before CHIP memory gets fragmented.
+ *
+ * @param ulSize Size of reserved CHIP memory, in bytes.
+ * @param uwMaxBlocks Maximum number of simultaneously live allocations.
+ * @return 1 on success, 0 on failure.
+ *
+ * @see chipHeapDestroy()
+ */
+UBYTE chipHeapCreate(ULONG ulSize, UWORD uwMaxBlocks);
+
+/**
+ * @brief Destroys chip heap, freeing its memory.
+ * All allocations should be freed by their owners beforehand.
+ *
+ * @see chipHeapCreate()
+ */
+void chipHeapDestroy(void);
+
+/**
+ * @brief Checks if chip heap is currently created.
+ *
+ * @return 1 if chip heap exists, otherwise 0.
+ */
+UBYTE chipHeapIsCreated(void);
+
+/**
+ * @brief Allocates relocatable memory from chip heap. Doesn't involve OS.
+ *
+ * @param ulSize Number of bytes to be allocated.
+ * @param cbRelocate Callback to be called after memory moves. May be zero
+ * if owner always accesses memory using chipHeapGetAddr().
+ * @param pOwner Owner pointer passed to cbRelocate.
+ * @return Handle of new allocation, zero on failure.
+ *
+ * @see chipHeapFree()
+ */
+tChipHandle chipHeapAlloc(ULONG ulSize, tCbChipRelocate cbRelocate, void *pOwner);
+
+/**
+ * @brief Frees memory allocated from chip heap.
+ *
+ * @param uwHandle Handle returned by chipHeapAlloc().
+ */
+void chipHeapFree(tChipHandle uwHandle);
+
+/**
+ * @brief Returns current address of given allocation. It's only valid until
+ * next call to chipHeapCompact().
+ *
+ * @param uwHandle Handle returned by chipHeapAlloc().
+ * @return Current allocation address.
+ */
+UBYTE *chipHeapGetAddr(tChipHandle uwHandle);
+
+/**
+ * @brief Pins or unpins given allocation, so that compaction won't move it.
+ * Lock blocks which are in use by DMA, e.g. currently displayed bitplanes.
+ *
+ * @param uwHandle Handle returned by chipHeapAlloc().
+ * @param isLocked 1 to prevent moving the block, 0 to allow it again.
+ */
+void chipHeapSetLocked(tChipHandle uwHandle, UBYTE isLocked);
+
+/**
+ * @brief Calculates current fragmentation of chip heap.
+ *
+ * @param pStats Structure to be filled with current stats.
+ */
+void chipHeapGetStats(tChipHeapStats *pStats);
+
+/**
+ * @brief Moves all unlocked allocations towards heap start using the blitter,
+ * joining free areas between them. Owners are notified about each move.
+ * Waits for the blitter to finish before returning.
+ *
+ * @param pBefore If non-zero, filled with heap stats before compaction.
+ * @param pAfter If non-zero, filled with heap stats after compaction.
+ * @return Number of moved allocations.
+ */
+UWORD chipHeapCompact(tChipHeapStats *pBefore, tChipHeapStats *pAfter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_MANAGERS_CHIP_HEAP_H_
@@ -15,8 +15,33 @@ extern "C" {
 #include <ace/managers/timer.h>
 #include <ace/utils/file.h>
 
+// Binary log format. File starts with "ALOG" magic and version byte padded
+// to 8 bytes, followed by records, big endian. Each record starts with
+// tLogBinRecordHeader and its size is always even.
+#define LOG_BIN_VERSION 1
+#define LOG_BIN_RECORD_FORMAT 1 ///< UWORD id, format string.
+#define LOG_BIN_RECORD_MESSAGE 2 ///< UWORD id, raw args.
+#define LOG_BIN_RECORD_TEXT 3 ///< Already formatted text.
+#define LOG_BIN_RECORD_BLOCK_END 4 ///< ULONG time delta, UBYTE isEmpty, pad, name.
+#define LOG_BIN_RECORD_LOST 5 ///< ULONG count of records lost on full buffer.
+
+// Max number of args of single binary message, doubles count as two.
+#define LOG_BIN_ARG_LONGS_MAX 16
+
+// Histogram of tAvg has 4 buckets per power of two of time delta, so that
+// percentiles are within 12.5% of real value without storing all samples.
+#define LOG_AVG_HISTOGRAM_SUBBUCKETS 4
+#define LOG_AVG_HISTOGRAM_BUCKETS 124
+
 // Types
 
+typedef struct _tLogBinRecordHeader {
+	UWORD uwSize; ///< Size of whole record, including header.
+	UBYTE ubType; ///< One of LOG_BIN_RECORD_* values.
+	UBYTE ubIndent; ///< Log indent at the time of writing.
+	ULONG ulTime; ///< Timestamp from timerGetPrec().
+} tLogBinRecordHeader;
+
 typedef struct _tAvg {
 	UWORD uwAllocCount;
 	UWORD uwUsedCount;
@@ -26,6 +51,8 @@ typedef struct _tAvg {
 	ULONG ulStartTime;
 	ULONG *pDeltas;
 	char *szName;
+	ULONG *pHistogram; ///< Sample count of each bucket, zero if not enabled.
+	ULONG ulHistogramCount; ///< Number of samples in histogram.
 } tAvg;
 
 
@@ -38,6 +65,10 @@ typedef struct _tLogManager {
 	char szTimeBfr[255];
 	UBYTE isBlockEmpty;
 	UBYTE ubShutUp;
+	UBYTE *pBinBuffer; ///< Binary records waiting to be flushed, zero in text mode.
+	ULONG ulBinSize;
+	ULONG ulBinUsed;
+	ULONG ulBinLost;
 } tLogManager;
 
 #ifdef ACE_DEBUG
@@ -47,6 +78,12 @@ extern tLogManager g_sLogManager;
 // Functions - general
 
 void _logOpen(const char *szFilePath);
+// Binary log stores format string once and then only its id, raw args and
+// timestamp for each message, so that no formatting is done on Amiga.
+// Records are kept in RAM and written only when OS is already in use or on
+// logFlush(). Use log_decode tool to convert it to text.
+void _logOpenBinary(const char *szFilePath, ULONG ulBufferSize);
+void _logFlush(void);
 void _logClose(void);
 
 void _logPushIndent(void);
@@ -71,10 +108,18 @@ void _logAvgDestroy(tAvg *pAvg);
 void _logAvgBegin(tAvg *pAvg);
 void _logAvgEnd(tAvg *pAvg);
 void _logAvgWrite(tAvg *pAvg);
+// Histogram mode additionally counts all samples in log-scale buckets, so that
+// logAvgWrite() can report p50/p95/p99. logAvgExportHistogram() writes
+// bucket counts as CSV for plotting on PC.
+UBYTE _logAvgEnableHistogram(tAvg *pAvg);
+void _logAvgWriteHistogram(tAvg *pAvg);
+UBYTE _logAvgExportHistogram(tAvg *pAvg, const char *szPath);
 
 // Functions - general logging
 
 #define logOpen(szFilePath) _logOpen(szFilePath)
+#define logOpenBinary(szFilePath, ulBufferSize) _logOpenBinary(szFilePath, ulBufferSize)
+#define logFlush() _logFlush()
 #define logClose() _logClose()
 #define logPushIndent() _logPushIndent()
 #define logPopIndent() _logPopIndent()
@@ -91,9 +136,14 @@ void _logAvgWrite(tAvg *pAvg);
 #define logAvgBegin(pAvg) _logAvgBegin(pAvg)
 #define logAvgEnd(pAvg) _logAvgEnd(pAvg)
 #define logAvgWrite(pAvg) _logAvgWrite(pAvg)
+#define logAvgEnableHistogram(pAvg) _logAvgEnableHistogram(pAvg)
+#define logAvgWriteHistogram(pAvg) _logAvgWriteHistogram(pAvg)
+#define logAvgExportHistogram(pAvg, szPath) _logAvgExportHistogram(pAvg, szPath)
 
 #else
 #define logOpen(szFilePath)
+#define logOpenBinary(szFilePath, ulBufferSize)
+#define logFlush()
 #define logClose()
 #define logPushIndent()
 #define logPopIndent()
@@ -110,6 +160,9 @@ void _logAvgWrite(tAvg *pAvg);
 #define logAvgBegin(pAvg)
 #define logAvgEnd(pAvg)
 #define logAvgWrite(pAvg)
+#define logAvgEnableHistogram(pAvg) 0
+#define logAvgWriteHistogram(pAvg)
+#define logAvgExportHistogram(pAvg, szPath) 0
 #endif // ACE_DEBUG
 
 #ifdef __cplusplus
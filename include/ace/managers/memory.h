@@ -17,6 +17,7 @@ extern "C" {
 #ifdef AMIGA
 #include <exec/memory.h> // MEMF_CLEAR etc
 #else
+#define MEMF_ANY     0
 #define MEMF_CHIP    0
 #define MEMF_FAST    1
 #define MEMF_CLEAR   2
@@ -25,9 +26,43 @@ extern "C" {
 #endif // AMIGA
 
 #include <ace/types.h>
+#include <ace/macros.h>
 
 /* Types */
 
+#define MEM_TRASH_LEFT BV(0)
+#define MEM_TRASH_RIGHT BV(1)
+
+/**
+ * @brief Max number of distinct allocation tags, including default one.
+ */
+#define MEM_TAG_MAX 32
+
+/**
+ * @brief Max depth of allocation tag stack.
+ */
+#define MEM_TAG_STACK_DEPTH 8
+
+/**
+ * Allocation dump record types. Dump starts with "AMEM" magic and version
+ * byte, followed by records, big endian. Tag records are followed by tag name
+ * of ulSize bytes, without null terminator.
+ */
+#define MEM_DUMP_VERSION 1
+#define MEM_DUMP_RECORD_TAG 1
+#define MEM_DUMP_RECORD_ALLOC 2
+#define MEM_DUMP_RECORD_FREE 3
+
+typedef struct _tMemDumpRecord {
+	UBYTE ubType; ///< One of MEM_DUMP_RECORD_* values.
+	UBYTE ubTag; ///< Index of allocation tag.
+	UBYTE ubMemType; ///< MEMF_CHIP or MEMF_FAST.
+	UBYTE ubPad;
+	ULONG ulTime; ///< Frame number from timerGet().
+	ULONG ulAddr;
+	ULONG ulSize; ///< Allocation size or tag name length.
+} tMemDumpRecord;
+
 /* Globals */
 
 /* Functions */
@@ -52,12 +87,50 @@ void _memFreeRls(void *pMem, ULONG ulSize);
 
 void _memCheckTrashAtAddr(void *pMem, UWORD uwLine, const char *szFile);
 
+/**
+ * @brief Writes trash guards around given memory block: 0xCAFEBABE in 4 bytes
+ * preceding the block and 0xDEADBEEF in 4 bytes following it.
+ * Caller must reserve space for them.
+ *
+ * @param pMem Start of the guarded memory block.
+ * @param ulSize Size of the guarded memory block.
+ * @see _memGetTrash()
+ */
+void _memWriteTrash(void *pMem, ULONG ulSize);
+
+/**
+ * @brief Checks trash guards written earlier with _memWriteTrash().
+ *
+ * @param pMem Start of the guarded memory block.
+ * @param ulSize Size of the guarded memory block.
+ * @return Combination of MEM_TRASH_LEFT and MEM_TRASH_RIGHT for each of
+ * the guards being overwritten, zero if both are intact.
+ */
+UBYTE _memGetTrash(const void *pMem, ULONG ulSize);
+
 void _memCheckIntegrity(UWORD uwLine, const char *szFile);
 
 void _memLogPeak(void);
 
+void _memPushTag(const char *szTag);
+
+void _memPopTag(void);
+
+void _memDumpStart(const char *szPath);
+
+void _memDumpStop(void);
+
 /**
- * Macros for enabling or disabling logging
+ * Macros for enabling or disabling logging.
+ *
+ * memPushTag()/memPopTag() set the tag of subsequent allocations, e.g. name
+ * of subsystem or game state being loaded. Current and peak CHIP/FAST usage
+ * is tracked for each tag and logged by memLogPeak() and memDestroy().
+ * Tag names must stay valid until memDestroy(), string literals are best.
+ *
+ * memDumpStart() writes each allocation & free to given file as compact
+ * binary records (see tMemDumpRecord), which can be analyzed by mem_prof tool.
+ * memDumpStop() flushes and closes the dump, memDestroy() does it too.
  */
 
 #ifdef ACE_DEBUG
@@ -68,6 +141,10 @@ void _memLogPeak(void);
 # define memCheckTrashAtAddr(pAddr) _memCheckTrashAtAddr(pAddr, __LINE__, __FILE__)
 # define memCheckIntegrity() _memCheckIntegrity(__LINE__, __FILE__)
 # define memLogPeak() _memLogPeak()
+# define memPushTag(szTag) _memPushTag(szTag)
+# define memPopTag() _memPopTag()
+# define memDumpStart(szPath) _memDumpStart(szPath)
+# define memDumpStop() _memDumpStop()
 #else
 # define memAlloc(ulSize, ulFlags) _memAllocRls(ulSize, ulFlags)
 # define memFree(pMem, ulSize) _memFreeRls(pMem, ulSize)
@@ -76,6 +153,10 @@ void _memLogPeak(void);
 # define memCheckTrashAtAddr(pAddr, ulSize)
 # define memCheckIntegrity()
 # define memLogPeak()
+# define memPushTag(szTag)
+# define memPopTag()
+# define memDumpStart(szPath)
+# define memDumpStop()
 #endif // ACE_DEBUG
 
 // Shorthands
@@ -0,0 +1,159 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_MANAGERS_PROFILER_H_
+#define _ACE_MANAGERS_PROFILER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hierarchical zone profiler.
+ * Each zone begin/end and frame start is stored as small event with
+ * timerGetPrec() timestamp in preallocated ring, so that last N events are
+ * always available. Ring can then be dumped to a file and converted
+ * with prof_trace tool to Chrome trace JSON, viewable in chrome://tracing
+ * or ui.perfetto.dev.
+ *
+ * Since timerGetPrec() is derived from frame counter and beam position,
+ * the latter is also recovered from timestamps by the converter.
+ *
+ * Engine already marks its own zones (bob undraw/draw, tilebuffer, copper,
+ * state loop), so mark the frame start with profilerFrameBegin() and add
+ * game-specific zones created with profilerZoneCreate().
+ *
+ * Everything compiles to nothing unless ACE_PROFILER is defined.
+ * Requires timerCreate() to be called beforehand.
+ * Zones can't be used from interrupts.
+ */
+
+#include <ace/types.h>
+
+#define PROFILER_ZONE_MAX 64
+#define PROFILER_DEPTH_MAX 16
+
+// Dump starts with "APRF" magic, version byte, zone count byte and two
+// padding bytes. Then zone names follow, null-terminated, padded to even size,
+// followed by ULONG event count and tProfilerEvent array, big endian.
+#define PROFILER_DUMP_VERSION 1
+#define PROFILER_EVENT_BEGIN 1
+#define PROFILER_EVENT_END 2
+#define PROFILER_EVENT_FRAME 3
+
+/* Types */
+
+typedef UBYTE tProfilerZone;
+
+typedef enum tProfilerZoneBuiltin {
+	PROFILER_ZONE_BOB_UNDRAW,
+	PROFILER_ZONE_BOB_DRAW,
+	PROFILER_ZONE_TILEBUFFER,
+	PROFILER_ZONE_COPPER,
+	PROFILER_ZONE_STATE,
+	PROFILER_ZONE_OVERFLOW, ///< Shared by zones created over PROFILER_ZONE_MAX.
+	PROFILER_ZONE_BUILTIN_COUNT
+} tProfilerZoneBuiltin;
+
+typedef struct _tProfilerEvent {
+	ULONG ulTime; ///< Timestamp from timerGetPrec().
+	UBYTE ubType; ///< One of PROFILER_EVENT_* values.
+	UBYTE ubZone; ///< Zone index, unused by frame events.
+} tProfilerEvent;
+
+/* Functions */
+
+#ifdef ACE_PROFILER
+
+/**
+ * @brief Allocates profiler's event ring and starts capturing.
+ *
+ * @param uwEventCount Number of events in ring. Each zone takes two events.
+ * @return 1 on success, otherwise 0.
+ *
+ * @see profilerDestroy()
+ */
+UBYTE _profilerCreate(UWORD uwEventCount);
+
+/**
+ * @brief Frees profiler's event ring.
+ *
+ * @see profilerCreate()
+ */
+void _profilerDestroy(void);
+
+/**
+ * @brief Registers new zone. May be called before profilerCreate().
+ *
+ * @param szName Name of zone. Must stay valid until next profilerDump().
+ * @return Zone index to be passed to profilerZoneBegin(). If there are
+ * already PROFILER_ZONE_MAX zones, PROFILER_ZONE_OVERFLOW is returned.
+ */
+tProfilerZone _profilerZoneCreate(const char *szName);
+
+/**
+ * @brief Marks the start of given zone. Zones may be nested, but those
+ * deeper than PROFILER_DEPTH_MAX aren't recorded.
+ *
+ * @param ubZone Zone returned by profilerZoneCreate() or builtin one.
+ *
+ * @see profilerZoneEnd()
+ */
+void _profilerZoneBegin(tProfilerZone ubZone);
+
+/**
+ * @brief Marks the end of most recently begun zone.
+ *
+ * @see profilerZoneBegin()
+ */
+void _profilerZoneEnd(void);
+
+/**
+ * @brief Marks the start of new frame. Call it once per game loop iteration.
+ */
+void _profilerFrameBegin(void);
+
+/**
+ * @brief Pauses or resumes event capture. Pause it right after noticing
+ * a slow frame to keep it in the ring until it's dumped.
+ * Zones in progress are ended on pause and begun again on resume, so that
+ * captured zones stay balanced. Zone calls may be made while paused.
+ *
+ * @param isEnabled 1 to capture events, 0 to ignore them.
+ */
+void _profilerSetEnabled(UBYTE isEnabled);
+
+/**
+ * @brief Writes captured events to file, oldest first. Uses OS.
+ *
+ * @param szPath Path of dump file.
+ * @return 1 on success, otherwise 0.
+ */
+UBYTE _profilerDump(const char *szPath);
+
+#define profilerCreate(uwEventCount) _profilerCreate(uwEventCount)
+#define profilerDestroy() _profilerDestroy()
+#define profilerZoneCreate(szName) _profilerZoneCreate(szName)
+#define profilerZoneBegin(ubZone) _profilerZoneBegin(ubZone)
+#define profilerZoneEnd() _profilerZoneEnd()
+#define profilerFrameBegin() _profilerFrameBegin()
+#define profilerSetEnabled(isEnabled) _profilerSetEnabled(isEnabled)
+#define profilerDump(szPath) _profilerDump(szPath)
+
+#else
+#define profilerCreate(uwEventCount) 0
+#define profilerDestroy()
+#define profilerZoneCreate(szName) 0
+#define profilerZoneBegin(ubZone)
+#define profilerZoneEnd()
+#define profilerFrameBegin()
+#define profilerSetEnabled(isEnabled)
+#define profilerDump(szPath) 0
+#endif // ACE_PROFILER
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_MANAGERS_PROFILER_H_
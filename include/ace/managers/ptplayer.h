@@ -16,19 +16,37 @@ extern "C" {
 #define PTPLAYER_VOLUME_MAX 64
 #define PTPLAYER_SFX_CHANNEL_ANY 0xFF
 #define PTPLAYER_MOD_SAMPLE_COUNT 31
+#define PTPLAYER_MIXER_VOICES_MAX 8
 
 #include <ace/types.h>
+#include <ace/utils/file.h>
+#include <ace/managers/chip_heap.h>
+#ifdef AMIGA
+// Not used by ptplayer, kept for games relying on them being included here
 #include <ace/utils/bitmap.h>
 #include <ace/utils/font.h>
+#endif // AMIGA
 
 #if defined(ACE_DEBUG_ALL) && !defined(ACE_DEBUG_PTPLAYER)
 #define ACE_DEBUG_PTPLAYER
 #endif
 
+// Measures raster time spent in ptplayer's main interrupt.
+// See ptplayerProfileLog().
+#if defined(ACE_DEBUG_ALL) && !defined(ACE_DEBUG_PTPLAYER_PROFILE)
+#define ACE_DEBUG_PTPLAYER_PROFILE
+#endif
+
+// Effect indices passed to ptplayerHostOnFx(): 0..15 for main commands,
+// PTPLAYER_FX_E_FIRST + x for extended commands Ex.
+#define PTPLAYER_FX_E_FIRST 16
+#define PTPLAYER_FX_COUNT 32
+
 typedef struct _tPtplayerSfx {
 	UWORD *pData;       ///< Sample start in Chip RAM, even address.
 	UWORD uwWordLength; ///< Sample length in words.
 	UWORD uwPeriod;     ///< Hardware replay period for sample.
+	tChipHandle uwChipHandle; ///< Non-zero if pData is allocated on chip heap.
 } tPtplayerSfx;
 
 typedef struct _tPtplayerSampleHeader {
@@ -53,9 +71,12 @@ typedef struct _tPtplayerMod {
 	char pFileFormatTag[4];  ///< Should be "M.K." for 31-sample format.
 	// MOD pattern/sample data follows
 
-	UBYTE *pPatterns;
+	UBYTE *pPatterns; ///< Raw patterns or packed channel streams.
 	UWORD *pSampleStarts[PTPLAYER_MOD_SAMPLE_COUNT];
 	ULONG ulPatternsSize;
+	UWORD *pPatternOffsets; ///< Packed patterns only: offsets of each pattern's
+	                        ///  channel streams in pPatterns, zero otherwise.
+	UWORD uwPatternOffsetsSize;
 	UBYTE isOwningSamples;
 } tPtplayerMod;
 
@@ -64,6 +85,41 @@ typedef struct tPtplayerSamplePack {
 	UWORD *pData;
 } tPtplayerSamplePack;
 
+/**
+ * @brief Long sample played from file, fed to Paula through a ring of small
+ * CHIP RAM buffers.
+ *
+ * @see ptplayerStreamCreateFromFd()
+ */
+typedef struct _tPtplayerStream {
+	tFile *pFile; ///< Source of sample data.
+	UBYTE *pBuffers; ///< Buffer ring in CHIP RAM, followed by a silent buffer.
+	ULONG ulDataPos; ///< Sample data position in file.
+	ULONG ulSampleCount; ///< Total number of samples in file.
+	ULONG ulSamplesLeft; ///< Samples left to be read in current pass.
+	UWORD uwBufferSize; ///< Size of each buffer, in bytes.
+	UWORD uwPeriod;
+	UBYTE ubChannel;
+	UBYTE ubCompression;
+	UBYTE isLooped;
+	UBYTE isDataEnd; ///< Set after last sample of non-looped stream was read.
+	volatile UBYTE isPlaying;
+	BYTE bDecodedLast; ///< Last decoded sample of compressed stream.
+	volatile UBYTE ubPlaying; ///< Buffer currently played by Paula.
+	volatile UBYTE ubQueued; ///< Buffer to be played by Paula after current one.
+	UBYTE ubNextFill; ///< First of free buffers, to be filled from file.
+	UBYTE ubNextQueue; ///< First of filled buffers, to be queued for Paula.
+	volatile UBYTE ubFreeCount;
+	volatile UBYTE ubReadyCount;
+#if defined(ACE_DEBUG)
+	/**
+	 * @brief Number of times Paula had to play silence because buffers
+	 * weren't refilled in time.
+	 */
+	volatile ULONG ulUnderrunCount;
+#endif
+} tPtplayerStream;
+
 typedef void (*tPtplayerCbSongEnd)(void);
 
 /**
@@ -77,6 +133,12 @@ void ptplayerCreate(UBYTE isPal);
 
 void ptplayerDestroy(void);
 
+/**
+ * @brief Does ptplayer's non-interrupt work. Must be called once per frame
+ * when sfx mixer is active.
+ *
+ * @see ptplayerMixerCreate()
+ */
 void ptplayerProcess(void);
 
 /**
@@ -168,6 +230,7 @@ void ptplayerSetMasterVolume(UBYTE ubMasterVolume);
 
 /**
  * @brief Define which channels are used for the player. Set bit 0 for channel 0, etc.
+ * Channels taken by sfx mixer or streams take the new setting once released.
  *
  * @param ubChannelMask Bit mask of music channels to be used. Uses bits 0..3.
  */
@@ -196,6 +259,7 @@ UBYTE ptplayerGetE8(void);
  * enough priority. When set to 4, no sound effects are played.
  *
  * At initialization, zero channels are reserved for music.
+ * Channels taken by sfx mixer count as used by sound effects.
  *
  * @param ubChannelCount Number of channels to be used only for playing music.
  */
@@ -235,6 +299,11 @@ tPtplayerSfx *ptplayerSfxCreateFromPath(const char *szPath, UBYTE isFast);
  * Note that this function sets SFX period based on currently set PAL/NTSC video
  * mode. If you plan to change it after loading SFX, be sure to adjust
  * the period value for new mode.
+ * Compressed v2 files are decoded during load straight into sample buffer,
+ * so they have no playback overhead.
+ * If chip heap is created, CHIP samples are allocated from it, so that they
+ * can be moved by chipHeapCompact() - don't compact while they are played
+ * on hardware channels.
  * @note This function may use OS.
  *
  * @param pFileSfx Handle to the .sfx file. Will be closed on function return.
@@ -320,6 +389,58 @@ void ptplayerWaitForSfx(void);
 
 UBYTE ptplayerSfxLengthInFrames(const tPtplayerSfx *pSfx);
 
+/**
+ * @brief Starts software mixing of sound effects on one or two channels,
+ * allowing more simultaneous sfx than there are free channels.
+ * Voices are mixed into double-buffered chip RAM streams in
+ * ptplayerProcess(), each buffer lasting two frames.
+ *
+ * Mixer channels are taken from music and hardware sfx playback until
+ * ptplayerMixerDestroy(), so set up ptplayerReserveChannelsForMusic() with
+ * remaining channels in mind.
+ *
+ * Voice volumes are pre-scaled so that mixed stream never clips, so each
+ * voice gets quieter the more voices there are per channel. Consider
+ * audio_conv's -n to normalize sfx used with mixer.
+ * @note This function may use OS.
+ *
+ * @param ubChannelMask Channels to be used for mixer output, 1 or 2 of them.
+ * Set bit 0 for channel 0, bit 1 for channel 1, etc. Voices are spread
+ * evenly among them.
+ * @param ubVoiceCount Max number of simultaneously mixed sfx, up to
+ * PTPLAYER_MIXER_VOICES_MAX. Mixer's CPU cost grows linearly with it,
+ * so it's the main knob for keeping mixing within frame budget.
+ * @param uwPeriod Paula period of mixer output. Sfx with same period are
+ * mixed fastest, others are resampled on the fly.
+ * @return 1 on success, otherwise 0.
+ *
+ * @see ptplayerMixerSfxPlay()
+ * @see ptplayerProfileLog()
+ */
+UBYTE ptplayerMixerCreate(UBYTE ubChannelMask, UBYTE ubVoiceCount, UWORD uwPeriod);
+
+/**
+ * @brief Stops software mixing of sound effects and gives mixer channels back
+ * to ptplayer. Called automatically by ptplayerDestroy().
+ * @note This function may use OS.
+ */
+void ptplayerMixerDestroy(void);
+
+/**
+ * @brief Plays sound effect using the software mixer.
+ * When all voices are busy, the one with lowest priority gets replaced.
+ * When priorities are the same, then the older sfx is replaced.
+ * Must be called outside of interrupts.
+ *
+ * @param pSfx Sfx to be played. May be located in either CHIP or FAST memory.
+ * @param ubVolume Playback volume 0..64.
+ * @param ubPriority Playback priority. The bigger the value, the higher
+ * the priority.
+ */
+void ptplayerMixerSfxPlay(
+	const tPtplayerSfx *pSfx, UBYTE ubVolume, UBYTE ubPriority
+);
+
 /**
  * @brief Loads MOD sample pack from file at given path.
  * @note This function may use OS.
@@ -331,6 +452,9 @@ tPtplayerSamplePack *ptplayerSampleDataCreateFromPath(const char *szPath);
 
 /**
  * @brief Loads MOD sample pack from file at given path.
+ * Both raw and compressed sample packs made by mod_tool are supported.
+ * Compressed ones are decoded into chip RAM in small pieces, so that loading
+ * needs only a small additional fast RAM buffer.
  * @note This function may use OS.
  *
  * @param pFileSamples Handle to the sample pack file to be loaded. Will be closed on function return.
@@ -346,6 +470,105 @@ tPtplayerSamplePack *ptplayerSampleDataCreateFromFd(tFile *pFileSamples);
  */
 void ptplayerSamplePackDestroy(tPtplayerSamplePack *pSamplePack);
 
+/**
+ * @brief Starts playing long .sfx file on given channel, reading it in small
+ * pieces instead of loading it whole to CHIP RAM.
+ *
+ * Paula plays the stream from a ring of CHIP RAM buffers, each lasting two
+ * frames. They're handed to Paula by channel's audio interrupt, while
+ * refilling them from file is done by ptplayerProcess() in batches of
+ * several buffers, so that file I/O is done rarely. This gives game loop
+ * a couple of frames of leeway, in which stream will keep on playing.
+ * ptplayerProcess() must be called once per frame.
+ *
+ * Refill doesn't take the OS by itself - it's up to file's implementation.
+ * Files which serve data from RAM are refilled without stalling anything.
+ * Disk files take the OS on each read, which waits for vertical blank and
+ * stops all ACE interrupts until read is done. This stalls the game loop
+ * for at least a frame per refill batch, pauses CIA-timed music and keeps
+ * Paula repeating stream's current buffer if read takes longer than it.
+ *
+ * Channel is taken from music and sfx playback until stream is destroyed.
+ * Both uncompressed and compressed .sfx files are supported. Lengths beyond
+ * what fits in .sfx header are taken from file's size.
+ * @note This function may use OS.
+ *
+ * @param pFileSfx Handle to .sfx file. It will be closed on stream destruction
+ * or failure.
+ * @param ubChannel Channel to play stream on (0..3).
+ * @param ubVolume Playback volume 0..64, unaffected by the song's master volume.
+ * @param isLooped Set to 1 to play the stream repeatedly, otherwise it plays
+ * once and then goes silent.
+ * @return Newly created stream, zero on failure.
+ *
+ * @see ptplayerStreamDestroy()
+ * @see ptplayerStreamIsPlaying()
+ */
+tPtplayerStream *ptplayerStreamCreateFromFd(
+	tFile *pFileSfx, UBYTE ubChannel, UBYTE ubVolume, UBYTE isLooped
+);
+
+/**
+ * @brief Starts playing long .sfx file at given path on given channel.
+ * @note This function may use OS.
+ *
+ * @see ptplayerStreamCreateFromFd()
+ */
+tPtplayerStream *ptplayerStreamCreateFromPath(
+	const char *szPath, UBYTE ubChannel, UBYTE ubVolume, UBYTE isLooped
+);
+
+/**
+ * @brief Stops given stream, closes its file and gives its channel back to
+ * ptplayer. Called automatically for active streams by ptplayerDestroy().
+ * @note This function may use OS.
+ *
+ * @param pStream Stream to be destroyed.
+ */
+void ptplayerStreamDestroy(tPtplayerStream *pStream);
+
+/**
+ * @brief Checks if stream is still playing.
+ *
+ * @param pStream Stream to be checked.
+ * @return 1 if stream is playing, 0 if non-looped one has played to the end.
+ */
+UBYTE ptplayerStreamIsPlaying(const tPtplayerStream *pStream);
+
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+/**
+ * @brief Clears raster time counters of music & sfx-only interrupt processing
+ * and sfx mixing.
+ * Called automatically by ptplayerLoadMod(), so that worst cases are per song.
+ */
+void ptplayerProfileReset(void);
+
+/**
+ * @brief Writes to log the number of music and sfx-only interrupt calls,
+ * as well as sfx mixer's buffer fills, along with average and worst raster
+ * lines spent in them since last reset. Also logs underruns of active streams.
+ * Must not be called from interrupts.
+ */
+void ptplayerProfileLog(void);
+#endif
+
+#if !defined(AMIGA)
+/**
+ * @brief Called by host builds after each write to Paula's audio registers.
+ * Must be implemented by the program running the replay, e.g. mod_render.
+ */
+void ptplayerHostOnRegWrite(void);
+
+/**
+ * @brief Called by host builds before each effect handler dispatch.
+ * Must be implemented by the program running the replay, e.g. mod_render.
+ *
+ * @param ubFx Effect index, less than PTPLAYER_FX_COUNT.
+ * Extended commands are reported both as 0xE and PTPLAYER_FX_E_FIRST + x.
+ */
+void ptplayerHostOnFx(UBYTE ubFx);
+#endif // !AMIGA
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,6 +10,8 @@ extern "C" {
 #endif
 
 #include <ace/types.h> // Amiga typedefs
+#include <ace/utils/arena.h>
+#include <ace/utils/pool.h>
 
 /* Types */
 
@@ -36,6 +38,12 @@ typedef struct _tState {
 	struct _tState *pPrev; ///< Optional pointer to previous state.
 	                       ///< Zero if there is no previous state. Will be
 	                       ///< overriden when pushed into state manager.
+
+	tArena *pArenaChip;    ///< Optional CHIP arena, rewound on state exit.
+	tArena *pArenaFast;    ///< Optional FAST arena, rewound on state exit.
+	tPool *pPool;          ///< Optional pool, reset on state exit.
+	ULONG ulArenaChipMark; ///< Mark of pArenaChip taken on state entry.
+	ULONG ulArenaFastMark; ///< Mark of pArenaFast taken on state entry.
 } tState;
 
 /**
@@ -82,6 +90,21 @@ tState *stateCreate(
  */
 void stateDestroy(tState *pState);
 
+/**
+ * Attaches allocators which are scoped to given state's lifetime.
+ * Arenas' marks are taken just before cbCreate and they are rewound to them
+ * right after cbDestroy, so everything allocated from them during state's life
+ * gets freed without OS involvement. Arenas may be shared between states
+ * which are pushed on top of each other. Pool is reset after cbDestroy.
+ * @param pState: Pointer to state which should own allocators.
+ * @param pArenaChip: CHIP arena scoped to given state. May be zero.
+ * @param pArenaFast: FAST arena scoped to given state. May be zero.
+ * @param pPool: Pool scoped to given state. May be zero.
+ */
+void stateSetAllocators(
+	tState *pState, tArena *pArenaChip, tArena *pArenaFast, tPool *pPool
+);
+
 /**
  * Pushes given state over current state in given state manager. Calls cbSuspend
  * on old state and cbCreate on new state. Will update pPrev in given state to
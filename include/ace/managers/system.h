@@ -9,7 +9,9 @@
 extern "C" {
 #endif
 
+#ifdef AMIGA
 #include <graphics/gfxbase.h> // Required for GfxBase
+#endif
 #include <ace/types.h>
 #include <ace/utils/custom.h>
 
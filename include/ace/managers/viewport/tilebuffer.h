@@ -77,6 +77,9 @@ typedef enum tTileBufferCreateTags {
 	/**
 	 * @brief Max length of tile redraw queue. Mandatory, must be non-zero.
 	 *
+	 * Each queue entry holds a run of vertically adjacent tiles in a single
+	 * column, so duplicate and neighbouring invalidations share one entry.
+	 *
 	 * @see tileBufferQueueProcess()
 	 */
 	TAG_TILEBUFFER_REDRAW_QUEUE_LENGTH = (TAG_USER | 11),
@@ -101,6 +104,15 @@ typedef struct tMarginState {
 	WORD wTileEnd;  ///< Index of last+1  tile to update in row/col
 } tMarginState;
 
+/**
+ * @brief Redraw queue entry - run of adjacent tiles in a single tile column.
+ */
+typedef struct tTileBufferRedrawRun {
+	UWORD uwTileX;     ///< Column of the run
+	UWORD uwTileY;     ///< First tile of the run
+	UWORD uwTileCount; ///< Number of consecutive tiles, going down
+} tTileBufferRedrawRun;
+
 typedef struct tRedrawState {
 #if defined(ACE_SCROLLBUFFER_ENABLE_SCROLL_X)
 	tMarginState sMarginL; ///< Data for left margin
@@ -120,8 +132,8 @@ typedef struct tRedrawState {
 	tMarginState *pMarginOppositeY; ///< Opposite margin of pMarginY
 #endif
 	// Tile redraw queue
-	tUwCoordYX *pPendingQueue;
-	UBYTE ubPendingCount;
+	tTileBufferRedrawRun *pPendingQueue;
+	UWORD uwPendingCount;
 } tRedrawState;
 
 typedef struct tTileBufferManager {
@@ -142,7 +154,7 @@ typedef struct tTileBufferManager {
 	// Margin & queue geometry
 	UBYTE ubMarginXLength; ///< Tile number in margins: left & right
 	UBYTE ubMarginYLength; ///< Ditto, up & down
-	UBYTE ubQueueSize;
+	UWORD uwQueueSize;     ///< Max number of runs in redraw queue
 	// Redraw state and double buffering
 	UBYTE ubStateIdx;
 	tRedrawState pRedrawStates[2];
@@ -157,11 +169,41 @@ typedef struct tTileBufferManager {
  * @brief Processes tile queue. Typically should be called once per game loop,
  * but other refreshing strategies can be used for better load balancing.
  *
+ * Redraws a single tile per call.
+ *
  * @param pManager The tile manager to be processed.
  * @see tileBufferProcess()
+ * @see tileBufferQueueProcessBudget()
  */
 void tileBufferQueueProcess(tTileBufferManager *pManager);
 
+/**
+ * @brief Processes tile queue until it's empty or given budget is exhausted.
+ *
+ * Each queued run of tiles is drawn with a single blitter setup. The raster
+ * line budget is checked between runs, so it may be exceeded by the time
+ * needed to draw the last one.
+ *
+ * @param pManager The tile manager to be processed.
+ * @param uwMaxTiles Max number of tiles to be drawn. Zero means no limit.
+ * @param uwMaxLines Max number of raster lines which may pass while
+ * processing. Zero means no limit.
+ * @return Number of tiles drawn.
+ * @see tileBufferQueueProcess()
+ */
+UWORD tileBufferQueueProcessBudget(
+	tTileBufferManager *pManager, UWORD uwMaxTiles, UWORD uwMaxLines
+);
+
+/**
+ * @brief Returns number of tiles still waiting in redraw queue of the buffer
+ * which is going to be processed next.
+ *
+ * @param pManager The tile manager to be checked.
+ * @return Number of pending tiles.
+ */
+UWORD tileBufferQueueGetPendingTileCount(const tTileBufferManager *pManager);
+
 /**
  * Tilemap buffer manager create fn. See TAG_TILEBUFFER_* for available options.
  *
@@ -223,12 +265,22 @@ void tileBufferDrawTileQuick(
 /**
  * Redraws all tiles intersecting with given rectangle
  * Only tiles currently on buffer are redrawn
+ * Tiles are queued column by column, merging with already queued ones.
  */
 void tileBufferInvalidateRect(
 	tTileBufferManager *pManager, UWORD uwX, UWORD uwY,
 	UWORD uwWidth, UWORD uwHeight
 );
 
+/**
+ * @brief Schedules redraw of given tile using redraw queue.
+ * Tiles already queued or adjacent to queued ones in the same column
+ * are merged into a single queue entry.
+ *
+ * @param pManager The tile manager to be used.
+ * @param uwTileX The X coordinate of tile, in tile-space.
+ * @param uwTileY The Y coordinate of tile, in tile-space.
+ */
 void tileBufferInvalidateTile(
 	tTileBufferManager *pManager, UWORD uwTileX, UWORD uwTileY
 );
@@ -39,9 +39,10 @@ typedef int32_t LONG;
 #define UWORD_MAX 0xFFFFu
 #define UBYTE_MAX 0xFFu
 
-#if defined(__CODE_CHECKER__) || defined(__INTELLISENSE__)
+#if defined(__CODE_CHECKER__) || defined(__INTELLISENSE__) || !defined(AMIGA)
 // My realtime source checker has problems with GCC asm() expanded from REGARG()
-// being in fn arg list, so I just use blank defines for it
+// being in fn arg list, so I just use blank defines for it.
+// Host builds, e.g. tools running parts of ACE on PC, don't need them either.
 #define INTERRUPT
 #define INTERRUPT_END do {} while(0)
 #define HWINTERRUPT
@@ -0,0 +1,120 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_UTILS_ARENA_H_
+#define _ACE_UTILS_ARENA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Arena (bump) allocator.
+ * Reserves one big memory block on creation and then serves allocations
+ * from it by just advancing the offset, so that no OS calls are made and
+ * allocating during gameplay doesn't need to wake the system up.
+ * There is no individual free - memory is given back by rewinding the arena
+ * to previously obtained mark or by resetting it as a whole.
+ *
+ * On ACE_DEBUG builds each allocation is surrounded with the same trash guards
+ * as memAlloc() ones, which are checked on each rewind and on demand.
+ */
+
+#include <ace/types.h>
+#include <ace/managers/memory.h>
+
+/**
+ * @brief Alignment of each arena allocation, same as the one of AllocMem().
+ */
+#define ARENA_ALIGNMENT 8
+
+/* Types */
+
+typedef struct _tArena {
+	UBYTE *pData; ///< Reserved memory block.
+	ULONG ulSize; ///< Size of reserved memory block.
+	ULONG ulUsed; ///< Offset of next allocation in pData.
+	ULONG ulPeak; ///< Highest ulUsed since arena creation.
+	ULONG ulMemFlags; ///< Flags used for reserving memory block.
+} tArena;
+
+/* Functions */
+
+/**
+ * @brief Creates new arena, reserving memory block of given size up front.
+ * This is the only place where the OS is involved, so do it on state load.
+ *
+ * @param ulSize Size of memory block to be reserved, in bytes. On ACE_DEBUG
+ * builds each allocation takes additional 12 bytes for guards and bookkeeping.
+ * @param ulMemFlags Memory flags for reserved block, e.g. MEMF_CHIP.
+ * @return Pointer to newly created arena, zero on failure.
+ *
+ * @see arenaDestroy()
+ */
+tArena *arenaCreate(ULONG ulSize, ULONG ulMemFlags);
+
+/**
+ * @brief Destroys given arena, freeing its memory block and thus
+ * invalidating all memory allocated from it.
+ *
+ * @param pArena Arena to be destroyed.
+ *
+ * @see arenaCreate()
+ */
+void arenaDestroy(tArena *pArena);
+
+/**
+ * @brief Allocates memory from given arena. Doesn't involve OS.
+ * Returned memory is not cleared.
+ *
+ * @param pArena Arena to allocate memory from.
+ * @param ulSize Number of bytes to be allocated.
+ * @return Pointer to allocated memory, aligned to ARENA_ALIGNMENT.
+ * Zero if there is not enough space left in the arena.
+ */
+void *arenaAlloc(tArena *pArena, ULONG ulSize);
+
+/**
+ * @brief Returns the mark of current arena fill, which may be later used
+ * for freeing all allocations made after it.
+ *
+ * @param pArena Arena to get mark from.
+ * @return Current arena mark.
+ *
+ * @see arenaRewind()
+ */
+ULONG arenaGetMark(const tArena *pArena);
+
+/**
+ * @brief Frees all allocations made after obtaining given mark.
+ * On ACE_DEBUG builds, checks the guards of those allocations beforehand.
+ *
+ * @param pArena Arena to be rewound.
+ * @param ulMark Mark previously obtained with arenaGetMark().
+ *
+ * @see arenaGetMark()
+ * @see arenaReset()
+ */
+void arenaRewind(tArena *pArena, ULONG ulMark);
+
+/**
+ * @brief Frees all allocations made in given arena.
+ *
+ * @param pArena Arena to be reset.
+ */
+void arenaReset(tArena *pArena);
+
+void _arenaCheckIntegrity(const tArena *pArena, UWORD uwLine, const char *szFile);
+
+#ifdef ACE_DEBUG
+# define arenaCheckIntegrity(pArena) _arenaCheckIntegrity(pArena, __LINE__, __FILE__)
+#else
+# define arenaCheckIntegrity(pArena)
+#endif // ACE_DEBUG
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_UTILS_ARENA_H_
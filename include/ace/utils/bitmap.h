@@ -11,6 +11,7 @@ extern "C" {
 
 #include <ace/types.h>
 #include <ace/utils/file.h>
+#include <ace/managers/chip_heap.h>
 
 // File has its own 'flags' field - could be used in new ACE bitmap struct
 #define BITMAP_INTERLEAVED 1
@@ -54,6 +55,17 @@ typedef struct _tBitMap {
  */
 #define BMF_CONTIGUOUS (1 << 6)
 
+/**
+ * @brief Allocates bitplanes in one block on chip heap, so that they can be
+ * moved by chipHeapCompact(). Planes pointers are updated after each move.
+ * Non-interleaved bitmaps are then allocated as if BMF_CONTIGUOUS was passed.
+ * Chip heap handle is stored in bitmap's pad field.
+ *
+ * @see chipHeapCreate()
+ * @see bitmapGetChipHandle()
+ */
+#define BMF_RELOCATABLE (1 << 7)
+
 /**
  * @brief New bitmap format.
  * Don't use until adopted into entire engine - this struct is more like feature
@@ -193,6 +205,18 @@ UBYTE bitmapIsInterleaved(const tBitMap *pBitMap);
  */
 UBYTE bitmapIsChip(const tBitMap *pBitMap);
 
+/**
+ * @brief Returns chip heap handle of given bitmap's bitplanes.
+ * Can be used for locking currently displayed bitmap during compaction.
+ *
+ * @param pBitMap Bitmap to be checked.
+ * @return Chip heap handle if bitmap was created with BMF_RELOCATABLE,
+ * otherwise zero.
+ *
+ * @see chipHeapSetLocked()
+ */
+tChipHandle bitmapGetChipHandle(const tBitMap *pBitMap);
+
 /**
  *  @brief Saves basic Bitmap information to log file.
  *
@@ -12,8 +12,61 @@ extern "C" {
 #include <ace/macros.h>
 
 #ifdef AMIGA
-
 #include <hardware/custom.h> // Custom chip register addresses
+#include <hardware/intbits.h> // INTF_* flags
+#include <hardware/dmabits.h> // DMAF_* flags
+#else
+// Host builds, e.g. tools running ptplayer on PC, get only the registers
+// they use, backed by regular memory. Layout doesn't match real hardware.
+
+struct AudChannel {
+	UWORD *ac_ptr; ///< Sample start.
+	UWORD ac_len; ///< Sample length, in words.
+	UWORD ac_per; ///< Period.
+	UWORD ac_vol; ///< Volume, 0..64.
+	UWORD ac_dat;
+};
+
+struct Custom {
+	UWORD dmaconr;
+	UWORD intenar;
+	UWORD intreqr;
+	UWORD dmacon;
+	UWORD intena;
+	UWORD intreq;
+	struct AudChannel aud[4];
+};
+
+// Subset of NDK's hardware/intbits.h and hardware/dmabits.h
+#define INTB_SETCLR 15
+#define INTB_INTEN 14
+#define INTB_EXTER 13
+#define INTB_AUD3 10
+#define INTB_AUD2 9
+#define INTB_AUD1 8
+#define INTB_AUD0 7
+#define INTB_VERTB 5
+#define INTF_SETCLR BV(INTB_SETCLR)
+#define INTF_INTEN BV(INTB_INTEN)
+#define INTF_EXTER BV(INTB_EXTER)
+#define INTF_AUD3 BV(INTB_AUD3)
+#define INTF_AUD2 BV(INTB_AUD2)
+#define INTF_AUD1 BV(INTB_AUD1)
+#define INTF_AUD0 BV(INTB_AUD0)
+#define INTF_VERTB BV(INTB_VERTB)
+
+#define DMAB_SETCLR 15
+#define DMAB_AUD3 3
+#define DMAB_AUD2 2
+#define DMAB_AUD1 1
+#define DMAB_AUD0 0
+#define DMAF_SETCLR BV(DMAB_SETCLR)
+#define DMAF_AUD3 BV(DMAB_AUD3)
+#define DMAF_AUD2 BV(DMAB_AUD2)
+#define DMAF_AUD1 BV(DMAB_AUD1)
+#define DMAF_AUD0 BV(DMAB_AUD0)
+#define DMAF_AUDIO (DMAF_AUD0 | DMAF_AUD1 | DMAF_AUD2 | DMAF_AUD3)
+#endif // AMIGA
 
 #define REGPTR volatile * const
 #define HARDWARE_SPRITE_CHANNEL_COUNT 8
@@ -208,8 +261,6 @@ extern tCopperUlong FAR REGPTR g_pCop2Lc;
 
 extern tCia FAR REGPTR g_pCia[CIA_COUNT];
 
-#endif // AMIGA
-
 #ifdef __cplusplus
 }
 #endif
@@ -52,6 +52,38 @@ static inline ULONG endianIntel32(ULONG ulIn) {
 #endif // AMIGA
 }
 
+/**
+ *  @brief Converts _native_ 16-bit to Big (Amiga) Endian.
+ *
+ *  @param uwIn 16-bit value to be converted
+ *  @return Supplied value, byte-swapped if neccessary.
+ *
+ *  @see endianAmiga32()
+ */
+static inline UWORD endianAmiga16(UWORD uwIn) {
+#ifdef AMIGA
+	return uwIn;
+#else
+	return (uwIn << 8) | (uwIn >> 8);
+#endif // AMIGA
+}
+
+/**
+ *  @brief Converts _native_ 32-bit to Big (Amiga) Endian.
+ *
+ *  @param ulIn 32-bit value to be converted
+ *  @return Supplied value, byte-swapped if neccessary.
+ *
+ *  @see endianAmiga16()
+ */
+static inline ULONG endianAmiga32(ULONG ulIn) {
+#ifdef AMIGA
+	return ulIn;
+#else
+	return (ulIn << 24) | ((ulIn&0xFF00) << 8) | ((ulIn & 0xFF0000) >> 8) | (ulIn >> 24);
+#endif // AMIGA
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,21 +29,91 @@ extern "C" {
 #define FONT_SHADOW  16
 #define FONT_COOKIE  32
 #define FONT_LAZY    64
+#define FONT_CACHED  128
 #define FONT_CENTER (FONT_HCENTER|FONT_VCENTER)
 
+/**
+ * @brief Codepoint returned by fontUtf8Next() on malformed UTF-8 sequence.
+ */
+#define FONT_CODEPOINT_INVALID 0xFFFD
+
+/**
+ * @brief Single glyph placement in atlas font's bitmap.
+ * Glyphs are stored trimmed vertically, hence ubOffsY needs to be added
+ * to line's Y position when drawing.
+ */
+typedef struct _tFontGlyph {
+	UWORD uwCodepoint; ///< Character code.
+	UWORD uwX;         ///< Glyph X position in atlas bitmap.
+	UWORD uwY;         ///< Glyph Y position in atlas bitmap.
+	UBYTE ubWidth;     ///< Glyph width, also used as advance.
+	UBYTE ubHeight;    ///< Height of glyph stored in atlas.
+	UBYTE ubOffsY;     ///< Offset of glyph from the top of the line.
+	UBYTE ubPad;
+} tFontGlyph;
+
+/**
+ * @brief Max glyph width supported by pre-shifted glyph cache.
+ * Glyphs up to 16px wide span at most two words regardless of X position.
+ */
+#define FONT_SHIFT_CACHE_MAX_WIDTH 16
+
+/**
+ * @brief Glyph rows pre-shifted to all 16 sub-word positions, stored in FAST.
+ * Allows assembling text with CPU by ORing ready words into destination
+ * instead of doing separate blit with shift for each glyph.
+ *
+ * Rows of glyph are stored as [shift][row], each being a longword with
+ * leftmost glyph pixel at bit 31 - shift. Glyph indices are char codes
+ * for version 1 fonts and pGlyphs indices for atlas fonts.
+ */
+typedef struct _tFontShiftCache {
+	UWORD uwGlyphCount;   ///< Number of glyphs in cache.
+	ULONG ulRowCount;     ///< Total number of rows in pRows.
+	ULONG *pGlyphOffsets; ///< pRows index of each glyph's unshifted first row.
+	ULONG *pRows;         ///< Pre-shifted glyph rows.
+} tFontShiftCache;
+
+/**
+ * @brief Text bitmap cache counters.
+ * Hit rate can be calculated as ulHits / (ulHits + ulMisses).
+ *
+ * @see fontCacheGetStats()
+ */
+typedef struct _tFontCacheStats {
+	ULONG ulHits;       ///< Lookups which returned already assembled text.
+	ULONG ulMisses;     ///< Lookups which needed text assembly.
+	ULONG ulEvictions;  ///< Entries dropped to fit in budget.
+	ULONG ulUsedBytes;  ///< CHIP memory taken by cached bitmaps.
+	ULONG ulBudget;     ///< Max CHIP memory allowed for cached bitmaps.
+	UWORD uwEntryCount; ///< Number of currently cached texts.
+} tFontCacheStats;
+
 /**
  *  @brief The font structure.
- *  All font glyphs are stored in continuous 1bb bitmap. Its width is
- *  determined by glyph count and height by font size.
+ *  In version 1 fonts, all font glyphs are stored in continuous 1bb bitmap.
+ *  Its width is determined by glyph count and height by font size.
  *  Not all glyphs in codepage must be included - all missing glyphs share
  *  offset with next implemented glyph.
+ *
+ *  In version 2 (atlas) fonts, glyphs are bin-packed in 2D bitmap and each of
+ *  them is described by tFontGlyph. pCharOffsets is then zero.
+ *  Those fonts may contain any codepoint from Unicode's Basic Multilingual
+ *  Plane and texts drawn or measured with them are treated as UTF-8.
+ *  Glyphs for codepoints below 256 are looked up directly through pGlyphPage,
+ *  the rest is found with binary search.
  */
 typedef struct _tFont {
 	UWORD uwWidth;       ///< Packed font bitmap width.
-	UWORD uwHeight;      ///< Packed font bitmap height.
+	UWORD uwHeight;      ///< Font line height.
 	UBYTE ubChars;       ///< Glyph count in font.
 	UWORD *pCharOffsets; ///< Glyph offsets in packed bitmap.
 	tBitMap *pRawData;   ///< Pointer to packed bitmap.
+	UWORD uwGlyphCount;  ///< Atlas glyph count, zero for version 1 fonts.
+	UWORD uwPageGlyphCount; ///< Number of atlas glyphs with codepoints 0..255.
+	tFontGlyph *pGlyphs; ///< Atlas glyphs sorted by codepoint, plus empty one.
+	UWORD *pGlyphPage;   ///< Lookup of pGlyphs index for codepoints 0..255.
+	tFontShiftCache *pShiftCache; ///< Optional CPU text assembly cache.
 } tFont;
 
 /**
@@ -76,6 +146,7 @@ tFont *fontCreateFromPath(const char *szPath);
 
 /**
  *  @brief Creates font instance from specified file.
+ *  Both single-row (version 1) and atlas (version 2) fonts are supported.
  *
  *  @param pFontFile Handle to the font file. Will be closed on function return.
  *  @return pointer to loaded font.
@@ -93,11 +164,41 @@ tFont *fontCreateFromFd(tFile *pFontFile);
  */
 void fontDestroy(tFont *pFont);
 
+/**
+ * @brief Creates pre-shifted glyph cache for given font.
+ * When font has the cache, fontDrawStr1bpp() assembles text using CPU instead
+ * of the blitter, which is much faster for small glyphs since there's no
+ * per-glyph blit setup. It comes at the cost of FAST memory: 64 bytes per
+ * each glyph row, e.g. 96 glyphs of 8px height take 48KiB.
+ *
+ * Only fonts with glyphs no wider than FONT_SHIFT_CACHE_MAX_WIDTH
+ * are supported.
+ *
+ * @param pFont Font for which cache should be created.
+ * @return 1 on success, 0 on failure.
+ *
+ * @see fontDestroyShiftCache()
+ */
+UBYTE fontCreateShiftCache(tFont *pFont);
+
+/**
+ * @brief Destroys pre-shifted glyph cache of given font, making it use
+ * the blitter for text assembly again.
+ * Also done automatically by fontDestroy().
+ *
+ * @param pFont Font of which cache should be destroyed.
+ *
+ * @see fontCreateShiftCache()
+ */
+void fontDestroyShiftCache(tFont *pFont);
+
 /**
  * @brief Draws given string using passed font on specified 1BPP bitmap.
  * This function draws text as fast as possible.
  * Background beneath bitmap is not cleared because you may want to remember
  * length of previous text and erase only relevant portion of bitmap.
+ * If font has pre-shifted glyph cache, text is assembled by CPU, so this
+ * function waits for the blitter to finish before writing to destination.
  *
  * @param pFont Font to be used.
  * @param pBitMap Destination bitmap.
@@ -154,8 +255,31 @@ void fontDestroyTextBitMap(tTextBitMap *pTextBitMap);
  */
 tUwCoordYX fontMeasureText(const tFont *pFont, const char *szText);
 
+/**
+ * @brief Gets glyph of given codepoint from atlas (version 2) font.
+ * Codepoints below 256 are looked up directly, others with binary search.
+ *
+ * @param pFont Atlas font to be used.
+ * @param ulCodepoint Unicode codepoint of glyph.
+ * @return Glyph for given codepoint. If there's none in font, zero-width glyph
+ * is returned.
+ */
+const tFontGlyph *fontGetGlyph(const tFont *pFont, ULONG ulCodepoint);
+
+/**
+ * @brief Decodes next codepoint from UTF-8 string and advances past it.
+ * Malformed sequences are consumed up to the offending byte and decoded as
+ * FONT_CODEPOINT_INVALID.
+ *
+ * @param pText Pointer to string pointer, which will be advanced to next char.
+ * Must not point at null terminator.
+ * @return Decoded codepoint.
+ */
+ULONG fontUtf8Next(const char **pText);
+
 /**
  * @brief Gets width of specified glyph on given font.
+ * For atlas fonts, the char is treated as a codepoint in range 0..255.
  *
  * @param pFont Font to be used for measurement.
  * @param c Glyph to be checked
@@ -199,6 +323,11 @@ void fontDrawTextBitMap(
  *  time-consuming. If same text is going to be redrawn in game loop, its bitmap
  *  buffer should be stored and used for redraw.
  *
+ *  Alternatively, FONT_CACHED flag may be passed to look up the text in text
+ *  bitmap cache first. pTextBitMap is then used only if text can't be cached
+ *  and may be zero if the cache is guaranteed to handle it - otherwise text
+ *  isn't drawn.
+ *
  *  @param pFont Font to be used for text assembly.
  *  @param pDest Destination bitmap.
  *  @param uwX X position on destination bitmap.
@@ -215,6 +344,65 @@ void fontDrawStr(
 	const char *szText, UBYTE ubColor, UBYTE ubFlags, tTextBitMap *pTextBitMap
 );
 
+/**
+ * @brief Creates text bitmap cache with given memory budget.
+ * Cache keeps assembled texts keyed by font and contents, so that texts which
+ * don't change between frames, like scores, labels or menu items, are drawn
+ * without being assembled again. When budget is exceeded, least recently used
+ * texts are evicted.
+ *
+ * @param ulBudget Max CHIP memory to be used by cached text bitmaps, in bytes.
+ *
+ * @see fontCacheDestroy()
+ * @see fontCacheGet()
+ */
+void fontCacheCreate(ULONG ulBudget);
+
+/**
+ * @brief Destroys text bitmap cache along with all cached text bitmaps.
+ *
+ * @see fontCacheCreate()
+ */
+void fontCacheDestroy(void);
+
+/**
+ * @brief Gets text bitmap with given text assembled with given font.
+ * On cache hit, returned bitmap is reused as is. On miss, new text bitmap is
+ * assembled and stored in cache, evicting least recently used entries
+ * if needed.
+ *
+ * Returned bitmap is owned by the cache and may be destroyed on any subsequent
+ * cache call, so don't store it for later.
+ *
+ * @param pFont Font to be used during text assembly.
+ * @param szText Text to be assembled.
+ * @return Text bitmap with assembled text, or zero if cache isn't created,
+ * text is empty or doesn't fit in cache budget.
+ */
+tTextBitMap *fontCacheGet(const tFont *pFont, const char *szText);
+
+/**
+ * @brief Removes all cached texts of given font.
+ * Done automatically by fontDestroy().
+ *
+ * @param pFont Font of which texts are to be removed.
+ */
+void fontCacheInvalidateFont(const tFont *pFont);
+
+/**
+ * @brief Returns text bitmap cache counters.
+ *
+ * @return Pointer to cache counters, valid until cache destruction.
+ *
+ * @see fontCacheResetStats()
+ */
+const tFontCacheStats *fontCacheGetStats(void);
+
+/**
+ * @brief Resets hit, miss and eviction counters of text bitmap cache.
+ */
+void fontCacheResetStats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,102 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_UTILS_POOL_H_
+#define _ACE_UTILS_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fixed-size block pool allocator.
+ * Reserves memory for given number of same-sized blocks on creation and then
+ * allocates and frees them in constant time using free list, without any
+ * OS calls. Suited for game objects which come and go during gameplay,
+ * e.g. projectiles, particles or sound effect buffers.
+ *
+ * On ACE_DEBUG builds each block is surrounded with the same trash guards
+ * as memAlloc() ones, which are checked on each free and on demand.
+ * Double frees and frees of foreign pointers are also detected.
+ */
+
+#include <ace/types.h>
+#include <ace/managers/memory.h>
+
+/* Types */
+
+typedef struct _tPool {
+	UBYTE *pData; ///< Reserved memory block.
+	void *pFreeHead; ///< First free block, each one points to next one.
+	ULONG ulStride; ///< Distance between consecutive blocks in pData.
+	ULONG ulBlockSize; ///< Requested size of a single block.
+	UWORD uwBlockCount; ///< Total number of blocks in pool.
+	UWORD uwFreeCount; ///< Number of blocks which are currently free.
+	UWORD uwFreeMin; ///< Lowest uwFreeCount since pool creation.
+	ULONG ulMemFlags; ///< Flags used for reserving memory block.
+} tPool;
+
+/* Functions */
+
+/**
+ * @brief Creates new pool, reserving memory for all of its blocks up front.
+ * This is the only place where the OS is involved, so do it on state load.
+ *
+ * @param ulBlockSize Size of single block, in bytes.
+ * @param uwBlockCount Number of blocks in pool.
+ * @param ulMemFlags Memory flags for reserved memory, e.g. MEMF_CHIP.
+ * @return Pointer to newly created pool, zero on failure.
+ *
+ * @see poolDestroy()
+ */
+tPool *poolCreate(ULONG ulBlockSize, UWORD uwBlockCount, ULONG ulMemFlags);
+
+/**
+ * @brief Destroys given pool, freeing its memory and thus invalidating
+ * all blocks allocated from it.
+ *
+ * @param pPool Pool to be destroyed.
+ *
+ * @see poolCreate()
+ */
+void poolDestroy(tPool *pPool);
+
+/**
+ * @brief Allocates single block from given pool. Doesn't involve OS.
+ * Returned memory is not cleared.
+ *
+ * @param pPool Pool to allocate block from.
+ * @return Pointer to allocated block, aligned to 8 bytes.
+ * Zero if all blocks are already taken.
+ */
+void *poolAlloc(tPool *pPool);
+
+/**
+ * @brief Gives given block back to the pool. Doesn't involve OS.
+ *
+ * @param pPool Pool from which given block was allocated.
+ * @param pBlock Block to be freed.
+ */
+void poolFree(tPool *pPool, void *pBlock);
+
+/**
+ * @brief Frees all blocks allocated from given pool.
+ *
+ * @param pPool Pool to be reset.
+ */
+void poolReset(tPool *pPool);
+
+void _poolCheckIntegrity(const tPool *pPool, UWORD uwLine, const char *szFile);
+
+#ifdef ACE_DEBUG
+# define poolCheckIntegrity(pPool) _poolCheckIntegrity(pPool, __LINE__, __FILE__)
+#else
+# define poolCheckIntegrity(pPool)
+#endif // ACE_DEBUG
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_UTILS_POOL_H_
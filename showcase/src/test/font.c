@@ -3,24 +3,30 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "test/font.h"
+#include <ace/macros.h>
 #include <ace/managers/blit.h>
 #include <ace/managers/key.h>
 #include <ace/managers/joy.h>
 #include <ace/managers/system.h>
+#include <ace/managers/timer.h>
 #include <ace/managers/viewport/simplebuffer.h>
 #include <ace/utils/extview.h>
 #include <ace/utils/font.h>
 #include <ace/generic/screen.h>
 #include "game.h"
 
+#define TEST_FONT_BENCH_RUNS 16
+#define TEST_FONT_BENCH_FRAME_TICKS (160 * 313)
+
 static tView *s_pTestFontView;
 static tVPort *s_pTestFontVPort;
 static tSimpleBufferManager *s_pTestFontBfr;
 
 static char s_szSentence[20];
 static tFont *s_pFontUI;
-static tTextBitMap *s_pGlyph, *s_pGlyphCode;
-static UBYTE s_ubPage;
+static tTextBitMap *s_pGlyph, *s_pGlyphCode, *s_pBenchText;
+static UWORD s_uwPage;
+static const char s_szBenchText[] = "The quick brown fox jumps over the lazy dog";
 
 void gsTestFontCreate(void) {
 	// Prepare view & viewport
@@ -46,9 +52,11 @@ void gsTestFontCreate(void) {
 	s_pGlyph = 0;
 	s_pGlyph = fontCreateTextBitMap(96, s_pFontUI->uwHeight);
 	s_pGlyphCode = fontCreateTextBitMap(96, s_pFontUI->uwHeight);
+	tUwCoordYX sBenchSize = fontMeasureText(s_pFontUI, s_szBenchText);
+	s_pBenchText = fontCreateTextBitMap(sBenchSize.uwX, sBenchSize.uwY);
 
 	// Loop vars
-	s_ubPage = 0;
+	s_uwPage = 0;
 	testFontDrawTable();
 	memset(s_szSentence, 0, 20);
 
@@ -57,6 +65,38 @@ void gsTestFontCreate(void) {
 	viewLoad(s_pTestFontView);
 }
 
+/**
+ * @brief Gets number of 64-glyph table pages. Version 1 fonts are shown
+ * by char code, atlas ones by glyph index, so that all their glyphs are
+ * reachable regardless of codepoint.
+ */
+static UWORD testFontGetPageCount(const tFont *pFont) {
+	if(pFont->pGlyphs) {
+		return MAX(1, (pFont->uwGlyphCount + 63) / 64);
+	}
+	return 4;
+}
+
+/**
+ * @brief Writes codepoint as null-terminated UTF-8 sequence, which is how
+ * atlas fonts expect text to be encoded.
+ */
+static void testFontEncodeUtf8(UWORD uwCodepoint, char *szOut) {
+	if(uwCodepoint < 0x80) {
+		*szOut++ = uwCodepoint;
+	}
+	else if(uwCodepoint < 0x800) {
+		*szOut++ = 0xC0 | (uwCodepoint >> 6);
+		*szOut++ = 0x80 | (uwCodepoint & 0x3F);
+	}
+	else {
+		*szOut++ = 0xE0 | (uwCodepoint >> 12);
+		*szOut++ = 0x80 | ((uwCodepoint >> 6) & 0x3F);
+		*szOut++ = 0x80 | (uwCodepoint & 0x3F);
+	}
+	*szOut = '\0';
+}
+
 void gsTestFontTableLoop(void) {
 	if (keyUse(KEY_ESCAPE)) {
 		stateChange(g_pGameStateManager, &g_pTestStates[TEST_STATE_MENU]);
@@ -69,21 +109,28 @@ void gsTestFontTableLoop(void) {
 		return;
 	}
 
+	if(keyUse(KEY_F3)) {
+		testFontDrawBench();
+		g_pGameStateManager->pCurrent->cbLoop = gsTestFontBenchLoop;
+		return;
+	}
+
+	UWORD uwPageCount = testFontGetPageCount(s_pFontUI);
 	if((keyUse(KEY_RIGHT) || keyUse(KEY_DOWN))) {
-		if(s_ubPage < 3) {
-				++s_ubPage;
+		if(s_uwPage < uwPageCount - 1) {
+				++s_uwPage;
 		}
 		else {
-			s_ubPage = 0;
+			s_uwPage = 0;
 		}
 		testFontDrawTable();
 	}
 	if((keyUse(KEY_LEFT) || keyUse(KEY_UP))) {
-		if(s_ubPage) {
-			--s_ubPage;
+		if(s_uwPage) {
+			--s_uwPage;
 		}
 		else {
-			s_ubPage = 3;
+			s_uwPage = uwPageCount - 1;
 		}
 		testFontDrawTable();
 	}
@@ -131,9 +178,27 @@ void gsTestFontSentenceLoop(void) {
 	}
 }
 
+void gsTestFontBenchLoop(void) {
+	if (keyUse(KEY_ESCAPE)) {
+		stateChange(g_pGameStateManager, &g_pTestStates[TEST_STATE_MENU]);
+		return;
+	}
+
+	if(keyUse(KEY_F1)) {
+		testFontDrawTable();
+		g_pGameStateManager->pCurrent->cbLoop = gsTestFontTableLoop;
+		return;
+	}
+
+	if(keyUse(KEY_RETURN)) {
+		testFontDrawBench();
+	}
+}
+
 void gsTestFontDestroy(void) {
 	systemUse();
 	// Free fonts
+	fontDestroyTextBitMap(s_pBenchText);
 	fontDestroyTextBitMap(s_pGlyphCode);
 	fontDestroyTextBitMap(s_pGlyph);
 	fontDestroy(s_pFontUI);
@@ -145,7 +210,7 @@ void gsTestFontDestroy(void) {
 void testFontDrawTable(void) {
 	tFont *pFont;
 	UWORD i;
-	char szCodeBfr[3];
+	char szCodeBfr[5];
 
 	pFont = s_pFontUI;
 
@@ -169,14 +234,30 @@ void testFontDrawTable(void) {
 	blitLine(s_pTestFontBfr->pBack, 0, uwMaxY, uwMaxX, uwMaxY, 0, 0xFFFF, 0);
 
 	for(i = 0; i < 64; ++i) {
-		UBYTE ubCharIdx = s_ubPage*64+i;
+		UWORD uwCode;
+		UBYTE isDrawable;
+		if(pFont->pGlyphs) {
+			UWORD uwGlyphIdx = s_uwPage*64+i;
+			if(uwGlyphIdx >= pFont->uwGlyphCount) {
+				break;
+			}
+			uwCode = pFont->pGlyphs[uwGlyphIdx].uwCodepoint;
+			isDrawable = uwCode && pFont->pGlyphs[uwGlyphIdx].ubWidth;
+			testFontEncodeUtf8(uwCode, szCodeBfr);
+		}
+		else {
+			uwCode = s_uwPage*64+i;
+			isDrawable = (
+				uwCode && // Not a null char
+				uwCode + 1 < pFont->ubChars &&
+				fontGlyphWidth(pFont, uwCode)
+			);
+			// Version 1 fonts are indexed by raw byte
+			szCodeBfr[0] = uwCode;
+			szCodeBfr[1] = '\0';
+		}
 		// Char - crashes because of font rendering bugs
-		if(
-			ubCharIdx && // Not a null char
-			pFont->pCharOffsets[ubCharIdx] < pFont->pCharOffsets[ubCharIdx+1] &&
-			ubCharIdx < pFont->ubChars
-		) {
-			sprintf(szCodeBfr, "%c", ubCharIdx);
+		if(isDrawable) {
 			fontDrawStr(
 				pFont, s_pTestFontBfr->pBack, (i/8)*40+40/2, (i%8)*32+(32/2),
 				szCodeBfr, 3, FONT_CENTER|FONT_COOKIE, s_pGlyph
@@ -184,7 +265,7 @@ void testFontDrawTable(void) {
 		}
 
 		// Char code
-		sprintf(szCodeBfr, "%02X", ubCharIdx);
+		sprintf(szCodeBfr, uwCode > 0xFF ? "%04X" : "%02X", uwCode);
 		fontDrawStr(
 			s_pFontUI, s_pTestFontBfr->pBack, (i/8)*40+40/2, (i%8)*32+32-2,
 			szCodeBfr, 0, FONT_HCENTER|FONT_BOTTOM|FONT_COOKIE, s_pGlyphCode
@@ -195,3 +276,58 @@ void testFontDrawTable(void) {
 void testFontDrawSentence(void) {
 
 }
+
+/**
+ * @brief Measures how many glyphs per frame can be assembled by
+ * fontFillTextBitMap() with current font setup.
+ */
+static ULONG testFontBenchGlyphsPerFrame(void) {
+	ULONG ulStart = timerGetPrec();
+	for(UBYTE i = 0; i < TEST_FONT_BENCH_RUNS; ++i) {
+		fontFillTextBitMap(s_pFontUI, s_pBenchText, s_szBenchText);
+	}
+	blitWait();
+	ULONG ulElapsed = timerGetDelta(ulStart, timerGetPrec());
+	ULONG ulGlyphs = TEST_FONT_BENCH_RUNS * (sizeof(s_szBenchText) - 1);
+	return (ulGlyphs * TEST_FONT_BENCH_FRAME_TICKS) / MAX(ulElapsed, 1);
+}
+
+void testFontDrawBench(void) {
+	char szLine[50];
+
+	blitRect(
+		s_pTestFontBfr->pBack, 0, 0,
+		s_pTestFontBfr->uBfrBounds.uwX, s_pTestFontBfr->uBfrBounds.uwY, 0
+	);
+
+	// Blitter-assembled text vs CPU using pre-shifted glyph cache.
+	// Labels reuse bench text bitmap, so each is drawn after its measurement.
+	ULONG ulBlitterGlyphs = testFontBenchGlyphsPerFrame();
+	fontDrawTextBitMap(s_pTestFontBfr->pBack, s_pBenchText, 8, 8, 3, FONT_COOKIE);
+	sprintf(szLine, "Blitter: %lu glyphs/frame", ulBlitterGlyphs);
+	fontDrawStr(
+		s_pFontUI, s_pTestFontBfr->pBack, 8, 24, szLine, 1, FONT_COOKIE, s_pBenchText
+	);
+
+	if(fontCreateShiftCache(s_pFontUI)) {
+		ULONG ulCachedGlyphs = testFontBenchGlyphsPerFrame();
+		fontDrawTextBitMap(s_pTestFontBfr->pBack, s_pBenchText, 8, 40, 3, FONT_COOKIE);
+		ULONG ulCacheSize = sizeof(ULONG) * s_pFontUI->pShiftCache->ulRowCount;
+		fontDestroyShiftCache(s_pFontUI);
+		sprintf(szLine, "Shift cache: %lu glyphs/frame", ulCachedGlyphs);
+		fontDrawStr(
+			s_pFontUI, s_pTestFontBfr->pBack, 8, 56, szLine, 1, FONT_COOKIE, s_pBenchText
+		);
+		sprintf(szLine, "Cache size: %lu bytes", ulCacheSize);
+	}
+	else {
+		sprintf(szLine, "Shift cache unavailable");
+	}
+	fontDrawStr(
+		s_pFontUI, s_pTestFontBfr->pBack, 8, 72, szLine, 1, FONT_COOKIE, s_pBenchText
+	);
+	fontDrawStr(
+		s_pFontUI, s_pTestFontBfr->pBack, 8, 96, "Return: rerun, F1: table",
+		2, FONT_COOKIE, s_pBenchText
+	);
+}
@@ -16,10 +16,12 @@
 void gsTestFontCreate(void);
 void gsTestFontTableLoop(void);
 void gsTestFontSentenceLoop(void);
+void gsTestFontBenchLoop(void);
 void gsTestFontDestroy(void);
 
 void testFontDrawTable(void);
 void testFontDrawSentence(void);
+void testFontDrawBench(void);
 
 //---------------------------------------------------------------------- INLINES
 
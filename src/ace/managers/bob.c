@@ -6,6 +6,7 @@
 #include <ace/managers/memory.h>
 #include <ace/managers/system.h>
 #include <ace/managers/blit.h>
+#include <ace/managers/profiler.h>
 #include <ace/managers/viewport/scrollbuffer.h> // for SCROLLBUFFER_HEIGHT_MODULO, TODO: get rid of it somehow
 #include <ace/utils/custom.h>
 
@@ -420,6 +421,7 @@ UBYTE bobProcessNext(void) {
 
 void bobBegin(tBitMap *pBuffer) {
 	bobCheckGood(pBuffer);
+	profilerZoneBegin(PROFILER_ZONE_BOB_UNDRAW);
 	tBobQueue *pQueue = &s_pQueues[s_ubBufferCurr];
 
 #if defined(ACE_BOB_PRISTINE_BUFFER)
@@ -532,6 +534,7 @@ void bobBegin(tBitMap *pBuffer) {
 	s_ubBobsDrawn = 0;
 	s_ubBobsPushed = 0;
 	s_isPushingDone = 0;
+	profilerZoneEnd();
 }
 
 void bobPushingDone(void) {
@@ -539,11 +542,13 @@ void bobPushingDone(void) {
 }
 
 void bobEnd(void) {
+	profilerZoneBegin(PROFILER_ZONE_BOB_DRAW);
 	bobPushingDone();
 	do {
 	} while(bobProcessNext());
 	s_pQueues[s_ubBufferCurr].ubUndrawCount = s_ubBobsPushed;
 	s_ubBufferCurr = !s_ubBufferCurr;
+	profilerZoneEnd();
 }
 
 void bobDiscardUndraw(void) {
@@ -0,0 +1,325 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <ace/managers/chip_heap.h>
+#include <ace/managers/log.h>
+#include <ace/managers/memory.h>
+#include <ace/managers/system.h>
+#include <ace/macros.h>
+#include <string.h>
+#ifdef AMIGA
+#include <ace/managers/blit.h> // Needs Amiga headers, host uses memmove()
+#endif
+
+// Blocks are aligned like AllocMem() ones, which is plenty for blitter & DMA
+#define CHIP_HEAP_ALIGNMENT 8
+
+// Largest OCS blit: 64 words wide, 1024 rows high
+#define CHIP_HEAP_BLIT_WORDS 64
+#define CHIP_HEAP_BLIT_ROWS 1024
+
+#define CHIP_BLOCK_INVALID 0xFFFF
+
+typedef struct _tChipBlock {
+	ULONG ulOffs; ///< Offset from heap start.
+	ULONG ulSize; ///< Size, including alignment padding.
+	tCbChipRelocate cbRelocate;
+	void *pOwner;
+	UWORD uwNext; ///< Next used block in address order or next free slot.
+	UBYTE isUsed;
+	UBYTE isLocked;
+} tChipBlock;
+
+typedef struct _tChipHeap {
+	UBYTE *pData;
+	ULONG ulSize;
+	tChipBlock *pBlocks;
+	UWORD uwMaxBlocks;
+	UWORD uwFirstUsed; ///< Used blocks are linked in ascending address order.
+	UWORD uwFirstFree; ///< Unused block slots.
+} tChipHeap;
+
+static tChipHeap s_sChipHeap;
+
+//------------------------------------------------------------ PRIVATE FUNCTIONS
+
+static inline tChipBlock *chipHeapGetBlock(tChipHandle uwHandle) {
+	return &s_sChipHeap.pBlocks[uwHandle - 1];
+}
+
+static void chipHeapBlitMove(UBYTE *pDst, const UBYTE *pSrc, ULONG ulSize) {
+#ifdef AMIGA
+	// Blocks are moved only towards heap start, so ascending blits are safe
+	// even when source and destination overlap - blitter reads always stay
+	// ahead of its writes.
+	ULONG ulWords = ulSize / sizeof(UWORD);
+	ULONG ulRows = ulWords / CHIP_HEAP_BLIT_WORDS;
+	UWORD uwRemainder = ulWords % CHIP_HEAP_BLIT_WORDS;
+
+	blitWait(); // Don't modify registers when other blit is in progress
+	g_pCustom->bltcon0 = USEA | USED | MINTERM_A;
+	g_pCustom->bltcon1 = 0;
+	g_pCustom->bltafwm = 0xFFFF;
+	g_pCustom->bltalwm = 0xFFFF;
+	g_pCustom->bltamod = 0;
+	g_pCustom->bltdmod = 0;
+	while(ulRows) {
+		UWORD uwRows = MIN(ulRows, CHIP_HEAP_BLIT_ROWS);
+		blitWait();
+		g_pCustom->bltapt = (APTR)pSrc;
+		g_pCustom->bltdpt = (APTR)pDst;
+		// Both fields wrap to 0 for max values, which is what blitter expects
+		g_pCustom->bltsize = ((uwRows & 0x3FF) << HSIZEBITS) | (CHIP_HEAP_BLIT_WORDS & 0x3F);
+		ulRows -= uwRows;
+		pSrc += uwRows * CHIP_HEAP_BLIT_WORDS * sizeof(UWORD);
+		pDst += uwRows * CHIP_HEAP_BLIT_WORDS * sizeof(UWORD);
+	}
+	if(uwRemainder) {
+		blitWait();
+		g_pCustom->bltapt = (APTR)pSrc;
+		g_pCustom->bltdpt = (APTR)pDst;
+		g_pCustom->bltsize = (1 << HSIZEBITS) | uwRemainder;
+	}
+#else
+	memmove(pDst, pSrc, ulSize);
+#endif // AMIGA
+}
+
+//------------------------------------------------------------- PUBLIC FUNCTIONS
+
+UBYTE chipHeapCreate(ULONG ulSize, UWORD uwMaxBlocks) {
+	logBlockBegin(
+		"chipHeapCreate(ulSize: %lu, uwMaxBlocks: %hu)", ulSize, uwMaxBlocks
+	);
+	if(s_sChipHeap.pData) {
+		logWrite("ERR: Chip heap already created\n");
+		logBlockEnd("chipHeapCreate()");
+		return 0;
+	}
+
+	ulSize &= ~(CHIP_HEAP_ALIGNMENT - 1);
+	s_sChipHeap.pData = memAllocChip(ulSize);
+	s_sChipHeap.pBlocks = memAllocFastClear(uwMaxBlocks * sizeof(tChipBlock));
+	if(!s_sChipHeap.pData || !s_sChipHeap.pBlocks) {
+		logWrite("ERR: Couldn't reserve chip heap memory\n");
+		if(s_sChipHeap.pData) {
+			memFree(s_sChipHeap.pData, ulSize);
+			s_sChipHeap.pData = 0;
+		}
+		if(s_sChipHeap.pBlocks) {
+			memFree(s_sChipHeap.pBlocks, uwMaxBlocks * sizeof(tChipBlock));
+		}
+		logBlockEnd("chipHeapCreate()");
+		return 0;
+	}
+
+	s_sChipHeap.ulSize = ulSize;
+	s_sChipHeap.uwMaxBlocks = uwMaxBlocks;
+	s_sChipHeap.uwFirstUsed = CHIP_BLOCK_INVALID;
+	for(UWORD i = 0; i < uwMaxBlocks; ++i) {
+		s_sChipHeap.pBlocks[i].uwNext = (i + 1 < uwMaxBlocks) ? i + 1 : CHIP_BLOCK_INVALID;
+	}
+	s_sChipHeap.uwFirstFree = 0;
+	logBlockEnd("chipHeapCreate()");
+	return 1;
+}
+
+void chipHeapDestroy(void) {
+	logBlockBegin("chipHeapDestroy()");
+	if(!s_sChipHeap.pData) {
+		logBlockEnd("chipHeapDestroy()");
+		return;
+	}
+	for(UWORD i = s_sChipHeap.uwFirstUsed; i != CHIP_BLOCK_INVALID;) {
+		const tChipBlock *pBlock = &s_sChipHeap.pBlocks[i];
+		logWrite(
+			"ERR: Block %hu still allocated: %p, size %lu\n",
+			i + 1, &s_sChipHeap.pData[pBlock->ulOffs], pBlock->ulSize
+		);
+		i = pBlock->uwNext;
+	}
+	memFree(s_sChipHeap.pData, s_sChipHeap.ulSize);
+	memFree(s_sChipHeap.pBlocks, s_sChipHeap.uwMaxBlocks * sizeof(tChipBlock));
+	s_sChipHeap.pData = 0;
+	logBlockEnd("chipHeapDestroy()");
+}
+
+UBYTE chipHeapIsCreated(void) {
+	return s_sChipHeap.pData != 0;
+}
+
+tChipHandle chipHeapAlloc(ULONG ulSize, tCbChipRelocate cbRelocate, void *pOwner) {
+	if(!s_sChipHeap.pData) {
+		logWrite("ERR: Chip heap not created\n");
+		return 0;
+	}
+	if(s_sChipHeap.uwFirstFree == CHIP_BLOCK_INVALID) {
+		logWrite(
+			"ERR: Chip heap out of block slots, max: %hu\n", s_sChipHeap.uwMaxBlocks
+		);
+		return 0;
+	}
+	ulSize = (ulSize + CHIP_HEAP_ALIGNMENT - 1) & ~(CHIP_HEAP_ALIGNMENT - 1);
+
+	// First fit - find the first gap between used blocks which is big enough
+	UWORD uwPrev = CHIP_BLOCK_INVALID;
+	UWORD uwNext = s_sChipHeap.uwFirstUsed;
+	ULONG ulOffs = 0;
+	while(uwNext != CHIP_BLOCK_INVALID) {
+		const tChipBlock *pNext = &s_sChipHeap.pBlocks[uwNext];
+		if(pNext->ulOffs - ulOffs >= ulSize) {
+			break;
+		}
+		ulOffs = pNext->ulOffs + pNext->ulSize;
+		uwPrev = uwNext;
+		uwNext = pNext->uwNext;
+	}
+	if(uwNext == CHIP_BLOCK_INVALID && s_sChipHeap.ulSize - ulOffs < ulSize) {
+		tChipHeapStats sStats;
+		chipHeapGetStats(&sStats);
+		logWrite(
+			"ERR: Can't alloc %lu bytes on chip heap - free: %lu, largest: %lu, fragmentation: %hhu%%\n",
+			ulSize, sStats.ulFree, sStats.ulLargestFree, sStats.ubFragmentation
+		);
+		return 0;
+	}
+
+	UWORD uwIdx = s_sChipHeap.uwFirstFree;
+	tChipBlock *pBlock = &s_sChipHeap.pBlocks[uwIdx];
+	s_sChipHeap.uwFirstFree = pBlock->uwNext;
+	pBlock->ulOffs = ulOffs;
+	pBlock->ulSize = ulSize;
+	pBlock->cbRelocate = cbRelocate;
+	pBlock->pOwner = pOwner;
+	pBlock->isUsed = 1;
+	pBlock->isLocked = 0;
+	pBlock->uwNext = uwNext;
+	if(uwPrev == CHIP_BLOCK_INVALID) {
+		s_sChipHeap.uwFirstUsed = uwIdx;
+	}
+	else {
+		s_sChipHeap.pBlocks[uwPrev].uwNext = uwIdx;
+	}
+	return uwIdx + 1;
+}
+
+void chipHeapFree(tChipHandle uwHandle) {
+	if(!uwHandle || uwHandle > s_sChipHeap.uwMaxBlocks || !chipHeapGetBlock(uwHandle)->isUsed) {
+		logWrite("ERR: Invalid chip heap handle: %hu\n", uwHandle);
+		return;
+	}
+	UWORD uwIdx = uwHandle - 1;
+	tChipBlock *pBlock = &s_sChipHeap.pBlocks[uwIdx];
+
+	// Unlink from address-ordered list
+	if(s_sChipHeap.uwFirstUsed == uwIdx) {
+		s_sChipHeap.uwFirstUsed = pBlock->uwNext;
+	}
+	else {
+		UWORD uwPrev = s_sChipHeap.uwFirstUsed;
+		while(s_sChipHeap.pBlocks[uwPrev].uwNext != uwIdx) {
+			uwPrev = s_sChipHeap.pBlocks[uwPrev].uwNext;
+		}
+		s_sChipHeap.pBlocks[uwPrev].uwNext = pBlock->uwNext;
+	}
+
+	pBlock->isUsed = 0;
+	pBlock->uwNext = s_sChipHeap.uwFirstFree;
+	s_sChipHeap.uwFirstFree = uwIdx;
+}
+
+UBYTE *chipHeapGetAddr(tChipHandle uwHandle) {
+	return &s_sChipHeap.pData[chipHeapGetBlock(uwHandle)->ulOffs];
+}
+
+void chipHeapSetLocked(tChipHandle uwHandle, UBYTE isLocked) {
+	chipHeapGetBlock(uwHandle)->isLocked = isLocked;
+}
+
+void chipHeapGetStats(tChipHeapStats *pStats) {
+	pStats->ulFree = 0;
+	pStats->ulLargestFree = 0;
+	pStats->uwFreeAreas = 0;
+	pStats->uwBlocks = 0;
+	ULONG ulOffs = 0;
+	UWORD uwIdx = s_sChipHeap.uwFirstUsed;
+	for(;;) {
+		ULONG ulEnd;
+		if(uwIdx == CHIP_BLOCK_INVALID) {
+			ulEnd = s_sChipHeap.ulSize;
+		}
+		else {
+			ulEnd = s_sChipHeap.pBlocks[uwIdx].ulOffs;
+		}
+		ULONG ulGap = ulEnd - ulOffs;
+		if(ulGap) {
+			pStats->ulFree += ulGap;
+			++pStats->uwFreeAreas;
+			if(ulGap > pStats->ulLargestFree) {
+				pStats->ulLargestFree = ulGap;
+			}
+		}
+		if(uwIdx == CHIP_BLOCK_INVALID) {
+			break;
+		}
+		++pStats->uwBlocks;
+		ulOffs = ulEnd + s_sChipHeap.pBlocks[uwIdx].ulSize;
+		uwIdx = s_sChipHeap.pBlocks[uwIdx].uwNext;
+	}
+
+	// Won't overflow since CHIP memory is at most 2MB
+	if(pStats->ulFree) {
+		pStats->ubFragmentation = 100 - pStats->ulLargestFree * 100 / pStats->ulFree;
+	}
+	else {
+		pStats->ubFragmentation = 0;
+	}
+}
+
+UWORD chipHeapCompact(tChipHeapStats *pBefore, tChipHeapStats *pAfter) {
+	logBlockBegin("chipHeapCompact(pBefore: %p, pAfter: %p)", pBefore, pAfter);
+	tChipHeapStats sStats;
+	chipHeapGetStats(&sStats);
+	logWrite(
+		"Before: %hu blocks, free: %lu in %hu areas, largest: %lu, fragmentation: %hhu%%\n",
+		sStats.uwBlocks, sStats.ulFree, sStats.uwFreeAreas,
+		sStats.ulLargestFree, sStats.ubFragmentation
+	);
+	if(pBefore) {
+		*pBefore = sStats;
+	}
+
+	UWORD uwMoved = 0;
+	ULONG ulOffs = 0;
+	for(UWORD i = s_sChipHeap.uwFirstUsed; i != CHIP_BLOCK_INVALID;) {
+		tChipBlock *pBlock = &s_sChipHeap.pBlocks[i];
+		if(!pBlock->isLocked && pBlock->ulOffs != ulOffs) {
+			UBYTE *pOld = &s_sChipHeap.pData[pBlock->ulOffs];
+			UBYTE *pNew = &s_sChipHeap.pData[ulOffs];
+			chipHeapBlitMove(pNew, pOld, pBlock->ulSize);
+			pBlock->ulOffs = ulOffs;
+			if(pBlock->cbRelocate) {
+				pBlock->cbRelocate(pBlock->pOwner, pOld, pNew);
+			}
+			++uwMoved;
+		}
+		ulOffs = pBlock->ulOffs + pBlock->ulSize;
+		i = pBlock->uwNext;
+	}
+#ifdef AMIGA
+	blitWait();
+#endif
+
+	chipHeapGetStats(&sStats);
+	logWrite(
+		"After: moved %hu blocks, free: %lu in %hu areas, largest: %lu, fragmentation: %hhu%%\n",
+		uwMoved, sStats.ulFree, sStats.uwFreeAreas,
+		sStats.ulLargestFree, sStats.ubFragmentation
+	);
+	if(pAfter) {
+		*pAfter = sStats;
+	}
+	logBlockEnd("chipHeapCompact()");
+	return uwMoved;
+}
@@ -6,6 +6,7 @@
 #ifdef AMIGA
 #include <stdarg.h>
 #include <ace/managers/system.h>
+#include <ace/managers/profiler.h>
 #include <limits.h>
 #include <proto/exec.h>
 
@@ -533,6 +534,7 @@ UBYTE copUpdateFromBlocks(void) {
 }
 
 void copProcessBlocks(void) {
+	profilerZoneBegin(PROFILER_ZONE_COPPER);
 	tCopList *pCopList = g_sCopManager.pCopList;
 	if(pCopList->ubMode == COPPER_MODE_BLOCK) {
 		UBYTE ubNewStatus = 0;
@@ -556,6 +558,7 @@ void copProcessBlocks(void) {
 
 	// Swap copper buffers
 	copSwapBuffers();
+	profilerZoneEnd();
 }
 
 void copBlockWait(tCopList *pCopList, tCopBlock *pBlock, UWORD uwX, UWORD uwY) {
@@ -38,7 +38,348 @@ static inline void uaeWrite(const char *szMsg) {
 // Functions
 
 static UBYTE isWritingToFileAllowed(void) {
-	return g_sLogManager.pFile && !g_sLogManager.wInterruptDepth;
+	// In binary mode records are only written on flush
+	return (
+		g_sLogManager.pFile && !g_sLogManager.wInterruptDepth &&
+		!g_sLogManager.pBinBuffer
+	);
+}
+
+/**
+ * Binary log
+ */
+
+// Format strings are identified by their address, so the table is indexed
+// by its hash. Index of format's entry is its id in the binary log.
+#define LOG_BIN_FORMAT_MAX 512
+#define LOG_BIN_ARG_INT 0
+#define LOG_BIN_ARG_STR 1
+#define LOG_BIN_ARG_DOUBLE 2
+#define LOG_BIN_ARG_LLONG 3
+#define LOG_BIN_LOST_RECORD_SIZE (sizeof(tLogBinRecordHeader) + sizeof(ULONG))
+
+typedef struct _tLogBinFormat {
+	const char *szFormat;
+	ULONG ulArgKinds; ///< Two bits per arg, first arg in lowest ones.
+	UBYTE ubArgCount;
+	UBYTE isSupported;
+} tLogBinFormat;
+
+static tLogBinFormat *s_pBinFormats;
+static UWORD s_uwBinFormatCount;
+static tLogBinRecordHeader *s_pBinRecord;
+static UBYTE *s_pBinCursor;
+static UBYTE *s_pBinLimit;
+#ifdef ACE_DEBUG_UAE
+static UBYTE s_wasUaeLastInline;
+#endif
+
+static UBYTE logBinRecordBegin(UBYTE ubType, UBYTE isReserveUsed) {
+	// Keep some space for lost record, so that it always fits on flush
+	ULONG ulLimit = g_sLogManager.ulBinSize - (
+		isReserveUsed ? 0 : LOG_BIN_LOST_RECORD_SIZE
+	);
+	ulLimit = MIN(ulLimit, g_sLogManager.ulBinUsed + 0xFFFE);
+	if(g_sLogManager.ulBinUsed + sizeof(tLogBinRecordHeader) > ulLimit) {
+		return 0;
+	}
+	s_pBinRecord = (tLogBinRecordHeader*)&g_sLogManager.pBinBuffer[g_sLogManager.ulBinUsed];
+	s_pBinRecord->ubType = ubType;
+	s_pBinRecord->ubIndent = g_sLogManager.ubIndent;
+	s_pBinRecord->ulTime = timerGetPrec();
+	s_pBinCursor = (UBYTE*)&s_pBinRecord[1];
+	s_pBinLimit = &g_sLogManager.pBinBuffer[ulLimit];
+	return 1;
+}
+
+static UBYTE logBinPut(const void *pData, UWORD uwSize) {
+	if(s_pBinCursor + uwSize > s_pBinLimit) {
+		return 0;
+	}
+	memcpy(s_pBinCursor, pData, uwSize);
+	s_pBinCursor += uwSize;
+	return 1;
+}
+
+static UBYTE logBinPutString(const char *szStr) {
+	// Pad to even size so that following longs are word-aligned
+	do {
+		if(s_pBinCursor >= s_pBinLimit) {
+			return 0;
+		}
+		*(s_pBinCursor++) = *szStr;
+	} while(*(szStr++));
+	if((ULONG)s_pBinCursor & 1) {
+		*(s_pBinCursor++) = '\0';
+	}
+	return 1;
+}
+
+static void logBinRecordEnd(void) {
+	s_pBinRecord->uwSize = s_pBinCursor - (UBYTE*)s_pBinRecord;
+	g_sLogManager.ulBinUsed += s_pBinRecord->uwSize;
+}
+
+static UBYTE logBinAddArg(tLogBinFormat *pFormat, UBYTE ubKind, UBYTE *pLongCount) {
+	*pLongCount += (ubKind == LOG_BIN_ARG_DOUBLE || ubKind == LOG_BIN_ARG_LLONG) ? 2 : 1;
+	if(*pLongCount > LOG_BIN_ARG_LONGS_MAX) {
+		return 0;
+	}
+	pFormat->ulArgKinds |= ubKind << (2 * pFormat->ubArgCount);
+	++pFormat->ubArgCount;
+	return 1;
+}
+
+static UBYTE logBinParseFormat(tLogBinFormat *pFormat) {
+	UBYTE ubLongCount = 0;
+	pFormat->ulArgKinds = 0;
+	pFormat->ubArgCount = 0;
+	for(const char *pChar = pFormat->szFormat; *pChar; ++pChar) {
+		if(*pChar != '%' || *(++pChar) == '%') {
+			continue;
+		}
+		while(
+			*pChar == '-' || *pChar == '+' || *pChar == ' ' ||
+			*pChar == '#' || *pChar == '0'
+		) {
+			++pChar;
+		}
+		// Width and precision, '*' takes int arg
+		while((*pChar >= '0' && *pChar <= '9') || *pChar == '.' || *pChar == '*') {
+			if(*pChar == '*' && !logBinAddArg(pFormat, LOG_BIN_ARG_INT, &ubLongCount)) {
+				return 0;
+			}
+			++pChar;
+		}
+		UBYTE ubLongModifiers = 0;
+		while(
+			*pChar == 'h' || *pChar == 'l' || *pChar == 'L' || *pChar == 'q' ||
+			*pChar == 'j' || *pChar == 'z' || *pChar == 't'
+		) {
+			if(*pChar == 'l') {
+				++ubLongModifiers;
+			}
+			++pChar;
+		}
+
+		UBYTE ubKind;
+		switch(*pChar) {
+			case 's':
+				ubKind = LOG_BIN_ARG_STR;
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+				ubKind = LOG_BIN_ARG_DOUBLE;
+				break;
+			case 'n': case '\0':
+				return 0;
+			default:
+				ubKind = (ubLongModifiers >= 2) ? LOG_BIN_ARG_LLONG : LOG_BIN_ARG_INT;
+		}
+		if(!logBinAddArg(pFormat, ubKind, &ubLongCount)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static const tLogBinFormat *logBinGetFormat(const char *szFormat, UWORD *pId) {
+	ULONG ulAddr = (ULONG)szFormat;
+	UWORD uwIdx = (ulAddr ^ (ulAddr >> 9)) & (LOG_BIN_FORMAT_MAX - 1);
+	while(s_pBinFormats[uwIdx].szFormat) {
+		if(s_pBinFormats[uwIdx].szFormat == szFormat) {
+			*pId = uwIdx;
+			return &s_pBinFormats[uwIdx];
+		}
+		uwIdx = (uwIdx + 1) & (LOG_BIN_FORMAT_MAX - 1);
+	}
+	if(s_uwBinFormatCount >= LOG_BIN_FORMAT_MAX * 3 / 4) {
+		return 0;
+	}
+
+	// First use of given format - store its text in log once
+	tLogBinFormat sFormat = {.szFormat = szFormat};
+	sFormat.isSupported = logBinParseFormat(&sFormat);
+	if(sFormat.isSupported) {
+		if(
+			!logBinRecordBegin(LOG_BIN_RECORD_FORMAT, 0) ||
+			!logBinPut(&uwIdx, sizeof(uwIdx)) || !logBinPutString(szFormat)
+		) {
+			return 0;
+		}
+		logBinRecordEnd();
+	}
+	s_pBinFormats[uwIdx] = sFormat;
+	++s_uwBinFormatCount;
+	*pId = uwIdx;
+	return &s_pBinFormats[uwIdx];
+}
+
+static UBYTE logBinPutArgs(const tLogBinFormat *pFormat, va_list vaArgs) {
+	for(UBYTE i = 0; i < pFormat->ubArgCount; ++i) {
+		UBYTE isOk;
+		switch((pFormat->ulArgKinds >> (2 * i)) & 3) {
+			case LOG_BIN_ARG_STR: {
+				const char *szArg = va_arg(vaArgs, const char*);
+				isOk = logBinPutString(szArg ? szArg : "(null)");
+			} break;
+			case LOG_BIN_ARG_DOUBLE: {
+				double fArg = va_arg(vaArgs, double);
+				isOk = logBinPut(&fArg, sizeof(fArg));
+			} break;
+			case LOG_BIN_ARG_LLONG: {
+				long long llArg = va_arg(vaArgs, long long);
+				isOk = logBinPut(&llArg, sizeof(llArg));
+			} break;
+			default: {
+				ULONG ulArg = va_arg(vaArgs, ULONG);
+				isOk = logBinPut(&ulArg, sizeof(ulArg));
+			}
+		}
+		if(!isOk) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#ifdef ACE_DEBUG_UAE
+static void logBinWriteUae(void) {
+	for(ULONG ulPos = 0; ulPos < g_sLogManager.ulBinUsed;) {
+		const tLogBinRecordHeader *pRecord = (tLogBinRecordHeader*)(
+			&g_sLogManager.pBinBuffer[ulPos]
+		);
+		const UBYTE *pPayload = (const UBYTE*)&pRecord[1];
+		ulPos += pRecord->uwSize;
+
+		UWORD uwOffs = 0;
+		if(!s_wasUaeLastInline) {
+			for(UBYTE i = pRecord->ubIndent; i--;) {
+				s_szMsg[uwOffs++] = '\t';
+			}
+		}
+		switch(pRecord->ubType) {
+			case LOG_BIN_RECORD_MESSAGE: {
+				const tLogBinFormat *pFormat = &s_pBinFormats[*(UWORD*)pPayload];
+				const UBYTE *pArg = &pPayload[sizeof(UWORD)];
+				ULONG pArgs[LOG_BIN_ARG_LONGS_MAX];
+				UBYTE ubLong = 0;
+				for(UBYTE i = 0; i < pFormat->ubArgCount; ++i) {
+					UBYTE ubKind = (pFormat->ulArgKinds >> (2 * i)) & 3;
+					if(ubKind == LOG_BIN_ARG_STR) {
+						pArgs[ubLong++] = (ULONG)pArg;
+						pArg += (strlen((const char*)pArg) + 2) & ~1;
+					}
+					else {
+						UBYTE ubSize = (ubKind == LOG_BIN_ARG_INT) ? 4 : 8;
+						memcpy(&pArgs[ubLong], pArg, ubSize);
+						ubLong += ubSize / sizeof(ULONG);
+						pArg += ubSize;
+					}
+				}
+				// All m68k varargs are passed on stack, so passing them as longs
+				// is binary-compatible with their original types.
+				sprintf(
+					&s_szMsg[uwOffs], pFormat->szFormat, pArgs[0], pArgs[1], pArgs[2],
+					pArgs[3], pArgs[4], pArgs[5], pArgs[6], pArgs[7], pArgs[8], pArgs[9],
+					pArgs[10], pArgs[11], pArgs[12], pArgs[13], pArgs[14], pArgs[15]
+				);
+			} break;
+			case LOG_BIN_RECORD_TEXT:
+				strcpy(&s_szMsg[uwOffs], (const char*)pPayload);
+				break;
+			case LOG_BIN_RECORD_BLOCK_END:
+				timerFormatPrec(g_sLogManager.szTimeBfr, *(ULONG*)pPayload);
+				if(pPayload[sizeof(ULONG)]) {
+					sprintf(s_szMsg, "...OK, time: %s\n", g_sLogManager.szTimeBfr);
+				}
+				else {
+					sprintf(
+						&s_szMsg[uwOffs], "Block end: %s, time: %s\n",
+						(const char*)&pPayload[sizeof(ULONG) + 2], g_sLogManager.szTimeBfr
+					);
+				}
+				break;
+			case LOG_BIN_RECORD_LOST:
+				sprintf(
+					&s_szMsg[uwOffs], "ERR: %lu log records lost, buffer full\n",
+					*(ULONG*)pPayload
+				);
+				break;
+			default:
+				continue;
+		}
+		s_wasUaeLastInline = s_szMsg[strlen(s_szMsg) - 1] != '\n';
+		uaeWrite(s_szMsg);
+	}
+}
+#endif // ACE_DEBUG_UAE
+
+static void logBinFlush(void) {
+	if(g_sLogManager.ulBinLost && logBinRecordBegin(LOG_BIN_RECORD_LOST, 1)) {
+		logBinPut(&g_sLogManager.ulBinLost, sizeof(g_sLogManager.ulBinLost));
+		logBinRecordEnd();
+		g_sLogManager.ulBinLost = 0;
+	}
+#ifdef ACE_DEBUG_UAE
+	logBinWriteUae();
+#endif
+	if(g_sLogManager.pFile && g_sLogManager.ulBinUsed) {
+		systemUse();
+		fileWrite(g_sLogManager.pFile, g_sLogManager.pBinBuffer, g_sLogManager.ulBinUsed);
+		fileFlush(g_sLogManager.pFile);
+		systemUnuse();
+	}
+	g_sLogManager.ulBinUsed = 0;
+}
+
+static void logBinTryFlush(void) {
+	// Flush only when it won't wake up the OS
+	if(
+		(g_sLogManager.ulBinUsed >= g_sLogManager.ulBinSize / 2 || g_sLogManager.ulBinLost) &&
+		!g_sLogManager.wInterruptDepth && systemIsUsed()
+	) {
+		logBinFlush();
+	}
+}
+
+static void logBinWriteVa(const char *szFormat, va_list vaArgs) {
+	logBinTryFlush();
+	UWORD uwId;
+	const tLogBinFormat *pFormat = logBinGetFormat(szFormat, &uwId);
+	UBYTE isOk;
+	if(pFormat && pFormat->isSupported) {
+		isOk = (
+			logBinRecordBegin(LOG_BIN_RECORD_MESSAGE, 0) &&
+			logBinPut(&uwId, sizeof(uwId)) && logBinPutArgs(pFormat, vaArgs)
+		);
+	}
+	else {
+		// Format table is full or format can't be deferred - format it now
+		vsprintf(s_szMsg, szFormat, vaArgs);
+		isOk = logBinRecordBegin(LOG_BIN_RECORD_TEXT, 0) && logBinPutString(s_szMsg);
+	}
+
+	if(isOk) {
+		logBinRecordEnd();
+	}
+	else {
+		++g_sLogManager.ulBinLost;
+	}
+}
+
+static void logBinWriteBlockEnd(const char *szBlockName, ULONG ulDelta) {
+	logBinTryFlush();
+	UBYTE pFlags[2] = {g_sLogManager.isBlockEmpty, 0};
+	if(
+		logBinRecordBegin(LOG_BIN_RECORD_BLOCK_END, 0) &&
+		logBinPut(&ulDelta, sizeof(ulDelta)) && logBinPut(pFlags, sizeof(pFlags)) &&
+		logBinPutString(szBlockName)
+	) {
+		logBinRecordEnd();
+	}
+	else {
+		++g_sLogManager.ulBinLost;
+	}
 }
 
 /**
@@ -54,6 +395,53 @@ void _logOpen(const char *szFilePath) {
 	g_sLogManager.ubShutUp = 0;
 }
 
+void _logOpenBinary(const char *szFilePath, ULONG ulBufferSize) {
+	logOpen(szFilePath);
+
+	// Log is opened before memory manager and closed after it, so it can't
+	// use tracked allocations.
+	ulBufferSize = MAX(ulBufferSize, 256) & ~1;
+	g_sLogManager.pBinBuffer = _memAllocRls(ulBufferSize, MEMF_ANY);
+	s_pBinFormats = _memAllocRls(
+		LOG_BIN_FORMAT_MAX * sizeof(tLogBinFormat), MEMF_ANY | MEMF_CLEAR
+	);
+	if(!g_sLogManager.pBinBuffer || !s_pBinFormats) {
+		if(g_sLogManager.pBinBuffer) {
+			_memFreeRls(g_sLogManager.pBinBuffer, ulBufferSize);
+			g_sLogManager.pBinBuffer = 0;
+		}
+		if(s_pBinFormats) {
+			_memFreeRls(s_pBinFormats, LOG_BIN_FORMAT_MAX * sizeof(tLogBinFormat));
+			s_pBinFormats = 0;
+		}
+		logWrite("ERR: Couldn't allocate binary log buffer, using text log\n");
+		return;
+	}
+	g_sLogManager.ulBinSize = ulBufferSize;
+	g_sLogManager.ulBinUsed = 0;
+	g_sLogManager.ulBinLost = 0;
+	s_uwBinFormatCount = 0;
+
+	if(g_sLogManager.pFile) {
+		static const UBYTE pHeader[8] = {'A', 'L', 'O', 'G', LOG_BIN_VERSION, 0, 0, 0};
+		systemUse();
+		fileWrite(g_sLogManager.pFile, pHeader, sizeof(pHeader));
+		systemUnuse();
+	}
+}
+
+void _logFlush(void) {
+	if(
+		!g_sLogManager.pBinBuffer || g_sLogManager.ubShutUp ||
+		g_sLogManager.wInterruptDepth
+	) {
+		return;
+	}
+	++g_sLogManager.ubShutUp;
+	logBinFlush();
+	--g_sLogManager.ubShutUp;
+}
+
 void _logPushIndent(void) {
 	++g_sLogManager.ubIndent;
 }
@@ -77,11 +465,17 @@ void _logWriteVa(char *szFormat, va_list vaArgs) {
 	// Prevent triggering logging by other log msg (e.g. turn on OS msg with
 	// logging to file) due to static nature of the buffer.
 	++g_sLogManager.ubShutUp;
+	g_sLogManager.isBlockEmpty = 0;
+
+	if(g_sLogManager.pBinBuffer) {
+		logBinWriteVa(szFormat, vaArgs);
+		--g_sLogManager.ubShutUp;
+		return;
+	}
 
 	// Bartman's UAE logger appends newline to each print, so the message must
 	// be emitted in one print with indentation.
 	UWORD uwOffs = 0;
-	g_sLogManager.isBlockEmpty = 0;
 	if (!g_sLogManager.wasLastInline) {
 		UBYTE ubLogIndent = g_sLogManager.ubIndent;
 		while (ubLogIndent--) {
@@ -105,10 +499,23 @@ void _logWriteVa(char *szFormat, va_list vaArgs) {
 
 void _logClose(void) {
 	logWrite("Log closed successfully\n");
+	UBYTE isBinary = (g_sLogManager.pBinBuffer != 0);
+	if(isBinary) {
+		logFlush();
+		_memFreeRls(g_sLogManager.pBinBuffer, g_sLogManager.ulBinSize);
+		_memFreeRls(s_pBinFormats, LOG_BIN_FORMAT_MAX * sizeof(tLogBinFormat));
+		g_sLogManager.pBinBuffer = 0;
+		s_pBinFormats = 0;
+		// Don't let fileClose() append text message to binary file
+		++g_sLogManager.ubShutUp;
+	}
 	if(g_sLogManager.pFile) {
 		fileClose(g_sLogManager.pFile);
 		g_sLogManager.pFile = 0;
 	}
+	if(isBinary) {
+		--g_sLogManager.ubShutUp;
+	}
 }
 
 /**
@@ -151,13 +558,19 @@ void _logBlockEnd(char *szBlockName) {
 
 	memCheckIntegrity();
 	logPopIndent();
-	timerFormatPrec(
-		g_sLogManager.szTimeBfr,
-		timerGetDelta(
-			g_sLogManager.pTimeStack[g_sLogManager.ubIndent],
-			timerGetPrec()
-		)
+	ULONG ulDelta = timerGetDelta(
+		g_sLogManager.pTimeStack[g_sLogManager.ubIndent], timerGetPrec()
 	);
+	if(g_sLogManager.pBinBuffer) {
+		// Time gets formatted by the decoder
+		++g_sLogManager.ubShutUp;
+		logBinWriteBlockEnd(szBlockName, ulDelta);
+		--g_sLogManager.ubShutUp;
+		g_sLogManager.isBlockEmpty = 0;
+		return;
+	}
+
+	timerFormatPrec(g_sLogManager.szTimeBfr, ulDelta);
 	if(g_sLogManager.isBlockEmpty) {
 		// empty block - collapse to single line
 		g_sLogManager.wasLastInline = 1;
@@ -177,6 +590,74 @@ void _logBlockEnd(char *szBlockName) {
 
 // Average logging
 
+static UBYTE logAvgGetBucket(ULONG ulDelta) {
+	if(ulDelta < LOG_AVG_HISTOGRAM_SUBBUCKETS) {
+		return ulDelta;
+	}
+
+	// Find most significant bit using binary search, then use next two bits
+	// to select sub-bucket
+	UBYTE ubMsb = 0;
+	ULONG ulValue = ulDelta;
+	if(ulValue >= (1UL << 16)) {
+		ulValue >>= 16;
+		ubMsb += 16;
+	}
+	if(ulValue >= (1UL << 8)) {
+		ulValue >>= 8;
+		ubMsb += 8;
+	}
+	if(ulValue >= (1UL << 4)) {
+		ulValue >>= 4;
+		ubMsb += 4;
+	}
+	if(ulValue >= (1UL << 2)) {
+		ulValue >>= 2;
+		ubMsb += 2;
+	}
+	if(ulValue >= (1UL << 1)) {
+		ubMsb += 1;
+	}
+	return (ubMsb - 1) * LOG_AVG_HISTOGRAM_SUBBUCKETS + ((ulDelta >> (ubMsb - 2)) & 3);
+}
+
+static ULONG logAvgGetBucketStart(UBYTE ubBucket) {
+	if(ubBucket < LOG_AVG_HISTOGRAM_SUBBUCKETS) {
+		return ubBucket;
+	}
+	UBYTE ubShift = ubBucket / LOG_AVG_HISTOGRAM_SUBBUCKETS - 1;
+	return (ULONG)(LOG_AVG_HISTOGRAM_SUBBUCKETS + (ubBucket & 3)) << ubShift;
+}
+
+static ULONG logAvgGetBucketEnd(UBYTE ubBucket) {
+	if(ubBucket + 1 >= LOG_AVG_HISTOGRAM_BUCKETS) {
+		return 0xFFFFFFFF;
+	}
+	return logAvgGetBucketStart(ubBucket + 1) - 1;
+}
+
+static ULONG logAvgTicksToUs(ULONG ulTicks, ULONG *pTenths) {
+	// One tick is 0.4us, split so that ticks * 4 won't overflow
+	ULONG ulRest = (ulTicks % 10) * 4;
+	*pTenths = ulRest % 10;
+	return (ulTicks / 10) * 4 + ulRest / 10;
+}
+
+static ULONG logAvgGetPercentile(const tAvg *pAvg, UBYTE ubPercent) {
+	// Use bucket's middle, clamped to measured extremes
+	ULONG ulTarget = (pAvg->ulHistogramCount * ubPercent + 99) / 100;
+	ULONG ulSum = 0;
+	for(UBYTE i = 0; i < LOG_AVG_HISTOGRAM_BUCKETS; ++i) {
+		ulSum += pAvg->pHistogram[i];
+		if(ulSum >= ulTarget) {
+			ULONG ulStart = logAvgGetBucketStart(i);
+			ULONG ulMid = ulStart + (logAvgGetBucketEnd(i) - ulStart) / 2;
+			return CLAMP(ulMid, pAvg->ulMin, pAvg->ulMax);
+		}
+	}
+	return pAvg->ulMax;
+}
+
 tAvg *_logAvgCreate(char *szName, UWORD uwAllocCount) {
 	tAvg *pAvg = memAllocFast(sizeof(tAvg));
 	pAvg->szName = szName;
@@ -186,11 +667,16 @@ tAvg *_logAvgCreate(char *szName, UWORD uwAllocCount) {
 	pAvg->pDeltas = memAllocFast(uwAllocCount*sizeof(ULONG));
 	pAvg->ulMin = 0xFFFFFFFF;
 	pAvg->ulMax = 0;
+	pAvg->pHistogram = 0;
+	pAvg->ulHistogramCount = 0;
 	return pAvg;
 }
 
 void _logAvgDestroy(tAvg *pAvg) {
 	logAvgWrite(pAvg);
+	if(pAvg->pHistogram) {
+		memFree(pAvg->pHistogram, LOG_AVG_HISTOGRAM_BUCKETS * sizeof(ULONG));
+	}
 	memFree(pAvg->pDeltas, pAvg->uwAllocCount*sizeof(ULONG));
 	memFree(pAvg, sizeof(tAvg));
 }
@@ -201,13 +687,18 @@ void _logAvgBegin(tAvg *pAvg) {
 
 void _logAvgEnd(tAvg *pAvg) {
 	// Calculate timestamp
-	pAvg->pDeltas[pAvg->uwCurrDelta] = timerGetDelta(pAvg->ulStartTime, timerGetPrec());
+	ULONG ulDelta = timerGetDelta(pAvg->ulStartTime, timerGetPrec());
+	pAvg->pDeltas[pAvg->uwCurrDelta] = ulDelta;
 	// Update min/max
-	if(pAvg->pDeltas[pAvg->uwCurrDelta] > pAvg->ulMax) {
-		pAvg->ulMax = pAvg->pDeltas[pAvg->uwCurrDelta];
+	if(ulDelta > pAvg->ulMax) {
+		pAvg->ulMax = ulDelta;
+	}
+	if(ulDelta < pAvg->ulMin) {
+		pAvg->ulMin = ulDelta;
 	}
-	if(pAvg->pDeltas[pAvg->uwCurrDelta] < pAvg->ulMin) {
-		pAvg->ulMin = pAvg->pDeltas[pAvg->uwCurrDelta];
+	if(pAvg->pHistogram) {
+		++pAvg->pHistogram[logAvgGetBucket(ulDelta)];
+		++pAvg->ulHistogramCount;
 	}
 	++pAvg->uwCurrDelta;
 	// Roll
@@ -237,7 +728,95 @@ void _logAvgWrite(tAvg *pAvg) {
 	timerFormatPrec(szAvg, ulAvg);
 	timerFormatPrec(szMin, pAvg->ulMin);
 	timerFormatPrec(szMax, pAvg->ulMax);
-	logWrite("Avg %s: %s, min: %s, max: %s\n", pAvg->szName, szAvg, szMin, szMax);
+	if(!pAvg->pHistogram || !pAvg->ulHistogramCount) {
+		logWrite("Avg %s: %s, min: %s, max: %s\n", pAvg->szName, szAvg, szMin, szMax);
+		return;
+	}
+
+	char szP50[15];
+	char szP95[15];
+	char szP99[15];
+	timerFormatPrec(szP50, logAvgGetPercentile(pAvg, 50));
+	timerFormatPrec(szP95, logAvgGetPercentile(pAvg, 95));
+	timerFormatPrec(szP99, logAvgGetPercentile(pAvg, 99));
+	logWrite(
+		"Avg %s: %s, min: %s, max: %s, p50: %s, p95: %s, p99: %s (%lu samples)\n",
+		pAvg->szName, szAvg, szMin, szMax, szP50, szP95, szP99,
+		pAvg->ulHistogramCount
+	);
+}
+
+UBYTE _logAvgEnableHistogram(tAvg *pAvg) {
+	if(!pAvg->pHistogram) {
+		pAvg->pHistogram = memAllocFastClear(LOG_AVG_HISTOGRAM_BUCKETS * sizeof(ULONG));
+		pAvg->ulHistogramCount = 0;
+	}
+	return pAvg->pHistogram != 0;
+}
+
+void _logAvgWriteHistogram(tAvg *pAvg) {
+	if(!pAvg->pHistogram || !pAvg->ulHistogramCount) {
+		logWrite("Avg %s: No histogram samples\n", pAvg->szName);
+		return;
+	}
+
+	ULONG ulMaxCount = 0;
+	for(UBYTE i = 0; i < LOG_AVG_HISTOGRAM_BUCKETS; ++i) {
+		ulMaxCount = MAX(ulMaxCount, pAvg->pHistogram[i]);
+	}
+
+	char szFrom[15];
+	char szTo[15];
+	char szBar[33];
+	logWrite("Avg %s histogram:\n", pAvg->szName);
+	for(UBYTE i = 0; i < LOG_AVG_HISTOGRAM_BUCKETS; ++i) {
+		if(!pAvg->pHistogram[i]) {
+			continue;
+		}
+		UBYTE ubBarLength = MAX(1, (pAvg->pHistogram[i] * (sizeof(szBar) - 1)) / ulMaxCount);
+		memset(szBar, '#', ubBarLength);
+		szBar[ubBarLength] = '\0';
+		timerFormatPrec(szFrom, logAvgGetBucketStart(i));
+		timerFormatPrec(szTo, logAvgGetBucketEnd(i));
+		logWrite("\t%s .. %s: %8lu %s\n", szFrom, szTo, pAvg->pHistogram[i], szBar);
+	}
+}
+
+UBYTE _logAvgExportHistogram(tAvg *pAvg, const char *szPath) {
+	if(!pAvg->pHistogram) {
+		logWrite("ERR: Histogram of avg %s is not enabled\n", pAvg->szName);
+		return 0;
+	}
+
+	systemUse();
+	tFile *pFile = diskFileOpen(szPath, "w");
+	if(!pFile) {
+		logWrite("ERR: Couldn't open '%s' for writing\n", szPath);
+		systemUnuse();
+		return 0;
+	}
+
+	// Bucket bounds in timerGetPrec() ticks and microseconds, one tick is 0.4us
+	char szLine[80];
+	fileWriteStr(pFile, "from_ticks,to_ticks,from_us,to_us,count\n");
+	for(UBYTE i = 0; i < LOG_AVG_HISTOGRAM_BUCKETS; ++i) {
+		if(!pAvg->pHistogram[i]) {
+			continue;
+		}
+		ULONG ulFrom = logAvgGetBucketStart(i);
+		ULONG ulTo = logAvgGetBucketEnd(i);
+		ULONG ulFromTenths, ulToTenths;
+		ULONG ulFromUs = logAvgTicksToUs(ulFrom, &ulFromTenths);
+		ULONG ulToUs = logAvgTicksToUs(ulTo, &ulToTenths);
+		sprintf(
+			szLine, "%lu,%lu,%lu.%lu,%lu.%lu,%lu\n", ulFrom, ulTo,
+			ulFromUs, ulFromTenths, ulToUs, ulToTenths, pAvg->pHistogram[i]
+		);
+		fileWriteStr(pFile, szLine);
+	}
+	fileClose(pFile);
+	systemUnuse();
+	return 1;
 }
 
 void _logPushInt(void) {
@@ -7,6 +7,9 @@
 #include <ace/managers/memory.h>
 #include <ace/managers/system.h>
 #include <ace/managers/log.h>
+#include <ace/managers/timer.h>
+#include <ace/utils/disk_file.h>
+#include <string.h>
 
 #ifdef AMIGA
 #include <clib/exec_protos.h> // AvailMem, AllocMem, FreeMem, etc.
@@ -14,129 +17,305 @@
 
 //------------------------------------------------------------------------ TYPES
 
+// Entries are kept in open-addressing hash table with linear probing, indexed
+// by allocation address. Table is stored in single memory block and grown
+// rarely, so that tracking doesn't need separate OS allocation for each entry
+// nor linear search on each free.
+#define MEM_TABLE_SIZE_INITIAL 1024
+
+#define MEM_TAG_DEFAULT 0
+#define MEM_DUMP_BUFFER_RECORDS 256
+
 typedef struct _tMemEntry {
-	void *pAddr;
+	void *pAddr; ///< Zero for empty slot.
 	ULONG ulSize;
+	const char *szFile;
+	UWORD uwLine;
 	UWORD uwId;
-	struct _tMemEntry *pNext;
+	UBYTE ubType;
+	UBYTE ubTag;
 } tMemEntry;
 
+typedef struct _tMemTag {
+	const char *szName;
+	ULONG ulChipUsage, ulChipPeakUsage, ulFastUsage, ulFastPeakUsage;
+} tMemTag;
+
 //----------------------------------------------------------------- PRIVATE VARS
 
 static UWORD s_uwLastId = 0;
-static tMemEntry *s_pMemTail;
+static tMemEntry *s_pMemEntries;
+static ULONG s_ulMemEntryCount, s_ulMemTableSize;
 static ULONG s_ulChipUsage, s_ulChipPeakUsage, s_ulFastUsage, s_ulFastPeakUsage;
 
+static tMemTag s_pTags[MEM_TAG_MAX] = {[MEM_TAG_DEFAULT] = {.szName = "untagged"}};
+static UBYTE s_ubTagCount = 1;
+static UBYTE s_pTagStack[MEM_TAG_STACK_DEPTH];
+static UBYTE s_ubTagStackDepth;
+
+static tFile *s_pDumpFile;
+static tMemDumpRecord *s_pDumpBuffer;
+static UWORD s_uwDumpRecordCount;
+
+//--------------------------------------------------------------------- DUMP FNS
+
+static void memDumpFlush(void) {
+	if(s_uwDumpRecordCount) {
+		systemUse();
+		fileWrite(
+			s_pDumpFile, s_pDumpBuffer, s_uwDumpRecordCount * sizeof(tMemDumpRecord)
+		);
+		systemUnuse();
+		s_uwDumpRecordCount = 0;
+	}
+}
+
+static void memDumpAdd(
+	UBYTE ubType, UBYTE ubTag, UBYTE ubMemType, const void *pAddr, ULONG ulSize
+) {
+	if(!s_pDumpFile) {
+		return;
+	}
+	tMemDumpRecord *pRecord = &s_pDumpBuffer[s_uwDumpRecordCount];
+	pRecord->ubType = ubType;
+	pRecord->ubTag = ubTag;
+	pRecord->ubMemType = ubMemType;
+	pRecord->ubPad = 0;
+	pRecord->ulTime = timerGet();
+	pRecord->ulAddr = (ULONG)pAddr;
+	pRecord->ulSize = ulSize;
+	if(++s_uwDumpRecordCount >= MEM_DUMP_BUFFER_RECORDS) {
+		memDumpFlush();
+	}
+}
+
+static void memDumpAddTag(UBYTE ubTag) {
+	if(!s_pDumpFile) {
+		return;
+	}
+	// Name goes straight after the record, so buffer must be flushed first
+	const char *szName = s_pTags[ubTag].szName;
+	ULONG ulLength = strlen(szName);
+	memDumpAdd(MEM_DUMP_RECORD_TAG, ubTag, 0, 0, ulLength);
+	memDumpFlush();
+	systemUse();
+	fileWrite(s_pDumpFile, szName, ulLength);
+	systemUnuse();
+}
+
+//---------------------------------------------------------------------- TAG FNS
+
+static UBYTE memTagGetIndex(const char *szTag) {
+	for(UBYTE i = 0; i < s_ubTagCount; ++i) {
+		if(s_pTags[i].szName == szTag || !strcmp(s_pTags[i].szName, szTag)) {
+			return i;
+		}
+	}
+	if(s_ubTagCount >= MEM_TAG_MAX) {
+		logWrite(
+			"[MEM] ERR: Too many tags, '%s' counted as '%s'\n",
+			szTag, s_pTags[MEM_TAG_DEFAULT].szName
+		);
+		return MEM_TAG_DEFAULT;
+	}
+	UBYTE ubTag = s_ubTagCount++;
+	s_pTags[ubTag] = (tMemTag){.szName = szTag};
+	memDumpAddTag(ubTag);
+	return ubTag;
+}
+
+static UBYTE memTagGetCurrent(void) {
+	if(!s_ubTagStackDepth) {
+		return MEM_TAG_DEFAULT;
+	}
+	return s_pTagStack[s_ubTagStackDepth - 1];
+}
+
 //---------------------------------------------------------------- MEM ENTRY FNS
 
+static inline ULONG memEntryGetHome(const void *pAddr) {
+	// Allocations are at least 8-byte aligned, so lowest bits are useless.
+	// Shifts & xor are much faster than multiplicative hash on 68000.
+	ULONG ulAddr = (ULONG)pAddr;
+	return ((ulAddr >> 3) ^ (ulAddr >> 13)) & (s_ulMemTableSize - 1);
+}
+
+static tMemEntry *memEntryFind(const void *pAddr) {
+	if(!s_pMemEntries) {
+		return 0;
+	}
+	ULONG ulMask = s_ulMemTableSize - 1;
+	for(ULONG i = memEntryGetHome(pAddr); s_pMemEntries[i].pAddr; i = (i + 1) & ulMask) {
+		if(s_pMemEntries[i].pAddr == pAddr) {
+			return &s_pMemEntries[i];
+		}
+	}
+	return 0;
+}
+
+static void memEntryInsert(const tMemEntry *pEntry) {
+	ULONG ulMask = s_ulMemTableSize - 1;
+	ULONG i = memEntryGetHome(pEntry->pAddr);
+	while(s_pMemEntries[i].pAddr) {
+		i = (i + 1) & ulMask;
+	}
+	s_pMemEntries[i] = *pEntry;
+	++s_ulMemEntryCount;
+}
+
+static void memEntryRemove(tMemEntry *pEntry) {
+	// Backward shift deletion - moves following entries of the same cluster
+	// into the hole if it's not before their home slot, so that no tombstones
+	// are needed and lookups stay short.
+	ULONG ulMask = s_ulMemTableSize - 1;
+	ULONG ulHole = pEntry - s_pMemEntries;
+	ULONG i = ulHole;
+	for(;;) {
+		i = (i + 1) & ulMask;
+		if(!s_pMemEntries[i].pAddr) {
+			break;
+		}
+		ULONG ulHome = memEntryGetHome(s_pMemEntries[i].pAddr);
+		if(((i - ulHome) & ulMask) >= ((i - ulHole) & ulMask)) {
+			s_pMemEntries[ulHole] = s_pMemEntries[i];
+			ulHole = i;
+		}
+	}
+	s_pMemEntries[ulHole].pAddr = 0;
+	--s_ulMemEntryCount;
+}
+
+static UBYTE memEntryTableResize(ULONG ulNewSize) {
+	tMemEntry *pOldEntries = s_pMemEntries;
+	ULONG ulOldSize = s_ulMemTableSize;
+	s_pMemEntries = _memAllocRls(ulNewSize * sizeof(tMemEntry), MEMF_CLEAR);
+	if(!s_pMemEntries) {
+		logWrite("[MEM] ERR: can't grow allocation table to %lu entries\n", ulNewSize);
+		s_pMemEntries = pOldEntries;
+		return 0;
+	}
+	s_ulMemTableSize = ulNewSize;
+	s_ulMemEntryCount = 0;
+	if(pOldEntries) {
+		for(ULONG i = 0; i < ulOldSize; ++i) {
+			if(pOldEntries[i].pAddr) {
+				memEntryInsert(&pOldEntries[i]);
+			}
+		}
+		_memFreeRls(pOldEntries, ulOldSize * sizeof(tMemEntry));
+	}
+	return 1;
+}
+
 static void _memEntryAdd(
 	void *pAddr, ULONG ulSize, UWORD uwLine, const char *szFile
 ) {
-	// Ozzyboshi discovered that memory allocation works without re-enabling
-	// the OS. After analyzing what's under the hood, it looks like there are only
-	// Forbid/Permit calls inside OS mem fns and the rest is just plain code.
-	// Still, OS mem fns can be patched by Snoopdos and/or newer OS versions,
-	// so I guess the safest approach is not to assume anything and wake OS up
-	// in case it needs other components on some exotic configs.
+	// Keep load factor below 3/4 so that probe sequences stay short.
+	// Growing needs OS, but it's rare since table size is doubled each time.
+	if(
+		!s_pMemEntries ||
+		(s_ulMemEntryCount + 1) * 4 > s_ulMemTableSize * 3
+	) {
+		ULONG ulNewSize = (
+			s_pMemEntries ? s_ulMemTableSize * 2 : MEM_TABLE_SIZE_INITIAL
+		);
+		if(!memEntryTableResize(ulNewSize) && !s_pMemEntries) {
+			return;
+		}
+	}
 
-	systemUse();
-	tMemEntry *pNext;
-	// Add mem usage entry
-	pNext = s_pMemTail;
-	s_pMemTail = _memAllocRls(sizeof(tMemEntry), MEMF_CLEAR);
-	s_pMemTail->pAddr = pAddr;
-	s_pMemTail->ulSize = ulSize;
-	s_pMemTail->uwId = s_uwLastId++;
-	s_pMemTail->pNext = pNext;
+	tMemEntry sEntry = {
+		.pAddr = pAddr, .ulSize = ulSize, .szFile = szFile, .uwLine = uwLine,
+		.uwId = s_uwLastId++, .ubType = memType(pAddr),
+		.ubTag = memTagGetCurrent()
+	};
+	memEntryInsert(&sEntry);
+	memDumpAdd(MEM_DUMP_RECORD_ALLOC, sEntry.ubTag, sEntry.ubType, pAddr, ulSize);
 
+	tMemTag *pTag = &s_pTags[sEntry.ubTag];
 	logWrite(
-		"[MEM] Allocated %s memory %hu@%p, size %lu (%s:%u)\n",
-		(memType(pAddr) & MEMF_CHIP) ? "CHIP" : "FAST",
-		s_pMemTail->uwId, pAddr, ulSize, szFile, uwLine
+		"[MEM] Allocated %s memory %hu@%p, size %lu, tag %s (%s:%u)\n",
+		(sEntry.ubType & MEMF_CHIP) ? "CHIP" : "FAST",
+		sEntry.uwId, pAddr, ulSize, pTag->szName, szFile, uwLine
 	);
 
 	// Update mem usage counter
-	if(memType(pAddr) & MEMF_CHIP) {
+	if(sEntry.ubType & MEMF_CHIP) {
 		s_ulChipUsage += ulSize;
 		if(s_ulChipUsage > s_ulChipPeakUsage) {
 			s_ulChipPeakUsage = s_ulChipUsage;
 		}
+		pTag->ulChipUsage += ulSize;
+		if(pTag->ulChipUsage > pTag->ulChipPeakUsage) {
+			pTag->ulChipPeakUsage = pTag->ulChipUsage;
+		}
 	}
 	else {
 		s_ulFastUsage += ulSize;
 		if(s_ulFastUsage > s_ulFastPeakUsage) {
 			s_ulFastPeakUsage = s_ulFastUsage;
 		}
+		pTag->ulFastUsage += ulSize;
+		if(pTag->ulFastUsage > pTag->ulFastPeakUsage) {
+			pTag->ulFastPeakUsage = pTag->ulFastUsage;
+		}
 	}
-	systemUnuse();
 }
 
 static ULONG _memEntryDelete(
 	void *pAddr, ULONG ulSize, UWORD uwLine, const char *szFile
 ) {
-	tMemEntry *pPrev = 0;
-	tMemEntry *pCurr = s_pMemTail;
-
 	// find memory entry
-	while(pCurr && pCurr->pAddr != pAddr) {
-		pPrev = pCurr;
-		pCurr = pCurr->pNext;
-	}
-	if(!pCurr) {
+	tMemEntry *pEntry = memEntryFind(pAddr);
+	if(!pEntry) {
 		logWrite(
 			"[MEM] ERR: can't find memory allocated at %p (%s:%u)\n", pAddr, szFile, uwLine
 		);
 		return 0;
 	}
 
-	// unlink entry from list
-	if(pPrev) {
-		pPrev->pNext = pCurr->pNext;
-	}
-	else {
-		s_pMemTail = pCurr->pNext;
-	}
-
-	// remove entry
-	systemUse();
-	if(ulSize != pCurr->ulSize) {
+	if(ulSize != pEntry->ulSize) {
 		logWrite(
 			"[MEM] ERR: memFree size mismatch at memory %hu@%p: %lu, should be %lu (%s:%u)\n",
-			pCurr->uwId, pAddr, ulSize, pCurr->ulSize, szFile, uwLine
+			pEntry->uwId, pAddr, ulSize, pEntry->ulSize, szFile, uwLine
 		);
 	}
 	logWrite(
 		"[MEM] Freed memory %hu@%p, size %lu (%s:%u)\n",
-		pCurr->uwId, pAddr, ulSize, szFile, uwLine
+		pEntry->uwId, pAddr, ulSize, szFile, uwLine
 	);
 
 	// Update mem usage counter
-	if(memType(pAddr) & MEMF_CHIP) {
-		s_ulChipUsage -= ulSize;
+	ULONG ulEntrySize = pEntry->ulSize;
+	tMemTag *pTag = &s_pTags[pEntry->ubTag];
+	if(pEntry->ubType & MEMF_CHIP) {
+		s_ulChipUsage -= ulEntrySize;
+		pTag->ulChipUsage -= ulEntrySize;
 	}
 	else {
-		s_ulFastUsage -= ulSize;
+		s_ulFastUsage -= ulEntrySize;
+		pTag->ulFastUsage -= ulEntrySize;
 	}
+	memDumpAdd(MEM_DUMP_RECORD_FREE, pEntry->ubTag, pEntry->ubType, pAddr, ulEntrySize);
 
-	systemUnuse();
-	return pCurr->ulSize;
+	memEntryRemove(pEntry);
+	return ulEntrySize;
 }
 
 static void memEntryCheckTrash(
 	const tMemEntry *pEntry, UWORD uwLine, const char *szFile
 ) {
-	UBYTE *pCafe = (UBYTE*)(pEntry->pAddr - 4*sizeof(UBYTE));
-	UBYTE *pDead = (UBYTE*)(pEntry->pAddr + pEntry->ulSize);
-	if(pCafe[0] != 0xCA || pCafe[1] != 0xFE || pCafe[2] != 0xBA || pCafe[3] != 0xBE) {
+	UBYTE ubTrash = _memGetTrash(pEntry->pAddr, pEntry->ulSize);
+	if(ubTrash & MEM_TRASH_LEFT) {
 		logWrite(
-			"[MEM] ERR: Left mem trashed: %hu@%p (%s:%u)\n",
-			pEntry->uwId, pEntry->pAddr, szFile, uwLine
+			"[MEM] ERR: Left mem trashed: %hu@%p, allocated at %s:%u (%s:%u)\n",
+			pEntry->uwId, pEntry->pAddr, pEntry->szFile, pEntry->uwLine, szFile, uwLine
 		);
 	}
-	if(pDead[0] != 0xDE || pDead[1] != 0xAD || pDead[2] != 0xBE || pDead[3] != 0xEF) {
+	if(ubTrash & MEM_TRASH_RIGHT) {
 		logWrite(
-			"[MEM] ERR: Right mem trashed: %hu@%p (%s:%u)\n",
-			pEntry->uwId, pEntry->pAddr, szFile, uwLine
+			"[MEM] ERR: Right mem trashed: %hu@%p, allocated at %s:%u (%s:%u)\n",
+			pEntry->uwId, pEntry->pAddr, pEntry->szFile, pEntry->uwLine, szFile, uwLine
 		);
 	}
 }
@@ -144,35 +323,62 @@ static void memEntryCheckTrash(
 //---------------------------------------------------------------------- MEM FNS
 
 void _memCheckIntegrity(UWORD uwLine, const char *szFile) {
-	tMemEntry *pEntry = s_pMemTail;
-	while(pEntry) {
-		memEntryCheckTrash(pEntry, uwLine, szFile);
-		pEntry = pEntry->pNext;
+	for(ULONG i = 0; i < s_ulMemTableSize; ++i) {
+		if(s_pMemEntries[i].pAddr) {
+			memEntryCheckTrash(&s_pMemEntries[i], uwLine, szFile);
+		}
 	}
 
 	systemCheckStack();
 }
 
 void _memCreate(void) {
-	s_pMemTail = 0;
+	if(s_pMemEntries) {
+		// Forget allocations made before memory manager creation
+		for(ULONG i = 0; i < s_ulMemTableSize; ++i) {
+			s_pMemEntries[i].pAddr = 0;
+		}
+		s_ulMemEntryCount = 0;
+	}
+	else {
+		memEntryTableResize(MEM_TABLE_SIZE_INITIAL);
+	}
 	s_ulChipUsage = 0;
 	s_ulChipPeakUsage = 0;
 	s_ulFastUsage = 0;
 	s_ulFastPeakUsage = 0;
 	s_uwLastId = 0;
+	s_pTags[MEM_TAG_DEFAULT] = (tMemTag){.szName = "untagged"};
+	s_ubTagCount = 1;
+	s_ubTagStackDepth = 0;
 }
 
 void _memDestroy(void) {
 	systemUse();
 	logWrite("\n=============== MEMORY MANAGER DESTROY ==============\n");
 	logWrite("If something is deallocated past here, you're a wuss!\n");
-	while(s_pMemTail) {
-		_memFreeDbg(s_pMemTail->pAddr, s_pMemTail->ulSize, 0, "memoryDestroy");
+	// Dump's file handle is tracked too, so close it before freeing leaks.
+	// Leaks will show up in dump as never freed.
+	_memDumpStop();
+	_memLogPeak();
+	for(ULONG i = 0; i < s_ulMemTableSize;) {
+		const tMemEntry *pEntry = &s_pMemEntries[i];
+		if(!pEntry->pAddr) {
+			++i;
+			continue;
+		}
+		// Removal may shift another entry into this slot, so check it again
+		logWrite(
+			"[MEM] Leak: %hu@%p, size %lu, allocated at %s:%u\n",
+			pEntry->uwId, pEntry->pAddr, pEntry->ulSize, pEntry->szFile, pEntry->uwLine
+		);
+		_memFreeDbg(pEntry->pAddr, pEntry->ulSize, 0, "memoryDestroy");
+	}
+	if(s_pMemEntries) {
+		_memFreeRls(s_pMemEntries, s_ulMemTableSize * sizeof(tMemEntry));
+		s_pMemEntries = 0;
+		s_ulMemTableSize = 0;
 	}
-	logWrite(
-		"[MEM] Peak usage: CHIP: %lu, FAST: %lu\n",
-		s_ulChipPeakUsage, s_ulFastPeakUsage
-	);
 	systemUnuse();
 }
 
@@ -183,6 +389,14 @@ void *_memAllocDbg(
 		logWrite("[MEM] ERR: zero alloc size! (%s:%u)\n", szFile, uwLine);
 		return 0;
 	}
+	// Ozzyboshi discovered that memory allocation works without re-enabling
+	// the OS. After analyzing what's under the hood, it looks like there are only
+	// Forbid/Permit calls inside OS mem fns and the rest is just plain code.
+	// Still, OS mem fns can be patched by Snoopdos and/or newer OS versions,
+	// so I guess the safest approach is not to assume anything and wake OS up
+	// in case it needs other components on some exotic configs.
+	// Whole fn is wrapped so that nested systemUse() calls are cheap.
+	systemUse();
 	void *pAddr;
 	pAddr = _memAllocRls(ulSize + 2 * sizeof(ULONG), ulFlags);
 	if(!pAddr) {
@@ -197,14 +411,13 @@ void *_memAllocDbg(
 			AvailMem(ulFlags | MEMF_LARGEST)
 		);
 #endif // AMIGA
+		systemUnuse();
 		return 0;
 	}
 	pAddr += sizeof(ULONG);
-	UBYTE *pCafe = (UBYTE*)(pAddr - 4*sizeof(UBYTE));
-	UBYTE *pDead = (UBYTE*)(pAddr + ulSize);
-	pCafe[0] = 0xCA; pCafe[1] = 0xFE; pCafe[2] = 0xBA; pCafe[3] = 0xBE;
-	pDead[0] = 0xDE; pDead[1] = 0xAD; pDead[2] = 0xBE; pDead[3] = 0xEF;
+	_memWriteTrash(pAddr, ulSize);
 	_memEntryAdd(pAddr, ulSize, uwLine, szFile);
+	systemUnuse();
 	return pAddr;
 }
 
@@ -248,12 +461,8 @@ void _memFreeRls(void *pMem, ULONG ulSize) {
 }
 
 void _memCheckTrashAtAddr(void *pMem, UWORD uwLine, const char *szFile) {
-	// find memory entry
-	tMemEntry *pEntry = s_pMemTail;
-	while(pEntry && pEntry->pAddr != pMem) {
-		pEntry = pEntry->pNext;
-	}
-	if(pEntry->pAddr != pMem) {
+	const tMemEntry *pEntry = memEntryFind(pMem);
+	if(!pEntry) {
 		logWrite(
 			"[MEM] ERR: can't find memory allocated at %p (%s:%u)\n",
 			pMem, szFile, uwLine
@@ -263,11 +472,113 @@ void _memCheckTrashAtAddr(void *pMem, UWORD uwLine, const char *szFile) {
 	memEntryCheckTrash(pEntry, uwLine, szFile);
 }
 
+void _memWriteTrash(void *pMem, ULONG ulSize) {
+	// Written bytewise since block size doesn't need to be even
+	UBYTE *pCafe = (UBYTE*)(pMem - 4*sizeof(UBYTE));
+	UBYTE *pDead = (UBYTE*)(pMem + ulSize);
+	pCafe[0] = 0xCA; pCafe[1] = 0xFE; pCafe[2] = 0xBA; pCafe[3] = 0xBE;
+	pDead[0] = 0xDE; pDead[1] = 0xAD; pDead[2] = 0xBE; pDead[3] = 0xEF;
+}
+
+UBYTE _memGetTrash(const void *pMem, ULONG ulSize) {
+	const UBYTE *pCafe = (const UBYTE*)(pMem - 4*sizeof(UBYTE));
+	const UBYTE *pDead = (const UBYTE*)(pMem + ulSize);
+	UBYTE ubTrash = 0;
+	if(pCafe[0] != 0xCA || pCafe[1] != 0xFE || pCafe[2] != 0xBA || pCafe[3] != 0xBE) {
+		ubTrash |= MEM_TRASH_LEFT;
+	}
+	if(pDead[0] != 0xDE || pDead[1] != 0xAD || pDead[2] != 0xBE || pDead[3] != 0xEF) {
+		ubTrash |= MEM_TRASH_RIGHT;
+	}
+	return ubTrash;
+}
+
 void _memLogPeak(void) {
 	logWrite(
 		"[MEM] Peak usage: CHIP: %lu, FAST: %lu\n",
 		s_ulChipPeakUsage, s_ulFastPeakUsage
 	);
+	for(UBYTE i = 0; i < s_ubTagCount; ++i) {
+		const tMemTag *pTag = &s_pTags[i];
+		logWrite(
+			"[MEM] Tag %s: CHIP peak %lu, now %lu; FAST peak %lu, now %lu\n",
+			pTag->szName, pTag->ulChipPeakUsage, pTag->ulChipUsage,
+			pTag->ulFastPeakUsage, pTag->ulFastUsage
+		);
+	}
+}
+
+void _memPushTag(const char *szTag) {
+	if(s_ubTagStackDepth >= MEM_TAG_STACK_DEPTH) {
+		logWrite("[MEM] ERR: Tag stack overflow, can't push '%s'\n", szTag);
+		return;
+	}
+	s_pTagStack[s_ubTagStackDepth++] = memTagGetIndex(szTag);
+}
+
+void _memPopTag(void) {
+	if(!s_ubTagStackDepth) {
+		logWrite("[MEM] ERR: Tag stack underflow\n");
+		return;
+	}
+	--s_ubTagStackDepth;
+}
+
+void _memDumpStart(const char *szPath) {
+	systemUse();
+	if(s_pDumpFile) {
+		_memDumpStop();
+	}
+	s_pDumpBuffer = _memAllocRls(
+		MEM_DUMP_BUFFER_RECORDS * sizeof(tMemDumpRecord), MEMF_ANY
+	);
+	if(!s_pDumpBuffer) {
+		logWrite("[MEM] ERR: Couldn't allocate dump buffer\n");
+		systemUnuse();
+		return;
+	}
+	tFile *pFile = diskFileOpen(szPath, "wb");
+	if(!pFile) {
+		logWrite("[MEM] ERR: Couldn't open dump file '%s'\n", szPath);
+		_memFreeRls(s_pDumpBuffer, MEM_DUMP_BUFFER_RECORDS * sizeof(tMemDumpRecord));
+		s_pDumpBuffer = 0;
+		systemUnuse();
+		return;
+	}
+	const UBYTE pHeader[8] = {'A', 'M', 'E', 'M', MEM_DUMP_VERSION, 0, 0, 0};
+	fileWrite(pFile, pHeader, sizeof(pHeader));
+	s_pDumpFile = pFile;
+	s_uwDumpRecordCount = 0;
+
+	// Describe current state so that dump's timeline is complete
+	for(UBYTE i = 0; i < s_ubTagCount; ++i) {
+		memDumpAddTag(i);
+	}
+	for(ULONG i = 0; i < s_ulMemTableSize; ++i) {
+		const tMemEntry *pEntry = &s_pMemEntries[i];
+		if(pEntry->pAddr) {
+			memDumpAdd(
+				MEM_DUMP_RECORD_ALLOC, pEntry->ubTag, pEntry->ubType,
+				pEntry->pAddr, pEntry->ulSize
+			);
+		}
+	}
+	systemUnuse();
+}
+
+void _memDumpStop(void) {
+	if(!s_pDumpFile) {
+		return;
+	}
+	systemUse();
+	memDumpFlush();
+	// Zero the handle first so that closing file doesn't record its own free
+	tFile *pFile = s_pDumpFile;
+	s_pDumpFile = 0;
+	fileClose(pFile);
+	_memFreeRls(s_pDumpBuffer, MEM_DUMP_BUFFER_RECORDS * sizeof(tMemDumpRecord));
+	s_pDumpBuffer = 0;
+	systemUnuse();
 }
 
 UBYTE memType(const void *pMem) {
@@ -0,0 +1,186 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <ace/managers/profiler.h>
+#ifdef ACE_PROFILER
+#include <string.h>
+#include <ace/managers/log.h>
+#include <ace/managers/memory.h>
+#include <ace/managers/system.h>
+#include <ace/managers/timer.h>
+#include <ace/utils/disk_file.h>
+
+static const char *s_pZoneNames[PROFILER_ZONE_MAX] = {
+	[PROFILER_ZONE_BOB_UNDRAW] = "bobUndraw",
+	[PROFILER_ZONE_BOB_DRAW] = "bobDraw",
+	[PROFILER_ZONE_TILEBUFFER] = "tileBuffer",
+	[PROFILER_ZONE_COPPER] = "copper",
+	[PROFILER_ZONE_STATE] = "state",
+	[PROFILER_ZONE_OVERFLOW] = "overflow",
+};
+static UBYTE s_ubZoneCount = PROFILER_ZONE_BUILTIN_COUNT;
+
+static tProfilerEvent *s_pEvents;
+static UWORD s_uwEventCount;
+static UWORD s_uwEventHead;
+static UBYTE s_isWrapped;
+static UBYTE s_isEnabled;
+
+static tProfilerZone s_pZoneStack[PROFILER_DEPTH_MAX];
+static UBYTE s_ubDepth;
+static UBYTE s_ubDepthOverflow; ///< Zones begun past PROFILER_DEPTH_MAX.
+
+static void profilerAddEvent(UBYTE ubType, tProfilerZone ubZone) {
+	tProfilerEvent *pEvent = &s_pEvents[s_uwEventHead];
+	pEvent->ulTime = timerGetPrec();
+	pEvent->ubType = ubType;
+	pEvent->ubZone = ubZone;
+	if(++s_uwEventHead >= s_uwEventCount) {
+		s_uwEventHead = 0;
+		s_isWrapped = 1;
+	}
+}
+
+UBYTE _profilerCreate(UWORD uwEventCount) {
+	logBlockBegin("profilerCreate(uwEventCount: %hu)", uwEventCount);
+	s_pEvents = memAllocFast(uwEventCount * sizeof(tProfilerEvent));
+	if(!s_pEvents) {
+		logBlockEnd("profilerCreate()");
+		return 0;
+	}
+	s_uwEventCount = uwEventCount;
+	s_uwEventHead = 0;
+	s_isWrapped = 0;
+	s_ubDepth = 0;
+	s_ubDepthOverflow = 0;
+	s_isEnabled = 1;
+	logBlockEnd("profilerCreate()");
+	return 1;
+}
+
+void _profilerDestroy(void) {
+	logBlockBegin("profilerDestroy()");
+	if(s_pEvents) {
+		memFree(s_pEvents, s_uwEventCount * sizeof(tProfilerEvent));
+		s_pEvents = 0;
+	}
+	s_isEnabled = 0;
+	logBlockEnd("profilerDestroy()");
+}
+
+tProfilerZone _profilerZoneCreate(const char *szName) {
+	// Zones are usually created on state load, so reuse them across loads
+	for(UBYTE i = 0; i < s_ubZoneCount; ++i) {
+		if(!strcmp(s_pZoneNames[i], szName)) {
+			return i;
+		}
+	}
+	if(s_ubZoneCount >= PROFILER_ZONE_MAX) {
+		logWrite("ERR: Can't create profiler zone '%s', limit reached\n", szName);
+		return PROFILER_ZONE_OVERFLOW;
+	}
+	s_pZoneNames[s_ubZoneCount] = szName;
+	return s_ubZoneCount++;
+}
+
+void _profilerZoneBegin(tProfilerZone ubZone) {
+	// Zone stack is kept even while paused, so that it's in sync on resume
+	if(s_ubDepth >= PROFILER_DEPTH_MAX) {
+		// Not recorded, but counted so that its end won't close the parent zone
+		if(!s_ubDepthOverflow) {
+			logWrite("ERR: Profiler zones nested too deep\n");
+		}
+		++s_ubDepthOverflow;
+		return;
+	}
+	s_pZoneStack[s_ubDepth++] = ubZone;
+	if(s_isEnabled) {
+		profilerAddEvent(PROFILER_EVENT_BEGIN, ubZone);
+	}
+}
+
+void _profilerZoneEnd(void) {
+	if(s_ubDepthOverflow) {
+		--s_ubDepthOverflow;
+		return;
+	}
+	if(!s_ubDepth) {
+		logWrite("ERR: profilerZoneEnd() without matching begin\n");
+		return;
+	}
+	--s_ubDepth;
+	if(s_isEnabled) {
+		profilerAddEvent(PROFILER_EVENT_END, s_pZoneStack[s_ubDepth]);
+	}
+}
+
+void _profilerFrameBegin(void) {
+	if(!s_isEnabled) {
+		return;
+	}
+	profilerAddEvent(PROFILER_EVENT_FRAME, 0);
+}
+
+void _profilerSetEnabled(UBYTE isEnabled) {
+	isEnabled = isEnabled && s_pEvents;
+	if(isEnabled == s_isEnabled) {
+		return;
+	}
+	if(isEnabled) {
+		// Reopen zones which are in progress, so that their ends have begins
+		s_isEnabled = 1;
+		for(UBYTE i = 0; i < s_ubDepth; ++i) {
+			profilerAddEvent(PROFILER_EVENT_BEGIN, s_pZoneStack[i]);
+		}
+	}
+	else {
+		// Close zones which are in progress, so that the ring ends with them
+		for(UBYTE i = s_ubDepth; i--;) {
+			profilerAddEvent(PROFILER_EVENT_END, s_pZoneStack[i]);
+		}
+		s_isEnabled = 0;
+	}
+}
+
+UBYTE _profilerDump(const char *szPath) {
+	logBlockBegin("profilerDump(szPath: '%s')", szPath);
+	systemUse();
+	tFile *pFile = diskFileOpen(szPath, "wb");
+	if(!pFile) {
+		logWrite("ERR: Couldn't open '%s' for writing\n", szPath);
+		systemUnuse();
+		logBlockEnd("profilerDump()");
+		return 0;
+	}
+
+	UBYTE pHeader[8] = {
+		'A', 'P', 'R', 'F', PROFILER_DUMP_VERSION, s_ubZoneCount, 0, 0
+	};
+	fileWrite(pFile, pHeader, sizeof(pHeader));
+	for(UBYTE i = 0; i < s_ubZoneCount; ++i) {
+		ULONG ulLength = strlen(s_pZoneNames[i]) + 1;
+		fileWrite(pFile, s_pZoneNames[i], ulLength);
+		if(ulLength & 1) {
+			fileWrite(pFile, "", 1);
+		}
+	}
+
+	// Oldest events are after the head if ring has wrapped
+	ULONG ulEventCount = s_isWrapped ? s_uwEventCount : s_uwEventHead;
+	fileWrite(pFile, &ulEventCount, sizeof(ulEventCount));
+	if(s_isWrapped) {
+		fileWrite(
+			pFile, &s_pEvents[s_uwEventHead],
+			(s_uwEventCount - s_uwEventHead) * sizeof(tProfilerEvent)
+		);
+	}
+	fileWrite(pFile, s_pEvents, s_uwEventHead * sizeof(tProfilerEvent));
+	fileClose(pFile);
+	systemUnuse();
+	logWrite("Dumped %lu events\n", ulEventCount);
+	logBlockEnd("profilerDump()");
+	return 1;
+}
+
+#endif // ACE_PROFILER
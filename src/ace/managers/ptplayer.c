@@ -14,8 +14,9 @@
 #include <ace/managers/system.h>
 #include <ace/utils/custom.h>
 #include <ace/utils/disk_file.h>
-#include <hardware/intbits.h>
-#include <hardware/dmabits.h>
+#include <ace/utils/endian.h>
+#include <ace/macros.h>
+#include <string.h>
 
 //----------------------------------------------------------------------- CONFIG
 
@@ -63,9 +64,25 @@
 #define MOD_BYTES_PER_NOTE 4
 // Length of single pattern.
 #define MOD_PATTERN_LENGTH (MOD_ROWS_IN_PATTERN * MOD_NOTES_PER_ROW * MOD_BYTES_PER_NOTE)
+#define MOD_ROW_LENGTH (MOD_NOTES_PER_ROW * MOD_BYTES_PER_NOTE)
+
+// Packed patterns, written by ACE's mod_tool with -pack
+#define MOD_PACKED_FORMAT_TAG "ACEP"
+#define MOD_PACKED_EMPTY_RUN 0x80
+#define MOD_PACKED_NO_PATTERN 0xFF
 
 // Size of period table.
 #define MOD_PERIOD_TABLE_LENGTH 36
+#define MOD_FINETUNE_COUNT 16
+
+// Range of periods in all period tables.
+#define MOD_PERIOD_MIN 108
+#define MOD_PERIOD_MAX 907
+
+// Period lookup tables have entry for each 8 periods. Periods in tables are
+// at least 6 apart, so each entry is at most 2 positions off.
+#define PERIOD_LOOKUP_SHIFT 3
+#define PERIOD_LOOKUP_SIZE (((MOD_PERIOD_MAX - MOD_PERIOD_MIN) >> PERIOD_LOOKUP_SHIFT) + 1)
 
 /**
  * @brief Delay in CIA-ticks, which guarantees that at least one Audio-DMA
@@ -77,6 +94,28 @@
 
 #define SFX_PRIORITY_LOOPED 0xFF
 
+#if defined(AMIGA)
+#define PAULA_WRITE(reg, value) (reg) = (value)
+#define PTPLAYER_ON_FX(ubFx)
+#else
+// Host builds report replay cost to the program running the replay
+#define PAULA_WRITE(reg, value) do { \
+	(reg) = (value); \
+	ptplayerHostOnRegWrite(); \
+} while(0)
+#define PTPLAYER_ON_FX(ubFx) ptplayerHostOnFx(ubFx)
+#endif
+
+// .sfx v2 compression types
+#define SFX_COMPRESSION_NONE 0
+#define SFX_COMPRESSION_FIB_DELTA 1
+
+// Compressed sample packs, written by ACE's mod_tool with -cmp
+#define SAMPLE_PACK_FORMAT_TAG "ACSP"
+#define SAMPLE_PACK_VERSION 1
+// Size of fast RAM buffer for encoded data, decoded into chip RAM piece by piece.
+#define SAMPLE_PACK_STAGING_SIZE 512
+
 //------------------------------------------------------------------------ TYPES
 
 typedef struct AudChannel tChannelRegs;
@@ -90,8 +129,14 @@ typedef struct _tModVoice {
 			UWORD uwNote; // [instrumentHi:4] [period:12]
 			union {
 				struct {
+#if defined(AMIGA)
 					UBYTE ubCmdHi; // [instrumentLo:4] [cmdNo:4]
 					UBYTE ubCmdLo; // [cmdArg:8] - special effects data
+#else
+					// Host builds are little-endian, words are swapped on load
+					UBYTE ubCmdLo;
+					UBYTE ubCmdHi;
+#endif
 				};
 				UWORD uwCmd; // [instrumentLo:4] [cmdNo:4] [cmdArg:8]
 			};
@@ -100,6 +145,20 @@ typedef struct _tModVoice {
 	};
 } tModVoice;
 
+/**
+ * @brief Sequential reader of pattern rows, used for packed patterns.
+ * Each channel is a stream of 4-byte notes, with runs of empty notes stored
+ * as single MOD_PACKED_EMPTY_RUN | (runLength - 1) byte. Reading next row
+ * is cheap, jumping elsewhere requires scanning pattern from its start.
+ */
+typedef struct _tPatternCursor {
+	const UBYTE *pStreams[MOD_NOTES_PER_ROW];
+	UBYTE pEmptyLeft[MOD_NOTES_PER_ROW]; ///< Remaining empty notes in current run.
+	UBYTE ubPatternIdx; ///< MOD_PACKED_NO_PATTERN if cursor isn't set.
+	UWORD uwNextPos; ///< Byte offset of next row in unpacked pattern.
+	tModVoice pRow[MOD_NOTES_PER_ROW]; ///< Last unpacked row.
+} tPatternCursor;
+
 typedef struct _tChannelStatus {
 	tModVoice sVoice;
 
@@ -170,6 +229,11 @@ typedef struct _tChannelStatus {
 	 */
 	UBYTE n_minusft;
 
+	/**
+	 * @brief Index of currently used period table, 0..15.
+	 */
+	UBYTE ubFineTune;
+
 	UBYTE n_vibratoamp;
 	UBYTE n_vibratospd;
 	UBYTE n_vibratopos;
@@ -987,6 +1051,101 @@ static UBYTE mt_SongPos; ///< Position in arrangement.
 static UBYTE mt_PattDelTime;
 static UBYTE mt_PattDelTime2;
 static UBYTE mt_SilCntValid;
+static tPatternCursor s_sCursorMusic; ///< Used by mt_music() only.
+static tPatternCursor s_sCursorPeek; ///< Used outside of music interrupt.
+
+/**
+ * @brief Position in period table of each finetune, for consecutive ranges
+ * of periods. Built in ptplayerCreate(), used by findPeriod().
+ */
+static UBYTE s_pPeriodLookup[MOD_FINETUNE_COUNT][PERIOD_LOOKUP_SIZE];
+
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+typedef struct _tPtplayerProfile {
+	ULONG ulCalls;
+	ULONG ulColorClocksTotal;
+	UWORD uwColorClocksMax;
+} tPtplayerProfile;
+
+static tPtplayerProfile s_sProfileMusic, s_sProfileSfx, s_sProfileMixer;
+#endif
+
+/**
+ * @brief Number of distinct volumes of software-mixed sfx. Each level takes
+ * 256 bytes of volume table.
+ */
+#define MIXER_VOLUME_LEVELS 16
+
+/**
+ * @brief Number of buffers in stream's ring, each lasting two frames.
+ */
+#define STREAM_BUFFER_COUNT 8
+
+/**
+ * @brief Stream is refilled after at least this many buffers were played.
+ */
+#define STREAM_REFILL_BATCH 4
+
+typedef struct _tMixerVoice {
+	const BYTE *pCurr; ///< Current sample position, zero if voice is idle.
+	const BYTE *pEnd; ///< Sample end.
+	const BYTE *pVolumeTable; ///< Scaled sample values for voice's volume.
+	UWORD uwFrac; ///< Fractional part of sample position.
+	UWORD uwStepFrac; ///< Fractional part of sample position increment.
+	UWORD uwStepInt; ///< Integer part of sample position increment.
+	UBYTE ubPriority;
+	ULONG ulStartIndex; ///< Used for replacing older sfx of same priority.
+} tMixerVoice;
+
+typedef struct _tMixerStream {
+	BYTE *pBuffers[2]; ///< Chip RAM buffers played back alternately by Paula.
+	UBYTE ubChannel;
+	UBYTE ubVoiceFirst; ///< Stream uses voices ubVoiceFirst + k * stream count.
+	UBYTE ubQueued; ///< Index of buffer to be played after current one.
+	UBYTE ubSilentBuffers; ///< Number of buffers already filled with silence.
+} tMixerStream;
+
+typedef struct _tMixer {
+	tMixerStream pStreams[2];
+	tMixerVoice pVoices[PTPLAYER_MIXER_VOICES_MAX];
+	BYTE *pVolumeTables; ///< MIXER_VOLUME_LEVELS tables of 256 values.
+	ULONG ulStartCount;
+	UWORD uwBufferSize; ///< Size of each buffer in bytes, even.
+	UWORD uwPeriod;
+	UBYTE ubChannelMask; ///< Channels taken by mixer, zero if it's inactive.
+	UBYTE ubStreamCount;
+	UBYTE ubVoiceCount;
+} tMixer;
+
+static tMixer s_sMixer;
+
+static void mixerProcess(void);
+static void mixerStopVoicesOfSfx(const tPtplayerSfx *pSfx);
+
+static void mixerRelocateVoicesOfSfx(
+	const tPtplayerSfx *pSfx, const UBYTE *pOld, const UBYTE *pNew
+);
+
+/**
+ * @brief Streams playing on each channel, zero if there's none.
+ */
+static tPtplayerStream *s_pStreams[4];
+
+static void streamProcess(tPtplayerStream *pStream);
+
+/**
+ * @brief Channels taken away from ptplayer by sfx mixer and streams.
+ */
+static UBYTE s_ubChannelsTaken;
+
+/**
+ * @brief Player channel mask of taken channels, restored on giving them back.
+ */
+static UBYTE s_ubChannelsTakenFromPlayer;
+
+static UBYTE isChannelTaken(UBYTE ubChannel) {
+	return BTST(s_ubChannelsTaken, ubChannel);
+}
 
 /**
  * Each player loop generates this from scratch.
@@ -1043,6 +1202,79 @@ static UBYTE isChannelDone(tChannelStatus *pChannelData) {
 #endif
 }
 
+static void ptCursorReset(tPatternCursor *pCursor) {
+	pCursor->ubPatternIdx = MOD_PACKED_NO_PATTERN;
+}
+
+static void ptCursorUnpackRow(tPatternCursor *pCursor) {
+	for(UBYTE ubChannel = 0; ubChannel < MOD_NOTES_PER_ROW; ++ubChannel) {
+		tModVoice *pVoice = &pCursor->pRow[ubChannel];
+		if(pCursor->pEmptyLeft[ubChannel]) {
+			--pCursor->pEmptyLeft[ubChannel];
+			pVoice->ulData = 0;
+			continue;
+		}
+
+		// Streams aren't word-aligned - copy byte by byte
+		const UBYTE *pStream = pCursor->pStreams[ubChannel];
+		UBYTE ubFirst = *(pStream++);
+		if(ubFirst & MOD_PACKED_EMPTY_RUN) {
+			pCursor->pEmptyLeft[ubChannel] = ubFirst & ~MOD_PACKED_EMPTY_RUN;
+			pVoice->ulData = 0;
+		}
+		else {
+			pVoice->uwNote = (ubFirst << 8) | pStream[0];
+			pVoice->uwCmd = (pStream[1] << 8) | pStream[2];
+			pStream += 3;
+		}
+		pCursor->pStreams[ubChannel] = pStream;
+	}
+	pCursor->uwNextPos += MOD_ROW_LENGTH;
+}
+
+/**
+ * @brief Returns pattern row at given position.
+ * Packed patterns are unpacked using given cursor, which is fastest when
+ * rows are read sequentially.
+ *
+ * @param pCursor Cursor used for unpacking packed patterns.
+ * @param ubPatternIdx Index of pattern to be read.
+ * @param uwPos Byte offset of row in unpacked pattern.
+ * @return Pointer to MOD_NOTES_PER_ROW voices of row. Valid until next call
+ * with the same cursor.
+ */
+static const tModVoice *ptGetRow(
+	tPatternCursor *pCursor, UBYTE ubPatternIdx, UWORD uwPos
+) {
+	if(!mt_mod->pPatternOffsets) {
+		return (tModVoice*)&mt_mod->pPatterns[ubPatternIdx * MOD_PATTERN_LENGTH + uwPos];
+	}
+
+	if(ubPatternIdx != pCursor->ubPatternIdx || uwPos != pCursor->uwNextPos) {
+		if(
+			ubPatternIdx == pCursor->ubPatternIdx &&
+			uwPos + MOD_ROW_LENGTH == pCursor->uwNextPos
+		) {
+			// Same row as last time
+			return pCursor->pRow;
+		}
+
+		// Seek from pattern start - only on jumps, breaks and loops
+		const UWORD *pOffsets = &mt_mod->pPatternOffsets[ubPatternIdx * MOD_NOTES_PER_ROW];
+		for(UBYTE ubChannel = 0; ubChannel < MOD_NOTES_PER_ROW; ++ubChannel) {
+			pCursor->pStreams[ubChannel] = &mt_mod->pPatterns[pOffsets[ubChannel]];
+			pCursor->pEmptyLeft[ubChannel] = 0;
+		}
+		pCursor->ubPatternIdx = ubPatternIdx;
+		pCursor->uwNextPos = 0;
+		while(pCursor->uwNextPos < uwPos) {
+			ptCursorUnpackRow(pCursor);
+		}
+	}
+	ptCursorUnpackRow(pCursor);
+	return pCursor->pRow;
+}
+
 static void printVoices(UNUSED_ARG const tModVoice *pVoices) {
 #if defined(ACE_DEBUG_PTPLAYER)
 	typedef struct _tPeriodNote {
@@ -1112,10 +1344,13 @@ static void printVoices(UNUSED_ARG const tModVoice *pVoices) {
 #endif
 }
 
-static inline UBYTE findPeriod(const UWORD *pPeriods, UWORD uwNote) {
-	// Find nearest period for a note value
+/**
+ * @brief Finds position of first period in table which is less or equal
+ * to given one by scanning the table. Used only for building lookup tables.
+ */
+static UBYTE findPeriodSlow(const UWORD *pPeriods, UWORD uwPeriod) {
 	for(UBYTE ubPeriodPos = 0; ubPeriodPos < MOD_PERIOD_TABLE_LENGTH - 1; ++ubPeriodPos) {
-		if (uwNote >= pPeriods[ubPeriodPos]) {
+		if (uwPeriod >= pPeriods[ubPeriodPos]) {
 			return ubPeriodPos;
 		}
 	}
@@ -1123,6 +1358,43 @@ static inline UBYTE findPeriod(const UWORD *pPeriods, UWORD uwNote) {
 	return MOD_PERIOD_TABLE_LENGTH - 1;
 }
 
+static void buildPeriodLookup(void) {
+	for(UBYTE ubFineTune = 0; ubFineTune < MOD_FINETUNE_COUNT; ++ubFineTune) {
+		for(UWORD i = 0; i < PERIOD_LOOKUP_SIZE; ++i) {
+			// Position for highest period of the range - it can only be too low
+			UWORD uwPeriodLast = MOD_PERIOD_MIN + ((i + 1) << PERIOD_LOOKUP_SHIFT) - 1;
+			s_pPeriodLookup[ubFineTune][i] = findPeriodSlow(
+				mt_PeriodTables[ubFineTune], uwPeriodLast
+			);
+		}
+	}
+}
+
+/**
+ * @brief Finds position of first period in table which is less or equal
+ * to given one.
+ *
+ * @param ubFineTune Index of period table to be searched.
+ * @param uwPeriod Period to be found.
+ * @return Position in period table, last one if all periods are larger.
+ */
+static inline UBYTE findPeriod(UBYTE ubFineTune, UWORD uwPeriod) {
+	if(uwPeriod < MOD_PERIOD_MIN) {
+		return MOD_PERIOD_TABLE_LENGTH - 1;
+	}
+	if(uwPeriod > MOD_PERIOD_MAX) {
+		return 0;
+	}
+	const UWORD *pPeriods = mt_PeriodTables[ubFineTune];
+	UBYTE ubPeriodPos = s_pPeriodLookup[ubFineTune][
+		(uwPeriod - MOD_PERIOD_MIN) >> PERIOD_LOOKUP_SHIFT
+	];
+	while(uwPeriod < pPeriods[ubPeriodPos] && ubPeriodPos < MOD_PERIOD_TABLE_LENGTH - 1) {
+		++ubPeriodPos;
+	}
+	return ubPeriodPos;
+}
+
 static void ptSongStep(void) {
 	mt_PatternPos = mt_PBreakPos;
 	mt_PBreakPos = 0;
@@ -1155,24 +1427,25 @@ static void startSfx(
 	// play new sound effect on this channel
 	systemSetDmaMask(pChannelData->uwDmaFlag, 0);
 	UWORD uwRepeatLength;
-	volatile UWORD *pSfxData = pChannelReg->ac_ptr = pChannelData->n_sfxptr;
+	UWORD *pSfxData = pChannelData->n_sfxptr;
+	PAULA_WRITE(pChannelReg->ac_ptr, pSfxData);
 	if(pChannelData->ubSfxPriority == SFX_PRIORITY_LOOPED) {
 		pChannelData->isLooped = 1;
 
 		// Skip first word which is used for idling
 		++pSfxData;
 		uwRepeatLength = pChannelData->uwSfxWordLength - 1;
-		pChannelReg->ac_ptr = pSfxData;
-		pChannelReg->ac_len = uwRepeatLength;
+		PAULA_WRITE(pChannelReg->ac_ptr, pSfxData);
+		PAULA_WRITE(pChannelReg->ac_len, uwRepeatLength);
 	}
 	else {
 		pChannelData->isLooped = 0;
 		uwRepeatLength = 1;
-		pChannelReg->ac_ptr = pSfxData;
-		pChannelReg->ac_len = pChannelData->uwSfxWordLength;
+		PAULA_WRITE(pChannelReg->ac_ptr, pSfxData);
+		PAULA_WRITE(pChannelReg->ac_len, pChannelData->uwSfxWordLength);
 	}
-	pChannelReg->ac_per = pChannelData->uwSfxPeriod;
-	pChannelReg->ac_vol = pChannelData->uwSfxVolume;
+	PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwSfxPeriod);
+	PAULA_WRITE(pChannelReg->ac_vol, pChannelData->uwSfxVolume);
 
 	// Save repeat and period for TimerB interrupt.
 	// After the sample has fully played back and there is no repeat,
@@ -1197,6 +1470,7 @@ void moreBlockedFx(
 		logWrite("ERR: blmorefx_tab index out of range: cmd %hu -> %hu\n", uwCmd, uwCmd >> 8);
 	}
 #endif
+	PTPLAYER_ON_FX(ubCmdIdx);
 	blmorefx_tab[ubCmdIdx](uwCmd, pChannelData, pChannelReg);
 }
 
@@ -1228,6 +1502,7 @@ static void checkmorefx(
 		logWrite("ERR: morefx_tab index out of range: cmd %hu\n", uwCmd);
 	}
 #endif
+	PTPLAYER_ON_FX(uwCmd);
 	morefx_tab[uwCmd](uwCmdArg, pChannelData, pChannelReg);
 }
 
@@ -1258,7 +1533,7 @@ static void mt_playvoice(
 	}
 	// n_note/cmd: any note or cmd set?
 	if(!pChannelData->sVoice.ulData) {
-		pChannelReg->ac_per = pChannelData->uwPeriod;
+		PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
 	}
 	pChannelData->sVoice.ulData = pVoice->ulData;
 
@@ -1299,6 +1574,7 @@ static void mt_playvoice(
 		// TODO: sanitize this value to only have lower nibble set when loading MOD/samplepack
 		UBYTE ubFineTune = pSampleDef->ubFineTune & 0xF;
 		pChannelData->pPeriodTable = mt_PeriodTables[ubFineTune];
+		pChannelData->ubFineTune = ubFineTune;
 		pChannelData->n_minusft = (ubFineTune >= 8);
 
 		pChannelData->uwVolume = pSampleDef->ubVolume;
@@ -1321,7 +1597,7 @@ static void mt_playvoice(
 		pChannelData->n_length = uwSampleLength;
 		pChannelData->n_loopstart = pSampleStart;
 		pChannelData->n_wavestart = (UBYTE*)pSampleStart;
-		pChannelReg->ac_vol = mt_MasterVolTab[pSampleDef->ubVolume];
+		PAULA_WRITE(pChannelReg->ac_vol, mt_MasterVolTab[pSampleDef->ubVolume]);
 	}
 
 	// inlined set_regs function here:
@@ -1337,6 +1613,7 @@ static void mt_playvoice(
 			logWrite("ERR: prefx_tab index out of range: cmd %hu\n", uwCmd);
 		}
 #endif
+		PTPLAYER_ON_FX(uwCmd);
 		prefx_tab[uwCmd](
 			uwCmd, uwCmdArg, uwMaskedCmdE, pVoice, pChannelData, pChannelReg
 		);
@@ -1379,7 +1656,7 @@ static void mt_checkfx(
 	UWORD uwCmd = (pChannelData->sVoice.uwCmd & 0x0FFF);
 	if(!uwCmd) {
 		// Just set the current period - same as mt_pernop
-		pChannelReg->ac_per = pChannelData->uwPeriod;
+		PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
 	}
 	else {
 		UBYTE ubCmdIndex = (pChannelData->sVoice.ubCmdHi & 0xF);
@@ -1388,6 +1665,7 @@ static void mt_checkfx(
 			logWrite("ERR: fx_tab index out of range: cmd %hhu\n", ubCmdIndex);
 		}
 #endif
+		PTPLAYER_ON_FX(ubCmdIndex);
 		fx_tab[ubCmdIndex](pChannelData->sVoice.ubCmdLo, pChannelData, pChannelReg);
 	}
 }
@@ -1395,14 +1673,81 @@ static void mt_checkfx(
 static void mt_sfxonly(void);
 static void mt_music(void);
 
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+// Color clocks per raster line, rounded down from 227.5
+#define PROFILE_COLOR_CLOCKS_PER_LINE 227
+
+static UWORD profileGetColorClocksSince(tRayPos sRayStart) {
+	tRayPos sRayEnd = getRayPos();
+	WORD wLines = sRayEnd.bfPosY - sRayStart.bfPosY;
+	if(wLines < 0) {
+		// Frame has ended in the meantime
+		wLines += s_isPal ? 313 : 263;
+	}
+	return wLines * PROFILE_COLOR_CLOCKS_PER_LINE + sRayEnd.bfPosX - sRayStart.bfPosX;
+}
+
+static void profileAdd(tPtplayerProfile *pProfile, UWORD uwColorClocks) {
+	++pProfile->ulCalls;
+	pProfile->ulColorClocksTotal += uwColorClocks;
+	if(uwColorClocks > pProfile->uwColorClocksMax) {
+		pProfile->uwColorClocksMax = uwColorClocks;
+	}
+}
+
+static void profileLogEntry(const char *szName, const tPtplayerProfile *pProfile) {
+	ULONG ulAvg = pProfile->ulCalls ? pProfile->ulColorClocksTotal / pProfile->ulCalls : 0;
+	logWrite(
+		"%s: %lu calls, lines avg: %lu.%02lu, max: %hu.%02hu\n", szName,
+		pProfile->ulCalls, ulAvg / PROFILE_COLOR_CLOCKS_PER_LINE,
+		(ulAvg % PROFILE_COLOR_CLOCKS_PER_LINE) * 100 / PROFILE_COLOR_CLOCKS_PER_LINE,
+		pProfile->uwColorClocksMax / PROFILE_COLOR_CLOCKS_PER_LINE,
+		(pProfile->uwColorClocksMax % PROFILE_COLOR_CLOCKS_PER_LINE) * 100 / PROFILE_COLOR_CLOCKS_PER_LINE
+	);
+}
+
+void ptplayerProfileReset(void) {
+	s_sProfileMusic = (tPtplayerProfile){0};
+	s_sProfileSfx = (tPtplayerProfile){0};
+	s_sProfileMixer = (tPtplayerProfile){0};
+}
+
+void ptplayerProfileLog(void) {
+	logBlockBegin("ptplayerProfileLog()");
+	profileLogEntry("mt_music", &s_sProfileMusic);
+	profileLogEntry("mt_sfxonly", &s_sProfileSfx);
+	profileLogEntry("mixer", &s_sProfileMixer);
+#if defined(ACE_DEBUG)
+	for(UBYTE i = 0; i < 4; ++i) {
+		if(s_pStreams[i]) {
+			logWrite(
+				"stream on channel %hhu: %lu underruns\n",
+				i, s_pStreams[i]->ulUnderrunCount
+			);
+		}
+	}
+#endif
+	logBlockEnd("ptplayerProfileLog()");
+}
+#endif
+
 static void intPlay() {
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+	tRayPos sRayStart = getRayPos();
+#endif
 	// it was a TA interrupt, do music when enabled
 	if(mt_Enable) {
 		mt_music();
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+		profileAdd(&s_sProfileMusic, profileGetColorClocksSince(sRayStart));
+#endif
 	}
 	else {
 		// no music, only sfx
 		mt_sfxonly();
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+		profileAdd(&s_sProfileSfx, profileGetColorClocksSince(sRayStart));
+#endif
 	}
 }
 
@@ -1458,8 +1803,8 @@ static inline void setChannelRepeat(
 	}
 
 	// Paula reads new register values after it finishes current audio playback.
-	pChannelRegs->ac_ptr = pChannelData->n_loopstart;
-	pChannelRegs->ac_len = pChannelData->n_replen;
+	PAULA_WRITE(pChannelRegs->ac_ptr, pChannelData->n_loopstart);
+	PAULA_WRITE(pChannelRegs->ac_len, pChannelData->n_replen);
 }
 
 static void intSetRep(volatile tCustom *pCustom) {
@@ -1571,11 +1916,10 @@ static void mt_music(void) {
 		mt_Counter = 0;
 		if(mt_PattDelTime2 <= 0) {
 			// determine pointer to current pattern line
-			UBYTE *pPatternData = mt_mod->pPatterns;
-			UBYTE *pArrangement = mt_mod->pArrangement;
-			UBYTE ubPatternIdx = pArrangement[mt_SongPos];
-			UBYTE *pCurrentPattern = &pPatternData[ubPatternIdx * 1024];
-			tModVoice *pLineVoices = (tModVoice*)&pCurrentPattern[mt_PatternPos];
+			UBYTE ubPatternIdx = mt_mod->pArrangement[mt_SongPos];
+			const tModVoice *pLineVoices = ptGetRow(
+				&s_sCursorMusic, ubPatternIdx, mt_PatternPos
+			);
 			printVoices(pLineVoices);
 
 			// play new note for each channel, apply some effects
@@ -1655,19 +1999,18 @@ static void resetChannel(tChannelStatus *pChannel) {
 void ptplayerStop(void) {
 	ptplayerEnableMusic(0);
 	for(UBYTE i = 0; i < 4; ++i) {
+		if(isChannelTaken(i)) {
+			// Channel is kept blocked until sfx mixer or stream gets destroyed
+			continue;
+		}
 		if(mt_chan[i].isEnabledForPlayer) {
 			systemSetDmaMask(mt_chan[i].uwDmaFlag, 0);
 		}
+		// Also frees the channel taken by SFX.
+		// Typically it would release itself but turning off DMA prevents this.
 		resetChannel(&mt_chan[i]);
 	}
 	s_pModCurr = 0;
-
-	// Free the channels taken by SFX.
-	// Typically they would release themselves but turning off DMA prevents this.
-	mt_chan[0].ubSfxPriority = 0;
-	mt_chan[1].ubSfxPriority = 0;
-	mt_chan[2].ubSfxPriority = 0;
-	mt_chan[3].ubSfxPriority = 0;
 }
 
 static inline void setTempo(UWORD uwTempo) {
@@ -1745,6 +2088,12 @@ static void INTERRUPT onAudio(
 #endif
 
 void ptplayerDestroy(void) {
+	ptplayerMixerDestroy();
+	for(UBYTE i = 0; i < 4; ++i) {
+		if(s_pStreams[i]) {
+			ptplayerStreamDestroy(s_pStreams[i]);
+		}
+	}
 	ptplayerStop();
 	// Disable handling of music
 	ptplayerEnableMusic(0);
@@ -1786,6 +2135,7 @@ void ptplayerCreate(UBYTE isPal) {
 #endif
 
 	ptplayerSetPal(isPal);
+	buildPeriodLookup();
 	mt_MasterVolTab = MasterVolTab[64];
 	for(UBYTE i = 0; i < 4; ++i) {
 		mt_chan[i].isEnabledForPlayer = 1;
@@ -1866,6 +2216,12 @@ void ptplayerLoadMod(
 		}
 	}
 
+	ptCursorReset(&s_sCursorMusic);
+	ptCursorReset(&s_sCursorPeek);
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+	// Worst case is measured per song
+	ptplayerProfileReset();
+#endif
 	mt_reset();
 	s_pModCurr = pMod;
 	logBlockEnd("ptplayerLoadMod()");
@@ -1884,16 +2240,16 @@ void ptplayerSetMusicChannelMask(UBYTE ChannelMask) {
 static void setAllVolumes(void) {
 	// Only set volume for channels used in MOD playback.
 	if (!mt_chan[0].ubSfxPriority && mt_chan[0].isEnabledForPlayer) {
-		g_pCustom->aud[0].ac_vol = mt_MasterVolTab[mt_chan[0].uwVolume];
+		PAULA_WRITE(g_pCustom->aud[0].ac_vol, mt_MasterVolTab[mt_chan[0].uwVolume]);
 	}
 	if (!mt_chan[1].ubSfxPriority && mt_chan[1].isEnabledForPlayer) {
-		g_pCustom->aud[1].ac_vol = mt_MasterVolTab[mt_chan[1].uwVolume];
+		PAULA_WRITE(g_pCustom->aud[1].ac_vol, mt_MasterVolTab[mt_chan[1].uwVolume]);
 	}
 	if (!mt_chan[2].ubSfxPriority && mt_chan[2].isEnabledForPlayer) {
-		g_pCustom->aud[2].ac_vol = mt_MasterVolTab[mt_chan[2].uwVolume];
+		PAULA_WRITE(g_pCustom->aud[2].ac_vol, mt_MasterVolTab[mt_chan[2].uwVolume]);
 	}
 	if (!mt_chan[3].ubSfxPriority && mt_chan[3].isEnabledForPlayer) {
-		g_pCustom->aud[3].ac_vol = mt_MasterVolTab[mt_chan[3].uwVolume];
+		PAULA_WRITE(g_pCustom->aud[3].ac_vol, mt_MasterVolTab[mt_chan[3].uwVolume]);
 	}
 }
 
@@ -1910,6 +2266,10 @@ void ptplayerSetMasterVolume(UBYTE ubMasterVolume) {
 }
 
 void ptplayerSetChannelsForPlayer(UBYTE ubChannelMask) {
+	// Channels used by sfx mixer and streams must stay untouched by the player,
+	// so only remember their setting until they're given back.
+	s_ubChannelsTakenFromPlayer = ubChannelMask & s_ubChannelsTaken;
+	ubChannelMask &= ~s_ubChannelsTaken;
 	g_pCustom->intena = INTF_INTEN;
 	mt_chan[0].isEnabledForPlayer = BTST(ubChannelMask, 0);
 	mt_chan[1].isEnabledForPlayer = BTST(ubChannelMask, 1);
@@ -1944,14 +2304,13 @@ static void mt_toneporta_nc(
 		}
 		pChannelData->uwPeriod = wNew;
 		if(pChannelData->n_gliss) {
-			// glissando: find nearest note for new period
+			// glissando: snap new period to note with same or next smaller period
 			const UWORD *pPeriodTable = pChannelData->pPeriodTable;
-			UWORD uwNoteOffs = 0;
-			UBYTE ubPeriodPos = findPeriod(pChannelData->pPeriodTable, uwNoteOffs);
+			UBYTE ubPeriodPos = findPeriod(pChannelData->ubFineTune, wNew);
 			pChannelData->n_noteoff = ubPeriodPos * 2;
 			wNew = pPeriodTable[ubPeriodPos];
 		}
-		pChannelReg->ac_per = wNew;
+		PAULA_WRITE(pChannelReg->ac_per, wNew);
 	}
 }
 
@@ -1960,7 +2319,7 @@ static void mt_vibrato_nc(
 	UBYTE ubAmplitude, UBYTE ubSpeed
 ) {
 	// calculate vibrato table offset
-	UBYTE ubOffs = 64 * ubAmplitude + (pChannelData->n_vibratopos & 63);
+	UWORD uwOffset = 64 * ubAmplitude + (pChannelData->n_vibratopos & 63);
 
 	// select vibrato waveform
 	const BYTE *pTable;
@@ -1977,7 +2336,7 @@ static void mt_vibrato_nc(
 	}
 
 	// add vibrato-offset to period
-	pChannelReg->ac_per = pChannelData->uwPeriod + pTable[ubOffs];
+	PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod + pTable[uwOffset]);
 
 	// Increase vibratopos by speed
 	pChannelData->n_vibratopos += ubSpeed;
@@ -2003,7 +2362,7 @@ static void mt_arpeggio(
 	};
 
 	// Step 0, just use normal period
-	pChannelReg->ac_per = pChannelData->uwPeriod;
+	PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
 
 	UWORD uwVal;
 	if(pArpTab[mt_Counter] >= 0) {
@@ -2019,7 +2378,7 @@ static void mt_arpeggio(
 	uwVal += pChannelData->n_noteoff;
 	if(uwVal < 2 * 36) {
 		// Set period with arpeggio offset from note table
-		pChannelReg->ac_per = pChannelData->pPeriodTable[uwVal / 2];
+		PAULA_WRITE(pChannelReg->ac_per, pChannelData->pPeriodTable[uwVal / 2]);
 		// TODO later: noteoff has byte offs from start of array, set it to divided
 		// by 2 since we're using UWORD pointers, not UBYTE
 	}
@@ -2031,7 +2390,7 @@ static void ptDoPortaUp(
 ) {
 	UWORD uwNewPer = MAX(113, pChannelData->uwPeriod - ubVal);
 	pChannelData->uwPeriod = uwNewPer;
-	pChannelReg->ac_per = uwNewPer;
+	PAULA_WRITE(pChannelReg->ac_per, uwNewPer);
 }
 
 static void mt_portaup(
@@ -2048,7 +2407,7 @@ static void ptDoPortaDn(
 ) {
 	UWORD uwNewPer = MIN(pChannelData->uwPeriod + ubVal, 856);
 	pChannelData->uwPeriod = uwNewPer;
-	pChannelReg->ac_per = uwNewPer;
+	PAULA_WRITE(pChannelReg->ac_per, uwNewPer);
 }
 
 static void mt_portadown(
@@ -2099,8 +2458,8 @@ static void ptVolSlide(
 ) {
 	bVolNew = CLAMP(bVolNew, 0, 64);
 	pChannelData->uwVolume = bVolNew;
-	pChannelReg->ac_per = pChannelData->uwPeriod;
-	pChannelReg->ac_vol = mt_MasterVolTab[bVolNew];
+	PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
+	PAULA_WRITE(pChannelReg->ac_vol, mt_MasterVolTab[bVolNew]);
 }
 
 static void mt_volumeslide(
@@ -2191,8 +2550,8 @@ static void mt_tremolo(
 	WORD wNewVol = pChannelData->uwVolume + pWaveform[uwOffset];
 	wNewVol = CLAMP(wNewVol, 0, 64);
 
-	pChannelReg->ac_per = pChannelData->uwPeriod;
-	pChannelReg->ac_vol = wNewVol;
+	PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
+	PAULA_WRITE(pChannelReg->ac_vol, wNewVol);
 
 	// increase tremolopos by speed
 	pChannelData->n_tremolopos += ubSpeed;
@@ -2210,6 +2569,7 @@ static void mt_e_cmds(
 		logWrite("ERR: ecmd_tab index out of range: cmd %hhu\n", ubCmdE);
 	}
 #endif
+	PTPLAYER_ON_FX(PTPLAYER_FX_E_FIRST + ubCmdE);
 	ecmd_tab[ubCmdE](ubArgE, pChannelData, pChannelReg);
 }
 
@@ -2282,6 +2642,7 @@ static void blocked_e_cmds(
 		logWrite("ERR: blecmd_tab index out of range: cmd %hhu\n", ubCmdE);
 	}
 #endif
+	PTPLAYER_ON_FX(PTPLAYER_FX_E_FIRST + ubCmdE);
 	blecmd_tab[ubCmdE](ubArg, pChannelData, pChannelReg);
 }
 
@@ -2307,7 +2668,7 @@ static void mt_pernop(
 	tChannelStatus *pChannelData, volatile tChannelRegs *pChannelReg
 ) {
 	// just set the current period
-	pChannelReg->ac_per = pChannelData->uwPeriod;
+	PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
 }
 
 static void mt_volchange(
@@ -2318,7 +2679,7 @@ static void mt_volchange(
 	if(ubNewVolume > 64) {
 		ubNewVolume = 64;
 	}
-	pChannelReg->ac_vol = mt_MasterVolTab[ubNewVolume];
+	PAULA_WRITE(pChannelReg->ac_vol, mt_MasterVolTab[ubNewVolume]);
 }
 
 static void mt_sampleoffset(
@@ -2422,6 +2783,7 @@ static void mt_finetune(
 ) {
 	// cmd 0x0E'5X (x = finetune)
 	pChannelData->pPeriodTable = mt_PeriodTables[ubArg];
+	pChannelData->ubFineTune = ubArg;
 	pChannelData->n_minusft = (ubArg >= 8);
 }
 
@@ -2476,8 +2838,8 @@ static void ptDoRetrigger(
 	// DMA off, set sample pointer and length
 	systemSetDmaMask(pChannelData->uwDmaFlag, 0);
 	// logWrite("retrigger: %p:%hu\n", pChannelData->n_start, pChannelData->n_length);
-	pChannelReg->ac_ptr = pChannelData->n_start;
-	pChannelReg->ac_len = pChannelData->n_length;
+	PAULA_WRITE(pChannelReg->ac_ptr, pChannelData->n_start);
+	PAULA_WRITE(pChannelReg->ac_len, pChannelData->n_length);
 	mt_dmaon |= pChannelData->uwDmaFlag;
 }
 
@@ -2534,7 +2896,7 @@ static void mt_notecut(
 	// cmd 0x0E'CX (x = counter to cut at)
 	if(mt_Counter == ubArg) {
 		pChannelData->uwVolume = 0;
-		pChannelReg->ac_vol = 0;
+		PAULA_WRITE(pChannelReg->ac_vol, 0);
 	}
 }
 
@@ -2545,7 +2907,7 @@ static void mt_notedelay(
 	if(mt_Counter == ubArg) {
 		// Trigger note when given
 		if(pChannelData->sVoice.uwNote) {
-			pChannelReg->ac_per = pChannelData->uwPeriod;
+			PAULA_WRITE(pChannelReg->ac_per, pChannelData->uwPeriod);
 			ptDoRetrigger(pChannelData, pChannelReg);
 		}
 	}
@@ -2611,7 +2973,7 @@ static void set_period(
 	tChannelStatus *pChannelData, volatile tChannelRegs *pChannelReg
 ) {
 	UWORD uwNote = pVoice->uwNote & 0xFFF;
-	UBYTE ubPeriodPos = findPeriod(mt_PeriodTables[0], uwNote);
+	UBYTE ubPeriodPos = findPeriod(0, uwNote);
 
 	// Apply finetuning, set period and note-offset
 	UWORD uwPeriod = pChannelData->pPeriodTable[ubPeriodPos];
@@ -2636,9 +2998,9 @@ static void set_period(
 		// 	pChannelData->n_start, pChannelData->n_length, uwPeriod
 		// );
 
-		pChannelReg->ac_ptr = pChannelData->n_start;
-		pChannelReg->ac_len = pChannelData->n_reallength;
-		pChannelReg->ac_per = uwPeriod;
+		PAULA_WRITE(pChannelReg->ac_ptr, pChannelData->n_start);
+		PAULA_WRITE(pChannelReg->ac_len, pChannelData->n_reallength);
+		PAULA_WRITE(pChannelReg->ac_per, uwPeriod);
 		mt_dmaon |= pChannelData->uwDmaFlag;
 	}
 	checkmorefx(uwCmd, uwCmdArg, pChannelData, pChannelReg);
@@ -2651,6 +3013,7 @@ static void set_finetune(
 	// logWrite("Set finetune\n");
 	UBYTE ubFineTune = uwCmdArg & 0xF;
 	pChannelData->pPeriodTable = mt_PeriodTables[ubFineTune];
+	pChannelData->ubFineTune = ubFineTune;
 	pChannelData->n_minusft = ubFineTune >= 8;
 	set_period(uwCmd, uwCmdArg, uwMaskedCmdE, pVoice, pChannelData, pChannelReg);
 }
@@ -2673,7 +3036,7 @@ static void set_toneporta(
 ) {
 	// Find first period which is less or equal the note in d6
 	UWORD uwNote = pVoice->uwNote & 0xFFF;
-	UBYTE ubPeriodPos = findPeriod(mt_PeriodTables[0], uwNote);
+	UBYTE ubPeriodPos = findPeriod(0, uwNote);
 	// Original ASM code does something similar, but without those lines it sounds accurate and not out-of-tune
 	// if(ubPeriodPos) {
 	// 	// One before for less/equal
@@ -2698,7 +3061,7 @@ static void set_toneporta(
 		mt_updatefunk(pChannelData);
 	}
 
-	pChannelReg->ac_per = uwPeriod;
+	PAULA_WRITE(pChannelReg->ac_per, uwPeriod);
 }
 
 static const tPreFx prefx_tab[16] = {
@@ -2737,14 +3100,21 @@ void ptplayerProcess(void) {
 		intSetRep(g_pCustom);
 	}
 #endif
+	if(s_sMixer.ubChannelMask) {
+		mixerProcess();
+	}
+	for(UBYTE i = 0; i < 4; ++i) {
+		if(s_pStreams[i]) {
+			streamProcess(s_pStreams[i]);
+		}
+	}
 }
 
 const tModVoice *ptplayerGetCurrentVoices(void) {
-	UBYTE *pPatternData = mt_mod->pPatterns;
-	UBYTE *pArrangement = mt_mod->pArrangement;
-	UBYTE ubPatternIdx = pArrangement[mt_SongPos];
-	UBYTE *pCurrentPattern = &pPatternData[ubPatternIdx * 1024];
-	tModVoice *pLineVoices = (tModVoice*)&pCurrentPattern[mt_PatternPos];
+	UBYTE ubPatternIdx = mt_mod->pArrangement[mt_SongPos];
+	const tModVoice *pLineVoices = ptGetRow(
+		&s_sCursorPeek, ubPatternIdx, mt_PatternPos
+	);
 	return pLineVoices;
 }
 
@@ -2797,25 +3167,65 @@ tPtplayerMod *ptplayerModCreateFromFd(tFile *pFileMod) {
 	fileRead(pFileMod, &pMod->ubSongEndPos, sizeof(pMod->ubSongEndPos));
 	fileRead(pFileMod, pMod->pArrangement, sizeof(pMod->pArrangement));
 	fileRead(pFileMod, pMod->pFileFormatTag, sizeof(pMod->pFileFormatTag));
+#if !defined(AMIGA)
+	for(UBYTE i = 0; i < PTPLAYER_MOD_SAMPLE_COUNT; ++i) {
+		tPtplayerSampleHeader *pHeader = &pMod->pSampleHeaders[i];
+		pHeader->uwLength = endianAmiga16(pHeader->uwLength);
+		pHeader->uwRepeatOffs = endianAmiga16(pHeader->uwRepeatOffs);
+		pHeader->uwRepeatLength = endianAmiga16(pHeader->uwRepeatLength);
+	}
+#endif
 
 	// Get number of highest pattern
+	UBYTE isPacked = !memcmp(pMod->pFileFormatTag, MOD_PACKED_FORMAT_TAG, 4);
 	UBYTE ubLastPattern = 0;
-	for(UBYTE i = 0; i < 127; ++i) {
+	for(UBYTE i = 0; i < (isPacked ? 128 : 127); ++i) {
 		if(pMod->pArrangement[i] > ubLastPattern) {
 			ubLastPattern = pMod->pArrangement[i];
 		}
 	}
 	UBYTE ubPatternCount = ubLastPattern + 1;
-	logWrite("Pattern count: %hhu\n", ubPatternCount);
+	logWrite("Pattern count: %hhu, packed: %hhu\n", ubPatternCount, isPacked);
 
 	// Read pattern data
-	pMod->ulPatternsSize = (ubPatternCount * MOD_PATTERN_LENGTH);
+	if(isPacked) {
+		pMod->uwPatternOffsetsSize = ubPatternCount * MOD_NOTES_PER_ROW * sizeof(UWORD);
+		pMod->pPatternOffsets = memAllocFast(pMod->uwPatternOffsetsSize);
+		if(!pMod->pPatternOffsets) {
+			logWrite("ERR: Couldn't allocate memory for pattern offsets");
+			goto fail;
+		}
+		fileRead(pFileMod, pMod->pPatternOffsets, pMod->uwPatternOffsetsSize);
+		fileRead(pFileMod, &pMod->ulPatternsSize, sizeof(pMod->ulPatternsSize));
+#if !defined(AMIGA)
+		for(UWORD i = 0; i < ubPatternCount * MOD_NOTES_PER_ROW; ++i) {
+			pMod->pPatternOffsets[i] = endianAmiga16(pMod->pPatternOffsets[i]);
+		}
+		pMod->ulPatternsSize = endianAmiga32(pMod->ulPatternsSize);
+#endif
+		logWrite(
+			"Packed pattern data size: %lu, unpacked: %lu\n",
+			pMod->ulPatternsSize, (ULONG)ubPatternCount * MOD_PATTERN_LENGTH
+		);
+	}
+	else {
+		pMod->ulPatternsSize = (ubPatternCount * MOD_PATTERN_LENGTH);
+	}
 	pMod->pPatterns = memAllocFast(pMod->ulPatternsSize);
 	if(!pMod->pPatterns) {
 		logWrite("ERR: Couldn't allocate memory for pattern data");
 		goto fail;
 	}
 	fileRead(pFileMod, pMod->pPatterns, pMod->ulPatternsSize);
+#if !defined(AMIGA)
+	if(!isPacked) {
+		// Packed streams are read byte by byte, so only raw notes need swapping
+		UWORD *pWords = (UWORD*)pMod->pPatterns;
+		for(ULONG i = 0; i < pMod->ulPatternsSize / sizeof(UWORD); ++i) {
+			pWords[i] = endianAmiga16(pWords[i]);
+		}
+	}
+#endif
 
 	// Read sample data
 	ULONG ulSampleStartPos = fileGetPos(pFileMod);
@@ -2843,6 +3253,9 @@ fail:
 		if(pMod->pPatterns) {
 			memFree(pMod->pPatterns, pMod->ulPatternsSize);
 		}
+		if(pMod->pPatternOffsets) {
+			memFree(pMod->pPatternOffsets, pMod->uwPatternOffsetsSize);
+		}
 		if(pMod->isOwningSamples) {
 			for(UBYTE ubSampleIndex = 0; ubSampleIndex < PTPLAYER_MOD_SAMPLE_COUNT; ++ubSampleIndex) {
 				ULONG ulSampleDataLength = pMod->pSampleHeaders[ubSampleIndex].uwLength * sizeof(UWORD);
@@ -2864,6 +3277,9 @@ void ptplayerModDestroy(tPtplayerMod *pMod) {
 		ptplayerStop();
 	}
 	memFree(pMod->pPatterns, pMod->ulPatternsSize);
+	if(pMod->pPatternOffsets) {
+		memFree(pMod->pPatternOffsets, pMod->uwPatternOffsetsSize);
+	}
 	if(pMod->isOwningSamples) {
 		for(UBYTE ubSampleIndex = 0; ubSampleIndex < PTPLAYER_MOD_SAMPLE_COUNT; ++ubSampleIndex) {
 			ULONG ulSampleDataLength = pMod->pSampleHeaders[ubSampleIndex].uwLength * sizeof(UWORD);
@@ -2881,6 +3297,94 @@ tPtplayerSfx *ptplayerSfxCreateFromPath(const char *szPath, UBYTE isFast) {
 	return ptplayerSfxCreateFromFd(diskFileOpen(szPath, "rb"), isFast);
 }
 
+/**
+ * @brief Fibonacci delta values, indexed by 4-bit code.
+ * Same as in 8SVX's compression, encoded by ACE's audio_conv and mod_tool with -cmp.
+ */
+static const BYTE s_pFibDeltas[16] = {
+	-34, -21, -13, -8, -5, -3, -2, -1, 0, 1, 2, 3, 5, 8, 13, 21
+};
+
+/**
+ * @brief Decodes Fibonacci delta codes into 8-bit samples.
+ * Two output samples per source byte, high nibble first. Destination may
+ * overlap with the source as long as source occupies its second half -
+ * each source byte is read before its bytes get overwritten.
+ *
+ * @param pDst Destination for 2 * uwSrcSize decoded samples.
+ * @param pSrc Encoded data.
+ * @param uwSrcSize Size of encoded data in bytes.
+ * @param bValue Value preceding the first decoded sample, 0 at stream start.
+ * @return Last decoded sample, for continuing decoding of the same stream.
+ */
+static BYTE fibDeltaDecode(
+	BYTE *pDst, const UBYTE *pSrc, UWORD uwSrcSize, BYTE bValue
+) {
+	while(uwSrcSize--) {
+		UBYTE ubCodes = *(pSrc++);
+		bValue += s_pFibDeltas[ubCodes >> 4];
+		*(pDst++) = bValue;
+		bValue += s_pFibDeltas[ubCodes & 0xF];
+		*(pDst++) = bValue;
+	}
+	return bValue;
+}
+
+/**
+ * @brief Reads .sfx file header, leaving file positioned at sample data.
+ *
+ * @param pFileSfx Handle to the .sfx file.
+ * @param pWordLength Destination for sample length, in words.
+ * @param pPeriod Destination for period matching sample rate
+ * in current PAL/NTSC mode.
+ * @param pCompression Destination for sample data compression.
+ * @return 1 on success, otherwise 0.
+ */
+static UBYTE sfxReadHeader(
+	tFile *pFileSfx, UWORD *pWordLength, UWORD *pPeriod, UBYTE *pCompression
+) {
+	UBYTE ubVersion;
+	fileRead(pFileSfx, &ubVersion, sizeof(ubVersion));
+	if(ubVersion != 1 && ubVersion != 2) {
+		logWrite("ERR: Unknown sample format version: %hhu\n", ubVersion);
+		return 0;
+	}
+	fileRead(pFileSfx, pWordLength, sizeof(*pWordLength));
+	*pWordLength = endianAmiga16(*pWordLength);
+
+	UWORD uwSampleRateHz;
+	fileRead(pFileSfx, &uwSampleRateHz, sizeof(uwSampleRateHz));
+	uwSampleRateHz = endianAmiga16(uwSampleRateHz);
+	*pPeriod = (getClockConstant() + uwSampleRateHz/2) / uwSampleRateHz;
+	logWrite(
+		"Length: %lu, sample rate: %hu, period: %hu\n",
+		(ULONG)*pWordLength * sizeof(UWORD), uwSampleRateHz, *pPeriod
+	);
+
+	*pCompression = SFX_COMPRESSION_NONE;
+	if(ubVersion == 2) {
+		fileRead(pFileSfx, pCompression, sizeof(*pCompression));
+		if(*pCompression != SFX_COMPRESSION_FIB_DELTA) {
+			logWrite("ERR: Unknown sample compression: %hhu\n", *pCompression);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void sfxOnRelocate(void *pOwner, UBYTE *pOld, UBYTE *pNew) {
+	tPtplayerSfx *pSfx = pOwner;
+	if(s_sMixer.ubChannelMask) {
+		mixerRelocateVoicesOfSfx(pSfx, pOld, pNew);
+	}
+	for(UBYTE ubChannel = 0; ubChannel < 4; ++ubChannel) {
+		if(mt_chan[ubChannel].n_sfxptr == pSfx->pData) {
+			mt_chan[ubChannel].n_sfxptr = (UWORD*)pNew;
+		}
+	}
+	pSfx->pData = (UWORD*)pNew;
+}
+
 tPtplayerSfx *ptplayerSfxCreateFromFd(tFile *pFileSfx, UBYTE isFast)
 {
 	systemUse();
@@ -2895,22 +3399,34 @@ tPtplayerSfx *ptplayerSfxCreateFromFd(tFile *pFileSfx, UBYTE isFast)
 	if(!pSfx) {
 		goto fail;
 	}
-	UBYTE ubVersion;
-	fileRead(pFileSfx, &ubVersion, sizeof(ubVersion));
-	if(ubVersion == 1) {
-		fileRead(pFileSfx, &pSfx->uwWordLength, sizeof(pSfx->uwWordLength));
+	UBYTE ubCompression;
+	if(sfxReadHeader(pFileSfx, &pSfx->uwWordLength, &pSfx->uwPeriod, &ubCompression)) {
 		ULONG ulByteSize = pSfx->uwWordLength * sizeof(UWORD);
-
-		UWORD uwSampleRateHz;
-		fileRead(pFileSfx, &uwSampleRateHz, sizeof(uwSampleRateHz));
-		pSfx->uwPeriod = (getClockConstant() + uwSampleRateHz/2) / uwSampleRateHz;
-		logWrite("Length: %lu, sample rate: %hu, period: %hu\n", ulByteSize, uwSampleRateHz, pSfx->uwPeriod);
-
-		pSfx->pData = isFast ? memAllocFast(ulByteSize) : memAllocChip(ulByteSize);
+		if(isFast) {
+			pSfx->pData = memAllocFast(ulByteSize);
+		}
+		else if(chipHeapIsCreated()) {
+			pSfx->uwChipHandle = chipHeapAlloc(ulByteSize, sfxOnRelocate, pSfx);
+			if(pSfx->uwChipHandle) {
+				pSfx->pData = (UWORD*)chipHeapGetAddr(pSfx->uwChipHandle);
+			}
+		}
+		else {
+			pSfx->pData = memAllocChip(ulByteSize);
+		}
 		if(!pSfx->pData) {
 			goto fail;
 		}
-		fileRead(pFileSfx, pSfx->pData, ulByteSize);
+		if(ubCompression == SFX_COMPRESSION_FIB_DELTA) {
+			// 4 bits per sample - read into buffer's second half and decode in place,
+			// so that no additional buffer is needed.
+			UBYTE *pEncoded = &((UBYTE*)pSfx->pData)[pSfx->uwWordLength];
+			fileRead(pFileSfx, pEncoded, pSfx->uwWordLength);
+			fibDeltaDecode((BYTE*)pSfx->pData, pEncoded, pSfx->uwWordLength, 0);
+		}
+		else {
+			fileRead(pFileSfx, pSfx->pData, ulByteSize);
+		}
 
 		// Check if pData[0] is zeroed-out - it should be because after sfx playback
 		// ptplayer sets the channel playback to looped first word. This should
@@ -2921,7 +3437,6 @@ tPtplayerSfx *ptplayerSfxCreateFromFd(tFile *pFileSfx, UBYTE isFast)
 		}
 	}
 	else {
-		logWrite("ERR: Unknown sample format version: %hhu\n", ubVersion);
 		goto fail;
 	}
 
@@ -2943,17 +3458,23 @@ fail:
 void ptplayerSfxDestroy(tPtplayerSfx *pSfx) {
 	logBlockBegin("ptplayerSfxDestroy(pSfx: %p)", pSfx);
 	if(pSfx) {
+		if(pSfx->pData && s_sMixer.ubChannelMask) {
+			mixerStopVoicesOfSfx(pSfx);
+		}
 		for(UBYTE ubChannel = 0; ubChannel < 4; ++ubChannel) {
 			if(mt_chan[ubChannel].n_sfxptr == pSfx->pData) {
 				// ptplayer doesn't mute its channels after sfx playback to save cycles
 				logWrite("channel %hhu is still using the sample - muting...\n", ubChannel);
-				g_pCustom->aud[ubChannel].ac_vol = 0;
+				PAULA_WRITE(g_pCustom->aud[ubChannel].ac_vol, 0);
 				break;
 			}
 		}
 
 		systemUse();
-		if(pSfx->pData) {
+		if(pSfx->uwChipHandle) {
+			chipHeapFree(pSfx->uwChipHandle);
+		}
+		else if(pSfx->pData) {
 			memFree(pSfx->pData, pSfx->uwWordLength * sizeof(UWORD));
 		}
 		memFree(pSfx, sizeof(*pSfx));
@@ -2987,6 +3508,10 @@ static void channelSetSfx(
 }
 
 void ptplayerSfxStopOnChannel(UBYTE ubChannel) {
+	if(isChannelTaken(ubChannel)) {
+		logWrite("ERR: Channel %hhu is used by sfx mixer or stream\n", ubChannel);
+		return;
+	}
 	g_pCustom->intena = INTF_INTEN;
 	tChannelStatus *pChannel = &mt_chan[ubChannel];
 	if(pChannel->ubSfxPriority != 0) {
@@ -3010,6 +3535,10 @@ void ptplayerSfxPlayLooped(
 	if(memType(pSfx->pData) == MEMF_FAST) {
 		logWrite("ERR: ptplayer only supports samples located in CHIP mem\n");
 	}
+	if(isChannelTaken(ubChannel)) {
+		logWrite("ERR: Channel %hhu is used by sfx mixer or stream\n", ubChannel);
+		return;
+	}
 	g_pCustom->intena = INTF_INTEN;
 	tChannelStatus *pChannel = &mt_chan[ubChannel];
 	channelSetSfx(pChannel, pSfx, ubVolume, SFX_PRIORITY_LOOPED);
@@ -3022,6 +3551,10 @@ void ptplayerSfxPlay(
 	if(memType(pSfx->pData) == MEMF_FAST) {
 		logWrite("ERR: ptplayer only supports samples located in CHIP mem\n");
 	}
+	if(ubChannel != PTPLAYER_SFX_CHANNEL_ANY && isChannelTaken(ubChannel)) {
+		logWrite("ERR: Channel %hhu is used by sfx mixer or stream\n", ubChannel);
+		return;
+	}
 	g_pCustom->intena = INTF_INTEN;
 	if(ubChannel != PTPLAYER_SFX_CHANNEL_ANY) {
 		// Use fixed channel for effect
@@ -3053,19 +3586,14 @@ void ptplayerSfxPlay(
 		mt_chan[2].n_freecnt = 0;
 		mt_chan[3].n_freecnt = 0;
 
-		// get pattern pointer
-		UBYTE *pPatterns = mt_mod->pPatterns;
-
 		UBYTE ubSongPos = mt_SongPos;
 		UWORD uwPatternPos = mt_PatternPos;
 		UBYTE isEnd = 0;
-		UBYTE *pPatternStart = &pPatterns[
-			mt_mod->pArrangement[ubSongPos] * MOD_PATTERN_LENGTH
-		];
-		tModVoice *pPatternEnd = (tModVoice*)(pPatternStart + MOD_PATTERN_LENGTH);
-		tModVoice *pPatternPos = (tModVoice*)(pPatternStart + uwPatternPos);
 		do {
 			UBYTE ubFreeChannelCnt = 4;
+			const tModVoice *pPatternPos = ptGetRow(
+				&s_sCursorPeek, mt_mod->pArrangement[ubSongPos], uwPatternPos
+			);
 
 			for(UBYTE ubChannel = 0; ubChannel < 4; ++ubChannel) {
 				if(!pMusicOnly[ubChannel]) {
@@ -3085,17 +3613,13 @@ void ptplayerSfxPlay(
 			isEnd = (ubFreeChannelCnt != 0 || --ubSteps == 0);
 
 			// End of pattern reached? Then load next pattern pointer
-			if(!isEnd && pPatternPos >= pPatternEnd) {
+			uwPatternPos += MOD_ROW_LENGTH;
+			if(!isEnd && uwPatternPos >= MOD_PATTERN_LENGTH) {
 				uwPatternPos = 0;
 				ubSongPos = (mt_SongPos + 1) & 127;
 				if(ubSongPos >= mt_mod->ubArrangementLength) {
 					ubSongPos = 0;
 				}
-				pPatternStart = &pPatterns[
-					mt_mod->pArrangement[ubSongPos] * MOD_PATTERN_LENGTH
-				];
-				pPatternEnd = (tModVoice*)(pPatternStart + MOD_PATTERN_LENGTH);
-				pPatternPos = (tModVoice*)pPatternStart;
 			}
 		} while(!isEnd);
 		mt_SilCntValid = 1;
@@ -3213,13 +3737,783 @@ UBYTE ptplayerSfxLengthInFrames(const tPtplayerSfx *pSfx) {
 	return uwFrameCount;
 }
 
+//--------------------------------------------------------------- TAKEN CHANNELS
+
+/**
+ * @brief Takes channel away from music & sfx playback, so that its registers
+ * can be driven by sfx mixer or stream. Works like a never-ending looped sfx.
+ * Must be called with interrupts disabled.
+ *
+ * @param ubChannel Channel to be taken (0..3).
+ */
+static void channelTake(UBYTE ubChannel) {
+	tChannelStatus *pChannel = &mt_chan[ubChannel];
+	systemSetDmaMask(pChannel->uwDmaFlag, 0);
+	resetChannel(pChannel);
+	if(pChannel->isEnabledForPlayer) {
+		s_ubChannelsTakenFromPlayer |= BV(ubChannel);
+	}
+	else {
+		s_ubChannelsTakenFromPlayer &= ~BV(ubChannel);
+	}
+	pChannel->isEnabledForPlayer = 0;
+	pChannel->ubSfxPriority = SFX_PRIORITY_LOOPED;
+	pChannel->isLooped = 1;
+	s_ubChannelsTaken |= BV(ubChannel);
+}
+
+/**
+ * @brief Silences channel taken by channelTake() and gives it back to ptplayer.
+ * Channel is used for music again only if it was before being taken.
+ * Must be called with interrupts disabled.
+ *
+ * @param ubChannel Channel to be given back (0..3).
+ */
+static void channelGiveBack(UBYTE ubChannel) {
+	systemSetDmaMask(mt_chan[ubChannel].uwDmaFlag, 0);
+	PAULA_WRITE(g_pCustom->aud[ubChannel].ac_vol, 0);
+	resetChannel(&mt_chan[ubChannel]);
+	mt_chan[ubChannel].isEnabledForPlayer = BTST(
+		s_ubChannelsTakenFromPlayer, ubChannel
+	);
+	s_ubChannelsTaken &= ~BV(ubChannel);
+}
+
+//-------------------------------------------------------------------- SFX MIXER
+
+/**
+ * @brief Finds how many output samples can be mixed from voice before its
+ * sample ends.
+ *
+ * @param pVoice Voice to be checked.
+ * @param uwCount Max number of output samples.
+ * @return Number of output samples, up to uwCount.
+ */
+static UWORD mixerVoiceGetRenderCount(const tMixerVoice *pVoice, UWORD uwCount) {
+	ULONG ulLeft = pVoice->pEnd - pVoice->pCurr;
+	if(ulLeft >= (ULONG)uwCount * (pVoice->uwStepInt + 1)) {
+		// Most common case - voice won't end in this buffer
+		return uwCount;
+	}
+
+	// Sample ends within this buffer - step through positions without mixing
+	UWORD uwFrac = pVoice->uwFrac;
+	UWORD uwRender = 0;
+	while(uwRender < uwCount) {
+		++uwRender;
+		UWORD uwFracNew = uwFrac + pVoice->uwStepFrac;
+		ULONG ulAdvance = pVoice->uwStepInt + (uwFracNew < uwFrac);
+		uwFrac = uwFracNew;
+		if(ulAdvance >= ulLeft) {
+			break;
+		}
+		ulLeft -= ulAdvance;
+	}
+	return uwRender;
+}
+
+/**
+ * @brief Mixes given voice into output buffer, advancing its position.
+ * Voice is set to idle after playing its sample to the end.
+ *
+ * @param pVoice Voice to be mixed.
+ * @param pOut Output buffer.
+ * @param uwCount Number of samples in output buffer.
+ * @param isFirst Set to 1 if this is the first voice mixed into the buffer -
+ * its samples are stored instead of added, which saves clearing the buffer.
+ */
+static void mixerVoiceRender(
+	tMixerVoice *pVoice, BYTE *pOut, UWORD uwCount, UBYTE isFirst
+) {
+	UWORD uwRender = mixerVoiceGetRenderCount(pVoice, uwCount);
+	const BYTE *pVolume = pVoice->pVolumeTable;
+	const BYTE *pSrc = pVoice->pCurr;
+	UWORD uwFrac = pVoice->uwFrac;
+	UWORD uwStepFrac = pVoice->uwStepFrac;
+	UWORD uwStepInt = pVoice->uwStepInt;
+	UWORD uwLeft = uwRender;
+
+	// Separate loops for sfx played at mixer's rate, since they're cheapest
+	if(!uwStepFrac && uwStepInt == 1) {
+		if(isFirst) {
+			while(uwLeft--) {
+				*(pOut++) = pVolume[*(const UBYTE*)(pSrc++)];
+			}
+		}
+		else {
+			while(uwLeft--) {
+				*(pOut++) += pVolume[*(const UBYTE*)(pSrc++)];
+			}
+		}
+	}
+	else {
+		if(isFirst) {
+			while(uwLeft--) {
+				*(pOut++) = pVolume[*(const UBYTE*)pSrc];
+				UWORD uwFracNew = uwFrac + uwStepFrac;
+				pSrc += uwStepInt + (uwFracNew < uwFrac);
+				uwFrac = uwFracNew;
+			}
+		}
+		else {
+			while(uwLeft--) {
+				*(pOut++) += pVolume[*(const UBYTE*)pSrc];
+				UWORD uwFracNew = uwFrac + uwStepFrac;
+				pSrc += uwStepInt + (uwFracNew < uwFrac);
+				uwFrac = uwFracNew;
+			}
+		}
+	}
+
+	if(pSrc >= pVoice->pEnd) {
+		pVoice->pCurr = 0;
+		if(isFirst) {
+			// Silence the rest of buffer
+			memset(pOut, 0, uwCount - uwRender);
+		}
+	}
+	else {
+		pVoice->pCurr = pSrc;
+		pVoice->uwFrac = uwFrac;
+	}
+}
+
+static void mixerFillBuffer(tMixerStream *pStream, BYTE *pOut) {
+	UBYTE isFirst = 1;
+	for(
+		UBYTE i = pStream->ubVoiceFirst; i < s_sMixer.ubVoiceCount;
+		i += s_sMixer.ubStreamCount
+	) {
+		tMixerVoice *pVoice = &s_sMixer.pVoices[i];
+		if(pVoice->pCurr) {
+			mixerVoiceRender(pVoice, pOut, s_sMixer.uwBufferSize, isFirst);
+			isFirst = 0;
+		}
+	}
+
+	if(!isFirst) {
+		pStream->ubSilentBuffers = 0;
+	}
+	else if(pStream->ubSilentBuffers < 2) {
+		// Nothing to mix - silence both buffers once and leave them be
+		memset(pOut, 0, s_sMixer.uwBufferSize);
+		++pStream->ubSilentBuffers;
+	}
+}
+
+static void mixerProcess(void) {
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+	tRayPos sRayStart = getRayPos();
+#endif
+	// Audio intbits get set when Paula latches location of next buffer
+	UWORD uwIntReq = g_pCustom->intreqr & (s_sMixer.ubChannelMask << INTB_AUD0);
+	if(!uwIntReq) {
+		return;
+	}
+	g_pCustom->intreq = uwIntReq;
+
+	for(UBYTE i = 0; i < s_sMixer.ubStreamCount; ++i) {
+		tMixerStream *pStream = &s_sMixer.pStreams[i];
+		if(!(uwIntReq & (INTF_AUD0 << pStream->ubChannel))) {
+			continue;
+		}
+
+		// Paula has just started playing queued buffer - queue the other one,
+		// which needs to be mixed before current one ends.
+		pStream->ubQueued = !pStream->ubQueued;
+		BYTE *pBuffer = pStream->pBuffers[pStream->ubQueued];
+		PAULA_WRITE(g_pCustom->aud[pStream->ubChannel].ac_ptr, (UWORD*)pBuffer);
+		mixerFillBuffer(pStream, pBuffer);
+	}
+#if defined(ACE_DEBUG_PTPLAYER_PROFILE)
+	profileAdd(&s_sProfileMixer, profileGetColorClocksSince(sRayStart));
+#endif
+}
+
+static void mixerRelocateVoicesOfSfx(
+	const tPtplayerSfx *pSfx, const UBYTE *pOld, const UBYTE *pNew
+) {
+	const BYTE *pStart = (const BYTE*)pOld;
+	const BYTE *pEnd = &pStart[pSfx->uwWordLength * sizeof(UWORD)];
+	LONG lDelta = pNew - pOld;
+	for(UBYTE i = 0; i < s_sMixer.ubVoiceCount; ++i) {
+		tMixerVoice *pVoice = &s_sMixer.pVoices[i];
+		if(pStart <= pVoice->pCurr && pVoice->pCurr < pEnd) {
+			pVoice->pCurr += lDelta;
+			pVoice->pEnd += lDelta;
+		}
+	}
+}
+
+static void mixerStopVoicesOfSfx(const tPtplayerSfx *pSfx) {
+	const BYTE *pStart = (const BYTE*)pSfx->pData;
+	const BYTE *pEnd = &pStart[pSfx->uwWordLength * sizeof(UWORD)];
+	for(UBYTE i = 0; i < s_sMixer.ubVoiceCount; ++i) {
+		tMixerVoice *pVoice = &s_sMixer.pVoices[i];
+		if(pStart <= pVoice->pCurr && pVoice->pCurr < pEnd) {
+			pVoice->pCurr = 0;
+		}
+	}
+}
+
+UBYTE ptplayerMixerCreate(UBYTE ubChannelMask, UBYTE ubVoiceCount, UWORD uwPeriod) {
+	logBlockBegin(
+		"ptplayerMixerCreate(ubChannelMask: %hhu, ubVoiceCount: %hhu, uwPeriod: %hu)",
+		ubChannelMask, ubVoiceCount, uwPeriod
+	);
+#if defined(PTPLAYER_USE_AUDIO_INT_HANDLERS)
+	logWrite("ERR: Mixer relies on polling audio intbits, unusable with audio int handlers\n");
+	logBlockEnd("ptplayerMixerCreate()");
+	return 0;
+#endif
+	if(s_sMixer.ubChannelMask) {
+		logWrite("ERR: Mixer is already active\n");
+		logBlockEnd("ptplayerMixerCreate()");
+		return 0;
+	}
+	if(ubChannelMask & s_ubChannelsTaken) {
+		logWrite("ERR: Mixer channels are already used by a stream\n");
+		logBlockEnd("ptplayerMixerCreate()");
+		return 0;
+	}
+	UBYTE ubStreamCount = 0;
+	for(UBYTE i = 0; i < 4; ++i) {
+		if(BTST(ubChannelMask, i)) {
+			s_sMixer.pStreams[ubStreamCount].ubChannel = i;
+			s_sMixer.pStreams[ubStreamCount].ubVoiceFirst = ubStreamCount;
+			++ubStreamCount;
+		}
+	}
+	if(ubStreamCount == 0 || ubStreamCount > 2 || (ubChannelMask & ~0xF)) {
+		logWrite("ERR: Mixer needs 1 or 2 channels, got mask %hhu\n", ubChannelMask);
+		logBlockEnd("ptplayerMixerCreate()");
+		return 0;
+	}
+	if(ubVoiceCount < ubStreamCount || ubVoiceCount > PTPLAYER_MIXER_VOICES_MAX) {
+		logWrite(
+			"ERR: Mixer voice count %hhu out of range %hhu..%d\n",
+			ubVoiceCount, ubStreamCount, PTPLAYER_MIXER_VOICES_MAX
+		);
+		logBlockEnd("ptplayerMixerCreate()");
+		return 0;
+	}
+	if(ubStreamCount + mt_MusicChannels > 4) {
+		logWrite(
+			"WARN: %hhu channels reserved for music, mixer takes %hhu of them\n",
+			mt_MusicChannels, ubStreamCount
+		);
+	}
+
+	// Each buffer lasts for two frames, so that ptplayerProcess() being called
+	// once per frame has at least a full frame for mixing the queued one.
+	UWORD uwFps = s_isPal ? 50 : 60;
+	ULONG ulSamplesPerFrame = (getClockConstant() + uwPeriod * uwFps - 1) / (uwPeriod * uwFps);
+	s_sMixer.uwBufferSize = (UWORD)(2 * ulSamplesPerFrame + 1) & ~1;
+	s_sMixer.uwPeriod = uwPeriod;
+	s_sMixer.ubStreamCount = ubStreamCount;
+	s_sMixer.ubVoiceCount = ubVoiceCount;
+	s_sMixer.ulStartCount = 0;
+	for(UBYTE i = 0; i < PTPLAYER_MIXER_VOICES_MAX; ++i) {
+		s_sMixer.pVoices[i].pCurr = 0;
+	}
+	logWrite("Buffer size: %hu bytes\n", s_sMixer.uwBufferSize);
+
+	systemUse();
+	s_sMixer.pVolumeTables = memAllocFast(MIXER_VOLUME_LEVELS * 256);
+	if(!s_sMixer.pVolumeTables) {
+		goto fail;
+	}
+	for(UBYTE i = 0; i < ubStreamCount; ++i) {
+		tMixerStream *pStream = &s_sMixer.pStreams[i];
+		pStream->pBuffers[0] = memAllocChipClear(2 * s_sMixer.uwBufferSize);
+		if(!pStream->pBuffers[0]) {
+			goto fail;
+		}
+		pStream->pBuffers[1] = &pStream->pBuffers[0][s_sMixer.uwBufferSize];
+		pStream->ubQueued = 0;
+		pStream->ubSilentBuffers = 2;
+	}
+	systemUnuse();
+
+	// Volume tables are scaled so that full volume voices of a stream can't
+	// overflow a byte when summed, so there's no need for clamping.
+	UBYTE ubVoicesPerStream = (ubVoiceCount + ubStreamCount - 1) / ubStreamCount;
+	BYTE *pTable = s_sMixer.pVolumeTables;
+	for(UBYTE ubLevel = 1; ubLevel <= MIXER_VOLUME_LEVELS; ++ubLevel) {
+		for(UWORD uwSample = 0; uwSample < 256; ++uwSample) {
+			*(pTable++) = ((WORD)(BYTE)uwSample * ubLevel) / (
+				MIXER_VOLUME_LEVELS * ubVoicesPerStream
+			);
+		}
+	}
+
+	g_pCustom->intena = INTF_INTEN;
+	for(UBYTE i = 0; i < ubStreamCount; ++i) {
+		tMixerStream *pStream = &s_sMixer.pStreams[i];
+		volatile tChannelRegs *pChannelReg = &g_pCustom->aud[pStream->ubChannel];
+		channelTake(pStream->ubChannel);
+		PAULA_WRITE(pChannelReg->ac_ptr, (UWORD*)pStream->pBuffers[0]);
+		PAULA_WRITE(pChannelReg->ac_len, s_sMixer.uwBufferSize / sizeof(UWORD));
+		PAULA_WRITE(pChannelReg->ac_per, uwPeriod);
+		PAULA_WRITE(pChannelReg->ac_vol, PTPLAYER_VOLUME_MAX);
+	}
+	// Intbits get set again when Paula starts playing the first buffers
+	g_pCustom->intreq = ubChannelMask << INTB_AUD0;
+	s_sMixer.ubChannelMask = ubChannelMask;
+	g_pCustom->intena = INTF_SETCLR | INTF_INTEN;
+	systemSetDmaMask(ubChannelMask << DMAB_AUD0, 1);
+
+	logBlockEnd("ptplayerMixerCreate()");
+	return 1;
+
+fail:
+	logWrite("ERR: Couldn't allocate mixer buffers\n");
+	for(UBYTE i = 0; i < ubStreamCount; ++i) {
+		if(s_sMixer.pStreams[i].pBuffers[0]) {
+			memFree(s_sMixer.pStreams[i].pBuffers[0], 2 * s_sMixer.uwBufferSize);
+			s_sMixer.pStreams[i].pBuffers[0] = 0;
+		}
+	}
+	if(s_sMixer.pVolumeTables) {
+		memFree(s_sMixer.pVolumeTables, MIXER_VOLUME_LEVELS * 256);
+		s_sMixer.pVolumeTables = 0;
+	}
+	systemUnuse();
+	logBlockEnd("ptplayerMixerCreate()");
+	return 0;
+}
+
+void ptplayerMixerDestroy(void) {
+	if(!s_sMixer.ubChannelMask) {
+		return;
+	}
+	logBlockBegin("ptplayerMixerDestroy()");
+
+	g_pCustom->intena = INTF_INTEN;
+	for(UBYTE i = 0; i < s_sMixer.ubStreamCount; ++i) {
+		channelGiveBack(s_sMixer.pStreams[i].ubChannel);
+	}
+	s_sMixer.ubChannelMask = 0;
+	g_pCustom->intena = INTF_SETCLR | INTF_INTEN;
+
+	systemUse();
+	for(UBYTE i = 0; i < s_sMixer.ubStreamCount; ++i) {
+		memFree(s_sMixer.pStreams[i].pBuffers[0], 2 * s_sMixer.uwBufferSize);
+		s_sMixer.pStreams[i].pBuffers[0] = 0;
+	}
+	memFree(s_sMixer.pVolumeTables, MIXER_VOLUME_LEVELS * 256);
+	s_sMixer.pVolumeTables = 0;
+	systemUnuse();
+	logBlockEnd("ptplayerMixerDestroy()");
+}
+
+void ptplayerMixerSfxPlay(
+	const tPtplayerSfx *pSfx, UBYTE ubVolume, UBYTE ubPriority
+) {
+	if(!s_sMixer.ubChannelMask) {
+		logWrite("ERR: Mixer is not active\n");
+		return;
+	}
+	UBYTE ubLevel = (ubVolume * MIXER_VOLUME_LEVELS + PTPLAYER_VOLUME_MAX / 2) / PTPLAYER_VOLUME_MAX;
+	if(!ubLevel) {
+		return;
+	}
+
+	// Prefer idle voice of stream with least voices busy, so that they're
+	// spread evenly across channels
+	UBYTE pBusyCounts[2] = {0, 0};
+	for(UBYTE i = 0; i < s_sMixer.ubVoiceCount; ++i) {
+		if(s_sMixer.pVoices[i].pCurr) {
+			++pBusyCounts[i % s_sMixer.ubStreamCount];
+		}
+	}
+	tMixerVoice *pBestVoice = 0;
+	UBYTE ubBestBusyCount = 0xFF;
+	for(UBYTE i = 0; i < s_sMixer.ubVoiceCount; ++i) {
+		UBYTE ubBusyCount = pBusyCounts[i % s_sMixer.ubStreamCount];
+		if(!s_sMixer.pVoices[i].pCurr && ubBusyCount < ubBestBusyCount) {
+			ubBestBusyCount = ubBusyCount;
+			pBestVoice = &s_sMixer.pVoices[i];
+		}
+	}
+
+	if(!pBestVoice) {
+		// All voices are busy. Replace the one with lowest priority, or the oldest
+		// one of same priority.
+		for(UBYTE i = 0; i < s_sMixer.ubVoiceCount; ++i) {
+			tMixerVoice *pVoice = &s_sMixer.pVoices[i];
+			if(pVoice->ubPriority > ubPriority) {
+				continue;
+			}
+			if(
+				!pBestVoice || pVoice->ubPriority < pBestVoice->ubPriority || (
+					pVoice->ubPriority == pBestVoice->ubPriority &&
+					pVoice->ulStartIndex < pBestVoice->ulStartIndex
+				)
+			) {
+				pBestVoice = pVoice;
+			}
+		}
+		if(!pBestVoice) {
+#if defined(ACE_DEBUG_PTPLAYER)
+			logWrite("No mixer voice for sfx of priority %hhu\n", ubPriority);
+#endif
+			return;
+		}
+	}
+
+	// Sample position step in 16.16 fixed point
+	ULONG ulStep = ((ULONG)s_sMixer.uwPeriod << 16) / pSfx->uwPeriod;
+	tMixerVoice *pVoice = pBestVoice;
+	pVoice->pCurr = 0;
+	pVoice->pEnd = &((const BYTE*)pSfx->pData)[pSfx->uwWordLength * sizeof(UWORD)];
+	pVoice->pVolumeTable = &s_sMixer.pVolumeTables[(ubLevel - 1) * 256];
+	pVoice->uwFrac = 0;
+	pVoice->uwStepFrac = ulStep & 0xFFFF;
+	pVoice->uwStepInt = ulStep >> 16;
+	pVoice->ubPriority = ubPriority;
+	pVoice->ulStartIndex = s_sMixer.ulStartCount++;
+	// Set last, so that voice is considered idle until it's fully set up
+	pVoice->pCurr = (const BYTE*)pSfx->pData;
+}
+
+//---------------------------------------------------------------------- STREAMS
+
+/**
+ * @brief Index of silent buffer, played by Paula when there's no data.
+ */
+#define STREAM_BUFFER_SILENCE STREAM_BUFFER_COUNT
+
+/**
+ * @brief Reads given number of consecutive free buffers from file. Looped
+ * streams are rewound at their end, non-looped ones are padded with silence.
+ * Uses OS only if file's implementation needs it.
+ *
+ * @param pStream Stream to be filled.
+ * @param ubBufferCount Number of buffers to fill. They must not wrap around
+ * the ring's end.
+ */
+static void streamFill(tPtplayerStream *pStream, UBYTE ubBufferCount) {
+	UBYTE *pDst = &pStream->pBuffers[pStream->ubNextFill * pStream->uwBufferSize];
+	ULONG ulSize = ubBufferCount * pStream->uwBufferSize;
+	while(ulSize) {
+		if(!pStream->ulSamplesLeft) {
+			if(!pStream->isLooped) {
+				memset(pDst, 0, ulSize);
+				pStream->isDataEnd = 1;
+				break;
+			}
+			fileSeek(pStream->pFile, pStream->ulDataPos, FILE_SEEK_SET);
+			pStream->ulSamplesLeft = pStream->ulSampleCount;
+			pStream->bDecodedLast = 0;
+		}
+
+		ULONG ulChunk = MIN(ulSize, pStream->ulSamplesLeft);
+		if(pStream->ubCompression == SFX_COMPRESSION_FIB_DELTA) {
+			// Same in-place decoding as in ptplayerSfxCreateFromFd().
+			// Chunk is always even, since both buffers and sample count are.
+			UWORD uwEncodedSize = ulChunk / 2;
+			UBYTE *pEncoded = &pDst[uwEncodedSize];
+			fileRead(pStream->pFile, pEncoded, uwEncodedSize);
+			pStream->bDecodedLast = fibDeltaDecode(
+				(BYTE*)pDst, pEncoded, uwEncodedSize, pStream->bDecodedLast
+			);
+		}
+		else {
+			fileRead(pStream->pFile, pDst, ulChunk);
+		}
+		pDst += ulChunk;
+		ulSize -= ulChunk;
+		pStream->ulSamplesLeft -= ulChunk;
+	}
+
+	pStream->ubNextFill += ubBufferCount;
+	if(pStream->ubNextFill >= STREAM_BUFFER_COUNT) {
+		pStream->ubNextFill -= STREAM_BUFFER_COUNT;
+	}
+	g_pCustom->intena = INTF_INTEN;
+	pStream->ubFreeCount -= ubBufferCount;
+	pStream->ubReadyCount += ubBufferCount;
+	g_pCustom->intena = INTF_SETCLR | INTF_INTEN;
+}
+
+/**
+ * @brief Called when Paula has started playing stream's queued buffer.
+ * Queues the next one, so that it's played right after current one.
+ */
+static void INTERRUPT streamOnAudio(
+	REGARG(volatile tCustom *pCustom, "a0"),
+	REGARG(volatile void *pData, "a1")
+) {
+	tPtplayerStream *pStream = (tPtplayerStream*)pData;
+	if(pStream->ubPlaying != STREAM_BUFFER_SILENCE) {
+		++pStream->ubFreeCount;
+	}
+	pStream->ubPlaying = pStream->ubQueued;
+
+	UBYTE ubNext = STREAM_BUFFER_SILENCE;
+	if(pStream->ubReadyCount) {
+		ubNext = pStream->ubNextQueue;
+		if(++pStream->ubNextQueue >= STREAM_BUFFER_COUNT) {
+			pStream->ubNextQueue = 0;
+		}
+		--pStream->ubReadyCount;
+	}
+	else if(pStream->isDataEnd) {
+		if(pStream->ubPlaying == STREAM_BUFFER_SILENCE) {
+			// Last data buffer has been played, silence has started
+			systemSetDmaMask(DMAF_AUD0 << pStream->ubChannel, 0);
+			pStream->isPlaying = 0;
+		}
+	}
+#if defined(ACE_DEBUG)
+	else {
+		++pStream->ulUnderrunCount;
+	}
+#endif
+	pStream->ubQueued = ubNext;
+	PAULA_WRITE(
+		pCustom->aud[pStream->ubChannel].ac_ptr,
+		(UWORD*)&pStream->pBuffers[ubNext * pStream->uwBufferSize]
+	);
+	INTERRUPT_END;
+}
+
+static void streamProcess(tPtplayerStream *pStream) {
+	if(pStream->isDataEnd || pStream->ubFreeCount < STREAM_REFILL_BATCH) {
+		return;
+	}
+
+	// Free buffers are consecutive - read them all at once, or in two reads
+	// if they wrap around the ring's end. OS isn't taken here, so that files
+	// served from RAM don't stall interrupts - disk files take it on their own.
+	UBYTE ubFreeCount = pStream->ubFreeCount;
+	while(ubFreeCount && !pStream->isDataEnd) {
+		UBYTE ubCount = MIN(ubFreeCount, STREAM_BUFFER_COUNT - pStream->ubNextFill);
+		streamFill(pStream, ubCount);
+		ubFreeCount -= ubCount;
+	}
+}
+
+tPtplayerStream *ptplayerStreamCreateFromPath(
+	const char *szPath, UBYTE ubChannel, UBYTE ubVolume, UBYTE isLooped
+) {
+	return ptplayerStreamCreateFromFd(
+		diskFileOpen(szPath, "rb"), ubChannel, ubVolume, isLooped
+	);
+}
+
+tPtplayerStream *ptplayerStreamCreateFromFd(
+	tFile *pFileSfx, UBYTE ubChannel, UBYTE ubVolume, UBYTE isLooped
+) {
+	systemUse();
+	logBlockBegin(
+		"ptplayerStreamCreateFromFd(pFileSfx: %p, ubChannel: %hhu, ubVolume: %hhu, isLooped: %hhu)",
+		pFileSfx, ubChannel, ubVolume, isLooped
+	);
+	tPtplayerStream *pStream = 0;
+	if(!pFileSfx) {
+		logWrite("ERR: Null file handle\n");
+		goto fail;
+	}
+	if(ubChannel >= 4 || isChannelTaken(ubChannel)) {
+		logWrite("ERR: Channel %hhu is invalid or already used by sfx mixer or stream\n", ubChannel);
+		goto fail;
+	}
+
+	pStream = memAllocFastClear(sizeof(*pStream));
+	if(!pStream) {
+		goto fail;
+	}
+	pStream->pFile = pFileSfx;
+	UWORD uwWordLength;
+	if(!sfxReadHeader(pFileSfx, &uwWordLength, &pStream->uwPeriod, &pStream->ubCompression)) {
+		goto fail;
+	}
+
+	// Header's length is too short for long streams, so use file size instead.
+	// Keep sample count even, so that compressed data is decoded in whole bytes.
+	pStream->ulDataPos = fileGetPos(pFileSfx);
+	ULONG ulDataSize = fileGetSize(pFileSfx) - pStream->ulDataPos;
+	if(pStream->ubCompression == SFX_COMPRESSION_FIB_DELTA) {
+		pStream->ulSampleCount = ulDataSize * 2;
+	}
+	else {
+		pStream->ulSampleCount = ulDataSize & ~1;
+	}
+	pStream->ulSamplesLeft = pStream->ulSampleCount;
+	if(!pStream->ulSampleCount) {
+		logWrite("ERR: No sample data\n");
+		goto fail;
+	}
+
+	// Two frames per buffer, same as sfx mixer
+	UWORD uwFps = s_isPal ? 50 : 60;
+	ULONG ulSamplesPerFrame = (
+		getClockConstant() + pStream->uwPeriod * uwFps - 1
+	) / (pStream->uwPeriod * uwFps);
+	pStream->uwBufferSize = (UWORD)(2 * ulSamplesPerFrame + 1) & ~1;
+	logWrite(
+		"Samples: %lu, buffer size: %hu\n",
+		pStream->ulSampleCount, pStream->uwBufferSize
+	);
+	pStream->pBuffers = memAllocChipClear(
+		(STREAM_BUFFER_COUNT + 1) * pStream->uwBufferSize
+	);
+	if(!pStream->pBuffers) {
+		goto fail;
+	}
+
+	pStream->ubChannel = ubChannel;
+	pStream->isLooped = isLooped;
+	pStream->isPlaying = 1;
+	pStream->ubFreeCount = STREAM_BUFFER_COUNT;
+	streamFill(pStream, STREAM_BUFFER_COUNT);
+
+	// First buffer gets latched by Paula as soon as DMA gets enabled,
+	// which triggers the audio interrupt queueing the next one.
+	pStream->ubPlaying = STREAM_BUFFER_SILENCE;
+	pStream->ubQueued = 0;
+	pStream->ubNextQueue = 1;
+	--pStream->ubReadyCount;
+
+	g_pCustom->intena = INTF_INTEN;
+	channelTake(ubChannel);
+	volatile tChannelRegs *pChannelReg = &g_pCustom->aud[ubChannel];
+	PAULA_WRITE(pChannelReg->ac_ptr, (UWORD*)pStream->pBuffers);
+	PAULA_WRITE(pChannelReg->ac_len, pStream->uwBufferSize / sizeof(UWORD));
+	PAULA_WRITE(pChannelReg->ac_per, pStream->uwPeriod);
+	PAULA_WRITE(pChannelReg->ac_vol, ubVolume);
+	g_pCustom->intreq = INTF_AUD0 << ubChannel;
+	s_pStreams[ubChannel] = pStream;
+	g_pCustom->intena = INTF_SETCLR | INTF_INTEN;
+	systemSetInt(INTB_AUD0 + ubChannel, streamOnAudio, pStream);
+	systemSetDmaMask(DMAF_AUD0 << ubChannel, 1);
+
+	logBlockEnd("ptplayerStreamCreateFromFd()");
+	systemUnuse();
+	return pStream;
+
+fail:
+	if(pStream) {
+		if(pStream->pBuffers) {
+			memFree(pStream->pBuffers, (STREAM_BUFFER_COUNT + 1) * pStream->uwBufferSize);
+		}
+		memFree(pStream, sizeof(*pStream));
+	}
+	if(pFileSfx) {
+		fileClose(pFileSfx);
+	}
+	logBlockEnd("ptplayerStreamCreateFromFd()");
+	systemUnuse();
+	return 0;
+}
+
+void ptplayerStreamDestroy(tPtplayerStream *pStream) {
+	logBlockBegin("ptplayerStreamDestroy(pStream: %p)", pStream);
+	if(pStream) {
+#if defined(ACE_DEBUG)
+		logWrite("Underruns: %lu\n", pStream->ulUnderrunCount);
+#endif
+		UBYTE ubChannel = pStream->ubChannel;
+#if defined(PTPLAYER_USE_AUDIO_INT_HANDLERS)
+		systemSetInt(INTB_AUD0 + ubChannel, onAudio, (void*)(ULONG)ubChannel);
+#else
+		systemSetInt(INTB_AUD0 + ubChannel, 0, 0);
+#endif
+		g_pCustom->intena = INTF_INTEN;
+		channelGiveBack(ubChannel);
+		s_pStreams[ubChannel] = 0;
+		g_pCustom->intena = INTF_SETCLR | INTF_INTEN;
+
+		systemUse();
+		fileClose(pStream->pFile);
+		memFree(pStream->pBuffers, (STREAM_BUFFER_COUNT + 1) * pStream->uwBufferSize);
+		memFree(pStream, sizeof(*pStream));
+		systemUnuse();
+	}
+	logBlockEnd("ptplayerStreamDestroy()");
+}
+
+UBYTE ptplayerStreamIsPlaying(const tPtplayerStream *pStream) {
+	return pStream->isPlaying;
+}
+
 tPtplayerSamplePack *ptplayerSampleDataCreateFromPath(const char *szPath) {
 	return ptplayerSampleDataCreateFromFd(diskFileOpen(szPath, "rb"));
 }
 
+/**
+ * @brief Reads compressed sample pack contents, decoding them into chip RAM.
+ * Encoded data is read in small pieces into fast RAM buffer, so that there's
+ * no need for full-size temporary buffer.
+ *
+ * @param pFileSamples Sample pack file, positioned after format tag.
+ * @param pSamplePack Sample pack to be filled.
+ * @return 1 on success, otherwise 0.
+ */
+static UBYTE samplePackReadCompressed(
+	tFile *pFileSamples, tPtplayerSamplePack *pSamplePack
+) {
+	UBYTE ubVersion, ubCompression;
+	UWORD uwSampleCount;
+	fileRead(pFileSamples, &ubVersion, sizeof(ubVersion));
+	fileRead(pFileSamples, &ubCompression, sizeof(ubCompression));
+	fileRead(pFileSamples, &uwSampleCount, sizeof(uwSampleCount));
+	uwSampleCount = endianAmiga16(uwSampleCount);
+	if(ubVersion != SAMPLE_PACK_VERSION) {
+		logWrite("ERR: Unknown sample pack version: %hhu\n", ubVersion);
+		return 0;
+	}
+	if(ubCompression != SFX_COMPRESSION_FIB_DELTA) {
+		logWrite("ERR: Unknown sample pack compression: %hhu\n", ubCompression);
+		return 0;
+	}
+	if(uwSampleCount > PTPLAYER_MOD_SAMPLE_COUNT) {
+		logWrite("ERR: Too many samples in pack: %hu\n", uwSampleCount);
+		return 0;
+	}
+
+	UWORD pWordLengths[PTPLAYER_MOD_SAMPLE_COUNT];
+	fileRead(pFileSamples, pWordLengths, uwSampleCount * sizeof(UWORD));
+	pSamplePack->ulSize = 0;
+	for(UBYTE i = 0; i < uwSampleCount; ++i) {
+		pWordLengths[i] = endianAmiga16(pWordLengths[i]);
+		pSamplePack->ulSize += pWordLengths[i] * sizeof(UWORD);
+	}
+	logWrite("Compressed sample pack, decoded size: %lu\n", pSamplePack->ulSize);
+
+	pSamplePack->pData = memAllocChip(pSamplePack->ulSize);
+	if(!pSamplePack->pData) {
+		return 0;
+	}
+	UBYTE *pStaging = memAllocFast(SAMPLE_PACK_STAGING_SIZE);
+	if(!pStaging) {
+		memFree(pSamplePack->pData, pSamplePack->ulSize);
+		pSamplePack->pData = 0;
+		return 0;
+	}
+
+	// Each sample is encoded separately, starting from zero.
+	// Two samples per byte, so encoded size in bytes is same as word length.
+	BYTE *pDst = (BYTE*)pSamplePack->pData;
+	for(UBYTE i = 0; i < uwSampleCount; ++i) {
+		UWORD uwEncodedLeft = pWordLengths[i];
+		BYTE bValue = 0;
+		while(uwEncodedLeft) {
+			UWORD uwChunkSize = MIN(uwEncodedLeft, SAMPLE_PACK_STAGING_SIZE);
+			fileRead(pFileSamples, pStaging, uwChunkSize);
+			bValue = fibDeltaDecode(pDst, pStaging, uwChunkSize, bValue);
+			pDst += uwChunkSize * 2;
+			uwEncodedLeft -= uwChunkSize;
+		}
+	}
+	memFree(pStaging, SAMPLE_PACK_STAGING_SIZE);
+	return 1;
+}
+
 tPtplayerSamplePack *ptplayerSampleDataCreateFromFd(tFile *pFileSamples)
 {
-	// TODO: add some kind of header for the file, read each sample separately
 	logBlockBegin("ptplayerSampleDataCreateFromFd(pFileSamples: %p)", pFileSamples);
 	systemUse();
 	tPtplayerSamplePack *pSamplePack = 0;
@@ -3231,13 +4525,23 @@ tPtplayerSamplePack *ptplayerSampleDataCreateFromFd(tFile *pFileSamples)
 
 	pSamplePack = memAllocFastClear(sizeof(*pSamplePack));
 	logWrite("Addr: %p\n", pSamplePack);
-	pSamplePack->ulSize = lSize;
-	pSamplePack->pData = memAllocChip(pSamplePack->ulSize);
-	if(!pSamplePack->pData) {
-		goto fail;
+	char pTag[4] = {0};
+	fileRead(pFileSamples, pTag, sizeof(pTag));
+	if(!memcmp(pTag, SAMPLE_PACK_FORMAT_TAG, sizeof(pTag))) {
+		if(!samplePackReadCompressed(pFileSamples, pSamplePack)) {
+			goto fail;
+		}
+	}
+	else {
+		// Raw sample pack - whole file is sample data
+		fileSeek(pFileSamples, 0, FILE_SEEK_SET);
+		pSamplePack->ulSize = lSize;
+		pSamplePack->pData = memAllocChip(pSamplePack->ulSize);
+		if(!pSamplePack->pData) {
+			goto fail;
+		}
+		fileRead(pFileSamples, pSamplePack->pData, pSamplePack->ulSize);
 	}
-
-	fileRead(pFileSamples, pSamplePack->pData, pSamplePack->ulSize);
 	fileClose(pFileSamples);
 
 	systemUnuse();
@@ -4,6 +4,7 @@
 
 #include <ace/managers/state.h>
 #include <ace/managers/log.h>
+#include <ace/managers/profiler.h>
 
 /* Functions */
 
@@ -25,6 +26,33 @@ static void _checkNull(
 #define checkNull(pPointer) do {} while(0)
 #endif
 
+static void stateEnter(tState *pState) {
+	if (pState->pArenaChip) {
+		pState->ulArenaChipMark = arenaGetMark(pState->pArenaChip);
+	}
+	if (pState->pArenaFast) {
+		pState->ulArenaFastMark = arenaGetMark(pState->pArenaFast);
+	}
+	if (pState->cbCreate) {
+		pState->cbCreate();
+	}
+}
+
+static void stateLeave(tState *pState) {
+	if (pState->cbDestroy) {
+		pState->cbDestroy();
+	}
+	if (pState->pArenaChip) {
+		arenaRewind(pState->pArenaChip, pState->ulArenaChipMark);
+	}
+	if (pState->pArenaFast) {
+		arenaRewind(pState->pArenaFast, pState->ulArenaFastMark);
+	}
+	if (pState->pPool) {
+		poolReset(pState->pPool);
+	}
+}
+
 tStateManager *stateManagerCreate(void) {
 	logBlockBegin("stateManagerCreate()");
 
@@ -64,6 +92,9 @@ tState *stateCreate(
 	pState->cbSuspend = cbSuspend;
 	pState->cbResume = cbResume;
 	pState->pPrev = 0;
+	pState->pArenaChip = 0;
+	pState->pArenaFast = 0;
+	pState->pPool = 0;
 
 	logBlockEnd("stateCreate()");
 
@@ -80,6 +111,16 @@ void stateDestroy(tState *pState) {
 	logBlockEnd("stateDestroy()");
 }
 
+void stateSetAllocators(
+	tState *pState, tArena *pArenaChip, tArena *pArenaFast, tPool *pPool
+) {
+	checkNull(pState);
+
+	pState->pArenaChip = pArenaChip;
+	pState->pArenaFast = pArenaFast;
+	pState->pPool = pPool;
+}
+
 void statePush(tStateManager *pStateManager, tState *pState) {
 	logBlockBegin(
 		"statePush(pStateManager: %p, pState: %p)",
@@ -96,9 +137,7 @@ void statePush(tStateManager *pStateManager, tState *pState) {
 	pState->pPrev = pStateManager->pCurrent;
 	pStateManager->pCurrent = pState;
 
-	if (pStateManager->pCurrent && pStateManager->pCurrent->cbCreate) {
-		pStateManager->pCurrent->cbCreate();
-	}
+	stateEnter(pState);
 
 	logBlockEnd("statePush()");
 }
@@ -108,8 +147,8 @@ void statePop(tStateManager *pStateManager) {
 
 	checkNull(pStateManager);
 
-	if (pStateManager->pCurrent && pStateManager->pCurrent->cbDestroy) {
-		pStateManager->pCurrent->cbDestroy();
+	if (pStateManager->pCurrent) {
+		stateLeave(pStateManager->pCurrent);
 	}
 
 	tState *pOldState = pStateManager->pCurrent;
@@ -128,9 +167,7 @@ void statePopAll(tStateManager *pStateManager) {
 	checkNull(pStateManager);
 
 	while (pStateManager->pCurrent) {
-		if (pStateManager->pCurrent->cbDestroy) {
-			pStateManager->pCurrent->cbDestroy();
-		}
+		stateLeave(pStateManager->pCurrent);
 
 		pStateManager->pCurrent = pStateManager->pCurrent->pPrev;
 	}
@@ -147,8 +184,8 @@ void stateChange(tStateManager *pStateManager, tState *pState) {
 	checkNull(pStateManager);
 	checkNull(pState);
 
-	if (pStateManager->pCurrent && pStateManager->pCurrent->cbDestroy) {
-		pStateManager->pCurrent->cbDestroy();
+	if (pStateManager->pCurrent) {
+		stateLeave(pStateManager->pCurrent);
 	}
 
 	if (pStateManager->pCurrent) {
@@ -160,9 +197,7 @@ void stateChange(tStateManager *pStateManager, tState *pState) {
 
 	pStateManager->pCurrent = pState;
 
-	if (pStateManager->pCurrent && pStateManager->pCurrent->cbCreate) {
-		pStateManager->pCurrent->cbCreate();
-	}
+	stateEnter(pState);
 
 	logBlockEnd("stateChange()");
 }
@@ -171,6 +206,8 @@ void stateProcess(tStateManager *pStateManager) {
 	checkNull(pStateManager);
 
 	if (pStateManager->pCurrent && pStateManager->pCurrent->cbLoop) {
+		profilerZoneBegin(PROFILER_ZONE_STATE);
 		pStateManager->pCurrent->cbLoop();
+		profilerZoneEnd();
 	}
 }
@@ -6,6 +6,7 @@
 #include <ace/macros.h>
 #include <ace/managers/blit.h>
 #include <ace/managers/system.h>
+#include <ace/managers/profiler.h>
 #include <ace/utils/tag.h>
 #include <proto/exec.h> // Bartman's compiler needs this
 
@@ -39,47 +40,73 @@ static void tileBufferResetRedrawState(tRedrawState *pState) {
 	pState->pMarginOppositeY = &pState->sMarginU;
 #endif
 
-	pState->ubPendingCount = 0;
+	pState->uwPendingCount = 0;
 }
 
-static void tileBufferQueueAdd(
-	tTileBufferManager *pManager, UWORD uwTileX, UWORD uwTileY
+/**
+ * @brief Adds run of tiles in given column to redraw queue of given state,
+ * merging it with all queued runs which overlap or touch it.
+ *
+ * If the queue is full, the new run is merged with any other run in the same
+ * column, redrawing tiles in between. Only if there's none, the run is dropped.
+ */
+static void tileBufferRedrawStateAddRun(
+	tRedrawState *pState, UWORD uwQueueSize,
+	UWORD uwTileX, UWORD uwTileY, UWORD uwTileCount
 ) {
-	// Add two times so that they're drawn properly in double buffering
-#if defined ACE_DEBUG
-	if(
-		pManager->pRedrawStates[0].ubPendingCount > pManager->ubQueueSize - 2 ||
-		pManager->pRedrawStates[1].ubPendingCount > pManager->ubQueueSize - 2
-	) {
-		logWrite("ERR: No more space in redraw queue");
-		return;
-	}
-#endif
-	tRedrawState *pState = &pManager->pRedrawStates[0];
-	if(pState->ubPendingCount >= pManager->ubQueueSize) {
-		logWrite("ERR: Pending tiles queue overflow\n");
+	tTileBufferRedrawRun *pRuns = pState->pPendingQueue;
+	UWORD uwEndY = uwTileY + uwTileCount;
+	tTileBufferRedrawRun *pSameColumn = 0;
+	UWORD uwIdx = 0;
+	while(uwIdx < pState->uwPendingCount) {
+		tTileBufferRedrawRun *pRun = &pRuns[uwIdx];
+		if(pRun->uwTileX == uwTileX) {
+			UWORD uwRunEndY = pRun->uwTileY + pRun->uwTileCount;
+			if(pRun->uwTileY <= uwTileY && uwEndY <= uwRunEndY) {
+				// Already queued as a whole
+				return;
+			}
+			if(pRun->uwTileY <= uwEndY && uwTileY <= uwRunEndY) {
+				// Overlapping or adjacent - absorb it and remove from queue
+				uwTileY = MIN(uwTileY, pRun->uwTileY);
+				uwEndY = MAX(uwEndY, uwRunEndY);
+				*pRun = pRuns[--pState->uwPendingCount];
+				continue;
+			}
+			pSameColumn = pRun;
+		}
+		++uwIdx;
 	}
-	pState->pPendingQueue[pState->ubPendingCount].uwX = uwTileX;
-	pState->pPendingQueue[pState->ubPendingCount].uwY = uwTileY;
-	++pState->ubPendingCount;
 
-	pState = &pManager->pRedrawStates[1];
-	if(pState->ubPendingCount >= pManager->ubQueueSize) {
-		logWrite("ERR: Pending tiles queue overflow\n");
+	if(pState->uwPendingCount >= uwQueueSize) {
+		if(!pSameColumn) {
+			logWrite("ERR: Pending tiles queue overflow\n");
+			return;
+		}
+		UWORD uwRunEndY = pSameColumn->uwTileY + pSameColumn->uwTileCount;
+		pSameColumn->uwTileY = MIN(uwTileY, pSameColumn->uwTileY);
+		pSameColumn->uwTileCount = MAX(uwEndY, uwRunEndY) - pSameColumn->uwTileY;
+		return;
 	}
-	pState->pPendingQueue[pState->ubPendingCount].uwX = uwTileX;
-	pState->pPendingQueue[pState->ubPendingCount].uwY = uwTileY;
-	++pState->ubPendingCount;
+
+	tTileBufferRedrawRun *pRun = &pRuns[pState->uwPendingCount++];
+	pRun->uwTileX = uwTileX;
+	pRun->uwTileY = uwTileY;
+	pRun->uwTileCount = uwEndY - uwTileY;
 }
 
-void tileBufferQueueProcess(tTileBufferManager *pManager) {
-	tRedrawState *pState = &pManager->pRedrawStates[pManager->ubStateIdx];
-	if(pState->ubPendingCount) {
-		--pState->ubPendingCount;
-		UBYTE ubPendingCount = pState->ubPendingCount;
-		const tUwCoordYX *pTile = &pState->pPendingQueue[ubPendingCount];
-		tileBufferDrawTile(pManager, pTile->uwX, pTile->uwY);
-	}
+static void tileBufferQueueAdd(
+	tTileBufferManager *pManager, UWORD uwTileX, UWORD uwTileY, UWORD uwTileCount
+) {
+	// Add two times so that they're drawn properly in double buffering
+	tileBufferRedrawStateAddRun(
+		&pManager->pRedrawStates[0], pManager->uwQueueSize,
+		uwTileX, uwTileY, uwTileCount
+	);
+	tileBufferRedrawStateAddRun(
+		&pManager->pRedrawStates[1], pManager->uwQueueSize,
+		uwTileX, uwTileY, uwTileCount
+	);
 }
 
 tTileBufferManager *tileBufferCreate(void *pTags, ...) {
@@ -142,10 +169,10 @@ tTileBufferManager *tileBufferCreate(void *pTags, ...) {
 	);
 	tileBufferReset(pManager, uwTileX, uwTileY, ubBitmapFlags, isDblBuf, uwCoplistOffStart, uwCoplistOffBreak);
 
-	pManager->ubQueueSize = tagGet(
+	pManager->uwQueueSize = tagGet(
 		pTags, vaTags, TAG_TILEBUFFER_REDRAW_QUEUE_LENGTH, 0
 	);
-	if(!pManager->ubQueueSize) {
+	if(!pManager->uwQueueSize) {
 		logWrite(
 			"ERR: No queue size (TAG_TILEBUFFER_REDRAW_QUEUE_LENGTH) specified!\n"
 		);
@@ -153,9 +180,10 @@ tTileBufferManager *tileBufferCreate(void *pTags, ...) {
 	}
 	// This alloc could be checked in regard of double buffering
 	// but I want process to be as quick as possible (one 'if' less)
-	// and redraw queue has no mem footprint at all (256 bytes max?)
-	pManager->pRedrawStates[0].pPendingQueue = memAllocFast(pManager->ubQueueSize);
-	pManager->pRedrawStates[1].pPendingQueue = memAllocFast(pManager->ubQueueSize);
+	// and redraw queue has small mem footprint anyway
+	ULONG ulQueueBytes = pManager->uwQueueSize * sizeof(tTileBufferRedrawRun);
+	pManager->pRedrawStates[0].pPendingQueue = memAllocFast(ulQueueBytes);
+	pManager->pRedrawStates[1].pPendingQueue = memAllocFast(ulQueueBytes);
 	if(
 		!pManager->pRedrawStates[0].pPendingQueue ||
 		!pManager->pRedrawStates[1].pPendingQueue
@@ -178,10 +206,16 @@ tTileBufferManager *tileBufferCreate(void *pTags, ...) {
 fail:
 	// TODO: proper fail
 	if(pManager->pRedrawStates[0].pPendingQueue) {
-		memFree(pManager->pRedrawStates[0].pPendingQueue, pManager->ubQueueSize);
+		memFree(
+			pManager->pRedrawStates[0].pPendingQueue,
+			pManager->uwQueueSize * sizeof(tTileBufferRedrawRun)
+		);
 	}
 	if(pManager->pRedrawStates[1].pPendingQueue) {
-		memFree(pManager->pRedrawStates[1].pPendingQueue, pManager->ubQueueSize);
+		memFree(
+			pManager->pRedrawStates[1].pPendingQueue,
+			pManager->uwQueueSize * sizeof(tTileBufferRedrawRun)
+		);
 	}
 	va_end(vaTags);
 	logBlockEnd("tileBufferCreate");
@@ -204,10 +238,16 @@ void tileBufferDestroy(tTileBufferManager *pManager) {
 	}
 
 	if(pManager->pRedrawStates[0].pPendingQueue) {
-		memFree(pManager->pRedrawStates[0].pPendingQueue, pManager->ubQueueSize);
+		memFree(
+			pManager->pRedrawStates[0].pPendingQueue,
+			pManager->uwQueueSize * sizeof(tTileBufferRedrawRun)
+		);
 	}
 	if(pManager->pRedrawStates[1].pPendingQueue) {
-		memFree(pManager->pRedrawStates[1].pPendingQueue, pManager->ubQueueSize);
+		memFree(
+			pManager->pRedrawStates[1].pPendingQueue,
+			pManager->uwQueueSize * sizeof(tTileBufferRedrawRun)
+		);
 	}
 
 	// Free manager
@@ -397,14 +437,137 @@ static inline void tileBufferContinueTileDraw(
 	}
 }
 
+/**
+ * Draws run of tiles in a single column, from uwTileCurr to uwTileEnd-1,
+ * followed by calling tile draw callback on each of them.
+ * Blitter must be already set up with tileBufferSetupTileDraw().
+ */
+static void tileBufferDrawColumnRun(
+	const tTileBufferManager *pManager, UWORD uwBltsize,
+	UWORD uwTilePos, UWORD uwTileCurr, UWORD uwTileEnd
+) {
+	UBYTE ubTileSize = pManager->ubTileSize;
+	UBYTE ubTileShift = pManager->ubTileShift;
+	UWORD uwMarginedHeight = pManager->uwMarginedHeight;
+	UWORD uwTileOffsY = SCROLLBUFFER_HEIGHT_MODULO(
+		uwTileCurr << ubTileShift, uwMarginedHeight
+	);
+	UWORD uwTileOffsX = (uwTilePos << ubTileShift);
+	const tTileBufferTileIndex *pTileColumn = pManager->pTileData[uwTilePos];
+	UWORD uwDstBytesPerRow = pManager->pScroll->pBack->BytesPerRow;
+	PLANEPTR pDstPlane = pManager->pScroll->pBack->Planes[0];
+	ULONG ulDstOffs = uwDstBytesPerRow * uwTileOffsY + uwTileOffsX / 8;
+	UWORD uwDstOffsStep = uwDstBytesPerRow * ubTileSize;
+	// set up the first bltdpt for an interleaved blit. if this isn't
+	// interleaved, this is wasted, but interleaved will be faster with
+	// this. we can just do this here, since tileBufferSetupTileDraw
+	// already waited for the blitter to be idle
+	g_pCustom->bltdpt = pDstPlane + ulDstOffs;
+	for(UWORD uwTile = uwTileCurr; uwTile < uwTileEnd; ++uwTile) {
+		tileBufferContinueTileDraw(
+			pManager, pTileColumn, uwTile,
+			uwBltsize, ulDstOffs, pDstPlane,
+			// do not set bltdpt, it was left at the right place by the previous blit
+			0
+		);
+		uwTileOffsY += ubTileSize;
+		if(uwTileOffsY >= uwMarginedHeight) {
+			uwTileOffsY -= uwMarginedHeight;
+			ulDstOffs = uwDstBytesPerRow * uwTileOffsY + uwTileOffsX / 8;
+			blitWait(); // this happens at most once in a column, so we take the hit
+			g_pCustom->bltdpt = pDstPlane + ulDstOffs;
+		}
+		else {
+			ulDstOffs += uwDstOffsStep;
+		}
+	}
+	if (pManager->cbTileDraw) {
+		uwTileOffsY = SCROLLBUFFER_HEIGHT_MODULO(
+			uwTileCurr << ubTileShift, uwMarginedHeight
+		);
+		for(UWORD uwTile = uwTileCurr; uwTile < uwTileEnd; ++uwTile) {
+			pManager->cbTileDraw(
+				uwTilePos, uwTile, pManager->pScroll->pBack, uwTileOffsX, uwTileOffsY
+			);
+			uwTileOffsY = SCROLLBUFFER_HEIGHT_MODULO(
+				uwTileOffsY + ubTileSize, uwMarginedHeight
+			);
+		}
+	}
+}
+
+void tileBufferQueueProcess(tTileBufferManager *pManager) {
+	tileBufferQueueProcessBudget(pManager, 1, 0);
+}
+
+UWORD tileBufferQueueProcessBudget(
+	tTileBufferManager *pManager, UWORD uwMaxTiles, UWORD uwMaxLines
+) {
+	tRedrawState *pState = &pManager->pRedrawStates[pManager->ubStateIdx];
+	if(!pState->uwPendingCount) {
+		return 0;
+	}
+
+	UWORD uwStartLine = uwMaxLines ? getRayPos().bfPosY : 0;
+	UWORD uwFrameLines = systemIsPal() ? 313 : 263;
+	UWORD uwTilesDrawn = 0;
+	do {
+		tTileBufferRedrawRun *pRun = &pState->pPendingQueue[pState->uwPendingCount - 1];
+		UWORD uwCount = pRun->uwTileCount;
+		if(uwMaxTiles && uwCount > uwMaxTiles - uwTilesDrawn) {
+			uwCount = uwMaxTiles - uwTilesDrawn;
+		}
+
+		// Tile draw callback may use blitter, so set it up for each run
+		UWORD uwBltsize = tileBufferSetupTileDraw(pManager);
+		tileBufferDrawColumnRun(
+			pManager, uwBltsize, pRun->uwTileX, pRun->uwTileY,
+			pRun->uwTileY + uwCount
+		);
+		uwTilesDrawn += uwCount;
+
+		if(uwCount == pRun->uwTileCount) {
+			--pState->uwPendingCount;
+		}
+		else {
+			pRun->uwTileY += uwCount;
+			pRun->uwTileCount -= uwCount;
+		}
+
+		if(uwMaxTiles && uwTilesDrawn >= uwMaxTiles) {
+			break;
+		}
+		if(uwMaxLines) {
+			UWORD uwLine = getRayPos().bfPosY;
+			if(uwLine < uwStartLine) {
+				// Ray went past the end of frame
+				uwLine += uwFrameLines;
+			}
+			if(uwLine - uwStartLine >= uwMaxLines) {
+				break;
+			}
+		}
+	} while(pState->uwPendingCount);
+
+	return uwTilesDrawn;
+}
+
+UWORD tileBufferQueueGetPendingTileCount(const tTileBufferManager *pManager) {
+	const tRedrawState *pState = &pManager->pRedrawStates[pManager->ubStateIdx];
+	UWORD uwTileCount = 0;
+	for(UWORD i = 0; i < pState->uwPendingCount; ++i) {
+		uwTileCount += pState->pPendingQueue[i].uwTileCount;
+	}
+	return uwTileCount;
+}
+
 FN_HOTSPOT
 void tileBufferProcess(tTileBufferManager *pManager) {
+	profilerZoneBegin(PROFILER_ZONE_TILEBUFFER);
 #if defined(ACE_SCROLLBUFFER_ENABLE_SCROLL_X) || defined(ACE_SCROLLBUFFER_ENABLE_SCROLL_Y)
 	WORD wMarginXPos, wMarginYPos;
-	UWORD uwTileOffsX, uwTileOffsY;
 	tRedrawState *pState = &pManager->pRedrawStates[pManager->ubStateIdx];
 
-	UBYTE ubTileSize = pManager->ubTileSize;
 	UBYTE ubTileShift = pManager->ubTileShift;
 #endif
 
@@ -429,58 +592,12 @@ void tileBufferProcess(tTileBufferManager *pManager) {
 		if (wMarginXPos != pState->pMarginX->wTilePos) {
 			// Not finished redrawing all column tiles?
 			if(pState->pMarginX->wTileCurr < pState->pMarginX->wTileEnd) {
-				uwTileOffsY = SCROLLBUFFER_HEIGHT_MODULO(
-					pState->pMarginX->wTileCurr << ubTileShift, pManager->uwMarginedHeight
-				);
-				uwTileOffsX = (pState->pMarginX->wTilePos << ubTileShift);
 				// Redraw remaining tiles
 				UWORD uwBltsize = tileBufferSetupTileDraw(pManager);
-				UWORD uwTileCurr = pState->pMarginX->wTileCurr;
-				UWORD uwTileEnd = pState->pMarginX->wTileEnd;
-				UWORD uwMarginedHeight = pManager->uwMarginedHeight;
-				UWORD uwTilePos = pState->pMarginX->wTilePos;
-				const tTileBufferTileIndex *pTileColumn = pManager->pTileData[uwTilePos];
-				UWORD uwDstBytesPerRow = pManager->pScroll->pBack->BytesPerRow;
-				PLANEPTR pDstPlane = pManager->pScroll->pBack->Planes[0];
-				ULONG ulDstOffs = uwDstBytesPerRow * uwTileOffsY + uwTileOffsX / 8;
-				UWORD uwDstOffsStep = uwDstBytesPerRow * ubTileSize;
-				// set up the first bltdpt for an interleaved blit. if this isn't
-				// interleaved, this is wasted, but interleaved will be faster with
-				// this. we can just do this here, since tileBufferSetupTileDraw
-				// already waited for the blitter to be idle
-				g_pCustom->bltdpt = pDstPlane + ulDstOffs;
-				while (uwTileCurr < uwTileEnd) {
-					tileBufferContinueTileDraw(
-						pManager, pTileColumn, uwTileCurr,
-						uwBltsize, ulDstOffs, pDstPlane,
-						// do not set bltdpt, it was left at the right place by the previous blit
-						0
-					);
-					++uwTileCurr;
-					uwTileOffsY += ubTileSize;
-					if(uwTileOffsY >= uwMarginedHeight) {
-						uwTileOffsY -= uwMarginedHeight;
-						ulDstOffs = uwDstBytesPerRow * uwTileOffsY + uwTileOffsX / 8;
-						blitWait(); // this happens at most once in a column, so we take the hit
-						g_pCustom->bltdpt = pDstPlane + ulDstOffs;
-					}
-					else {
-						ulDstOffs += uwDstOffsStep;
-					}
-				}
-				if (pManager->cbTileDraw) {
-					uwTileOffsY = SCROLLBUFFER_HEIGHT_MODULO(
-						pState->pMarginX->wTileCurr << ubTileShift, pManager->uwMarginedHeight
-					);
-					uwTileCurr = pState->pMarginX->wTileCurr;
-					while (uwTileCurr < uwTileEnd) {
-						pManager->cbTileDraw(uwTilePos, uwTileCurr, pManager->pScroll->pBack, uwTileOffsX, uwTileOffsY);
-						++uwTileCurr;
-						uwTileOffsY = SCROLLBUFFER_HEIGHT_MODULO(
-							uwTileOffsY + ubTileSize, uwMarginedHeight
-						);
-					}
-				}
+				tileBufferDrawColumnRun(
+					pManager, uwBltsize, pState->pMarginX->wTilePos,
+					pState->pMarginX->wTileCurr, pState->pMarginX->wTileEnd
+				);
 				pState->pMarginX->wTileCurr = pState->pMarginX->wTileEnd;
 			}
 			// Prepare new column redraw data
@@ -522,6 +639,9 @@ void tileBufferProcess(tTileBufferManager *pManager) {
 #endif // defined(ACE_SCROLLBUFFER_ENABLE_SCROLL_X)
 
 #if defined(ACE_SCROLLBUFFER_ENABLE_SCROLL_Y)
+	UWORD uwTileOffsX, uwTileOffsY;
+	UBYTE ubTileSize = pManager->ubTileSize;
+
 	// Y movement
 	WORD wDeltaY = cameraGetDeltaY(pManager->pCamera);
 	if (wDeltaY) {
@@ -612,6 +732,7 @@ void tileBufferProcess(tTileBufferManager *pManager) {
 #endif // defined(ACE_SCROLLBUFFER_ENABLE_SCROLL_Y)
 
 	pManager->ubStateIdx = !pManager->ubStateIdx;
+	profilerZoneEnd();
 }
 
 void tileBufferRedrawAll(tTileBufferManager *pManager) {
@@ -747,9 +868,7 @@ void tileBufferInvalidateRect(
 	UWORD uwEndY = (uwY+uwHeight) >> pManager->ubTileShift;
 
 	for(uwX = uwStartX; uwX <= uwEndX; ++uwX) {
-		for(uwY = uwStartY; uwY <= uwEndY; ++uwY) {
-			tileBufferInvalidateTile(pManager, uwX, uwY);
-		}
+		tileBufferQueueAdd(pManager, uwX, uwStartY, uwEndY - uwStartY + 1);
 	}
 }
 
@@ -781,7 +900,7 @@ void tileBufferInvalidateTile(
 	// }
 
 	// Add to queue
-	tileBufferQueueAdd(pManager, uwTileX, uwTileY);
+	tileBufferQueueAdd(pManager, uwTileX, uwTileY, 1);
 }
 
 UBYTE tileBufferIsTileOnBuffer(
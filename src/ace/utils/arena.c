@@ -0,0 +1,137 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <ace/utils/arena.h>
+#include <ace/managers/log.h>
+
+// On ACE_DEBUG builds, each allocation is laid out as follows:
+// [ULONG ulSize] [0xCAFEBABE] [ulSize bytes of data] [0xDEADBEEF] [padding]
+// so that the whole arena can be walked and the guards checked.
+#ifdef ACE_DEBUG
+#define ARENA_HEADER_SIZE (2 * sizeof(ULONG))
+#define ARENA_FOOTER_SIZE sizeof(ULONG)
+#else
+#define ARENA_HEADER_SIZE 0
+#define ARENA_FOOTER_SIZE 0
+#endif
+
+static inline ULONG arenaAlign(ULONG ulOffset) {
+	return (ulOffset + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+#ifdef ACE_DEBUG
+static void arenaCheckRange(
+	const tArena *pArena, ULONG ulFrom, UWORD uwLine, const char *szFile
+) {
+	ULONG ulOffset = ulFrom;
+	while(ulOffset < pArena->ulUsed) {
+		UBYTE *pAlloc = &pArena->pData[ulOffset + ARENA_HEADER_SIZE];
+		ULONG ulSize = *(ULONG*)&pArena->pData[ulOffset];
+		if(ulOffset + ARENA_HEADER_SIZE + ulSize + ARENA_FOOTER_SIZE > pArena->ulUsed) {
+			logWrite(
+				"[ARENA] ERR: Header at %p trashed, can't check further (%s:%u)\n",
+				&pArena->pData[ulOffset], szFile, uwLine
+			);
+			return;
+		}
+		UBYTE ubTrash = _memGetTrash(pAlloc, ulSize);
+		if(ubTrash & MEM_TRASH_LEFT) {
+			logWrite(
+				"[ARENA] ERR: Left mem trashed: %p, size %lu (%s:%u)\n",
+				pAlloc, ulSize, szFile, uwLine
+			);
+		}
+		if(ubTrash & MEM_TRASH_RIGHT) {
+			logWrite(
+				"[ARENA] ERR: Right mem trashed: %p, size %lu (%s:%u)\n",
+				pAlloc, ulSize, szFile, uwLine
+			);
+		}
+		ulOffset = arenaAlign(ulOffset + ARENA_HEADER_SIZE + ulSize + ARENA_FOOTER_SIZE);
+	}
+}
+
+void _arenaCheckIntegrity(const tArena *pArena, UWORD uwLine, const char *szFile) {
+	arenaCheckRange(pArena, 0, uwLine, szFile);
+}
+#endif // ACE_DEBUG
+
+tArena *arenaCreate(ULONG ulSize, ULONG ulMemFlags) {
+	logBlockBegin("arenaCreate(ulSize: %lu, ulMemFlags: %lu)", ulSize, ulMemFlags);
+	ulSize = arenaAlign(ulSize);
+	tArena *pArena = memAllocFast(sizeof(*pArena));
+	if(!pArena) {
+		logBlockEnd("arenaCreate()");
+		return 0;
+	}
+	pArena->pData = memAlloc(ulSize, ulMemFlags);
+	if(!pArena->pData) {
+		logWrite("ERR: Couldn't reserve arena memory\n");
+		memFree(pArena, sizeof(*pArena));
+		logBlockEnd("arenaCreate()");
+		return 0;
+	}
+	pArena->ulSize = ulSize;
+	pArena->ulUsed = 0;
+	pArena->ulPeak = 0;
+	pArena->ulMemFlags = ulMemFlags;
+	logBlockEnd("arenaCreate()");
+	return pArena;
+}
+
+void arenaDestroy(tArena *pArena) {
+	logBlockBegin("arenaDestroy(pArena: %p)", pArena);
+#ifdef ACE_DEBUG
+	arenaCheckRange(pArena, 0, __LINE__, __FILE__);
+#endif
+	logWrite("Peak usage: %lu/%lu\n", pArena->ulPeak, pArena->ulSize);
+	memFree(pArena->pData, pArena->ulSize);
+	memFree(pArena, sizeof(*pArena));
+	logBlockEnd("arenaDestroy()");
+}
+
+void *arenaAlloc(tArena *pArena, ULONG ulSize) {
+	ULONG ulEnd = arenaAlign(
+		pArena->ulUsed + ARENA_HEADER_SIZE + ulSize + ARENA_FOOTER_SIZE
+	);
+	if(ulEnd > pArena->ulSize || ulEnd < pArena->ulUsed) {
+		logWrite(
+			"ERR: Arena %p overflow: requested %lu bytes, used %lu/%lu\n",
+			pArena, ulSize, pArena->ulUsed, pArena->ulSize
+		);
+		return 0;
+	}
+	UBYTE *pAlloc = &pArena->pData[pArena->ulUsed + ARENA_HEADER_SIZE];
+#ifdef ACE_DEBUG
+	*(ULONG*)&pArena->pData[pArena->ulUsed] = ulSize;
+	_memWriteTrash(pAlloc, ulSize);
+#endif
+	pArena->ulUsed = ulEnd;
+	if(ulEnd > pArena->ulPeak) {
+		pArena->ulPeak = ulEnd;
+	}
+	return pAlloc;
+}
+
+ULONG arenaGetMark(const tArena *pArena) {
+	return pArena->ulUsed;
+}
+
+void arenaRewind(tArena *pArena, ULONG ulMark) {
+	if(ulMark > pArena->ulUsed) {
+		logWrite(
+			"ERR: Arena %p rewind mark %lu past used %lu\n",
+			pArena, ulMark, pArena->ulUsed
+		);
+		return;
+	}
+#ifdef ACE_DEBUG
+	arenaCheckRange(pArena, ulMark, __LINE__, __FILE__);
+#endif
+	pArena->ulUsed = ulMark;
+}
+
+void arenaReset(tArena *pArena) {
+	arenaRewind(pArena, 0);
+}
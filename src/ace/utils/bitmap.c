@@ -16,6 +16,31 @@
 
 /* Functions */
 
+static void bitmapOnRelocate(void *pOwner, UBYTE *pOld, UBYTE *pNew) {
+	tBitMap *pBitMap = pOwner;
+	LONG lDelta = pNew - pOld;
+	for(UBYTE i = 0; i < pBitMap->Depth; ++i) {
+		pBitMap->Planes[i] = (PLANEPTR)((UBYTE*)pBitMap->Planes[i] + lDelta);
+	}
+}
+
+static PLANEPTR bitmapAllocPlaneBlock(
+	tBitMap *pBitMap, ULONG ulSize, UBYTE ubFlags
+) {
+	if(ubFlags & BMF_RELOCATABLE) {
+		tChipHandle uwHandle = chipHeapAlloc(ulSize, bitmapOnRelocate, pBitMap);
+		if(!uwHandle) {
+			return 0;
+		}
+		pBitMap->Flags |= BMF_RELOCATABLE;
+		pBitMap->pad = uwHandle;
+		return (PLANEPTR)chipHeapGetAddr(uwHandle);
+	}
+	return (PLANEPTR) memAlloc(
+		ulSize, (ubFlags & BMF_FASTMEM) ? MEMF_ANY : MEMF_CHIP
+	);
+}
+
 tBitMap *bitmapCreate(
 	UWORD uwWidth, UWORD uwHeight, UBYTE ubDepth, UBYTE ubFlags
 ) {
@@ -50,15 +75,25 @@ tBitMap *bitmapCreate(
 	pBitMap->Flags = 0;
 	pBitMap->Depth = ubDepth;
 
+	if(ubFlags & BMF_RELOCATABLE) {
+		if(ubFlags & BMF_FASTMEM) {
+			logWrite("ERR: relocatable bitmap must be in CHIP memory\n");
+			goto fail;
+		}
+		if(!(ubFlags & BMF_INTERLEAVED)) {
+			// Relocation needs all bitplanes in single block
+			ubFlags |= BMF_CONTIGUOUS;
+		}
+	}
+
 	if(ubFlags & BMF_INTERLEAVED) {
 		pBitMap->Flags |= BMF_INTERLEAVED;
 		UWORD uwRealWidth;
 		uwRealWidth = pBitMap->BytesPerRow;
 		pBitMap->BytesPerRow *= ubDepth;
 
-		pBitMap->Planes[0] = (PLANEPTR) memAlloc(
-			pBitMap->BytesPerRow*uwHeight,
-			(ubFlags & BMF_FASTMEM) ? MEMF_ANY : MEMF_CHIP
+		pBitMap->Planes[0] = bitmapAllocPlaneBlock(
+			pBitMap, pBitMap->BytesPerRow*uwHeight, ubFlags
 		);
 		if(!pBitMap->Planes[0]) {
 			logWrite("ERR: Can't alloc interleaved bitplanes\n");
@@ -75,7 +110,9 @@ tBitMap *bitmapCreate(
 	else if(ubFlags & BMF_CONTIGUOUS) {
 		pBitMap->Flags |= BMF_CONTIGUOUS;
 		ULONG ulPlaneSize = pBitMap->BytesPerRow * uwHeight;
-		pBitMap->Planes[0] = (PLANEPTR) memAllocChip(ulPlaneSize * ubDepth);
+		pBitMap->Planes[0] = bitmapAllocPlaneBlock(
+			pBitMap, ulPlaneSize * ubDepth, ubFlags & ~BMF_FASTMEM
+		);
 		if(!pBitMap->Planes[0]) {
 				logWrite("ERR: Can't alloc contiguous bitplanes\n");
 				goto fail;
@@ -321,7 +358,10 @@ void bitmapDestroy(tBitMap *pBitMap) {
 		blitWait();
 #endif
 		systemUse();
-		if(bitmapIsInterleaved(pBitMap)) {
+		if(pBitMap->Flags & BMF_RELOCATABLE) {
+			chipHeapFree(pBitMap->pad);
+		}
+		else if(bitmapIsInterleaved(pBitMap)) {
 			memFree(pBitMap->Planes[0], pBitMap->BytesPerRow * pBitMap->Rows);
 		}
 		else if(pBitMap->Flags & BMF_CONTIGUOUS) {
@@ -348,6 +388,13 @@ UBYTE bitmapIsChip(const tBitMap *pBitMap) {
 	return memType(pBitMap->Planes[0]) == MEMF_CHIP;
 }
 
+tChipHandle bitmapGetChipHandle(const tBitMap *pBitMap) {
+	if(pBitMap->Flags & BMF_RELOCATABLE) {
+		return pBitMap->pad;
+	}
+	return 0;
+}
+
 void bitmapDump(const tBitMap *pBitMap) {
 	UBYTE i;
 
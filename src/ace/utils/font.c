@@ -10,11 +10,97 @@
 
 /* Globals */
 
+#define FONT_GLYPH_PAGE_SIZE 256
+#define FONT_CACHE_BUCKET_COUNT 32
+
+typedef struct _tFontCacheEntry {
+	struct _tFontCacheEntry *pPrev; ///< More recently used entry.
+	struct _tFontCacheEntry *pNext; ///< Less recently used entry.
+	struct _tFontCacheEntry *pNextInBucket;
+	const tFont *pFont;
+	ULONG ulHash;
+	ULONG ulBitmapSize;
+	UWORD uwTextLength;
+	tTextBitMap *pTextBitMap;
+	char szText[];
+} tFontCacheEntry;
+
+typedef struct _tFontCache {
+	UBYTE isCreated;
+	tFontCacheEntry *pFirst; ///< Most recently used entry.
+	tFontCacheEntry *pLast; ///< Least recently used entry.
+	tFontCacheEntry *pBuckets[FONT_CACHE_BUCKET_COUNT];
+	tFontCacheStats sStats;
+} tFontCache;
+
 static tBitMap s_sTmpDest; // Temp bitmap for drawing text on single bitplane
+static tFontCache s_sFontCache;
 
 /* Functions */
 
+const tFontGlyph *fontGetGlyph(const tFont *pFont, ULONG ulCodepoint) {
+	if(ulCodepoint < FONT_GLYPH_PAGE_SIZE) {
+		return &pFont->pGlyphs[pFont->pGlyphPage[ulCodepoint]];
+	}
+
+	// Glyphs past the page are sorted by codepoint
+	UWORD uwLo = pFont->uwPageGlyphCount;
+	UWORD uwHi = pFont->uwGlyphCount;
+	while(uwLo < uwHi) {
+		UWORD uwMid = (uwLo + uwHi) >> 1;
+		UWORD uwMidCodepoint = pFont->pGlyphs[uwMid].uwCodepoint;
+		if(uwMidCodepoint == ulCodepoint) {
+			return &pFont->pGlyphs[uwMid];
+		}
+		if(uwMidCodepoint < ulCodepoint) {
+			uwLo = uwMid + 1;
+		}
+		else {
+			uwHi = uwMid;
+		}
+	}
+	return &pFont->pGlyphs[pFont->uwGlyphCount];
+}
+
+ULONG fontUtf8Next(const char **pText) {
+	const UBYTE *p = (const UBYTE*)*pText;
+	ULONG ulCodepoint = *(p++);
+	if(ulCodepoint >= 0x80) {
+		UBYTE ubExtraBytes;
+		if((ulCodepoint & 0xE0) == 0xC0) {
+			ulCodepoint &= 0x1F;
+			ubExtraBytes = 1;
+		}
+		else if((ulCodepoint & 0xF0) == 0xE0) {
+			ulCodepoint &= 0x0F;
+			ubExtraBytes = 2;
+		}
+		else if((ulCodepoint & 0xF8) == 0xF0) {
+			ulCodepoint &= 0x07;
+			ubExtraBytes = 3;
+		}
+		else {
+			// Stray continuation byte or invalid lead byte
+			*pText = (const char*)p;
+			return FONT_CODEPOINT_INVALID;
+		}
+		while(ubExtraBytes--) {
+			if((*p & 0xC0) != 0x80) {
+				// Truncated sequence - don't skip over next char or terminator
+				*pText = (const char*)p;
+				return FONT_CODEPOINT_INVALID;
+			}
+			ulCodepoint = (ulCodepoint << 6) | (*(p++) & 0x3F);
+		}
+	}
+	*pText = (const char*)p;
+	return ulCodepoint;
+}
+
 UBYTE fontGlyphWidth(const tFont *pFont, char c) {
+	if(pFont->pGlyphs) {
+		return fontGetGlyph(pFont, (UBYTE)c)->ubWidth;
+	}
 	UBYTE ubIdx = (UBYTE)c;
 	return pFont->pCharOffsets[ubIdx + 1] - pFont->pCharOffsets[ubIdx];
 }
@@ -23,6 +109,95 @@ tFont *fontCreateFromPath(const char *szPath) {
 	return fontCreateFromFd(diskFileOpen(szPath, "rb"));
 }
 
+static UBYTE fontLoadPackedBitmap(tFont *pFont, tFile *pFontFile, UWORD uwRows) {
+	pFont->pRawData = bitmapCreate(pFont->uwWidth, uwRows, 1, 0);
+	if(!pFont->pRawData) {
+		return 0;
+	}
+#ifdef AMIGA
+	ULONG ulPlaneByteSize = ((pFont->uwWidth+15)/16) * 2 * uwRows;
+	fileRead(pFontFile, pFont->pRawData->Planes[0], ulPlaneByteSize);
+	return 1;
+#else
+	logWrite("ERR: Unimplemented\n");
+	return 0;
+#endif // AMIGA
+}
+
+/**
+ * @brief Reads version 1 font, in which all glyphs are in single row.
+ * Its header starts with non-zero bitmap width.
+ */
+static UBYTE fontLoadV1(tFont *pFont, tFile *pFontFile) {
+	fileRead(pFontFile, &pFont->uwHeight, sizeof(UWORD));
+	fileRead(pFontFile, &pFont->ubChars, sizeof(UBYTE));
+	logWrite(
+		"Addr: %p, data width: %upx, chars: %u, font height: %upx\n",
+		pFont, pFont->uwWidth, pFont->ubChars, pFont->uwHeight
+	);
+
+	pFont->pCharOffsets = memAllocFast(sizeof(UWORD) * pFont->ubChars);
+	if(!pFont->pCharOffsets) {
+		return 0;
+	}
+	fileRead(pFontFile, pFont->pCharOffsets, sizeof(UWORD) * pFont->ubChars);
+
+	return fontLoadPackedBitmap(pFont, pFontFile, pFont->uwHeight);
+}
+
+/**
+ * @brief Reads versioned font, for now only version 2 - atlas font.
+ * Its header starts with zero in place of v1 bitmap width, followed by
+ * version byte.
+ */
+static UBYTE fontLoadVersioned(tFont *pFont, tFile *pFontFile) {
+	UBYTE ubVersion;
+	fileRead(pFontFile, &ubVersion, sizeof(ubVersion));
+	if(ubVersion != 2) {
+		logWrite("ERR: Unsupported font version: %hhu\n", ubVersion);
+		return 0;
+	}
+
+	UWORD uwAtlasHeight;
+	fileRead(pFontFile, &pFont->uwHeight, sizeof(UWORD));
+	fileRead(pFontFile, &pFont->uwGlyphCount, sizeof(UWORD));
+	fileRead(pFontFile, &pFont->uwWidth, sizeof(UWORD));
+	fileRead(pFontFile, &uwAtlasHeight, sizeof(UWORD));
+	logWrite(
+		"Addr: %p, atlas: %hux%hupx, glyphs: %hu, font height: %hupx\n",
+		pFont, pFont->uwWidth, uwAtlasHeight, pFont->uwGlyphCount, pFont->uwHeight
+	);
+
+	// Extra zeroed glyph at the end is used for all missing chars, so that
+	// lookup doesn't need any checks.
+	pFont->pGlyphs = memAllocFastClear(
+		sizeof(tFontGlyph) * (pFont->uwGlyphCount + 1)
+	);
+	pFont->pGlyphPage = memAllocFast(sizeof(UWORD) * FONT_GLYPH_PAGE_SIZE);
+	if(!pFont->pGlyphs || !pFont->pGlyphPage) {
+		return 0;
+	}
+	fileRead(
+		pFontFile, pFont->pGlyphs, sizeof(tFontGlyph) * pFont->uwGlyphCount
+	);
+
+	for(UWORD i = 0; i < FONT_GLYPH_PAGE_SIZE; ++i) {
+		pFont->pGlyphPage[i] = pFont->uwGlyphCount;
+	}
+	// Glyphs are sorted, so the ones fitting in page are at the beginning
+	UWORD uwPageGlyphCount = 0;
+	while(
+		uwPageGlyphCount < pFont->uwGlyphCount &&
+		pFont->pGlyphs[uwPageGlyphCount].uwCodepoint < FONT_GLYPH_PAGE_SIZE
+	) {
+		pFont->pGlyphPage[pFont->pGlyphs[uwPageGlyphCount].uwCodepoint] = uwPageGlyphCount;
+		++uwPageGlyphCount;
+	}
+	pFont->uwPageGlyphCount = uwPageGlyphCount;
+
+	return fontLoadPackedBitmap(pFont, pFontFile, uwAtlasHeight);
+}
+
 tFont *fontCreateFromFd(tFile *pFontFile) {
 
 	logBlockBegin("fontCreateFromFd(pFontFile: %p)", pFontFile);
@@ -33,7 +208,7 @@ tFont *fontCreateFromFd(tFile *pFontFile) {
 		return 0;
 	}
 
-	tFont *pFont = (tFont *) memAllocFast(sizeof(tFont));
+	tFont *pFont = (tFont *) memAllocFastClear(sizeof(tFont));
 	if (!pFont) {
 		fileClose(pFontFile);
 		logWrite("ERR: Couldn't alloc mem\n");
@@ -41,30 +216,22 @@ tFont *fontCreateFromFd(tFile *pFontFile) {
 		return 0;
 	}
 
+	UBYTE isLoaded;
 	fileRead(pFontFile, &pFont->uwWidth, sizeof(UWORD));
-	fileRead(pFontFile, &pFont->uwHeight, sizeof(UWORD));
-	fileRead(pFontFile, &pFont->ubChars, sizeof(UBYTE));
-	logWrite(
-		"Addr: %p, data width: %upx, chars: %u, font height: %upx\n",
-		pFont, pFont->uwWidth, pFont->ubChars, pFont->uwHeight
-	);
-
-	pFont->pCharOffsets = memAllocFast(sizeof(UWORD) * pFont->ubChars);
-	fileRead(pFontFile, pFont->pCharOffsets, sizeof(UWORD) * pFont->ubChars);
-
-	pFont->pRawData = bitmapCreate(pFont->uwWidth, pFont->uwHeight, 1, 0);
-#ifdef AMIGA
-	UWORD uwPlaneByteSize = ((pFont->uwWidth+15)/16) * 2 * pFont->uwHeight;
-	fileRead(pFontFile, pFont->pRawData->Planes[0], uwPlaneByteSize);
-#else
-	logWrite("ERR: Unimplemented\n");
-	memFree(pFont, sizeof(tFont));
+	if(pFont->uwWidth) {
+		isLoaded = fontLoadV1(pFont, pFontFile);
+	}
+	else {
+		isLoaded = fontLoadVersioned(pFont, pFontFile);
+	}
 	fileClose(pFontFile);
-	logBlockEnd("fontCreateFromFd()");
-	return 0;
-#endif // AMIGA
 
-	fileClose(pFontFile);
+	if(!isLoaded) {
+		logWrite("ERR: Couldn't load font\n");
+		fontDestroy(pFont);
+		pFont = 0;
+	}
+
 	logBlockEnd("fontCreateFromFd()");
 	return pFont;
 }
@@ -74,13 +241,185 @@ void fontDestroy(tFont *pFont) {
 	logBlockBegin("fontDestroy(pFont: %p)", pFont);
 	if (pFont) {
 		bitmapDestroy(pFont->pRawData);
-		memFree(pFont->pCharOffsets, sizeof(UWORD) * pFont->ubChars);
+		if(pFont->pCharOffsets) {
+			memFree(pFont->pCharOffsets, sizeof(UWORD) * pFont->ubChars);
+		}
+		if(pFont->pGlyphs) {
+			memFree(pFont->pGlyphs, sizeof(tFontGlyph) * (pFont->uwGlyphCount + 1));
+		}
+		if(pFont->pGlyphPage) {
+			memFree(pFont->pGlyphPage, sizeof(UWORD) * FONT_GLYPH_PAGE_SIZE);
+		}
+		fontDestroyShiftCache(pFont);
+		fontCacheInvalidateFont(pFont);
 		memFree(pFont, sizeof(tFont));
 	}
 	logBlockEnd("fontDestroy()");
 	systemUnuse();
 }
 
+/**
+ * @brief Reads glyph row from 1bpp bitmap, left-aligning it to bit 31.
+ */
+static ULONG fontReadGlyphRow(
+	const tBitMap *pBitMap, UWORD uwX, UWORD uwY, UBYTE ubWidth
+) {
+	const UWORD *pRow = (const UWORD*)(
+		pBitMap->Planes[0] + uwY * pBitMap->BytesPerRow
+	) + (uwX >> 4);
+	UBYTE ubShift = uwX & 15;
+	ULONG ulRow = (ULONG)pRow[0] << 16;
+	if(ubShift + ubWidth > 16) {
+		ulRow |= pRow[1];
+	}
+	return (ulRow << ubShift) & ~(0xFFFFFFFF >> ubWidth);
+}
+
+UBYTE fontCreateShiftCache(tFont *pFont) {
+	systemUse();
+	logBlockBegin("fontCreateShiftCache(pFont: %p)", pFont);
+	fontDestroyShiftCache(pFont);
+
+	tFontShiftCache *pCache = memAllocFastClear(sizeof(*pCache));
+	if(!pCache) {
+		goto fail;
+	}
+	pFont->pShiftCache = pCache;
+
+	// Last v1 offset only marks end of last glyph, atlas fonts have extra
+	// empty glyph used for missing chars.
+	pCache->uwGlyphCount = (
+		pFont->pGlyphs ? pFont->uwGlyphCount + 1 : pFont->ubChars - 1
+	);
+	pCache->pGlyphOffsets = memAllocFast(sizeof(ULONG) * pCache->uwGlyphCount);
+	if(!pCache->pGlyphOffsets) {
+		goto fail;
+	}
+
+	// Count rows of non-empty glyphs, all shifts included
+	for(UWORD i = 0; i < pCache->uwGlyphCount; ++i) {
+		UBYTE ubWidth, ubHeight;
+		if(pFont->pGlyphs) {
+			ubWidth = pFont->pGlyphs[i].ubWidth;
+			ubHeight = pFont->pGlyphs[i].ubHeight;
+		}
+		else {
+			ubWidth = fontGlyphWidth(pFont, i);
+			ubHeight = pFont->uwHeight;
+		}
+		if(ubWidth > FONT_SHIFT_CACHE_MAX_WIDTH) {
+			logWrite(
+				"ERR: Glyph %hu is %hhu px wide, max supported is %d\n",
+				i, ubWidth, FONT_SHIFT_CACHE_MAX_WIDTH
+			);
+			goto fail;
+		}
+		pCache->pGlyphOffsets[i] = pCache->ulRowCount;
+		if(ubWidth) {
+			pCache->ulRowCount += 16 * ubHeight;
+		}
+	}
+
+	pCache->pRows = memAllocFast(sizeof(ULONG) * pCache->ulRowCount);
+	if(!pCache->pRows) {
+		goto fail;
+	}
+
+	for(UWORD i = 0; i < pCache->uwGlyphCount; ++i) {
+		UWORD uwX, uwY;
+		UBYTE ubWidth, ubHeight;
+		if(pFont->pGlyphs) {
+			uwX = pFont->pGlyphs[i].uwX;
+			uwY = pFont->pGlyphs[i].uwY;
+			ubWidth = pFont->pGlyphs[i].ubWidth;
+			ubHeight = pFont->pGlyphs[i].ubHeight;
+		}
+		else {
+			uwX = pFont->pCharOffsets[i];
+			uwY = 0;
+			ubWidth = fontGlyphWidth(pFont, i);
+			ubHeight = pFont->uwHeight;
+		}
+		if(!ubWidth) {
+			continue;
+		}
+		ULONG *pGlyphRows = &pCache->pRows[pCache->pGlyphOffsets[i]];
+		for(UBYTE ubRow = 0; ubRow < ubHeight; ++ubRow) {
+			ULONG ulRow = fontReadGlyphRow(
+				pFont->pRawData, uwX, uwY + ubRow, ubWidth
+			);
+			for(UBYTE ubShift = 0; ubShift < 16; ++ubShift) {
+				pGlyphRows[ubShift * ubHeight + ubRow] = ulRow >> ubShift;
+			}
+		}
+	}
+
+	logWrite(
+		"Cached %hu glyphs, %lu bytes\n",
+		pCache->uwGlyphCount, sizeof(ULONG) * pCache->ulRowCount
+	);
+	logBlockEnd("fontCreateShiftCache()");
+	systemUnuse();
+	return 1;
+
+fail:
+	logWrite("ERR: Couldn't create shift cache\n");
+	fontDestroyShiftCache(pFont);
+	logBlockEnd("fontCreateShiftCache()");
+	systemUnuse();
+	return 0;
+}
+
+void fontDestroyShiftCache(tFont *pFont) {
+	tFontShiftCache *pCache = pFont->pShiftCache;
+	if(!pCache) {
+		return;
+	}
+	systemUse();
+	if(pCache->pRows) {
+		memFree(pCache->pRows, sizeof(ULONG) * pCache->ulRowCount);
+	}
+	if(pCache->pGlyphOffsets) {
+		memFree(pCache->pGlyphOffsets, sizeof(ULONG) * pCache->uwGlyphCount);
+	}
+	memFree(pCache, sizeof(*pCache));
+	pFont->pShiftCache = 0;
+	systemUnuse();
+}
+
+/**
+ * @brief ORs pre-shifted glyph rows onto 1bpp bitmap using CPU.
+ * Narrow glyphs which don't cross word boundary at given position are written
+ * word by word, others as longwords spanning two words.
+ */
+static void fontDrawCachedGlyph(
+	const tFontShiftCache *pCache, tBitMap *pBitMap, UWORD uwGlyphIdx,
+	UWORD uwX, UWORD uwY, UBYTE ubWidth, UBYTE ubHeight
+) {
+	if(!ubWidth) {
+		// Missing glyph has no rows in cache
+		return;
+	}
+	UBYTE ubShift = uwX & 15;
+	const ULONG *pSrc = &pCache->pRows[
+		pCache->pGlyphOffsets[uwGlyphIdx] + ubShift * ubHeight
+	];
+	UWORD uwStride = pBitMap->BytesPerRow;
+	UBYTE *pDst = pBitMap->Planes[0] + uwY * uwStride + ((uwX >> 4) << 1);
+	if(ubShift + ubWidth <= 16) {
+		for(UBYTE ubRow = ubHeight; ubRow--;) {
+			*(UWORD*)pDst |= *(pSrc++) >> 16;
+			pDst += uwStride;
+		}
+	}
+	else {
+		for(UBYTE ubRow = ubHeight; ubRow--;) {
+			*(ULONG*)pDst |= *(pSrc++);
+			pDst += uwStride;
+		}
+	}
+}
+
 tTextBitMap *fontCreateTextBitMap(UWORD uwWidth, UWORD uwHeight) {
 	systemUse();
 	logBlockBegin(
@@ -129,7 +468,42 @@ UBYTE fontTextFitsInTextBitmap(
 	return 0;
 }
 
+/**
+ * @brief Measures text drawn with atlas font, decoding it as UTF-8.
+ */
+static tUwCoordYX fontMeasureTextUtf8(const tFont *pFont, const char *szText) {
+	UWORD uwWidth = 0, uwHeight = 0, uwMaxWidth = 0;
+	const char *p = szText;
+	while(*p) {
+		ULONG ulCodepoint = fontUtf8Next(&p);
+		if(ulCodepoint == '\n') {
+			uwHeight += pFont->uwHeight;
+			uwWidth = 0;
+		}
+		else {
+			UBYTE ubGlyphWidth = fontGetGlyph(pFont, ulCodepoint)->ubWidth;
+#if defined(ACE_DEBUG)
+			if(ubGlyphWidth == 0) {
+				logWrite(
+					"ERR: Missing glyph for codepoint U+%04lX, pos %ld in string '%s'\n",
+					ulCodepoint, p - szText, szText
+				);
+			}
+#endif
+			uwWidth += ubGlyphWidth + 1;
+			uwMaxWidth = MAX(uwMaxWidth, uwWidth);
+		}
+	}
+	uwHeight += pFont->uwHeight; // Add height of last line
+	tUwCoordYX sBounds = {.uwX = uwMaxWidth, .uwY = uwHeight};
+	return sBounds;
+}
+
 tUwCoordYX fontMeasureText(const tFont *pFont, const char *szText) {
+	if(pFont->pGlyphs) {
+		return fontMeasureTextUtf8(pFont, szText);
+	}
+
 	UWORD uwWidth = 0, uwHeight = 0, uwMaxWidth = 0;
 	for (const char *p = szText; *p; ++p) {
 		if(*p == '\n') {
@@ -170,13 +544,74 @@ tTextBitMap *fontCreateTextBitMapFromStr(const tFont *pFont, const char *szText)
 	return pTextBitMap;
 }
 
+/**
+ * @brief Draws text with atlas font, decoding it as UTF-8.
+ */
+static tUwCoordYX fontDrawStr1bppUtf8(
+	const tFont *pFont, tBitMap *pBitMap, UWORD uwStartX, UWORD uwStartY,
+	const char *szText
+) {
+	UWORD uwX = uwStartX;
+	UWORD uwY = uwStartY;
+	UWORD uwBoundX = 0;
+	if(pFont->pShiftCache) {
+		// Destination may still be cleared by the blitter
+		blitWait();
+	}
+	const char *p = szText;
+	while(*p) {
+		ULONG ulCodepoint = fontUtf8Next(&p);
+		if(ulCodepoint == '\n') {
+			uwBoundX = MAX(uwBoundX, uwX);
+			uwX = uwStartX;
+			uwY += pFont->uwHeight;
+		}
+		else {
+			const tFontGlyph *pGlyph = fontGetGlyph(pFont, ulCodepoint);
+#if defined(ACE_DEBUG)
+			if(pGlyph->ubWidth == 0) {
+				logWrite(
+					"ERR: Missing glyph for codepoint U+%04lX, pos %ld in string '%s'\n",
+					ulCodepoint, p - szText, szText
+				);
+				continue;
+			}
+#endif
+			if(pFont->pShiftCache) {
+				fontDrawCachedGlyph(
+					pFont->pShiftCache, pBitMap, pGlyph - pFont->pGlyphs,
+					uwX, uwY + pGlyph->ubOffsY, pGlyph->ubWidth, pGlyph->ubHeight
+				);
+			}
+			else if(pGlyph->ubHeight) {
+				blitCopy(
+					pFont->pRawData, pGlyph->uwX, pGlyph->uwY, pBitMap,
+					uwX, uwY + pGlyph->ubOffsY, pGlyph->ubWidth, pGlyph->ubHeight,
+					MINTERM_COOKIE
+				);
+			}
+			uwX += pGlyph->ubWidth + 1;
+		}
+	}
+	tUwCoordYX sBounds = {.uwX = MAX(uwBoundX, uwX), .uwY = uwY + pFont->uwHeight};
+	return sBounds;
+}
+
 tUwCoordYX fontDrawStr1bpp(
 	const tFont *pFont, tBitMap *pBitMap, UWORD uwStartX, UWORD uwStartY,
 	const char *szText
 ) {
+	if(pFont->pGlyphs) {
+		return fontDrawStr1bppUtf8(pFont, pBitMap, uwStartX, uwStartY, szText);
+	}
+
 	UWORD uwX = uwStartX;
 	UWORD uwY = uwStartY;
 	UWORD uwBoundX = 0;
+	if(pFont->pShiftCache) {
+		// Destination may still be cleared by the blitter
+		blitWait();
+	}
 	for(const char *p = szText; *p; ++p) {
 		if(*p == '\n') {
 			uwBoundX = MAX(uwBoundX, uwX);
@@ -194,10 +629,18 @@ tUwCoordYX fontDrawStr1bpp(
 				continue;
 			}
 #endif
-			blitCopy(
-				pFont->pRawData, pFont->pCharOffsets[(UBYTE)*p], 0, pBitMap, uwX, uwY,
-				ubGlyphWidth, pFont->uwHeight, MINTERM_COOKIE
-			);
+			if(pFont->pShiftCache) {
+				fontDrawCachedGlyph(
+					pFont->pShiftCache, pBitMap, (UBYTE)*p, uwX, uwY,
+					ubGlyphWidth, pFont->uwHeight
+				);
+			}
+			else {
+				blitCopy(
+					pFont->pRawData, pFont->pCharOffsets[(UBYTE)*p], 0, pBitMap, uwX, uwY,
+					ubGlyphWidth, pFont->uwHeight, MINTERM_COOKIE
+				);
+			}
 			uwX += ubGlyphWidth + 1;
 		}
 	}
@@ -319,9 +762,189 @@ void fontDrawStr(
 	const tFont *pFont, tBitMap *pDest, UWORD uwX, UWORD uwY,
 	const char *szText, UBYTE ubColor, UBYTE ubFlags, tTextBitMap *pTextBitMap
 ) {
+	if(ubFlags & FONT_CACHED) {
+		tTextBitMap *pCachedTextBitMap = fontCacheGet(pFont, szText);
+		if(pCachedTextBitMap) {
+			fontDrawTextBitMap(pDest, pCachedTextBitMap, uwX, uwY, ubColor, ubFlags);
+			return;
+		}
+	}
 	if(!pTextBitMap) {
+		// Cache miss: empty text, text over the budget or out of memory
 		logWrite("ERR: pTextBitMap must be non-null\n");
+		return;
 	}
 	fontFillTextBitMap(pFont, pTextBitMap, szText);
 	fontDrawTextBitMap(pDest, pTextBitMap, uwX, uwY, ubColor, ubFlags);
 }
+
+/**
+ * @brief FNV-1a hash of text, mixed with font address so that same texts
+ * of different fonts land in different buckets.
+ */
+static ULONG fontCacheHash(const tFont *pFont, const char *szText, UWORD *pLength) {
+	ULONG ulHash = 2166136261u ^ (ULONG)pFont;
+	const char *p;
+	for(p = szText; *p; ++p) {
+		ulHash = (ulHash ^ (UBYTE)*p) * 16777619u;
+	}
+	*pLength = p - szText;
+	return ulHash;
+}
+
+static void fontCacheUnlink(tFontCacheEntry *pEntry) {
+	if(pEntry->pPrev) {
+		pEntry->pPrev->pNext = pEntry->pNext;
+	}
+	else {
+		s_sFontCache.pFirst = pEntry->pNext;
+	}
+	if(pEntry->pNext) {
+		pEntry->pNext->pPrev = pEntry->pPrev;
+	}
+	else {
+		s_sFontCache.pLast = pEntry->pPrev;
+	}
+}
+
+static void fontCachePushFront(tFontCacheEntry *pEntry) {
+	pEntry->pPrev = 0;
+	pEntry->pNext = s_sFontCache.pFirst;
+	if(s_sFontCache.pFirst) {
+		s_sFontCache.pFirst->pPrev = pEntry;
+	}
+	else {
+		s_sFontCache.pLast = pEntry;
+	}
+	s_sFontCache.pFirst = pEntry;
+}
+
+static void fontCacheRemove(tFontCacheEntry *pEntry) {
+	tFontCacheEntry **pLink = &s_sFontCache.pBuckets[
+		pEntry->ulHash % FONT_CACHE_BUCKET_COUNT
+	];
+	while(*pLink != pEntry) {
+		pLink = &(*pLink)->pNextInBucket;
+	}
+	*pLink = pEntry->pNextInBucket;
+	fontCacheUnlink(pEntry);
+
+	s_sFontCache.sStats.ulUsedBytes -= pEntry->ulBitmapSize;
+	--s_sFontCache.sStats.uwEntryCount;
+	fontDestroyTextBitMap(pEntry->pTextBitMap);
+	memFree(pEntry, sizeof(*pEntry) + pEntry->uwTextLength + 1);
+}
+
+void fontCacheCreate(ULONG ulBudget) {
+	logBlockBegin("fontCacheCreate(ulBudget: %lu)", ulBudget);
+	if(s_sFontCache.isCreated) {
+		fontCacheDestroy();
+	}
+	memset(&s_sFontCache, 0, sizeof(s_sFontCache));
+	s_sFontCache.sStats.ulBudget = ulBudget;
+	s_sFontCache.isCreated = 1;
+	logBlockEnd("fontCacheCreate()");
+}
+
+void fontCacheDestroy(void) {
+	logBlockBegin("fontCacheDestroy()");
+	logWrite(
+		"Hits: %lu, misses: %lu, evictions: %lu\n", s_sFontCache.sStats.ulHits,
+		s_sFontCache.sStats.ulMisses, s_sFontCache.sStats.ulEvictions
+	);
+	while(s_sFontCache.pFirst) {
+		fontCacheRemove(s_sFontCache.pFirst);
+	}
+	s_sFontCache.isCreated = 0;
+	logBlockEnd("fontCacheDestroy()");
+}
+
+tTextBitMap *fontCacheGet(const tFont *pFont, const char *szText) {
+	if(!s_sFontCache.isCreated) {
+		return 0;
+	}
+
+	UWORD uwLength;
+	ULONG ulHash = fontCacheHash(pFont, szText, &uwLength);
+	for(
+		tFontCacheEntry *pEntry = s_sFontCache.pBuckets[ulHash % FONT_CACHE_BUCKET_COUNT];
+		pEntry; pEntry = pEntry->pNextInBucket
+	) {
+		if(
+			pEntry->ulHash == ulHash && pEntry->pFont == pFont &&
+			pEntry->uwTextLength == uwLength && !memcmp(pEntry->szText, szText, uwLength)
+		) {
+			++s_sFontCache.sStats.ulHits;
+			if(pEntry != s_sFontCache.pFirst) {
+				fontCacheUnlink(pEntry);
+				fontCachePushFront(pEntry);
+			}
+			return pEntry->pTextBitMap;
+		}
+	}
+
+	++s_sFontCache.sStats.ulMisses;
+	tUwCoordYX sSize = fontMeasureText(pFont, szText);
+	// Padded the same way as in fontCreateTextBitMapFromStr()
+	UWORD uwBitmapWidth = (blockCountCeil(sSize.uwX, 16) + 1) * 16;
+	ULONG ulBitmapSize = (uwBitmapWidth / 8) * sSize.uwY;
+	if(!uwLength || ulBitmapSize > s_sFontCache.sStats.ulBudget) {
+		return 0;
+	}
+
+	while(
+		s_sFontCache.sStats.ulUsedBytes + ulBitmapSize > s_sFontCache.sStats.ulBudget
+	) {
+		fontCacheRemove(s_sFontCache.pLast);
+		++s_sFontCache.sStats.ulEvictions;
+	}
+
+	systemUse();
+	tFontCacheEntry *pEntry = memAllocFast(sizeof(*pEntry) + uwLength + 1);
+	systemUnuse();
+	if(!pEntry) {
+		return 0;
+	}
+	pEntry->pTextBitMap = fontCreateTextBitMap(uwBitmapWidth, sSize.uwY);
+	if(!pEntry->pTextBitMap) {
+		systemUse();
+		memFree(pEntry, sizeof(*pEntry) + uwLength + 1);
+		systemUnuse();
+		return 0;
+	}
+	fontFillTextBitMap(pFont, pEntry->pTextBitMap, szText);
+
+	pEntry->pFont = pFont;
+	pEntry->ulHash = ulHash;
+	pEntry->ulBitmapSize = ulBitmapSize;
+	pEntry->uwTextLength = uwLength;
+	memcpy(pEntry->szText, szText, uwLength + 1);
+	UBYTE ubBucket = ulHash % FONT_CACHE_BUCKET_COUNT;
+	pEntry->pNextInBucket = s_sFontCache.pBuckets[ubBucket];
+	s_sFontCache.pBuckets[ubBucket] = pEntry;
+	fontCachePushFront(pEntry);
+	s_sFontCache.sStats.ulUsedBytes += ulBitmapSize;
+	++s_sFontCache.sStats.uwEntryCount;
+	return pEntry->pTextBitMap;
+}
+
+void fontCacheInvalidateFont(const tFont *pFont) {
+	tFontCacheEntry *pEntry = s_sFontCache.pFirst;
+	while(pEntry) {
+		tFontCacheEntry *pNext = pEntry->pNext;
+		if(pEntry->pFont == pFont) {
+			fontCacheRemove(pEntry);
+		}
+		pEntry = pNext;
+	}
+}
+
+const tFontCacheStats *fontCacheGetStats(void) {
+	return &s_sFontCache.sStats;
+}
+
+void fontCacheResetStats(void) {
+	s_sFontCache.sStats.ulHits = 0;
+	s_sFontCache.sStats.ulMisses = 0;
+	s_sFontCache.sStats.ulEvictions = 0;
+}
@@ -0,0 +1,164 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <ace/utils/pool.h>
+#include <ace/managers/log.h>
+
+// On ACE_DEBUG builds, each block is laid out as follows:
+// [ULONG isTaken] [0xCAFEBABE] [ulBlockSize bytes of data] [0xDEADBEEF] [padding]
+// Free blocks store pointer to next free one in first bytes of their data.
+#ifdef ACE_DEBUG
+#define POOL_HEADER_SIZE (2 * sizeof(ULONG))
+#define POOL_FOOTER_SIZE sizeof(ULONG)
+#else
+#define POOL_HEADER_SIZE 0
+#define POOL_FOOTER_SIZE 0
+#endif
+
+#define POOL_ALIGNMENT 8
+
+static inline UBYTE *poolGetBlock(const tPool *pPool, UWORD uwIdx) {
+	return &pPool->pData[uwIdx * pPool->ulStride + POOL_HEADER_SIZE];
+}
+
+#ifdef ACE_DEBUG
+static inline ULONG *poolGetTakenFlag(UBYTE *pBlock) {
+	return (ULONG*)(pBlock - POOL_HEADER_SIZE);
+}
+
+static void poolCheckBlock(
+	const tPool *pPool, const UBYTE *pBlock, UWORD uwLine, const char *szFile
+) {
+	UBYTE ubTrash = _memGetTrash(pBlock, pPool->ulBlockSize);
+	if(ubTrash & MEM_TRASH_LEFT) {
+		logWrite(
+			"[POOL] ERR: Left mem trashed: %p (%s:%u)\n", pBlock, szFile, uwLine
+		);
+	}
+	if(ubTrash & MEM_TRASH_RIGHT) {
+		logWrite(
+			"[POOL] ERR: Right mem trashed: %p (%s:%u)\n", pBlock, szFile, uwLine
+		);
+	}
+}
+
+void _poolCheckIntegrity(const tPool *pPool, UWORD uwLine, const char *szFile) {
+	for(UWORD i = 0; i < pPool->uwBlockCount; ++i) {
+		poolCheckBlock(pPool, poolGetBlock(pPool, i), uwLine, szFile);
+	}
+}
+#endif // ACE_DEBUG
+
+static void poolLinkAll(tPool *pPool) {
+	// Link all blocks in ascending order, so that allocs are sequential
+	void *pNext = 0;
+	for(UWORD i = pPool->uwBlockCount; i--;) {
+		UBYTE *pBlock = poolGetBlock(pPool, i);
+#ifdef ACE_DEBUG
+		*poolGetTakenFlag(pBlock) = 0;
+		_memWriteTrash(pBlock, pPool->ulBlockSize);
+#endif
+		*(void**)pBlock = pNext;
+		pNext = pBlock;
+	}
+	pPool->pFreeHead = pNext;
+	pPool->uwFreeCount = pPool->uwBlockCount;
+}
+
+tPool *poolCreate(ULONG ulBlockSize, UWORD uwBlockCount, ULONG ulMemFlags) {
+	logBlockBegin(
+		"poolCreate(ulBlockSize: %lu, uwBlockCount: %hu, ulMemFlags: %lu)",
+		ulBlockSize, uwBlockCount, ulMemFlags
+	);
+	if(!ulBlockSize || !uwBlockCount) {
+		logWrite("ERR: Pool needs non-zero block size and count\n");
+		logBlockEnd("poolCreate()");
+		return 0;
+	}
+
+	tPool *pPool = memAllocFast(sizeof(*pPool));
+	if(!pPool) {
+		logBlockEnd("poolCreate()");
+		return 0;
+	}
+
+	// Each free block must fit the pointer to next one
+	if(ulBlockSize < sizeof(void*)) {
+		ulBlockSize = sizeof(void*);
+	}
+	pPool->ulBlockSize = ulBlockSize;
+	pPool->ulStride = (
+		POOL_HEADER_SIZE + ulBlockSize + POOL_FOOTER_SIZE + POOL_ALIGNMENT - 1
+	) & ~(POOL_ALIGNMENT - 1);
+	pPool->uwBlockCount = uwBlockCount;
+	pPool->ulMemFlags = ulMemFlags;
+	pPool->pData = memAlloc(pPool->ulStride * uwBlockCount, ulMemFlags);
+	if(!pPool->pData) {
+		logWrite("ERR: Couldn't reserve pool memory\n");
+		memFree(pPool, sizeof(*pPool));
+		logBlockEnd("poolCreate()");
+		return 0;
+	}
+
+	poolLinkAll(pPool);
+	pPool->uwFreeMin = uwBlockCount;
+	logBlockEnd("poolCreate()");
+	return pPool;
+}
+
+void poolDestroy(tPool *pPool) {
+	logBlockBegin("poolDestroy(pPool: %p)", pPool);
+	poolCheckIntegrity(pPool);
+	logWrite(
+		"Peak usage: %hu/%hu blocks\n",
+		pPool->uwBlockCount - pPool->uwFreeMin, pPool->uwBlockCount
+	);
+	memFree(pPool->pData, pPool->ulStride * pPool->uwBlockCount);
+	memFree(pPool, sizeof(*pPool));
+	logBlockEnd("poolDestroy()");
+}
+
+void *poolAlloc(tPool *pPool) {
+	void **pBlock = pPool->pFreeHead;
+	if(!pBlock) {
+		logWrite(
+			"ERR: Pool %p exhausted, all %hu blocks taken\n",
+			pPool, pPool->uwBlockCount
+		);
+		return 0;
+	}
+	pPool->pFreeHead = *pBlock;
+	if(--pPool->uwFreeCount < pPool->uwFreeMin) {
+		pPool->uwFreeMin = pPool->uwFreeCount;
+	}
+#ifdef ACE_DEBUG
+	*poolGetTakenFlag((UBYTE*)pBlock) = 1;
+#endif
+	return pBlock;
+}
+
+void poolFree(tPool *pPool, void *pBlock) {
+#ifdef ACE_DEBUG
+	ULONG ulOffs = (UBYTE*)pBlock - poolGetBlock(pPool, 0);
+	if(ulOffs >= pPool->ulStride * pPool->uwBlockCount || ulOffs % pPool->ulStride) {
+		logWrite("ERR: Block %p doesn't belong to pool %p\n", pBlock, pPool);
+		return;
+	}
+	ULONG *pTaken = poolGetTakenFlag(pBlock);
+	if(!*pTaken) {
+		logWrite("ERR: Block %p of pool %p is already free\n", pBlock, pPool);
+		return;
+	}
+	*pTaken = 0;
+	poolCheckBlock(pPool, pBlock, __LINE__, __FILE__);
+#endif
+	*(void**)pBlock = pPool->pFreeHead;
+	pPool->pFreeHead = pBlock;
+	++pPool->uwFreeCount;
+}
+
+void poolReset(tPool *pPool) {
+	poolCheckIntegrity(pPool);
+	poolLinkAll(pPool);
+}
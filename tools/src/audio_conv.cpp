@@ -3,17 +3,38 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include <optional>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <set>
 #include "common/logging.h"
+#include "common/parse.h"
 #include "common/fs.h"
 #include "common/sfx.h"
 #include "common/wav.h"
 #include "common/math.h"
 
+static constexpr std::uint32_t s_ulPaulaClockPal = 3546895;
+static constexpr std::uint32_t s_ulPaulaClockNtsc = 3579545;
+
 void printUsage(const std::string &szAppName) {
 	using fmt::print;
-	print("Usage:\n\t{} inPath [extraOpts]\n\n", szAppName);
+	print("Usage:\n\t{} inPath [extraOpts]\n", szAppName);
+	print("\t{} -jobs listPath [-j N] [extraOpts]\n\n", szAppName);
 	print("Required arguments:\n");
 	print("\tinPath      Path to supported file format\n");
+	print("Batch mode:\n");
+	print("\t-jobs path  Convert all files listed in given text file, one per line, in parallel\n");
+	print("\t            Each line is 'inPath [extraOpts]', empty lines and ones starting with # are skipped\n");
+	print("\t            Extra options passed on command line apply to all files, options in list override them\n");
+	print("\t            Output paths must be unique, so -o can only be given in list\n");
+	print("\t-j N        Convert up to N files at once. Default: CPU thread count\n");
 	print("Extra options:\n");
 	print("\t-o outPath  Specify output file path. If ommited, it will perform default conversion\n");
 	print("\t-d N        Specify amplitude division. Useful for some audio-mixing libraries\n");
@@ -23,160 +44,216 @@ void printUsage(const std::string &szAppName) {
 	print("\t-fpt        Enforce ptplayer-friendly mode: adds empty sample at the beginning, if missing\n");
 	print("\t-fpad N     Force given byte-padding\n");
 	print("\t-sa N       Split sample after every given number of bytes, or kbytes if value ends with k\n");
+	print("\t-rate N     Resample to given rate, in Hz\n");
+	print("\t-period N   Resample to rate matching given Paula period, e.g. 428 for ProTracker's C-2\n");
+	print("\t-ntsc       Use NTSC clock for -period instead of PAL one\n");
+	print("\t-dither T   Dither used when reducing to 8 bits: none (default), tpdf or shaped\n");
+	print("\t-cmp        Write compressed .sfx v2 using 4-bit Fibonacci delta codes. Halves file size, smears sharp transients\n");
 	print("Default conversions:\n");
 	print("\t.wav -> .sfx\n");
 	print("\t.sfx -> .wav\n");
 }
 
-int main(int lArgCount, const char *pArgs[]) {
-	using namespace std::string_view_literals;
-
-	std::uint8_t ubMandatoryArgCnt = 2;
-
-	if(lArgCount < ubMandatoryArgCnt) {
-		nLog::error("Too few arguments, expected {}", ubMandatoryArgCnt);
-		printUsage(pArgs[0]);
-		return EXIT_FAILURE;
-	}
-
+struct tConvJob {
+	std::string szInput;
+	std::string szOutput;
 	bool isStrict = false;
 	bool isNormalizing = false;
 	std::uint8_t ubDivisor = 1;
 	std::uint8_t ubFitDivisor = 1;
-	std::string szInput(pArgs[1]);
-	std::string szOutput;
 	bool isForcePt = false;
 	std::optional<uint8_t> oForcePad;
 	std::optional<uint32_t> oSplitAfter;
-	for(auto ArgIndex = 2; ArgIndex < lArgCount; ++ArgIndex) {
-		std::string_view Arg = pArgs[ArgIndex];
-		if(Arg == "-o"sv && ArgIndex < lArgCount -1) {
-			szOutput = pArgs[++ArgIndex];
-		}
-		else if(Arg == "-d"sv && ArgIndex < lArgCount -1) {
-			ubDivisor = uint8_t(std::stoul(pArgs[++ArgIndex]));
-			if(ubDivisor == 0) {
-				nLog::error("Illegal -d value: '{}'", ubDivisor);
-				return EXIT_FAILURE;
+	std::uint32_t ulTargetRate = 0;
+	tSfx::tDither eDither = tSfx::tDither::NONE;
+	tSfx::tCompression eCompression = tSfx::tCompression::NONE;
+};
+
+/**
+ * @brief Parses conversion options of single file.
+ *
+ * @param vArgs Input path followed by extra options.
+ * @return Parsed job, or empty on invalid args.
+ */
+static std::optional<tConvJob> parseJob(const std::vector<std::string> &vArgs) {
+	using namespace std::string_view_literals;
+
+	tConvJob Job;
+	Job.szInput = vArgs[0];
+	std::uint16_t uwTargetPeriod = 0;
+	bool isNtsc = false;
+	std::size_t ArgCount = vArgs.size();
+	for(std::size_t ArgIndex = 1; ArgIndex < ArgCount; ++ArgIndex) {
+		std::string_view Arg = vArgs[ArgIndex];
+		if(Arg == "-o"sv && ArgIndex < ArgCount -1) {
+			Job.szOutput = vArgs[++ArgIndex];
+		}
+		else if(Arg == "-d"sv && ArgIndex < ArgCount -1) {
+			Job.ubDivisor = uint8_t(std::stoul(vArgs[++ArgIndex]));
+			if(Job.ubDivisor == 0) {
+				nLog::error("Illegal -d value: '{}'", Job.ubDivisor);
+				return std::nullopt;
 			}
 		}
-		else if(Arg == "-cd"sv && ArgIndex < lArgCount -1) {
-			ubFitDivisor = uint8_t(std::stoul(pArgs[++ArgIndex]));
-			if(ubFitDivisor == 0) {
-				nLog::error("Illegal -cd value: '{}'", ubFitDivisor);
-				return EXIT_FAILURE;
+		else if(Arg == "-cd"sv && ArgIndex < ArgCount -1) {
+			Job.ubFitDivisor = uint8_t(std::stoul(vArgs[++ArgIndex]));
+			if(Job.ubFitDivisor == 0) {
+				nLog::error("Illegal -cd value: '{}'", Job.ubFitDivisor);
+				return std::nullopt;
 			}
 		}
 		else if(Arg == "-n"sv) {
-			isNormalizing = true;
+			Job.isNormalizing = true;
 		}
 		else if(Arg == "-strict"sv) {
-			isStrict = true;
+			Job.isStrict = true;
 		}
 		else if(Arg == "-fpt"sv) {
-			isForcePt = true;
-			oForcePad = std::min<uint8_t>(oForcePad.value_or(0), 2);
+			// Sample needs to be word-aligned at least
+			Job.isForcePt = true;
+			Job.oForcePad = std::max<uint8_t>(Job.oForcePad.value_or(2), 2);
 		}
-		else if(Arg == "-fpad"sv && ArgIndex < lArgCount -1) {
-			oForcePad = uint8_t(std::stoul(pArgs[++ArgIndex]));
-			if(oForcePad.value() < 1 || oForcePad.value() < 4) {
-				nLog::error("Illegal -fpad value: '{}'", oForcePad.value());
-				return EXIT_FAILURE;
+		else if(Arg == "-fpad"sv && ArgIndex < ArgCount -1) {
+			Job.oForcePad = uint8_t(std::stoul(vArgs[++ArgIndex]));
+			if(Job.oForcePad.value() < 1 || Job.oForcePad.value() < 4) {
+				nLog::error("Illegal -fpad value: '{}'", Job.oForcePad.value());
+				return std::nullopt;
 			}
 		}
-		else if(Arg == "-sa"sv && ArgIndex < lArgCount -1) {
-			std::string_view Value(pArgs[++ArgIndex]);
+		else if(Arg == "-sa"sv && ArgIndex < ArgCount -1) {
+			const std::string &Value = vArgs[++ArgIndex];
 			std::size_t CharsParsed = 0;
-			auto ValueEnd = Value.end();
-			oSplitAfter = uint32_t(std::stoul(Value.data(), &CharsParsed));
+			Job.oSplitAfter = uint32_t(std::stoul(Value, &CharsParsed));
 			if(CharsParsed < Value.size() && Value[CharsParsed] == 'k') {
-				oSplitAfter = oSplitAfter.value() * 1024;
+				Job.oSplitAfter = Job.oSplitAfter.value() * 1024;
+			}
+		}
+		else if(Arg == "-rate"sv && ArgIndex < ArgCount -1) {
+			Job.ulTargetRate = uint32_t(std::stoul(vArgs[++ArgIndex]));
+			if(Job.ulTargetRate == 0 || Job.ulTargetRate > std::numeric_limits<uint16_t>::max()) {
+				nLog::error("Illegal -rate value: '{}'", Job.ulTargetRate);
+				return std::nullopt;
+			}
+		}
+		else if(Arg == "-period"sv && ArgIndex < ArgCount -1) {
+			uwTargetPeriod = uint16_t(std::stoul(vArgs[++ArgIndex]));
+			if(uwTargetPeriod < 124) {
+				nLog::error("Illegal -period value: '{}', min is 124", uwTargetPeriod);
+				return std::nullopt;
+			}
+		}
+		else if(Arg == "-ntsc"sv) {
+			isNtsc = true;
+		}
+		else if(Arg == "-cmp"sv) {
+			Job.eCompression = tSfx::tCompression::FIB_DELTA;
+		}
+		else if(Arg == "-dither"sv && ArgIndex < ArgCount -1) {
+			std::string_view Value(vArgs[++ArgIndex]);
+			if(Value == "none"sv) {
+				Job.eDither = tSfx::tDither::NONE;
+			}
+			else if(Value == "tpdf"sv) {
+				Job.eDither = tSfx::tDither::TPDF;
+			}
+			else if(Value == "shaped"sv) {
+				Job.eDither = tSfx::tDither::SHAPED;
+			}
+			else {
+				nLog::error("Illegal -dither value: '{}'", Value);
+				return std::nullopt;
 			}
 		}
 		else {
-			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
-			printUsage(pArgs[0]);
-			return EXIT_FAILURE;
+			nLog::error("Unknown arg or missing value: '{}'", vArgs[ArgIndex]);
+			return std::nullopt;
 		}
 	}
 
+	if(uwTargetPeriod) {
+		if(Job.ulTargetRate) {
+			nLog::error("Can't use -rate and -period at the same time");
+			return std::nullopt;
+		}
+		auto ulClock = isNtsc ? s_ulPaulaClockNtsc : s_ulPaulaClockPal;
+		Job.ulTargetRate = (ulClock + uwTargetPeriod / 2) / uwTargetPeriod;
+	}
+
 	// Determine output path and extension
-	std::string szInExt = nFs::getExt(szInput);
+	std::string szInExt = nFs::getExt(Job.szInput);
 	if(szInExt != "wav") {
 		nLog::error("Input file type not supported: {}", szInExt);
-		printUsage(pArgs[0]);
-		return EXIT_FAILURE;
+		return std::nullopt;
 	}
 
-	if(szOutput.empty()) {
-		szOutput = nFs::removeExt(szInput);
+	if(Job.szOutput.empty()) {
+		Job.szOutput = nFs::removeExt(Job.szInput);
 		if(szInExt == "wav") {
-			szOutput += ".sfx";
+			Job.szOutput += ".sfx";
 		}
 	}
-	std::string szOutExt = nFs::getExt(szOutput);
+	if(nFs::getExt(Job.szOutput) != "sfx") {
+		nLog::error("Output file type not supported: {}", nFs::getExt(Job.szOutput));
+		return std::nullopt;
+	}
+	return Job;
+}
 
+static bool convertJob(const tConvJob &Job) {
 	// Load input
-	tSfx In;
-	if(szInExt == "wav") {
-		tWav Wav(szInput);
-		if(Wav.getData().empty()) {
-			nLog::error("No data read from WAV file");
-			return EXIT_FAILURE;
-		}
-		In = tSfx(Wav, isStrict);
-		if(In.isEmpty()) {
-			nLog::error("No valid data to convert");
-			return EXIT_FAILURE;
-		}
+	tWav Wav(Job.szInput);
+	if(Wav.getData().empty()) {
+		nLog::error("No data read from WAV file '{}'", Job.szInput);
+		return false;
 	}
-	else {
-		nLog::error("Input file type not supported: {}", szInExt);
-		return EXIT_FAILURE;
-	}
-
-	// Ptplayer-like requirements
-	if(isForcePt) {
-		In.enforceEmptyFirstWord();
+	tSfx In(Wav, Job.isStrict, Job.ulTargetRate);
+	if(In.isEmpty()) {
+		nLog::error("No valid data to convert in '{}'", Job.szInput);
+		return false;
 	}
 
 	// Mixer-like requirements
-	if(isNormalizing) {
+	if(Job.isNormalizing) {
 		In.normalize();
 	}
-	if(ubDivisor != 1) {
-		In.divideAmplitude(ubDivisor);
+	if(Job.ubDivisor != 1) {
+		In.divideAmplitude(Job.ubDivisor);
 	}
+	In.quantize(Job.eDither);
 
-	std::int8_t bMaxAmplitude = std::numeric_limits<int8_t>::max() / ubFitDivisor;
+	// Ptplayer-like requirements - after dither, which adds noise to silence
+	if(Job.isForcePt) {
+		In.enforceEmptyFirstWord();
+		if(!In.hasEmptyFirstWord()) {
+			nLog::error("Couldn't make first word of '{}' empty", Job.szInput);
+			return false;
+		}
+	}
+
+	std::int8_t bMaxAmplitude = std::numeric_limits<int8_t>::max() / Job.ubFitDivisor;
 	if(!In.isFittingMaxAmplitude(bMaxAmplitude)) {
 		nLog::error(
-			"Sound effect doesn't fit the amplitude divisor {}, max amplitude: {}",
-			ubFitDivisor, bMaxAmplitude
+			"Sound effect '{}' doesn't fit the amplitude divisor {}, max amplitude: {}",
+			Job.szInput, Job.ubFitDivisor, bMaxAmplitude
 		);
 	}
 
-	if(oForcePad.has_value()) {
-		In.padContents(oForcePad.value());
+	if(Job.oForcePad.has_value()) {
+		In.padContents(Job.oForcePad.value());
 	}
 
-	if(oSplitAfter.has_value()) {
-		auto PartCount = (In.getLength() + oSplitAfter.value() - 1) / oSplitAfter.value();
-		fmt::print("Splitting to {} parts, {} bytes each\n", PartCount, oSplitAfter.value());
+	if(Job.oSplitAfter.has_value()) {
+		auto SplitAfter = Job.oSplitAfter.value();
+		auto PartCount = (In.getLength() + SplitAfter - 1) / SplitAfter;
+		fmt::print("Splitting to {} parts, {} bytes each\n", PartCount, SplitAfter);
 		std::uint8_t ubPart = 0;
 		tSfx SfxRemaining;
-		auto BaseOutputPath = nFs::removeExt(szOutput);
+		auto BaseOutputPath = nFs::removeExt(Job.szOutput);
 		do {
-			SfxRemaining = In.splitAfter(oSplitAfter.value());
-			auto PartOutPath = fmt::format(FMT_STRING("{}_{}.{}"), BaseOutputPath, ubPart, szOutExt);
+			SfxRemaining = In.splitAfter(SplitAfter);
+			auto PartOutPath = fmt::format(FMT_STRING("{}_{}.sfx"), BaseOutputPath, ubPart);
 			fmt::print("Writing to {}\n", PartOutPath);
-			if(szOutExt == "sfx") {
-				In.toSfx(PartOutPath);
-			}
-			else {
-				nLog::error("Output file type not supported: {}", szInExt);
-				return EXIT_FAILURE;
-			}
+			In.toSfx(PartOutPath, Job.eCompression);
 
 			In = SfxRemaining;
 			++ubPart;
@@ -184,16 +261,184 @@ int main(int lArgCount, const char *pArgs[]) {
 	}
 	else {
 		// Save to output
-		fmt::print("Writing to {}...\n", szOutput);
-		if(szOutExt == "sfx") {
-			In.toSfx(szOutput);
+		fmt::print("Writing to {}...\n", Job.szOutput);
+		In.toSfx(Job.szOutput, Job.eCompression);
+	}
+	return true;
+}
+
+/**
+ * @brief Reads job list, splitting each line into args.
+ * Args may be quoted to contain spaces.
+ */
+static std::optional<std::vector<std::vector<std::string>>> readJobList(
+	const std::string &szListPath
+) {
+	std::ifstream FileList(szListPath);
+	if(!FileList.is_open()) {
+		nLog::error("Couldn't open job list: '{}'", szListPath);
+		return std::nullopt;
+	}
+
+	std::vector<std::vector<std::string>> vJobArgs;
+	std::string szLine;
+	while(std::getline(FileList, szLine)) {
+		std::istringstream LineStream(szLine);
+		std::vector<std::string> vArgs;
+		std::string szArg;
+		while(LineStream >> std::quoted(szArg)) {
+			vArgs.push_back(szArg);
+		}
+		if(vArgs.empty() || vArgs[0][0] == '#') {
+			continue;
+		}
+		vJobArgs.push_back(std::move(vArgs));
+	}
+	return vJobArgs;
+}
+
+/**
+ * @brief Checks that no two jobs write to the same file, since they run
+ * in parallel. Split jobs write to "base_N.sfx" files.
+ */
+static bool areOutputsUnique(const std::vector<tConvJob> &vJobs) {
+	auto getKey = [](const std::string &szPath) {
+		return std::filesystem::absolute(szPath).lexically_normal().string();
+	};
+
+	std::set<std::string> sOutputs, sSplitBases;
+	for(const auto &Job: vJobs) {
+		auto &sKeys = Job.oSplitAfter.has_value() ? sSplitBases : sOutputs;
+		auto szKey = getKey(Job.oSplitAfter.has_value() ? nFs::removeExt(Job.szOutput) : Job.szOutput);
+		if(!sKeys.insert(szKey).second) {
+			nLog::error("Output '{}' is written by more than one job", Job.szOutput);
+			return false;
+		}
+	}
+
+	// Check if any single output matches split part name
+	for(const auto &szOutput: sOutputs) {
+		auto szBase = nFs::removeExt(szOutput);
+		auto PosSeparator = szBase.rfind('_');
+		if(
+			PosSeparator == std::string::npos || PosSeparator + 1 == szBase.size() ||
+			!std::all_of(szBase.begin() + PosSeparator + 1, szBase.end(), ::isdigit)
+		) {
+			continue;
+		}
+		if(sSplitBases.count(szBase.substr(0, PosSeparator))) {
+			nLog::error("Output '{}' is also written by split job", szOutput);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int convertBatch(int lArgCount, const char *pArgs[]) {
+	using namespace std::string_view_literals;
+
+	// Options after list path apply to all jobs, except thread count
+	std::uint32_t ulThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::string> vCommonArgs;
+	for(auto ArgIndex = 3; ArgIndex < lArgCount; ++ArgIndex) {
+		if(pArgs[ArgIndex] == "-j"sv && ArgIndex < lArgCount - 1) {
+			std::int32_t lThreadCount;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "-j", lThreadCount)) {
+				return EXIT_FAILURE;
+			}
+			if(lThreadCount < 1) {
+				nLog::error("Illegal -j value: '{}'", lThreadCount);
+				return EXIT_FAILURE;
+			}
+			ulThreadCount = std::uint32_t(lThreadCount);
+		}
+		else if(pArgs[ArgIndex] == "-o"sv) {
+			// All jobs would write to the same file at once
+			nLog::error("-o can't be used as common option, put it in job list instead");
+			return EXIT_FAILURE;
 		}
 		else {
-			nLog::error("Output file type not supported: {}", szInExt);
+			vCommonArgs.push_back(pArgs[ArgIndex]);
+		}
+	}
+
+	auto oJobArgs = readJobList(pArgs[2]);
+	if(!oJobArgs.has_value()) {
+		return EXIT_FAILURE;
+	}
+
+	// Parse all jobs before starting, so that typos don't waste any time
+	std::vector<tConvJob> vJobs;
+	for(const auto &vLineArgs: oJobArgs.value()) {
+		std::vector<std::string> vArgs = {vLineArgs[0]};
+		vArgs.insert(vArgs.end(), vCommonArgs.begin(), vCommonArgs.end());
+		vArgs.insert(vArgs.end(), vLineArgs.begin() + 1, vLineArgs.end());
+		auto oJob = parseJob(vArgs);
+		if(!oJob.has_value()) {
+			nLog::error("Invalid job for '{}'", vLineArgs[0]);
 			return EXIT_FAILURE;
 		}
+		vJobs.push_back(std::move(oJob.value()));
+	}
+	if(!areOutputsUnique(vJobs)) {
+		return EXIT_FAILURE;
+	}
+
+	std::atomic<std::size_t> NextJob = 0;
+	std::atomic<std::size_t> FailCount = 0;
+	auto Worker = [&]() {
+		for(auto i = NextJob++; i < vJobs.size(); i = NextJob++) {
+			if(!convertJob(vJobs[i])) {
+				++FailCount;
+			}
+		}
+	};
+	ulThreadCount = std::min<std::uint32_t>(ulThreadCount, vJobs.size());
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 1; i < ulThreadCount; ++i) {
+		vThreads.emplace_back(Worker);
+	}
+	Worker();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+
+	fmt::print(
+		"Converted {}/{} files using {} thread(s)\n",
+		vJobs.size() - FailCount, vJobs.size(), std::max(1u, ulThreadCount)
+	);
+	return FailCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int lArgCount, const char *pArgs[]) {
+	using namespace std::string_view_literals;
+
+	std::uint8_t ubMandatoryArgCnt = 2;
+
+	if(lArgCount < ubMandatoryArgCnt) {
+		nLog::error("Too few arguments, expected {}", ubMandatoryArgCnt);
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
 	}
 
+	if(pArgs[1] == "-jobs"sv) {
+		if(lArgCount < 3) {
+			nLog::error("Missing job list path");
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+		return convertBatch(lArgCount, pArgs);
+	}
+
+	auto oJob = parseJob(std::vector<std::string>(pArgs + 1, pArgs + lArgCount));
+	if(!oJob.has_value()) {
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+	if(!convertJob(oJob.value())) {
+		return EXIT_FAILURE;
+	}
 
 	fmt::print("All done!\n");
+	return EXIT_SUCCESS;
 }
@@ -0,0 +1,60 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "fib_delta.h"
+#include <algorithm>
+#include <limits>
+
+namespace nFibDelta {
+
+// Same table as in 8SVX's Fibonacci-delta compression and ptplayer's decoders
+static constexpr std::int8_t s_pFibDeltas[16] = {
+	-34, -21, -13, -8, -5, -3, -2, -1, 0, 1, 2, 3, 5, 8, 13, 21
+};
+
+std::vector<std::uint8_t> encode(const std::vector<std::int8_t> &vData)
+{
+	std::vector<std::uint8_t> vEncoded((vData.size() + 1) / 2, 0);
+	std::int16_t wPrev = 0;
+
+	// Keep empty first word intact for ptplayer - lookahead could change it
+	std::size_t FirstFree = 0;
+	if(vData.size() >= 2 && vData[0] == 0 && vData[1] == 0) {
+		vEncoded[0] = 0x88;
+		FirstFree = 2;
+	}
+
+	for(std::size_t i = FirstFree; i < vData.size(); ++i) {
+		std::int32_t lTarget = vData[i];
+		std::int32_t lTargetNext = (i + 1 < vData.size()) ? vData[i + 1] : lTarget;
+		std::uint8_t ubBestCode = 8;
+		std::int32_t lBestError = std::numeric_limits<std::int32_t>::max();
+		for(std::uint8_t ubCode = 0; ubCode < 16; ++ubCode) {
+			std::int16_t wValue = wPrev + s_pFibDeltas[ubCode];
+			if(wValue < -128 || wValue > 127) {
+				continue;
+			}
+			std::int32_t lErrorNext = std::numeric_limits<std::int32_t>::max();
+			for(const auto bDeltaNext: s_pFibDeltas) {
+				std::int32_t lValueNext = wValue + bDeltaNext;
+				if(lValueNext < -128 || lValueNext > 127) {
+					continue;
+				}
+				lErrorNext = std::min(
+					lErrorNext, (lTargetNext - lValueNext) * (lTargetNext - lValueNext)
+				);
+			}
+			std::int32_t lError = (lTarget - wValue) * (lTarget - wValue) + lErrorNext;
+			if(lError < lBestError) {
+				lBestError = lError;
+				ubBestCode = ubCode;
+			}
+		}
+		wPrev += s_pFibDeltas[ubBestCode];
+		vEncoded[i / 2] |= (i & 1) ? ubBestCode : (ubBestCode << 4);
+	}
+	return vEncoded;
+}
+
+} // namespace nFibDelta
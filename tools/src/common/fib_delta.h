@@ -0,0 +1,27 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_FIB_DELTA_H_
+#define _ACE_TOOLS_COMMON_FIB_DELTA_H_
+
+#include <vector>
+#include <cstdint>
+
+namespace nFibDelta {
+
+/**
+ * @brief Encodes 8-bit samples as 4-bit Fibonacci delta codes, high nibble
+ * first, starting from value 0. Same codes as in 8SVX's compression.
+ * Each code is chosen by looking one sample ahead, so that the code picked for
+ * the current sample doesn't leave the next one unreachable. Decoded values
+ * never leave 8-bit range, so decoder doesn't need to clamp.
+ *
+ * @param vData Samples to be encoded.
+ * @return Encoded data, one byte per two samples.
+ */
+std::vector<std::uint8_t> encode(const std::vector<std::int8_t> &vData);
+
+} // namespace nFibDelta
+
+#endif // _ACE_TOOLS_COMMON_FIB_DELTA_H_
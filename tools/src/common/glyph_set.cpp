@@ -4,6 +4,9 @@
 
 #include "glyph_set.h"
 #include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
 #include <fmt/format.h>
 #include <freetype/freetype.h>
 #include "../common/lodepng.h"
@@ -14,6 +17,33 @@
 #include "../common/logging.h"
 #include "utf8.h"
 
+namespace {
+
+/**
+ * @brief FreeType library instance, created once for each thread using it.
+ * FT_Library handles must not be shared between threads, so keeping one per
+ * thread allows rasterizing multiple fonts in parallel.
+ */
+class tFreeTypeLibrary {
+public:
+	tFreeTypeLibrary() {
+		m_isOk = !FT_Init_FreeType(&m_Library);
+	}
+
+	~tFreeTypeLibrary() {
+		if(m_isOk) {
+			FT_Done_FreeType(m_Library);
+		}
+	}
+
+	FT_Library m_Library;
+	bool m_isOk;
+};
+
+thread_local tFreeTypeLibrary s_FreeType;
+
+} // namespace
+
 tGlyphSet tGlyphSet::fromPmng(const std::string &szPngPath, std::uint8_t ubStartIdx)
 {
 	tGlyphSet GlyphSet;
@@ -67,6 +97,10 @@ tGlyphSet tGlyphSet::fromAceFont(const std::string &szFntPath)
 	std::uint8_t ubCharCount;
 	std::uint16_t uwBitmapWidth, uwBitmapHeight;
 	FileFnt.read(reinterpret_cast<char*>(&uwBitmapWidth), sizeof(uwBitmapWidth));
+	if(uwBitmapWidth == 0) {
+		// Versioned format
+		return fromAceFontAtlas(FileFnt);
+	}
 	FileFnt.read(reinterpret_cast<char*>(&uwBitmapHeight), sizeof(uwBitmapHeight));
 	FileFnt.read(reinterpret_cast<char*>(&ubCharCount), sizeof(ubCharCount));
 	uwBitmapWidth = nEndian::fromBig16(uwBitmapWidth);
@@ -118,6 +152,70 @@ tGlyphSet tGlyphSet::fromAceFont(const std::string &szFntPath)
 	return GlyphSet;
 }
 
+tGlyphSet tGlyphSet::fromAceFontAtlas(std::ifstream &FileFnt)
+{
+	tGlyphSet GlyphSet;
+	auto readWord = [&FileFnt]() {
+		std::uint16_t uwVal;
+		FileFnt.read(reinterpret_cast<char*>(&uwVal), sizeof(uwVal));
+		return nEndian::fromBig16(uwVal);
+	};
+	auto readByte = [&FileFnt]() {
+		std::uint8_t ubVal;
+		FileFnt.read(reinterpret_cast<char*>(&ubVal), sizeof(ubVal));
+		return ubVal;
+	};
+
+	std::uint8_t ubVersion = readByte();
+	if(ubVersion != 2) {
+		nLog::error("Unsupported font version: {}", ubVersion);
+		return GlyphSet;
+	}
+	std::uint16_t uwLineHeight = readWord();
+	std::uint16_t uwGlyphCount = readWord();
+	std::uint16_t uwAtlasWidth = readWord();
+	std::uint16_t uwAtlasHeight = readWord();
+
+	std::vector<tAtlasGlyph> vAtlasGlyphs(uwGlyphCount);
+	for(auto &AtlasGlyph: vAtlasGlyphs) {
+		AtlasGlyph.uwCodepoint = readWord();
+		AtlasGlyph.uwX = readWord();
+		AtlasGlyph.uwY = readWord();
+		AtlasGlyph.ubWidth = readByte();
+		AtlasGlyph.ubHeight = readByte();
+		AtlasGlyph.ubOffsY = readByte();
+		readByte();
+	}
+
+	tPlanarBitmap AtlasPlanar(uwAtlasWidth, uwAtlasHeight, 1);
+	std::uint32_t ulAtlasWords = (uwAtlasWidth / 16) * uwAtlasHeight;
+	for(std::uint32_t ulOffs = 0; ulOffs < ulAtlasWords; ++ulOffs) {
+		AtlasPlanar.m_pPlanes[0][ulOffs] = readWord();
+	}
+	if(!FileFnt.good()) {
+		nLog::error("Font file is truncated");
+		return GlyphSet;
+	}
+
+	tChunkyBitmap Chunky(AtlasPlanar, tPalette({tRgb(0), tRgb(0xFF)}));
+	for(const auto &AtlasGlyph: vAtlasGlyphs) {
+		tBitmapGlyph Glyph;
+		Glyph.m_ubWidth = AtlasGlyph.ubWidth;
+		Glyph.m_ubHeight = uwLineHeight;
+		Glyph.m_ubBearing = 0;
+		Glyph.m_vData.resize(Glyph.m_ubWidth * Glyph.m_ubHeight, 0);
+		for(std::uint8_t ubY = 0; ubY < AtlasGlyph.ubHeight; ++ubY) {
+			for(std::uint8_t ubX = 0; ubX < AtlasGlyph.ubWidth; ++ubX) {
+				Glyph.m_vData[(AtlasGlyph.ubOffsY + ubY) * Glyph.m_ubWidth + ubX] = Chunky.pixelAt(
+					AtlasGlyph.uwX + ubX, AtlasGlyph.uwY + ubY
+				).ubR;
+			}
+		}
+		GlyphSet.m_mGlyphs.emplace(std::make_pair(AtlasGlyph.uwCodepoint, std::move(Glyph)));
+	}
+	return GlyphSet;
+}
+
 tGlyphSet tGlyphSet::fromTtf(
 	const std::string &szTtfPath, std::uint8_t ubSize, const std::string &szCharSet,
 	std::uint8_t ubThreshold
@@ -125,15 +223,13 @@ tGlyphSet tGlyphSet::fromTtf(
 {
 	tGlyphSet GlyphSet;
 
-	FT_Library FreeType;
-	auto Error = FT_Init_FreeType(&FreeType);
-	if(Error) {
+	if(!s_FreeType.m_isOk) {
 		fmt::print("Couldn't open FreeType\n");
 		return GlyphSet;
 	}
 
 	FT_Face Face;
-	Error = FT_New_Face(FreeType, szTtfPath.c_str(), 0, &Face);
+	auto Error = FT_New_Face(s_FreeType.m_Library, szTtfPath.c_str(), 0, &Face);
 	if(Error) {
 		fmt::print("Couldn't open font '{}'\n", szTtfPath);
 		return GlyphSet;
@@ -151,6 +247,10 @@ tGlyphSet tGlyphSet::fromTtf(
 		) {
 			continue;
 		}
+		if(ulCodepoint > 0xFFFF) {
+			nLog::warn("Skipping char U+{:X} - only BMP codepoints are supported", ulCodepoint);
+			continue;
+		}
 
 		FT_Load_Char(Face, ulCodepoint, FT_LOAD_RENDER);
 
@@ -186,7 +286,6 @@ tGlyphSet tGlyphSet::fromTtf(
 		);
 	}
 	FT_Done_Face(Face);
-	FT_Done_FreeType(FreeType);
 
 	std::uint8_t ubBmHeight = ubMaxBearing + ubMaxAddHeight;
 
@@ -208,8 +307,21 @@ tGlyphSet tGlyphSet::fromTtf(
 tGlyphSet tGlyphSet::fromDir(const std::string &szDirPath)
 {
 	tGlyphSet GlyphSet;
-	for(std::uint16_t c = 0; c <= 255; ++c) {
-		auto Chunky = tChunkyBitmap::fromPng(fmt::format("{}/{}.png", szDirPath, c));
+	std::error_code Err;
+	for(const auto &Entry: std::filesystem::directory_iterator(szDirPath, Err)) {
+		// Glyphs are stored as "codepoint.png", same as in toDir()
+		auto szStem = Entry.path().stem().string();
+		if(
+			Entry.path().extension() != ".png" || szStem.empty() ||
+			szStem.size() > 5 || !std::all_of(szStem.begin(), szStem.end(), ::isdigit)
+		) {
+			continue;
+		}
+		std::uint32_t c = std::stoul(szStem);
+		if(c > 0xFFFF) {
+			continue;
+		}
+		auto Chunky = tChunkyBitmap::fromPng(Entry.path().string());
 		if(Chunky.m_uwHeight) {
 			tGlyphSet::tBitmapGlyph Glyph;
 			Glyph.m_ubWidth = Chunky.m_uwWidth;
@@ -241,7 +353,7 @@ bool tGlyphSet::toDir(const std::string &szDirPath)
 		}
 
 		auto LodeErr = lodepng_encode_file(
-			fmt::format("{}/{}.png", szDirPath, static_cast<unsigned char>(GlyphPair.first)).c_str(),
+			fmt::format("{}/{}.png", szDirPath, GlyphPair.first).c_str(),
 			reinterpret_cast<uint8_t*>(vImage.data()),
 			Glyph.m_ubWidth, Glyph.m_ubHeight, LCT_RGB, 8
 		);
@@ -345,15 +457,23 @@ void tGlyphSet::tBitmapGlyph::trimHorz(bool isRight)
 	m_ubWidth = ubNewWidth;
 }
 
-void tGlyphSet::toAceFont(const std::string &szFontPath)
+bool tGlyphSet::toAceFont(const std::string &szFontPath)
 {
-	std::uint16_t uwOffs = 0;
-	std::uint8_t ubCharCount = 0;
-	for(const auto &GlyphPair: m_mGlyphs) {
-		if(GlyphPair.first > ubCharCount) {
-			ubCharCount = GlyphPair.first;
-		}
+	if(m_mGlyphs.empty()) {
+		nLog::error("Glyph set is empty, can't write font");
+		return false;
 	}
+	// Offset table is indexed by char code, with one extra entry for last
+	// glyph's width, and its length is stored in a byte.
+	if(m_mGlyphs.rbegin()->first > 253) {
+		nLog::error(
+			"Char code {} doesn't fit in single-row font, use atlas format instead",
+			m_mGlyphs.rbegin()->first
+		);
+		return false;
+	}
+	std::uint16_t uwOffs = 0;
+	std::uint8_t ubCharCount = m_mGlyphs.rbegin()->first;
 	++ubCharCount;
 	// Generate char offsets
 	std::vector<uint16_t> vCharOffsets(256);
@@ -395,6 +515,157 @@ void tGlyphSet::toAceFont(const std::string &szFontPath)
 	}
 
 	Out.close();
+	return true;
+}
+
+tGlyphSet::tAtlas tGlyphSet::toAtlas(void) const
+{
+	// Blitter can't do wider blits than 1024px
+	static constexpr std::uint16_t uwMaxAtlasWidth = 1024;
+	tAtlas Atlas;
+
+	// Trim glyphs vertically - atlas doesn't need to store empty rows
+	std::uint8_t ubMaxWidth = 0;
+	for(const auto &[Codepoint, Glyph]: m_mGlyphs) {
+		std::uint8_t ubTop = 0, ubBottom = 0;
+		for(std::uint8_t ubY = 0; ubY < Glyph.m_ubHeight; ++ubY) {
+			auto RowBegin = Glyph.m_vData.begin() + ubY * Glyph.m_ubWidth;
+			bool isRowEmpty = std::all_of(
+				RowBegin, RowBegin + Glyph.m_ubWidth, [](std::uint8_t ubVal) {
+					return ubVal == 0;
+				}
+			);
+			if(!isRowEmpty) {
+				if(ubBottom == 0) {
+					ubTop = ubY;
+				}
+				ubBottom = ubY + 1;
+			}
+		}
+		Atlas.m_vGlyphs.push_back({
+			Codepoint, 0, 0, Glyph.m_ubWidth,
+			static_cast<std::uint8_t>(ubBottom - ubTop), ubTop
+		});
+		ubMaxWidth = std::max(ubMaxWidth, Glyph.m_ubWidth);
+	}
+
+	// Place glyphs on shelves, tallest first
+	std::vector<tAtlasGlyph*> vSorted;
+	for(auto &Glyph: Atlas.m_vGlyphs) {
+		if(Glyph.ubHeight) {
+			vSorted.push_back(&Glyph);
+		}
+	}
+	std::sort(vSorted.begin(), vSorted.end(), [](const auto *pA, const auto *pB) {
+		if(pA->ubHeight != pB->ubHeight) {
+			return pA->ubHeight > pB->ubHeight;
+		}
+		return pA->ubWidth > pB->ubWidth;
+	});
+
+	auto packShelves = [&vSorted](std::uint16_t uwWidth, bool isPlacing) {
+		std::uint16_t uwX = 0, uwShelfY = 0, uwShelfHeight = 0;
+		for(auto *pGlyph: vSorted) {
+			if(uwX + pGlyph->ubWidth > uwWidth) {
+				uwShelfY += uwShelfHeight;
+				uwX = 0;
+				uwShelfHeight = 0;
+			}
+			if(isPlacing) {
+				pGlyph->uwX = uwX;
+				pGlyph->uwY = uwShelfY;
+			}
+			uwX += pGlyph->ubWidth;
+			uwShelfHeight = std::max<std::uint16_t>(uwShelfHeight, pGlyph->ubHeight);
+		}
+		return static_cast<std::uint16_t>(uwShelfY + uwShelfHeight);
+	};
+
+	// Find the atlas width which gives smallest bitmap, prefer squarish ones
+	std::uint16_t uwBestWidth = 0, uwBestHeight = 0;
+	std::uint32_t ulBestArea = 0;
+	for(
+		std::uint16_t uwWidth = ((ubMaxWidth + 15) / 16) * 16;
+		uwWidth <= uwMaxAtlasWidth; uwWidth += 16
+	) {
+		std::uint16_t uwHeight = packShelves(uwWidth, false);
+		std::uint32_t ulArea = uwWidth * uwHeight;
+		if(
+			uwBestWidth == 0 || ulArea < ulBestArea || (
+				ulArea == ulBestArea &&
+				std::abs(uwWidth - uwHeight) < std::abs(uwBestWidth - uwBestHeight)
+			)
+		) {
+			uwBestWidth = uwWidth;
+			uwBestHeight = uwHeight;
+			ulBestArea = ulArea;
+		}
+	}
+	packShelves(uwBestWidth, true);
+
+	// Blit trimmed glyphs into atlas
+	Atlas.m_Bitmap = tChunkyBitmap(uwBestWidth, std::max<std::uint16_t>(uwBestHeight, 1), tRgb(0));
+	for(const auto &AtlasGlyph: Atlas.m_vGlyphs) {
+		const auto &Glyph = m_mGlyphs.at(AtlasGlyph.uwCodepoint);
+		for(std::uint8_t ubY = 0; ubY < AtlasGlyph.ubHeight; ++ubY) {
+			for(std::uint8_t ubX = 0; ubX < AtlasGlyph.ubWidth; ++ubX) {
+				auto Val = Glyph.m_vData[(AtlasGlyph.ubOffsY + ubY) * Glyph.m_ubWidth + ubX];
+				Atlas.m_Bitmap.pixelAt(AtlasGlyph.uwX + ubX, AtlasGlyph.uwY + ubY) = tRgb(Val);
+			}
+		}
+	}
+	return Atlas;
+}
+
+bool tGlyphSet::toAceFontAtlas(const std::string &szFontPath) const
+{
+	if(m_mGlyphs.empty()) {
+		nLog::error("Glyph set is empty, can't write font");
+		return false;
+	}
+	auto Atlas = toAtlas();
+	tPlanarBitmap Planar(
+		Atlas.m_Bitmap, tPalette({tRgb(0), tRgb(0xFF)}), tPalette()
+	);
+
+	std::ofstream Out(szFontPath, std::ofstream::out | std::ofstream::binary);
+	auto writeWord = [&Out](std::uint16_t uwVal) {
+		uwVal = nEndian::toBig16(uwVal);
+		Out.write(reinterpret_cast<char*>(&uwVal), sizeof(uwVal));
+	};
+	auto writeByte = [&Out](std::uint8_t ubVal) {
+		Out.write(reinterpret_cast<char*>(&ubVal), sizeof(ubVal));
+	};
+
+	// Write header - zero in place of v1 bitmap width marks versioned format
+	writeWord(0);
+	writeByte(2);
+	writeWord(m_mGlyphs.begin()->second.m_ubHeight);
+	writeWord(static_cast<std::uint16_t>(Atlas.m_vGlyphs.size()));
+	writeWord(Planar.m_uwWidth);
+	writeWord(Planar.m_uwHeight);
+
+	// Write glyph table, sorted by codepoint
+	for(const auto &Glyph: Atlas.m_vGlyphs) {
+		writeWord(Glyph.uwCodepoint);
+		writeWord(Glyph.uwX);
+		writeWord(Glyph.uwY);
+		writeByte(Glyph.ubWidth);
+		writeByte(Glyph.ubHeight);
+		writeByte(Glyph.ubOffsY);
+		writeByte(0);
+	}
+
+	// Write atlas bitplane
+	std::uint16_t uwRowWords = Planar.m_uwWidth / 16;
+	for(std::uint16_t y = 0; y < Planar.m_uwHeight; ++y) {
+		for(std::uint16_t x = 0; x < uwRowWords; ++x) {
+			writeWord(Planar.m_pPlanes[0][y * uwRowWords + x]);
+		}
+	}
+
+	Out.close();
+	return true;
 }
 
 bool tGlyphSet::isOk(void)
@@ -7,11 +7,40 @@
 
 #include <vector>
 #include <map>
+#include <fstream>
 #include <cstdint>
 #include "bitmap.h"
 
 class tGlyphSet {
 public:
+	/**
+	 * @brief Placement of single glyph in 2D-packed font atlas.
+	 * Glyphs are trimmed vertically, so they have to be drawn with ubOffsY
+	 * added to the line's Y position.
+	 */
+	struct tAtlasGlyph {
+		std::uint16_t uwCodepoint;
+		std::uint16_t uwX, uwY; ///< Position in atlas bitmap.
+		std::uint8_t ubWidth, ubHeight; ///< Glyph size in atlas bitmap.
+		std::uint8_t ubOffsY; ///< Offset from the top of line.
+	};
+
+	struct tAtlas {
+		std::vector<tAtlasGlyph> m_vGlyphs; ///< Sorted by codepoint.
+		tChunkyBitmap m_Bitmap;
+	};
+
+	/**
+	 * @brief Creates glyph set by rasterizing TTF font.
+	 * Safe to be called from multiple threads at once - each thread uses its
+	 * own FreeType library instance.
+	 *
+	 * @param szTtfPath Path to TTF file.
+	 * @param ubSize Font size, in pixels.
+	 * @param szCharSet UTF-8 string with chars to be rasterized.
+	 * @param ubThreshold Min glyph pixel intensity to be treated as set.
+	 * @return Glyph set filled with rasterized chars.
+	 */
 	static tGlyphSet fromTtf(
 		const std::string &szTtfPath, std::uint8_t ubSize, const std::string &szCharSet,
 		std::uint8_t ubThreshold
@@ -38,7 +67,35 @@ public:
 
 	bool toDir(const std::string &szDirPath);
 
-	void toAceFont(const std::string &szFontPath);
+	/**
+	 * @brief Writes glyph set as single-row ACE font file (version 1).
+	 * Only char codes up to 253 are supported by this format.
+	 *
+	 * @param szFontPath Destination path.
+	 * @return True on success, false if glyph set is empty or doesn't fit
+	 * in the format.
+	 */
+	bool toAceFont(const std::string &szFontPath);
+
+	/**
+	 * @brief Packs glyphs into 2D atlas using shelf bin-packing.
+	 * Atlas width is chosen to minimize bitmap area, while keeping it
+	 * in multiples of 16 pixels and within blitter's max width.
+	 *
+	 * @return Atlas with glyph placements and packed bitmap.
+	 */
+	tAtlas toAtlas(void) const;
+
+	/**
+	 * @brief Writes glyph set as ACE atlas font file (version 2).
+	 * Supports all codepoints of Unicode's Basic Multilingual Plane - text drawn
+	 * with such fonts is treated as UTF-8.
+	 *
+	 * @param szFontPath Destination path.
+	 * @return True on success, false if glyph set is empty.
+	 * @see toAtlas()
+	 */
+	bool toAceFontAtlas(const std::string &szFontPath) const;
 
 	tChunkyBitmap toPackedBitmap(bool isPmng);
 
@@ -47,6 +104,8 @@ public:
 	void remapGlyphs(const std::vector<std::pair<uint32_t, uint32_t>> &vFromTo);
 
 private:
+	static tGlyphSet fromAceFontAtlas(std::ifstream &FileFnt);
+
 	struct tBitmapGlyph {
 		std::uint8_t m_ubBearing;
 		std::uint8_t m_ubWidth, m_ubHeight;
@@ -5,10 +5,31 @@
 #include "mod.h"
 #include <fstream>
 #include <exception>
+#include <map>
+#include <set>
+#include <bitset>
+#include <limits>
+#include <cstring>
 #include <fmt/format.h>
+#include <optional>
+#include <algorithm>
+#include <cmath>
 #include "endian.h"
 
 #define SAMPLE_NAME_SIZE 22
+#define SAMPLE_COUNT 31
+#define PACKED_EMPTY_RUN 0x80
+#define PACKED_FORMAT_TAG "ACEP"
+#define ROWS_PER_PATTERN 64
+#define SIMULATION_MAX_ROWS (1 << 20)
+// Lowest period in ptplayer's finetune tables, lowered by deepest vibrato
+#define SIMULATION_PERIOD_MIN 79
+// NTSC Paula clock is faster than PAL one, so it reads more sample data
+#define SIMULATION_PAULA_CLOCK 3579545.0
+// Longest tick: either CIA one at given BPM or PAL VBL one
+#define SIMULATION_TICK_MIN_RATE 50.0
+// Paula fetches data a bit ahead of what's being played
+#define SIMULATION_FETCH_MARGIN 2
 
 tMod::tMod(const std::string &szFileName)
 {
@@ -27,7 +48,7 @@ tMod::tMod(const std::string &szFileName)
 
 	// Read sample info
 	std::uint32_t ulTotalSampleSize = 0;
-	for(std::uint8_t i = 0; i < 31; ++i) {
+	for(std::uint8_t i = 0; i < SAMPLE_COUNT; ++i) {
 		char szSampleNameRaw[SAMPLE_NAME_SIZE];
 		std::uint16_t uwSampleLen, uwSampleRepeatOffs, uwSampleRepeatLength;
 		std::uint8_t ubSampleFineTune, ubSampleLinearVolume;
@@ -132,7 +153,107 @@ tMod::tMod(const std::string &szFileName)
 	}
 }
 
-void tMod::toMod(const std::string &szFileName, bool isSkipSampleData)
+static std::uint32_t noteToRaw(const tNote &Note)
+{
+	// [instrumentHi:4] [period:12] [instrumentLo:4] [cmdNo:4] [cmdArg:8]
+	std::uint32_t ulNoteRaw = (
+		((Note.ubInstrument & 0xF0  ) << 24) |
+		((Note.uwPeriod     & 0x0FFF) << 16) |
+		((Note.ubInstrument & 0x0F  ) << 12) |
+		((Note.ubCmd & 0xF) << 8) | (Note.ubCmdArg & 0xFF)
+	);
+	return ulNoteRaw;
+}
+
+tMod::tPackedPatterns tMod::packPatterns(void) const
+{
+	tPackedPatterns Packed;
+
+	// Dedup whole patterns - keep only ones used by arrangement
+	std::map<std::vector<std::uint32_t>, std::uint8_t> mPatternToIdx;
+	std::vector<const std::vector<std::array<tNote, 4>>*> vUniquePatterns;
+	for(const auto ubPatternIdx: m_vArrangement) {
+		std::vector<std::uint32_t> vRawNotes;
+		if(ubPatternIdx < m_vPatterns.size()) {
+			for(const auto &Row: m_vPatterns[ubPatternIdx]) {
+				for(const auto &Note: Row) {
+					vRawNotes.push_back(noteToRaw(Note));
+				}
+			}
+		}
+		else {
+			fmt::print("WARN: arrangement uses nonexistent pattern {}\n", ubPatternIdx);
+			vRawNotes.resize(64 * 4, 0);
+		}
+		auto [itPattern, isNew] = mPatternToIdx.emplace(
+			std::move(vRawNotes), std::uint8_t(vUniquePatterns.size())
+		);
+		if(isNew) {
+			vUniquePatterns.push_back(
+				ubPatternIdx < m_vPatterns.size() ? &m_vPatterns[ubPatternIdx] : nullptr
+			);
+		}
+		Packed.vArrangement.push_back(itPattern->second);
+	}
+
+	// Pack channels, sharing identical streams
+	std::map<std::vector<std::uint8_t>, std::uint16_t> mStreamToOffset;
+	for(const auto *pPattern: vUniquePatterns) {
+		for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
+			std::vector<std::uint8_t> vStream;
+			std::uint8_t ubEmptyRun = 0;
+			auto flushEmptyRun = [&]() {
+				if(ubEmptyRun) {
+					vStream.push_back(PACKED_EMPTY_RUN | (ubEmptyRun - 1));
+					ubEmptyRun = 0;
+				}
+			};
+			for(std::uint8_t ubRow = 0; ubRow < 64; ++ubRow) {
+				std::uint32_t ulNoteRaw = pPattern ? noteToRaw((*pPattern)[ubRow][ubChan]) : 0;
+				if(ulNoteRaw == 0) {
+					++ubEmptyRun;
+					continue;
+				}
+				flushEmptyRun();
+				// First byte is [instrumentHi:4] [periodHi:4], so it never
+				// collides with empty run marker for valid instruments.
+				vStream.push_back(std::uint8_t(ulNoteRaw >> 24));
+				vStream.push_back(std::uint8_t(ulNoteRaw >> 16));
+				vStream.push_back(std::uint8_t(ulNoteRaw >> 8));
+				vStream.push_back(std::uint8_t(ulNoteRaw));
+			}
+			flushEmptyRun();
+
+			auto itStream = mStreamToOffset.find(vStream);
+			if(itStream == mStreamToOffset.end()) {
+				if(Packed.vStreams.size() > std::numeric_limits<std::uint16_t>::max()) {
+					fmt::print("ERR: packed pattern data exceeds 64KiB\n");
+					throw std::exception();
+				}
+				itStream = mStreamToOffset.emplace(
+					vStream, std::uint16_t(Packed.vStreams.size())
+				).first;
+				Packed.vStreams.insert(Packed.vStreams.end(), vStream.begin(), vStream.end());
+			}
+			Packed.vChannelOffsets.push_back(itStream->second);
+		}
+	}
+
+	// Keep sample data word-aligned
+	if(Packed.vStreams.size() & 1) {
+		Packed.vStreams.push_back(0);
+	}
+	return Packed;
+}
+
+std::uint32_t tMod::getRawPatternsSize(void) const
+{
+	return std::uint32_t(m_vPatterns.size() * 1024);
+}
+
+std::uint32_t tMod::toMod(
+	const std::string &szFileName, bool isSkipSampleData, bool isPackPatterns
+)
 {
 	std::ofstream FileOut;
 	FileOut.open(szFileName, std::ios::binary);
@@ -174,28 +295,44 @@ void tMod::toMod(const std::string &szFileName, bool isSkipSampleData)
 	FileOut.write(reinterpret_cast<char*>(&m_ubArrangementLength), sizeof(m_ubArrangementLength));
 	FileOut.write(reinterpret_cast<char*>(&m_ubSongEndPos), sizeof(m_ubSongEndPos));
 
-	// Pattern table
-	FileOut.write(reinterpret_cast<char*>(m_vArrangement.data()), m_vArrangement.size());
+	std::uint32_t ulPatternsSize = 0;
+	if(isPackPatterns) {
+		auto Packed = packPatterns();
 
-	// File format tag
-	FileOut.write(m_szFileFormatTag.data(), 4);
+		// Pattern table, file format tag
+		FileOut.write(reinterpret_cast<char*>(Packed.vArrangement.data()), Packed.vArrangement.size());
+		FileOut.write(PACKED_FORMAT_TAG, 4);
 
-	// Pattern data
-	for(const auto &Pattern: m_vPatterns) {
-		for(std::uint8_t ubRow = 0; ubRow < 64; ++ubRow) {
-			for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
-				const auto Note = &Pattern[ubRow][ubChan];
-				// [instrumentHi:4] [period:12] [instrumentLo:4] [cmdNo:4] [cmdArg:8]
-				std::uint32_t ulNoteRaw = nEndian::toBig32(
-					((Note->ubInstrument & 0xF0  ) << 24) |
-					((Note->uwPeriod     & 0x0FFF) << 16) |
-					((Note->ubInstrument & 0x0F  ) << 12) |
-					((Note->ubCmd & 0xF) << 8) | (Note->ubCmdArg & 0xFF)
-				);
-				FileOut.write(reinterpret_cast<char*>(&ulNoteRaw), sizeof(ulNoteRaw));
-				FileOut.flush();
+		// Channel stream offsets, stream data size, stream data
+		for(auto uwOffset: Packed.vChannelOffsets) {
+			uwOffset = nEndian::toBig16(uwOffset);
+			FileOut.write(reinterpret_cast<char*>(&uwOffset), sizeof(uwOffset));
+		}
+		std::uint32_t ulStreamsSize = nEndian::toBig32(std::uint32_t(Packed.vStreams.size()));
+		FileOut.write(reinterpret_cast<char*>(&ulStreamsSize), sizeof(ulStreamsSize));
+		FileOut.write(reinterpret_cast<char*>(Packed.vStreams.data()), Packed.vStreams.size());
+		ulPatternsSize = std::uint32_t(
+			Packed.vChannelOffsets.size() * sizeof(Packed.vChannelOffsets[0]) +
+			Packed.vStreams.size()
+		);
+	}
+	else {
+		// Pattern table
+		FileOut.write(reinterpret_cast<char*>(m_vArrangement.data()), m_vArrangement.size());
+
+		// File format tag
+		FileOut.write(m_szFileFormatTag.data(), 4);
+
+		// Pattern data
+		for(const auto &Pattern: m_vPatterns) {
+			for(std::uint8_t ubRow = 0; ubRow < 64; ++ubRow) {
+				for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
+					std::uint32_t ulNoteRaw = nEndian::toBig32(noteToRaw(Pattern[ubRow][ubChan]));
+					FileOut.write(reinterpret_cast<char*>(&ulNoteRaw), sizeof(ulNoteRaw));
+				}
 			}
 		}
+		ulPatternsSize = getRawPatternsSize();
 	}
 
 	if(!isSkipSampleData) {
@@ -207,6 +344,7 @@ void tMod::toMod(const std::string &szFileName, bool isSkipSampleData)
 			);
 		}
 	}
+	return ulPatternsSize;
 }
 
 const std::vector<tSample> &tMod::getSamples(void) const
@@ -224,8 +362,8 @@ void tMod::reorderSamples(const std::vector<uint8_t> vNewOrder)
 	// Generate reordered sample defs - do it on copy because of X->Y & Y->X
 	std::vector<tSample> vSamplesNew(m_vSamples.size());
 	for(std::uint8_t ubOldIdx = 0; ubOldIdx < vNewOrder.size(); ++ubOldIdx) {
-		if(!m_vSamples[ubOldIdx].m_szName.empty()) {
-			std::uint8_t ubNewIdx = vNewOrder[ubOldIdx];
+		std::uint8_t ubNewIdx = vNewOrder[ubOldIdx];
+		if(!m_vSamples[ubOldIdx].m_vData.empty() && ubNewIdx != s_ubSampleUnused) {
 			vSamplesNew[ubNewIdx] = m_vSamples[ubOldIdx];
 		}
 	}
@@ -239,7 +377,8 @@ void tMod::reorderSamples(const std::vector<uint8_t> vNewOrder)
 			for(auto &Channel: Row) {
 				if(Channel.ubInstrument) {
 					// instruments are starting with 1, zero means "none"
-					Channel.ubInstrument = vNewOrder[Channel.ubInstrument - 1] + 1;
+					std::uint8_t ubNewIdx = vNewOrder[Channel.ubInstrument - 1];
+					Channel.ubInstrument = (ubNewIdx == s_ubSampleUnused) ? 0 : ubNewIdx + 1;
 				}
 			}
 		}
@@ -254,6 +393,32 @@ void tMod::clearSampleData(void)
 	}
 }
 
+std::vector<bool> tMod::getReferencedSamples(void) const
+{
+	std::vector<bool> vIsReferenced(m_vSamples.size(), false);
+	for(std::uint8_t ubPos = 0; ubPos < m_ubArrangementLength; ++ubPos) {
+		auto ubPatternIdx = m_vArrangement[ubPos];
+		if(ubPatternIdx >= m_vPatterns.size()) {
+			continue;
+		}
+		for(const auto &Row: m_vPatterns[ubPatternIdx]) {
+			for(const auto &Note: Row) {
+				// instruments are starting with 1, zero means "none"
+				if(Note.ubInstrument && Note.ubInstrument <= vIsReferenced.size()) {
+					vIsReferenced[Note.ubInstrument - 1] = true;
+				}
+			}
+		}
+	}
+	return vIsReferenced;
+}
+
+void tMod::setSamples(const std::vector<tSample> &vSamplesNew)
+{
+	m_vSamples = vSamplesNew;
+	m_vSamples.resize(SAMPLE_COUNT);
+}
+
 bool tSample::operator ==(const tSample &Other) const
 {
 	bool isSame = (
@@ -266,3 +431,396 @@ bool tSample::operator ==(const tSample &Other) const
 	);
 	return isSame;
 }
+
+bool tSample::isSameSound(const tSample &Other) const
+{
+	bool isSame = (
+		m_ubFineTune == Other.m_ubFineTune &&
+		m_uwRepeatLength == Other.m_uwRepeatLength &&
+		m_uwRepeatOffs == Other.m_uwRepeatOffs &&
+		m_vData == Other.m_vData
+	);
+	return isSame;
+}
+
+std::uint64_t tSample::getSoundHash(void) const
+{
+	// FNV-1a over data words and playback params
+	std::uint64_t ullHash = 0xCBF29CE484222325;
+	auto hashWord = [&ullHash](std::uint16_t uwWord) {
+		ullHash = (ullHash ^ (uwWord & 0xFF)) * 0x100000001B3;
+		ullHash = (ullHash ^ (uwWord >> 8)) * 0x100000001B3;
+	};
+	hashWord(m_ubFineTune);
+	hashWord(m_uwRepeatOffs);
+	hashWord(m_uwRepeatLength);
+	for(const auto &uwWord: m_vData) {
+		hashWord(uwWord);
+	}
+	return ullHash;
+}
+
+namespace {
+
+/**
+ * @brief Parts of ptplayer's channel state which decide how much sample data
+ * is read by Paula. Offsets and lengths are in words.
+ */
+struct tChannelSim {
+	std::uint8_t ubSample = 0; ///< 1-based, zero if none set.
+	std::uint32_t ulStart = 0; ///< n_start, moved by 9xx until next instrument.
+	std::uint32_t ulLength = 0; ///< n_length, 9xx offsets are checked against it.
+	std::uint8_t ubLastOffset = 0; ///< n_sampleoffset, used by 9xx without arg.
+	bool isPlaying = false;
+	std::uint8_t ubPlayedSample = 0;
+	std::uint32_t ulPlayedStart = 0;
+	std::uint16_t uwPlayedPeriod = 0;
+	bool isPitchChanged = false; ///< Set if period may drop below note's one.
+	double fWordsRead = 0;
+};
+
+} // namespace
+
+tModOptimizeReport tMod::optimize(const std::vector<std::uint8_t> &vEntryPositions)
+{
+	tModOptimizeReport Report = {};
+	for(const auto ubEntryPos: vEntryPositions) {
+		if(ubEntryPos >= m_ubArrangementLength) {
+			Report.vInvalidEntryPositions.push_back(ubEntryPos);
+		}
+	}
+	if(vEntryPositions.empty() || !Report.vInvalidEntryPositions.empty()) {
+		// Nothing would be reached, so everything would be removed
+		return Report;
+	}
+
+	std::vector<bool> vIsPositionReached(m_ubArrangementLength, false);
+	std::vector<std::bitset<ROWS_PER_PATTERN>> vReachedRows(m_vPatterns.size());
+	std::vector<bool> vIsSampleUsed(m_vSamples.size(), false);
+	std::vector<std::uint32_t> vReachedWords(m_vSamples.size(), 0);
+	bool isReadPastEnd = false;
+
+	auto endNote = [&](tChannelSim &Chan, bool isPlayedToEnd) {
+		if(!Chan.isPlaying) {
+			return;
+		}
+		Chan.isPlaying = false;
+		// ptplayer starts DMA with whole sample's length even after 9xx moved
+		// the start, then it switches to the loop
+		std::uint32_t ulSampleLength = std::uint32_t(
+			m_vSamples[Chan.ubPlayedSample - 1].m_vData.size()
+		);
+		std::uint32_t ulRead = ulSampleLength;
+		if(!isPlayedToEnd) {
+			ulRead = std::min(ulRead, std::uint32_t(
+				std::ceil(Chan.fWordsRead) + SIMULATION_FETCH_MARGIN
+			));
+		}
+		if(Chan.ulPlayedStart + ulRead > ulSampleLength) {
+			// Data past the sample end belongs to samples stored after it
+			isReadPastEnd = true;
+		}
+		auto &ulReached = vReachedWords[Chan.ubPlayedSample - 1];
+		ulReached = std::max(
+			ulReached, std::min(ulSampleLength, Chan.ulPlayedStart + ulRead)
+		);
+	};
+
+	// Simulate playback the same way as ptplayer does
+	for(const auto ubEntryPos: vEntryPositions) {
+		std::uint8_t ubPos = ubEntryPos;
+		std::uint8_t ubRow = 0;
+		std::uint8_t ubSpeed = 6;
+		std::uint8_t ubTempo = 125;
+		std::array<std::uint8_t, 4> LoopStarts = {0};
+		std::array<std::uint8_t, 4> LoopCounts = {0};
+		std::array<tChannelSim, 4> Channels;
+		std::set<std::pair<std::uint8_t, std::uint8_t>> sVisited;
+		std::uint8_t ubRepeat = 0;
+		for(std::uint32_t ulStep = 0; ulStep < SIMULATION_MAX_ROWS; ++ulStep) {
+			// Same row with no loops in progress means that song repeats.
+			// Play it once more, so that notes also start with channel state left
+			// by the previous repeat. Then only let the notes which are still
+			// playing run until their channels get retriggered.
+			bool isLooping = std::any_of(
+				LoopCounts.begin(), LoopCounts.end(), [](auto Count) {return Count != 0;}
+			);
+			if(!isLooping && !sVisited.emplace(ubPos, ubRow).second) {
+				if(++ubRepeat > 2) {
+					break;
+				}
+				sVisited = {{ubPos, ubRow}};
+			}
+			bool isDraining = (ubRepeat == 2);
+			if(isDraining && std::none_of(
+				Channels.begin(), Channels.end(),
+				[](const tChannelSim &Chan) {return Chan.isPlaying;}
+			)) {
+				break;
+			}
+
+			vIsPositionReached[ubPos] = true;
+			auto ubPatternIdx = m_vArrangement[ubPos];
+			if(ubPatternIdx >= m_vPatterns.size()) {
+				break;
+			}
+			vReachedRows[ubPatternIdx].set(ubRow);
+			const auto &Row = m_vPatterns[ubPatternIdx][ubRow];
+
+			// Speed, tempo and pattern delay apply to the row they're on
+			std::uint8_t ubRowDelay = 0;
+			for(const auto &Note: Row) {
+				if(Note.ubCmd == 0xF && Note.ubCmdArg) {
+					if(Note.ubCmdArg < 0x20) {
+						ubSpeed = Note.ubCmdArg;
+					}
+					else {
+						ubTempo = Note.ubCmdArg;
+					}
+				}
+				else if(Note.ubCmd == 0xE && (Note.ubCmdArg >> 4) == 0xE) {
+					ubRowDelay = std::max<std::uint8_t>(ubRowDelay, Note.ubCmdArg & 0xF);
+				}
+			}
+			double fRowSeconds = ubSpeed * (1 + ubRowDelay) * std::max(
+				2.5 / ubTempo, 1.0 / SIMULATION_TICK_MIN_RATE
+			);
+			auto getRowWords = [fRowSeconds](const tChannelSim &Chan) {
+				// Finetune may lower the period by up to 7/8 of semitone
+				std::uint16_t uwPeriod = Chan.isPitchChanged ?
+					SIMULATION_PERIOD_MIN : (Chan.uwPlayedPeriod * 15) / 16;
+				uwPeriod = std::max<std::uint16_t>(uwPeriod, SIMULATION_PERIOD_MIN);
+				return fRowSeconds * SIMULATION_PAULA_CLOCK / (2 * uwPeriod);
+			};
+
+			std::optional<std::uint8_t> oJumpPos, oBreakRow, oLoopRow;
+			for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
+				const auto &Note = Row[ubChan];
+				auto &Chan = Channels[ubChan];
+				std::uint8_t ubCmdE = Note.ubCmdArg >> 4;
+				if(Note.ubInstrument && Note.ubInstrument <= vIsSampleUsed.size()) {
+					vIsSampleUsed[Note.ubInstrument - 1] = true;
+					const auto &Sample = m_vSamples[Note.ubInstrument - 1];
+					// ptplayer plays first word of first sample for empty ones
+					Chan.ubSample = Sample.m_vData.empty() ? 0 : Note.ubInstrument;
+					Chan.ulStart = 0;
+					Chan.ulLength = std::uint32_t(
+						Sample.m_uwRepeatLength > 1 ?
+						Sample.m_uwRepeatLength : Sample.m_vData.size()
+					);
+				}
+				auto applySampleOffset = [&Chan, &Note]() {
+					// Same as ptplayer's mt_sampleoffset()
+					if(Note.ubCmdArg) {
+						Chan.ubLastOffset = Note.ubCmdArg;
+					}
+					std::uint32_t ulOffset = Chan.ubLastOffset * 128;
+					if(ulOffset < Chan.ulLength) {
+						Chan.ulLength -= ulOffset;
+						Chan.ulStart += ulOffset;
+					}
+					else {
+						Chan.ulLength = 1;
+					}
+				};
+				bool isTonePorta = (Note.ubCmd == 0x3 || Note.ubCmd == 0x5);
+				if(Note.uwPeriod && !isTonePorta) {
+					if(Note.ubCmd == 0x9) {
+						applySampleOffset();
+					}
+					if(Note.ubCmd == 0xE && ubCmdE == 0xD && Chan.isPlaying) {
+						// Previous note plays until the delay ends
+						Chan.fWordsRead += getRowWords(Chan);
+					}
+					endNote(Chan, false);
+					if(Chan.ubSample && !isDraining) {
+						Chan.isPlaying = true;
+						Chan.ubPlayedSample = Chan.ubSample;
+						Chan.ulPlayedStart = Chan.ulStart;
+						Chan.uwPlayedPeriod = Note.uwPeriod;
+						Chan.isPitchChanged = false;
+						Chan.fWordsRead = 0;
+					}
+				}
+				if(Note.ubCmd == 0x9) {
+					// ptplayer applies 9xx once more after the note is triggered,
+					// which moves the start of next notes without instrument
+					applySampleOffset();
+				}
+				bool isPitchChange = (
+					(Note.ubCmd == 0x0 && Note.ubCmdArg) || isTonePorta ||
+					Note.ubCmd == 0x1 || Note.ubCmd == 0x4 || Note.ubCmd == 0x6 ||
+					(Note.ubCmd == 0xE && (ubCmdE == 0x1 || ubCmdE == 0x5))
+				);
+				if(isPitchChange) {
+					Chan.isPitchChanged = true;
+				}
+
+				if(Note.ubCmd == 0xB) {
+					oJumpPos = Note.ubCmdArg & 0x7F;
+					oBreakRow = 0;
+				}
+				else if(Note.ubCmd == 0xD) {
+					std::uint8_t ubHi = Note.ubCmdArg >> 4;
+					std::uint8_t ubBreakRow = (ubHi <= 9 ? ubHi * 10 : 0) + (Note.ubCmdArg & 0xF);
+					oBreakRow = (ubBreakRow < ROWS_PER_PATTERN) ? ubBreakRow : 0;
+					if(!oJumpPos.has_value()) {
+						oJumpPos = ubPos + 1;
+					}
+				}
+				else if(Note.ubCmd == 0xE && ubCmdE == 0x6) {
+					std::uint8_t ubLoopArg = Note.ubCmdArg & 0xF;
+					if(!ubLoopArg) {
+						LoopStarts[ubChan] = ubRow;
+					}
+					else if(LoopCounts[ubChan] == 0) {
+						LoopCounts[ubChan] = ubLoopArg;
+						oLoopRow = LoopStarts[ubChan];
+					}
+					else if(--LoopCounts[ubChan] != 0) {
+						oLoopRow = LoopStarts[ubChan];
+					}
+				}
+			}
+			for(auto &Chan: Channels) {
+				if(Chan.isPlaying) {
+					Chan.fWordsRead += getRowWords(Chan);
+				}
+			}
+
+			// Advance to next row
+			if(oJumpPos.has_value()) {
+				ubPos = oJumpPos.value();
+				ubRow = oBreakRow.value_or(0);
+			}
+			else if(oLoopRow.has_value()) {
+				ubRow = oLoopRow.value();
+			}
+			else if(++ubRow >= ROWS_PER_PATTERN) {
+				ubRow = 0;
+				++ubPos;
+			}
+			if(ubPos >= m_ubArrangementLength) {
+				// ptplayer restarts song from the beginning
+				ubPos = 0;
+			}
+		}
+
+		// Notes which are never retriggered may go on until sample end
+		for(auto &Chan: Channels) {
+			endNote(Chan, true);
+		}
+	}
+
+	// Remove unreachable positions and adjust position jumps
+	std::vector<std::uint8_t> vPosRemap(128, 0);
+	std::vector<std::uint8_t> vArrangementNew;
+	for(std::uint8_t ubPos = 0; ubPos < m_ubArrangementLength; ++ubPos) {
+		if(vIsPositionReached[ubPos]) {
+			vPosRemap[ubPos] = std::uint8_t(vArrangementNew.size());
+			vArrangementNew.push_back(m_vArrangement[ubPos]);
+		}
+	}
+	Report.ubPositionsRemoved = std::uint8_t(m_ubArrangementLength - vArrangementNew.size());
+	for(const auto ubEntryPos: vEntryPositions) {
+		Report.vEntryPositions.push_back(vPosRemap[ubEntryPos]);
+	}
+	if(m_ubSongEndPos < m_ubArrangementLength) {
+		// Point restart position at first position kept after it
+		std::uint8_t ubPos = m_ubSongEndPos;
+		while(ubPos < m_ubArrangementLength && !vIsPositionReached[ubPos]) {
+			++ubPos;
+		}
+		m_ubSongEndPos = (ubPos < m_ubArrangementLength) ? vPosRemap[ubPos] : 0;
+	}
+
+	// Remove unused patterns, clear unreachable rows
+	std::vector<std::uint8_t> vPatternRemap(256, 0);
+	std::vector<bool> vIsPatternUsed(m_vPatterns.size(), false);
+	for(const auto ubPatternIdx: vArrangementNew) {
+		if(ubPatternIdx < m_vPatterns.size()) {
+			vIsPatternUsed[ubPatternIdx] = true;
+		}
+	}
+	decltype(m_vPatterns) vPatternsNew;
+	for(std::size_t PatternIdx = 0; PatternIdx < m_vPatterns.size(); ++PatternIdx) {
+		if(!vIsPatternUsed[PatternIdx]) {
+			++Report.ubPatternsRemoved;
+			continue;
+		}
+		vPatternRemap[PatternIdx] = std::uint8_t(vPatternsNew.size());
+		auto Pattern = m_vPatterns[PatternIdx];
+		for(std::uint8_t ubRow = 0; ubRow < ROWS_PER_PATTERN; ++ubRow) {
+			auto &Row = Pattern[ubRow];
+			if(!vReachedRows[PatternIdx].test(ubRow)) {
+				bool isEmpty = std::all_of(Row.begin(), Row.end(), [](const tNote &Note) {
+					return !Note.ubInstrument && !Note.uwPeriod && !Note.ubCmd && !Note.ubCmdArg;
+				});
+				if(!isEmpty) {
+					Row.fill(tNote{0, 0, 0, 0});
+					++Report.ulRowsCleared;
+				}
+				continue;
+			}
+			for(auto &Note: Row) {
+				if(Note.ubCmd == 0xB) {
+					Note.ubCmdArg = vPosRemap[Note.ubCmdArg & 0x7F];
+				}
+			}
+		}
+		vPatternsNew.push_back(std::move(Pattern));
+	}
+	Report.ulPatternBytesSaved = Report.ubPatternsRemoved * 1024;
+	m_vPatterns = std::move(vPatternsNew);
+
+	m_ubArrangementLength = std::uint8_t(vArrangementNew.size());
+	for(auto &ubPatternIdx: vArrangementNew) {
+		ubPatternIdx = vPatternRemap[ubPatternIdx];
+	}
+	vArrangementNew.resize(128, 0);
+	m_vArrangement = std::move(vArrangementNew);
+
+	// Remove unused samples, truncate used ones after the furthest word read
+	if(isReadPastEnd) {
+		fmt::print(
+			"WARN: 9xx offsets make ptplayer read data past sample end, "
+			"samples won't be truncated\n"
+		);
+	}
+	for(std::size_t SampleIdx = 0; SampleIdx < m_vSamples.size(); ++SampleIdx) {
+		auto &Sample = m_vSamples[SampleIdx];
+		std::uint32_t ulOldSize = std::uint32_t(Sample.m_vData.size() * sizeof(Sample.m_vData[0]));
+		if(!ulOldSize) {
+			continue;
+		}
+		if(!vIsSampleUsed[SampleIdx]) {
+			Sample.m_vData.clear();
+			Sample.m_uwRepeatOffs = 0;
+			Sample.m_uwRepeatLength = 1;
+			++Report.ubSamplesRemoved;
+		}
+		else if(!isReadPastEnd) {
+			// Looped part is played after first pass, non-looped one replays
+			// the first word
+			std::size_t KeptSize = std::max<std::size_t>(1, vReachedWords[SampleIdx]);
+			if(Sample.m_uwRepeatLength > 1) {
+				KeptSize = std::max<std::size_t>(
+					KeptSize, Sample.m_uwRepeatOffs + Sample.m_uwRepeatLength
+				);
+			}
+			if(KeptSize < Sample.m_vData.size()) {
+				Sample.m_vData.resize(KeptSize);
+			}
+		}
+		std::uint32_t ulNewSize = std::uint32_t(Sample.m_vData.size() * sizeof(Sample.m_vData[0]));
+		if(ulNewSize != ulOldSize) {
+			fmt::print(
+				"Sample {} '{}': {} -> {} bytes\n",
+				SampleIdx + 1, Sample.m_szName, ulOldSize, ulNewSize
+			);
+		}
+		Report.ulSampleBytesSaved += ulOldSize - ulNewSize;
+	}
+
+	return Report;
+}
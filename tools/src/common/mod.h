@@ -12,13 +12,24 @@
 
 struct tSample {
 	std::string m_szName;
-	std::uint8_t m_ubFineTune; ///< Finetune. Only lower nibble is used. Values translate to finetune: {0..7, -8..-1}
-	std::uint8_t m_ubVolume; ///< Sample volume. 0..64
-	std::uint16_t m_uwRepeatOffs; ///< In words.
-	std::uint16_t m_uwRepeatLength; ///< In words.
+	std::uint8_t m_ubFineTune = 0; ///< Finetune. Only lower nibble is used. Values translate to finetune: {0..7, -8..-1}
+	std::uint8_t m_ubVolume = 0; ///< Sample volume. 0..64
+	std::uint16_t m_uwRepeatOffs = 0; ///< In words.
+	std::uint16_t m_uwRepeatLength = 0; ///< In words.
 
 	std::vector<uint16_t> m_vData;
 
+	/**
+	 * @brief Checks if samples sound the same, regardless of name and volume.
+	 * Compares data, loop points and finetune.
+	 */
+	bool isSameSound(const tSample &Other) const;
+
+	/**
+	 * @brief Calculates hash of fields compared by isSameSound().
+	 */
+	std::uint64_t getSoundHash(void) const;
+
 	bool operator ==(const tSample &Other) const;
 	bool operator !=(const tSample &Other) const
 	{
@@ -33,21 +44,62 @@ struct tNote {
 	std::uint8_t ubCmdArg;
 };
 
+struct tModOptimizeReport {
+	std::uint8_t ubPositionsRemoved;
+	std::uint8_t ubPatternsRemoved;
+	std::uint32_t ulRowsCleared;
+	std::uint8_t ubSamplesRemoved;
+	std::uint32_t ulPatternBytesSaved;
+	std::uint32_t ulSampleBytesSaved; ///< Sample data lives in chip RAM.
+	std::vector<std::uint8_t> vEntryPositions; ///< Entry positions after removal.
+	std::vector<std::uint8_t> vInvalidEntryPositions; ///< Past arrangement end.
+};
+
 class tMod {
 public:
+	/**
+	 * @brief Reorder value which removes sample from notes using it.
+	 */
+	static constexpr std::uint8_t s_ubSampleUnused = 0xFF;
+
 	tMod(const std::string &szFileName);
 
-	void toMod(const std::string &szFileName, bool isSkipSampleData);
+	/**
+	 * @brief Writes module to file.
+	 *
+	 * @param szFileName Output file path.
+	 * @param isSkipSampleData If set, sample data isn't written, e.g. because
+	 * it's stored in samplepack.
+	 * @param isPackPatterns If set, patterns are deduplicated and stored in
+	 * ACE's packed format, readable only by ptplayer. See packPatterns().
+	 * @return Size of written pattern data, including packed format's tables.
+	 */
+	std::uint32_t toMod(
+		const std::string &szFileName, bool isSkipSampleData,
+		bool isPackPatterns = false
+	);
+
+	/**
+	 * @brief Returns size of raw pattern data, as stored in regular .mod file.
+	 */
+	std::uint32_t getRawPatternsSize(void) const;
 
 	const std::vector<tSample> &getSamples(void) const;
 
 	const std::string &getSongName(void) const;
 
-	void setSamples(std::vector<tSample> &vSamplesNew);
+	/**
+	 * @brief Replaces sample definitions of module.
+	 * Patterns aren't changed. Missing samples up to 31 are added as empty.
+	 *
+	 * @param vSamplesNew New sample definitions, up to 31.
+	 */
+	void setSamples(const std::vector<tSample> &vSamplesNew);
 
 	/**
 	 * @brief Reorder samples in module using the index array.
-	 * Reorder values for empty samples are ignored.
+	 * Sample defs aren't moved for empty samples and ones reordered to
+	 * s_ubSampleUnused. Notes using the latter are set to instrument 0 (none).
 	 *
 	 * @param vNewOrder Vector index is old sample idx, value is new sample idx.
 	 */
@@ -55,7 +107,52 @@ public:
 
 	void clearSampleData(void);
 
+	/**
+	 * @brief Checks which samples are used by notes of arranged patterns.
+	 *
+	 * @return Vector index is zero-based sample idx, value is true if used.
+	 */
+	std::vector<bool> getReferencedSamples(void) const;
+
+	/**
+	 * @brief Removes data which never gets played.
+	 * Playback is simulated from each entry position, following arrangement,
+	 * position jumps, pattern breaks and pattern loops. Then following is done:
+	 * - unreachable arrangement positions are removed, with position jumps
+	 *   adjusted accordingly,
+	 * - unused patterns are removed and unreachable rows are cleared,
+	 * - samples never triggered are removed,
+	 * - samples are truncated after the furthest word any of their notes may
+	 *   read, keeping loops intact. Note lengths come from speed, tempo
+	 *   and period, assuming worst case for pitch effects and finetune.
+	 *   Notes still playing when song repeats are assumed to play to the end.
+	 *   Nothing is truncated if 9xx makes playback read past sample end.
+	 * Restart position is moved along with removed positions.
+	 * If any entry position is past arrangement end, or none is given,
+	 * module is left unchanged.
+	 *
+	 * @param vEntryPositions Positions from which playback may start.
+	 * @return Summary of removed data. Invalid entry positions are listed
+	 * in vInvalidEntryPositions.
+	 */
+	tModOptimizeReport optimize(const std::vector<std::uint8_t> &vEntryPositions);
+
 private:
+	struct tPackedPatterns {
+		std::vector<std::uint8_t> vArrangement;
+		std::vector<std::uint16_t> vChannelOffsets; ///< 4 stream offsets per pattern.
+		std::vector<std::uint8_t> vStreams;
+	};
+
+	/**
+	 * @brief Packs patterns into per-channel streams.
+	 * Identical patterns are merged and arrangement is adjusted accordingly.
+	 * Each channel of pattern is stored as stream of 4-byte notes, with runs
+	 * of empty notes replaced by single byte 0x80 | (runLength - 1).
+	 * Identical channel streams are stored only once.
+	 */
+	tPackedPatterns packPatterns(void) const;
+
 	std::string m_szSongName;
 	std::uint8_t m_ubArrangementLength; ///< End pattern idx? Jumps are possible.
 	std::uint8_t m_ubSongEndPos;
@@ -0,0 +1,119 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "resampler.h"
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+// Independent accumulators in dot product - allows compiler to vectorize it
+// without relaxing float math rules. Tap count is padded to multiple of it.
+static constexpr std::uint32_t s_ulLaneCount = 8;
+
+// Kaiser window shape, ~80dB stopband attenuation
+static constexpr double s_fKaiserBeta = 8.0;
+
+// Cutoff slightly below Nyquist so that transition band doesn't alias
+static constexpr double s_fCutoffRatio = 0.95;
+
+static double besselI0(double fX) {
+	// Power series, converges quickly for window's argument range
+	double fSum = 1.0, fTerm = 1.0;
+	for(std::uint32_t k = 1; k < 50; ++k) {
+		fTerm *= (fX / (2.0 * k)) * (fX / (2.0 * k));
+		fSum += fTerm;
+		if(fTerm < fSum * 1e-12) {
+			break;
+		}
+	}
+	return fSum;
+}
+
+tResampler::tResampler(
+	std::uint32_t ulRateIn, std::uint32_t ulRateOut, std::uint8_t ubZeroCrossings
+)
+{
+	auto Gcd = std::gcd(ulRateIn, ulRateOut);
+	m_ulStepIn = ulRateIn / Gcd;
+	m_ulStepOut = ulRateOut / Gcd;
+	m_ulPhaseCount = std::min(m_ulStepOut, s_ulMaxPhases);
+
+	// Cutoff as a fraction of input Nyquist frequency. When downsampling,
+	// filter needs to get proportionally longer to keep its steepness.
+	double fCutoff = std::min(1.0, double(ulRateOut) / ulRateIn) * s_fCutoffRatio;
+	m_ulHalfLength = std::uint32_t(std::ceil(ubZeroCrossings / fCutoff));
+	m_ulTapCount = (
+		(2 * m_ulHalfLength + s_ulLaneCount - 1) / s_ulLaneCount
+	) * s_ulLaneCount;
+
+	// Taps of each phase start at input sample (m_ulHalfLength - 1) before
+	// the output position and are normalized for unity gain at DC.
+	m_vTaps.resize(m_ulPhaseCount * m_ulTapCount, 0);
+	double fWindowNorm = besselI0(s_fKaiserBeta);
+	for(std::uint32_t ulPhase = 0; ulPhase < m_ulPhaseCount; ++ulPhase) {
+		double fFrac = double(ulPhase) / m_ulPhaseCount;
+		float *pTaps = &m_vTaps[ulPhase * m_ulTapCount];
+		double fSum = 0;
+		for(std::uint32_t i = 0; i < 2 * m_ulHalfLength; ++i) {
+			double fDist = double(i) - (m_ulHalfLength - 1) - fFrac;
+			double fWindowPos = fDist / m_ulHalfLength;
+			if(std::abs(fWindowPos) >= 1.0) {
+				continue;
+			}
+			double fX = M_PI * fDist * fCutoff;
+			double fSinc = (fX == 0) ? 1.0 : std::sin(fX) / fX;
+			double fWindow = besselI0(
+				s_fKaiserBeta * std::sqrt(1.0 - fWindowPos * fWindowPos)
+			) / fWindowNorm;
+			pTaps[i] = float(fSinc * fWindow);
+			fSum += pTaps[i];
+		}
+		for(std::uint32_t i = 0; i < m_ulTapCount; ++i) {
+			pTaps[i] = float(pTaps[i] / fSum);
+		}
+	}
+}
+
+std::vector<float> tResampler::process(const std::vector<float> &vIn) const
+{
+	std::uint64_t ullOutCount = (
+		std::uint64_t(vIn.size()) * m_ulStepOut + m_ulStepIn - 1
+	) / m_ulStepIn;
+
+	// Zero padding on both sides so that inner loop needs no bound checks
+	std::vector<float> vPadded(m_ulHalfLength + vIn.size() + m_ulTapCount + 1, 0);
+	std::copy(vIn.begin(), vIn.end(), vPadded.begin() + m_ulHalfLength);
+
+	std::vector<float> vOut(ullOutCount);
+	for(std::uint64_t ullOut = 0; ullOut < ullOutCount; ++ullOut) {
+		// Output position in input samples, with remainder in 1/m_ulStepOut units
+		std::uint64_t ullPos = ullOut * m_ulStepIn;
+		std::uint64_t ullIn = ullPos / m_ulStepOut;
+		std::uint64_t ullRem = ullPos % m_ulStepOut;
+		std::uint32_t ulPhase = std::uint32_t(
+			(ullRem * m_ulPhaseCount + m_ulStepOut / 2) / m_ulStepOut
+		);
+		if(ulPhase == m_ulPhaseCount) {
+			ulPhase = 0;
+			++ullIn;
+		}
+
+		// vPadded[m_ulHalfLength + ullIn] is the input sample at output position,
+		// taps start (m_ulHalfLength - 1) samples before it.
+		const float *pIn = &vPadded[ullIn + 1];
+		const float *pTaps = &m_vTaps[ulPhase * m_ulTapCount];
+		float pAcc[s_ulLaneCount] = {0};
+		for(std::uint32_t i = 0; i < m_ulTapCount; i += s_ulLaneCount) {
+			for(std::uint32_t ulLane = 0; ulLane < s_ulLaneCount; ++ulLane) {
+				pAcc[ulLane] += pIn[i + ulLane] * pTaps[i + ulLane];
+			}
+		}
+		float fOut = 0;
+		for(std::uint32_t ulLane = 0; ulLane < s_ulLaneCount; ++ulLane) {
+			fOut += pAcc[ulLane];
+		}
+		vOut[ullOut] = fOut;
+	}
+	return vOut;
+}
@@ -0,0 +1,55 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_RESAMPLER_H_
+#define _ACE_TOOLS_COMMON_RESAMPLER_H_
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Polyphase windowed-sinc sample rate converter.
+ * Filter taps for each fractional position (phase) are precomputed, so that
+ * each output sample is a single dot product of contiguous input samples
+ * and contiguous taps, which compilers can easily vectorize.
+ *
+ * When rate ratio needs too many phases, phase is rounded to the nearest
+ * of the precomputed ones - error of that is way below 8-bit output's noise.
+ */
+class tResampler {
+public:
+	/**
+	 * @brief Prepares filter bank for given rate conversion.
+	 *
+	 * @param ulRateIn Input sample rate, in Hz.
+	 * @param ulRateOut Output sample rate, in Hz.
+	 * @param ubZeroCrossings Sinc zero crossings on each side of filter
+	 * at the lower of both rates. More gives steeper cutoff at the cost
+	 * of speed.
+	 */
+	tResampler(
+		std::uint32_t ulRateIn, std::uint32_t ulRateOut,
+		std::uint8_t ubZeroCrossings = 16
+	);
+
+	/**
+	 * @brief Converts whole sample buffer to output rate.
+	 *
+	 * @param vIn Input samples.
+	 * @return Resampled samples.
+	 */
+	std::vector<float> process(const std::vector<float> &vIn) const;
+
+private:
+	static constexpr std::uint32_t s_ulMaxPhases = 1024;
+
+	std::uint32_t m_ulStepIn; ///< Input samples advanced per m_ulStepOut outputs.
+	std::uint32_t m_ulStepOut;
+	std::uint32_t m_ulPhaseCount;
+	std::uint32_t m_ulHalfLength; ///< Filter half length, in input samples.
+	std::uint32_t m_ulTapCount; ///< Taps per phase, padded for vectorization.
+	std::vector<float> m_vTaps; ///< m_ulTapCount taps for each phase.
+};
+
+#endif // _ACE_TOOLS_COMMON_RESAMPLER_H_
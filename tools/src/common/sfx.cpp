@@ -5,102 +5,141 @@
 #include "sfx.h"
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include "logging.h"
 #include "endian.h"
+#include "resampler.h"
+#include "fib_delta.h"
 
 tSfx::tSfx(void):
 	m_ulFreq(0)
 {
 }
 
-tSfx::tSfx(const tWav &Wav, bool isStrict):
+tSfx::tSfx(const tWav &Wav, bool isStrict, std::uint32_t ulTargetRate):
 	tSfx()
 {
-	auto vWavData = Wav.getData();
 	m_ulFreq = Wav.getSampleRate();
 	auto BitsPerSample = Wav.getBitsPerSample();
-
-	if(BitsPerSample == 8) {
-		// Convert 8-bit unsigned to signed - https://wiki.multimedia.cx/index.php/PCM#Sign
-		for(const auto &UnsignedSample: vWavData) {
-			std::int8_t bSample = UnsignedSample - 128;
-			m_vData.push_back(bSample);
-		}
-	}
-	else if(BitsPerSample == 16) {
-		nLog::warn("Got 16bps, expected 8bps. Resample your .wav in proper audio program!");
+	if(BitsPerSample != 8 || Wav.isFloat()) {
+		nLog::warn(
+			"Got {}bps{}, expected 8bps. Resample your .wav in proper audio program!",
+			BitsPerSample, Wav.isFloat() ? " float" : ""
+		);
 		if(isStrict) {
 			nLog::error("Strict mode - aborting...");
 			return;
 		}
-		nLog::warn("Resampling data - may result in poor results!");
-		auto DataSize = vWavData.size();
-		for(std::uint32_t i = 0; i < DataSize; i += 2) {
-			std::uint16_t uwRawSample = vWavData[i + 0] | (vWavData[i + 1] << 8);
-			auto *pAsSigned = reinterpret_cast<std::int16_t *>(&uwRawSample);
-			m_vData.push_back(*pAsSigned / 256);
-		}
+		nLog::warn("Reducing to 8bps - may result in poor results!");
+	}
+	if(Wav.getChannelCount() > 1) {
+		fmt::print("Down-mixing {} channels to mono\n", Wav.getChannelCount());
+	}
+
+	auto vSamples = Wav.getSamplesMono();
+	if(ulTargetRate != 0 && ulTargetRate != m_ulFreq) {
+		fmt::print("Resampling from {} Hz to {} Hz\n", m_ulFreq, ulTargetRate);
+		vSamples = tResampler(m_ulFreq, ulTargetRate).process(vSamples);
+		m_ulFreq = ulTargetRate;
+	}
+
+	// Scale to 8-bit range, quantization is done when writing
+	m_vSamples.reserve(vSamples.size() + 1);
+	for(const auto &fSample: vSamples) {
+		m_vSamples.push_back(fSample * 128.0f);
 	}
 
 	// Needs even number of bytes - Amiga reads it as words
-	if(m_vData.size() & 1) {
-		m_vData.push_back(0);
+	if(m_vSamples.size() & 1) {
+		m_vSamples.push_back(0);
 	}
 }
 
-bool tSfx::toSfx(const std::string &szPath) const {
+std::uint32_t tSfx::getSampleRate(void) const
+{
+	return m_ulFreq;
+}
+
+static std::int8_t toSample8(float fSample) {
+	return std::int8_t(std::clamp<long>(std::lround(fSample), -128, 127));
+}
+
+bool tSfx::toSfx(const std::string &szPath, tCompression eCompression) const {
 	std::ofstream FileOut(szPath, std::ios::binary);
 
-	const std::uint8_t ubVersion = 1;
-	const std::uint16_t uwWordLength = nEndian::toBig16(uint16_t(m_vData.size() / 2));
+	std::vector<std::int8_t> vData(m_vSamples.size());
+	std::transform(m_vSamples.begin(), m_vSamples.end(), vData.begin(), toSample8);
+
+	const std::uint8_t ubVersion = (eCompression == tCompression::NONE) ? 1 : 2;
+	std::size_t WordLength = vData.size() / 2;
+	if(WordLength > std::numeric_limits<std::uint16_t>::max()) {
+		// Ptplayer's streams take length from file size instead
+		nLog::warn(
+			"'{}' is too long for ptplayerSfxCreateFromFd(), use ptplayerStreamCreateFromFd() instead",
+			szPath
+		);
+		WordLength = std::numeric_limits<std::uint16_t>::max();
+	}
+	const std::uint16_t uwWordLength = nEndian::toBig16(uint16_t(WordLength));
 	const std::uint16_t uwSampleReateHz = nEndian::toBig16(m_ulFreq);
 
 	FileOut.write(reinterpret_cast<const char*>(&ubVersion), sizeof(ubVersion));
 	FileOut.write(reinterpret_cast<const char*>(&uwWordLength), sizeof(uwWordLength));
 	FileOut.write(reinterpret_cast<const char*>(&uwSampleReateHz), sizeof(uwSampleReateHz));
-	FileOut.write(reinterpret_cast<const char*>(m_vData.data()), m_vData.size());
+	if(eCompression == tCompression::NONE) {
+		FileOut.write(reinterpret_cast<const char*>(vData.data()), vData.size());
+	}
+	else {
+		// v2 has compression type byte after v1 header
+		const std::uint8_t ubCompression = std::uint8_t(eCompression);
+		auto vEncoded = nFibDelta::encode(vData);
+		FileOut.write(reinterpret_cast<const char*>(&ubCompression), sizeof(ubCompression));
+		FileOut.write(reinterpret_cast<const char*>(vEncoded.data()), vEncoded.size());
+	}
 
 	return true;
 }
 
 bool tSfx::isEmpty(void) const
 {
-	return m_vData.empty();
+	return m_vSamples.empty();
 }
 
 std::uint32_t tSfx::getLength(void) const
 {
-	return m_vData.size();
+	return m_vSamples.size();
 }
 
 void tSfx::normalize(void)
 {
 	// Get the biggest amplitude - negative or positive
-	std::int8_t bMaxAmplitude = 0;
-	for(const auto &Sample: m_vData) {
-		auto Amplitude = abs(Sample);
-		if(Amplitude > bMaxAmplitude) {
-			bMaxAmplitude = int8_t(Amplitude);
-		}
+	float fMaxAmplitude = 0;
+	for(const auto &Sample: m_vSamples) {
+		fMaxAmplitude = std::max(fMaxAmplitude, std::abs(Sample));
+	}
+	if(fMaxAmplitude == 0) {
+		return;
 	}
 
 	// Scale samples
-	for(auto &Sample: m_vData) {
-		Sample = (Sample * std::numeric_limits<int8_t>::max()) / bMaxAmplitude;
+	float fScale = std::numeric_limits<int8_t>::max() / fMaxAmplitude;
+	for(auto &Sample: m_vSamples) {
+		Sample *= fScale;
 	}
 }
 
 void tSfx::divideAmplitude(std::uint8_t ubDivisor)
 {
-	for(auto &Sample: m_vData) {
+	for(auto &Sample: m_vSamples) {
 		Sample /= ubDivisor;
 	}
 }
 
 bool tSfx::isFittingMaxAmplitude(std::int8_t bMaxAmplitude) const
 {
-	for(auto &Sample: m_vData) {
-		if(Sample > bMaxAmplitude) {
+	for(auto &Sample: m_vSamples) {
+		if(toSample8(Sample) > bMaxAmplitude) {
 			return false;
 		}
 	}
@@ -108,33 +147,78 @@ bool tSfx::isFittingMaxAmplitude(std::int8_t bMaxAmplitude) const
 }
 
 bool tSfx::hasEmptyFirstWord(void) const {
-	return m_vData[0] == 0 && m_vData[1] == 0;
+	return toSample8(m_vSamples[0]) == 0 && toSample8(m_vSamples[1]) == 0;
 }
 
 void tSfx::enforceEmptyFirstWord(void) {
 	while(!hasEmptyFirstWord()) {
-		m_vData.push_back(0);
-		std::rotate(m_vData.rbegin(), m_vData.rbegin() + 1, m_vData.rend());
+		m_vSamples.push_back(0);
+		std::rotate(m_vSamples.rbegin(), m_vSamples.rbegin() + 1, m_vSamples.rend());
 	}
 }
 
 void tSfx::padContents(std::uint8_t ubAlignment) {
-		std::uint8_t ubAddCount = m_vData.size() % ubAlignment;
+		std::uint8_t ubAddCount = (ubAlignment - m_vSamples.size() % ubAlignment) % ubAlignment;
 		for(std::uint8_t i = ubAddCount; i--;) {
-			m_vData.push_back(0);
+			m_vSamples.push_back(0);
 		}
 }
 
 tSfx tSfx::splitAfter(std::uint32_t ulSamples) {
 	tSfx Out;
-	if(m_vData.size() <= ulSamples) {
+	if(m_vSamples.size() <= ulSamples) {
 		return Out;
 	}
 
-	for(std::uint32_t ulPos = ulSamples; ulPos < m_vData.size(); ++ulPos) {
-		Out.m_vData.push_back(m_vData[ulPos]);
-	}
+	Out.m_vSamples.assign(m_vSamples.begin() + ulSamples, m_vSamples.end());
 	Out.m_ulFreq = m_ulFreq;
-	m_vData.resize(ulSamples);
+	m_vSamples.resize(ulSamples);
 	return Out;
 }
+
+void tSfx::quantize(tDither eDither)
+{
+	if(eDither == tDither::NONE) {
+		for(auto &Sample: m_vSamples) {
+			Sample = toSample8(Sample);
+		}
+		return;
+	}
+
+	// Sum of two uniform values gives triangular distribution in -1..1 LSB.
+	// Generated up front in separate pass, which compiler can vectorize:
+	// each value is a hash of its index, so there's no state carried
+	// between iterations.
+	std::vector<float> vNoise(m_vSamples.size());
+	auto hashRand = [](std::uint32_t ulCounter) {
+		// lowbias32 integer hash
+		ulCounter ^= ulCounter >> 16;
+		ulCounter *= 0x7FEB352D;
+		ulCounter ^= ulCounter >> 15;
+		ulCounter *= 0x846CA68B;
+		ulCounter ^= ulCounter >> 16;
+		return float(ulCounter >> 8) / float(1 << 24);
+	};
+	for(std::size_t i = 0; i < vNoise.size(); ++i) {
+		std::uint32_t ulCounter = 0x12345678 + std::uint32_t(i) * 2;
+		vNoise[i] = hashRand(ulCounter) - hashRand(ulCounter + 1);
+	}
+
+	if(eDither == tDither::TPDF) {
+		for(std::size_t i = 0; i < m_vSamples.size(); ++i) {
+			m_vSamples[i] = toSample8(m_vSamples[i] + vNoise[i]);
+		}
+	}
+	else {
+		// Feeding back previous quantization error shapes noise with (1 - z^-1),
+		// pushing it towards high frequencies. Error is limited so that clipped
+		// samples don't make the loop unstable.
+		float fError = 0;
+		for(std::size_t i = 0; i < m_vSamples.size(); ++i) {
+			float fWanted = m_vSamples[i] - fError;
+			float fQuantized = toSample8(fWanted + vNoise[i]);
+			fError = std::clamp(fQuantized - fWanted, -1.5f, 1.5f);
+			m_vSamples[i] = fQuantized;
+		}
+	}
+}
@@ -8,13 +8,49 @@
 #include "wav.h"
 #include <string>
 
+/**
+ * @brief Sound effect data, kept at full precision until it's written,
+ * so that all amplitude processing happens before final 8-bit quantization.
+ * Samples are stored as floats in 8-bit signed range.
+ */
 class tSfx {
 public:
-	tSfx(void);
+	enum class tDither: std::uint8_t {
+		NONE,   ///< Plain rounding.
+		TPDF,   ///< Triangular noise of +/-1 LSB, decorrelates error from signal.
+		SHAPED, ///< TPDF with first-order error feedback, moves noise up in spectrum.
+	};
+
+	enum class tCompression: std::uint8_t {
+		NONE,      ///< Raw 8-bit samples, written as .sfx v1.
+		FIB_DELTA, ///< 4-bit Fibonacci delta codes, written as .sfx v2.
+	};
 
-	tSfx(const tWav &Wav, bool isStrict);
+	tSfx(void);
 
-	bool toSfx(const std::string &szPath) const;
+	/**
+	 * @brief Converts WAV data to 8-bit mono sound effect.
+	 *
+	 * @param Wav Source WAV file. Multi-channel data is down-mixed to mono.
+	 * @param isStrict If set, conversion fails when WAV isn't 8-bit.
+	 * @param ulTargetRate If non-zero, data is resampled to given rate, in Hz.
+	 */
+	tSfx(const tWav &Wav, bool isStrict, std::uint32_t ulTargetRate = 0);
+
+	std::uint32_t getSampleRate(void) const;
+
+	/**
+	 * @brief Writes sound effect to .sfx file.
+	 * Samples are rounded to 8-bit unless quantize() was called before.
+	 *
+	 * @param szPath Output file path.
+	 * @param eCompression Compression of sample data. Fibonacci delta halves
+	 * the file size at the cost of slew rate - sharp transients get smeared.
+	 * @return True on success, otherwise false.
+	 */
+	bool toSfx(
+		const std::string &szPath, tCompression eCompression = tCompression::NONE
+	) const;
 
 	bool isEmpty(void) const;
 
@@ -34,9 +70,19 @@ public:
 
 	tSfx splitAfter(std::uint32_t ulSamples);
 
+	/**
+	 * @brief Quantizes samples to 8-bit values using given dither.
+	 * Should be done after all amplitude processing, e.g. normalize() and
+	 * divideAmplitude(). Without it, samples are rounded when written.
+	 * Dither noise is generated from fixed seed, so output is reproducible.
+	 *
+	 * @param eDither Dither type to be used.
+	 */
+	void quantize(tDither eDither);
+
 private:
 	std::uint32_t m_ulFreq;
-	std::vector<int8_t> m_vData;
+	std::vector<float> m_vSamples;
 };
 
 #endif // _ACE_TOOLS_COMMON_SFX_H_
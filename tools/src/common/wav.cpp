@@ -4,118 +4,129 @@
 
 #include "wav.h"
 #include <fstream>
-#include <sstream>
 #include <algorithm>
+#include <cstring>
 #include "logging.h"
 
 enum class tAudioFormat: std::uint16_t {
-	PCM = 1
+	PCM = 1,
+	FLOAT = 3,
+	EXTENSIBLE = 0xFFFE,
 };
 
-bool tryRead(std::ifstream &Stream, char *Buffer, std::uint32_t ulSize)
+static std::uint16_t readLe16(const std::uint8_t *pData)
 {
-	// ifstream::read doesn't return meaningful return value
-	// so here's a helper fn for it
-	Stream.read(Buffer, ulSize);
-	return Stream.good();
+	return pData[0] | (pData[1] << 8);
 }
 
-tWav::tWav(const std::string &szPath)
+static std::uint32_t readLe32(const std::uint8_t *pData)
 {
-	// Read header - chunk
-	std::string szRiffId(4, '\0');
-	std::ifstream StreamFile(szPath.c_str(), std::ios::binary);
+	return readLe16(pData) | (std::uint32_t(readLe16(pData + 2)) << 16);
+}
+
+tWav::tWav(const std::string &szPath):
+	m_DataOffset(0),
+	m_DataSize(0),
+	m_ulSampleRate(0),
+	m_ubBitsPerSample(0),
+	m_uwChannelCount(0),
+	m_isFloat(false)
+{
+	std::ifstream StreamFile(szPath.c_str(), std::ios::binary | std::ios::ate);
 	if(!StreamFile.is_open()) {
 		nLog::error("Couldn't open: '{}'", szPath);
 		return;
 	}
-	tryRead(StreamFile, szRiffId.data(), szRiffId.length());
-	if(szRiffId != "RIFF") {
-		nLog::error("Couldn't find RIFF header, got: '{}'", szRiffId);
-		return;
-	}
-
-	std::uint32_t ulChunkSize;
-	tryRead(StreamFile, reinterpret_cast<char*>(&ulChunkSize), sizeof(ulChunkSize));
+	auto FileSize = StreamFile.tellg();
+	StreamFile.seekg(0);
+	m_vFile.resize(FileSize);
+	StreamFile.read(reinterpret_cast<char*>(m_vFile.data()), FileSize);
 
-	std::string szFormat(4, '\0');
-	tryRead(StreamFile, szFormat.data(), szFormat.length());
-
-	if(szFormat != "WAVE") {
-		nLog::error("Unsupported format: '{}', expected 'WAVE'", szFormat);
+	// Read header - chunk
+	if(m_vFile.size() < 12 || memcmp(m_vFile.data(), "RIFF", 4)) {
+		nLog::error(
+			"Couldn't find RIFF header, got: '{}'",
+			std::string(m_vFile.begin(), m_vFile.begin() + std::min<std::size_t>(4, m_vFile.size()))
+		);
 		return;
 	}
-
-	// Read subchunks
-	bool isEnd = false;
-	std::string szSubchunkId(4, '\0');
-	while(tryRead(StreamFile, szSubchunkId.data(), szSubchunkId.length())) {
-		tSubchunk Subchunk;
-		Subchunk.m_szId = szSubchunkId;
-		tryRead(StreamFile, reinterpret_cast<char*>(&Subchunk.m_ulSize), sizeof(Subchunk.m_ulSize));
-		Subchunk.m_szContents.resize(Subchunk.m_ulSize);
-		tryRead(StreamFile, Subchunk.m_szContents.data(),Subchunk.m_szContents.length());
-		m_vSubchunks.push_back(std::move(Subchunk));
+	if(memcmp(&m_vFile[8], "WAVE", 4)) {
+		nLog::error(
+			"Unsupported format: '{}', expected 'WAVE'",
+			std::string(m_vFile.begin() + 8, m_vFile.begin() + 12)
+		);
+		return;
 	}
 
 	// Find and read "fmt" subchunk
-	auto *pSubchunkFmt = findSubchunk("fmt ");
-	if(pSubchunkFmt == nullptr) {
+	auto SubchunkFmt = findChunk("fmt ");
+	if(SubchunkFmt.size() < 16) {
 		nLog::error("Couldn't find WAV 'fmt' subchunk");
 		return;
 	}
-	std::stringstream StreamSubchunk(pSubchunkFmt->m_szContents);
-	tAudioFormat eAudioFormat;
-	std::uint16_t uwNumChannels, uwBlockAlign, uwBitsPerSample;
-	std::uint32_t ulSampleRate, ulByteRate;
-	StreamSubchunk.read(reinterpret_cast<char*>(&eAudioFormat), sizeof(eAudioFormat));
-	StreamSubchunk.read(reinterpret_cast<char*>(&uwNumChannels), sizeof(uwNumChannels));
-	StreamSubchunk.read(reinterpret_cast<char*>(&ulSampleRate), sizeof(ulSampleRate));
-	StreamSubchunk.read(reinterpret_cast<char*>(&ulByteRate), sizeof(ulByteRate));
-	StreamSubchunk.read(reinterpret_cast<char*>(&uwBlockAlign), sizeof(uwBlockAlign));
-	StreamSubchunk.read(reinterpret_cast<char*>(&uwBitsPerSample), sizeof(uwBitsPerSample));
-
-	if(eAudioFormat != tAudioFormat::PCM) {
+	auto eAudioFormat = tAudioFormat(readLe16(&SubchunkFmt[0]));
+	std::uint16_t uwNumChannels = readLe16(&SubchunkFmt[2]);
+	std::uint32_t ulSampleRate = readLe32(&SubchunkFmt[4]);
+	std::uint16_t uwBitsPerSample = readLe16(&SubchunkFmt[14]);
+
+	if(eAudioFormat == tAudioFormat::EXTENSIBLE && SubchunkFmt.size() >= 26) {
+		// Actual format is stored in first two bytes of subformat GUID,
+		// after cbSize, valid bits and channel mask.
+		eAudioFormat = tAudioFormat(readLe16(&SubchunkFmt[24]));
+	}
+	if(eAudioFormat != tAudioFormat::PCM && eAudioFormat != tAudioFormat::FLOAT) {
 		nLog::error("Unrecognized WAV audio format: {}", static_cast<int>(eAudioFormat));
 		return;
 	}
-	if(uwNumChannels != 1) {
+	if(uwNumChannels == 0) {
 		nLog::error("Unsupported WAV channel count: {}", uwNumChannels);
 		return;
 	}
-	if(uwBitsPerSample != 8 && uwBitsPerSample != 16) {
+	bool isFloat = (eAudioFormat == tAudioFormat::FLOAT);
+	if(
+		(isFloat && uwBitsPerSample != 32) ||
+		(!isFloat && uwBitsPerSample != 8 && uwBitsPerSample != 16 &&
+			uwBitsPerSample != 24 && uwBitsPerSample != 32)
+	) {
 		nLog::error("Unsupported WAV bps: {}", uwBitsPerSample);
 		return;
 	}
 
-	// Read "data" subchunk
-	auto *pSubchunkData = findSubchunk("data");
-	if(pSubchunkData == nullptr) {
+	// Find "data" subchunk
+	auto SubchunkData = findChunk("data");
+	if(SubchunkData.empty()) {
 		nLog::error("Couldn't find WAV 'data' subchunk");
 		return;
 	}
 
 	m_ubBitsPerSample = uwBitsPerSample;
 	m_ulSampleRate = ulSampleRate;
-	m_vData.resize(pSubchunkData->m_szContents.length());
-	memcpy(m_vData.data(), pSubchunkData->m_szContents.data(), pSubchunkData->m_szContents.length());
+	m_uwChannelCount = uwNumChannels;
+	m_isFloat = isFloat;
+	m_DataOffset = SubchunkData.data() - m_vFile.data();
+	m_DataSize = SubchunkData.size();
 }
 
-const tWav::tSubchunk *tWav::findSubchunk(const std::string &szId) const {
-	auto Subchunk = std::find_if(
-		m_vSubchunks.cbegin(), m_vSubchunks.cend(), [szId](const tSubchunk &Sc) {
-			return Sc.m_szId == szId;
+std::span<const std::uint8_t> tWav::findChunk(const char *szId) const {
+	// Subchunks start after RIFF header and are padded to even size
+	std::size_t Pos = 12;
+	while(Pos + 8 <= m_vFile.size()) {
+		std::uint32_t ulSize = readLe32(&m_vFile[Pos + 4]);
+		std::size_t Start = Pos + 8;
+		if(!memcmp(&m_vFile[Pos], szId, 4)) {
+			// Truncated files are common, use as much as there is
+			return std::span<const std::uint8_t>(
+				&m_vFile[Start], std::min<std::size_t>(ulSize, m_vFile.size() - Start)
+			);
 		}
-	);
-	if(Subchunk == m_vSubchunks.cend()) {
-		return nullptr;
+		Pos = Start + ulSize + (ulSize & 1);
 	}
-	return &*Subchunk;
+	return {};
 }
 
-const std::vector<uint8_t> &tWav::getData(void) const
+std::span<const std::uint8_t> tWav::getData(void) const
 {
-	return m_vData;
+	return std::span<const std::uint8_t>(m_vFile).subspan(m_DataOffset, m_DataSize);
 }
 
 std::uint32_t tWav::getSampleRate(void) const
@@ -127,3 +138,53 @@ std::uint8_t tWav::getBitsPerSample(void) const
 {
 	return m_ubBitsPerSample;
 }
+
+std::uint16_t tWav::getChannelCount(void) const
+{
+	return m_uwChannelCount;
+}
+
+bool tWav::isFloat(void) const
+{
+	return m_isFloat;
+}
+
+std::vector<float> tWav::getSamplesMono(void) const
+{
+	std::uint8_t ubBytesPerSample = m_ubBitsPerSample / 8;
+	std::uint32_t ulFrameSize = ubBytesPerSample * m_uwChannelCount;
+	if(!ulFrameSize) {
+		return {};
+	}
+	auto Data = getData();
+	std::uint32_t ulFrameCount = Data.size() / ulFrameSize;
+	std::vector<float> vSamples(ulFrameCount);
+
+	auto readSample = [&](const std::uint8_t *pRaw) -> float {
+		if(m_isFloat) {
+			float fSample;
+			memcpy(&fSample, pRaw, sizeof(fSample));
+			return fSample;
+		}
+		if(ubBytesPerSample == 1) {
+			// 8-bit WAV data is unsigned
+			return (pRaw[0] - 128) / 128.0f;
+		}
+		// Little-endian signed, put into top bits of 32-bit value
+		std::uint32_t ulRaw = 0;
+		for(std::uint8_t i = 0; i < ubBytesPerSample; ++i) {
+			ulRaw |= std::uint32_t(pRaw[i]) << (8 * (4 - ubBytesPerSample + i));
+		}
+		return float(static_cast<std::int32_t>(ulRaw) / 2147483648.0);
+	};
+
+	for(std::uint32_t ulFrame = 0; ulFrame < ulFrameCount; ++ulFrame) {
+		const std::uint8_t *pFrame = &Data[ulFrame * ulFrameSize];
+		float fSum = 0;
+		for(std::uint16_t uwChannel = 0; uwChannel < m_uwChannelCount; ++uwChannel) {
+			fSum += readSample(&pFrame[uwChannel * ubBytesPerSample]);
+		}
+		vSamples[ulFrame] = fSum / m_uwChannelCount;
+	}
+	return vSamples;
+}
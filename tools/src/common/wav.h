@@ -7,29 +7,49 @@
 
 #include <string>
 #include <vector>
+#include <span>
 #include <cstdint>
 
 class tWav {
 public:
+	/**
+	 * @brief Loads WAV file.
+	 * Whole file is read with single bulk read and its chunks are parsed
+	 * in place, without copying them.
+	 *
+	 * @param szPath Path to WAV file.
+	 */
 	tWav(const std::string &szPath);
 
-	const std::vector<uint8_t> &getData(void) const;
+	/**
+	 * @brief Returns raw contents of "data" chunk.
+	 * Empty if file couldn't be loaded.
+	 */
+	std::span<const std::uint8_t> getData(void) const;
 	std::uint32_t getSampleRate(void) const;
 	std::uint8_t getBitsPerSample(void) const;
+	std::uint16_t getChannelCount(void) const;
+	bool isFloat(void) const;
+
+	/**
+	 * @brief Decodes sample data to floats in range -1..1.
+	 * Supports 8, 16, 24 and 32-bit integer PCM as well as 32-bit float data.
+	 * Multi-channel data is down-mixed to mono by averaging channels.
+	 *
+	 * @return Mono samples.
+	 */
+	std::vector<float> getSamplesMono(void) const;
 
 private:
-	struct tSubchunk {
-		std::string m_szId = std::string(4, '\0');
-		std::uint32_t m_ulSize;
-		std::string m_szContents;
-	};
+	std::span<const std::uint8_t> findChunk(const char *szId) const;
 
-	const tSubchunk *findSubchunk(const std::string &szId) const;
-
-	std::vector<tSubchunk> m_vSubchunks;
-	std::vector<uint8_t> m_vData;
+	std::vector<std::uint8_t> m_vFile; ///< Whole file contents.
+	std::size_t m_DataOffset; ///< Position of "data" chunk contents in m_vFile.
+	std::size_t m_DataSize;
 	std::uint32_t m_ulSampleRate;
 	std::uint8_t m_ubBitsPerSample;
+	std::uint16_t m_uwChannelCount;
+	bool m_isFloat;
 };
 
 #endif // _ACE_TOOLS_COMMON_WAV_H_
@@ -4,6 +4,8 @@
 
 #include <map>
 #include <fstream>
+#include <atomic>
+#include <thread>
 #include "common/logging.h"
 #include "common/glyph_set.h"
 #include "common/fs.h"
@@ -36,7 +38,7 @@ void printUsage(const std::string &szAppName) {
 	print("Usage:\n\t{} inPath outType [extraOpts]\n\n", szAppName);
 	print("inPath\t- path to input. Supported types:\n");
 	print("\tTTF file.\n");
-	print("\tDirectory with PNG glyphs. All have to be of same height and named with ASCII indices of chars.\n");
+	print("\tDirectory with PNG glyphs. All have to be of same height and named with decimal codepoints of chars.\n");
 	print("\tProMotion NG's PNG font.\n");
 	print("outType\t- one of following:\n");
 	print("\tdir\tDirectory with each glyph as separate PNG\n");
@@ -50,13 +52,26 @@ void printUsage(const std::string &szAppName) {
 	// -charFile
 	print("\t-charfile \"file.txt\"\tInclude chars specified in file.txt.\n");
 	print("\t\t\t\tNewline chars (\\r, \\n) and repeats are omitted.\n\n");
+	// -charsets
+	print("\t-charsets \"a.txt,b.txt\"\tRasterize separate font for each of listed charset files.\n");
+	print("\t\t\t\tChars from -chars and -charfile are added to each of them.\n");
+	print("\t\t\t\tOutput names get suffixed with charset file name, e.g. \"out_a.fnt\".\n\n");
 	// -size
-	print("\t-size 8\t\t\tRasterize font using size of 8pt. Default: 20.\n\n");
+	print("\t-size 8\t\t\tRasterize font using size of 8pt. Default: 20.\n");
+	print("\t\t\t\tMultiple sizes may be given as list, e.g. \"8,10,12\".\n");
+	print("\t\t\t\tOutput names then get suffixed with size, e.g. \"out_8.fnt\".\n\n");
+	// -j
+	print("\t-j 4\t\t\tRasterize up to 4 fonts in parallel. Default: CPU thread count.\n\n");
 	// -out
 	print("\t-out outPath\tSpecify output path, including file name.\n");
 	print("\t\t\tDefault is same name as input with changed extension\n");
 	// -fc
-	print("\t-fc firstchar\tSpecify first ASCII character idx in ProMotion NG font. Default: 33.");
+	print("\t-fc firstchar\tSpecify first ASCII character idx in ProMotion NG font. Default: 33.\n");
+	// -atlas
+	print("\t-atlas\t\tFor fnt output, pack glyphs into 2D atlas (font version 2).\n");
+	print("\t\t\tKeeps bitmap width small and removes 16-bit offset limit.\n");
+	print("\t\t\tRequired for chars above 253, e.g. Latin Extended or Cyrillic,\n");
+	print("\t\t\tin which case texts in game need to be UTF-8 encoded.\n");
 }
 
 static std::uint32_t getCharCodeFromTok(const tJson *pJson, std::uint16_t uwTok) {
@@ -85,6 +100,142 @@ static std::uint32_t getCharCodeFromTok(const tJson *pJson, std::uint16_t uwTok)
 	return ulVal;
 }
 
+static std::vector<std::string> splitList(const std::string &szList) {
+	std::vector<std::string> vItems;
+	std::string::size_type Start = 0;
+	while(Start <= szList.length()) {
+		auto End = szList.find(',', Start);
+		if(End == std::string::npos) {
+			End = szList.length();
+		}
+		if(End > Start) {
+			vItems.push_back(szList.substr(Start, End - Start));
+		}
+		Start = End + 1;
+	}
+	return vItems;
+}
+
+static std::string readCharFile(const std::string &szPath) {
+	std::ifstream File(szPath, std::ios::binary);
+	return std::string(
+		std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>()
+	);
+}
+
+static std::string getCharsetName(const std::string &szCharsetPath) {
+	auto PosSlash = szCharsetPath.find_last_of("/\\");
+	auto szName = szCharsetPath.substr(
+		PosSlash == std::string::npos ? 0 : PosSlash + 1
+	);
+	return szName.substr(0, szName.find_last_of('.'));
+}
+
+struct tFontJob {
+	std::uint8_t ubSize;
+	std::string szCharset;
+	std::string szOutPath;
+	tGlyphSet Glyphs;
+};
+
+/**
+ * @brief Rasterizes TTF glyph sets of all jobs, using up to ulThreadCount
+ * worker threads.
+ */
+static void rasterizeJobs(
+	std::vector<tFontJob> &vJobs, const std::string &szFontPath,
+	std::uint32_t ulThreadCount
+) {
+	std::atomic<std::size_t> NextJob = 0;
+	auto Worker = [&]() {
+		for(auto i = NextJob++; i < vJobs.size(); i = NextJob++) {
+			vJobs[i].Glyphs = tGlyphSet::fromTtf(
+				szFontPath, vJobs[i].ubSize, vJobs[i].szCharset, 128
+			);
+		}
+	};
+
+	ulThreadCount = std::min<std::uint32_t>(ulThreadCount, vJobs.size());
+	if(ulThreadCount <= 1) {
+		Worker();
+		return;
+	}
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 0; i < ulThreadCount; ++i) {
+		vThreads.emplace_back(Worker);
+	}
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+}
+
+static void printAtlasMemoryReport(tGlyphSet &GlyphSet) {
+	// Sizes as allocated by fontCreateFromFd()
+	auto Packed = GlyphSet.toPackedBitmap(false);
+	std::uint32_t ulPackedChip = (Packed.m_uwWidth / 8) * Packed.m_uwHeight;
+	// Offset table is as long as the highest char code + 2
+	std::uint32_t ulPackedFast = 0;
+	auto Atlas = GlyphSet.toAtlas();
+	for(const auto &Glyph: Atlas.m_vGlyphs) {
+		ulPackedFast = std::max<std::uint32_t>(ulPackedFast, (Glyph.uwCodepoint + 2) * 2);
+	}
+	std::uint32_t ulAtlasChip = (Atlas.m_Bitmap.m_uwWidth / 8) * Atlas.m_Bitmap.m_uwHeight;
+	// Glyph table with one extra empty glyph + 256-entry lookup page
+	std::uint32_t ulAtlasFast = (Atlas.m_vGlyphs.size() + 1) * 10 + 256 * 2;
+
+	fmt::print(
+		"Single-row bitmap: {}x{}, chip: {} bytes, fast: {} bytes\n",
+		Packed.m_uwWidth, Packed.m_uwHeight, ulPackedChip, ulPackedFast
+	);
+	fmt::print(
+		"Atlas bitmap: {}x{}, chip: {} bytes, fast: {} bytes\n",
+		Atlas.m_Bitmap.m_uwWidth, Atlas.m_Bitmap.m_uwHeight, ulAtlasChip, ulAtlasFast
+	);
+	fmt::print(
+		"Chip RAM change: {:+} bytes ({:.1f}%)\n",
+		static_cast<std::int32_t>(ulAtlasChip - ulPackedChip),
+		ulPackedChip ? (100.0 * ulAtlasChip) / ulPackedChip - 100.0 : 0.0
+	);
+}
+
+static bool writeGlyphSet(
+	tGlyphSet &GlyphSet, tFontFormat eOutType, std::string szOutPath,
+	const std::string &szFontPath, bool isAtlas
+) {
+	if(eOutType == tFontFormat::DIR) {
+		if(szOutPath == szFontPath) {
+			szOutPath += ".dir";
+		}
+		GlyphSet.toDir(szOutPath);
+	}
+	else if(eOutType == tFontFormat::PNG) {
+		tChunkyBitmap FontChunky = GlyphSet.toPackedBitmap(true);
+		if(szOutPath.substr(szOutPath.length() - 4) != ".png") {
+			szOutPath += ".png";
+		}
+		FontChunky.toPng(szOutPath);
+	}
+	else if(eOutType == tFontFormat::FNT) {
+		if(szOutPath.substr(szOutPath.length() - 4) != ".fnt") {
+			szOutPath += ".fnt";
+		}
+		if(isAtlas) {
+			if(!GlyphSet.toAceFontAtlas(szOutPath)) {
+				return false;
+			}
+			printAtlasMemoryReport(GlyphSet);
+		}
+		else if(!GlyphSet.toAceFont(szOutPath)) {
+			return false;
+		}
+	}
+	else {
+		nLog::error("Unsupported output type");
+		return false;
+	}
+	return true;
+}
+
 int main(int lArgCount, const char *pArgs[])
 {
 	const std::uint8_t ubMandatoryArgCnt = 2;
@@ -100,10 +251,13 @@ int main(int lArgCount, const char *pArgs[])
 
 	// Optional args' default values
 	std::string szCharset = "";
+	std::vector<std::string> vCharsetPaths;
 	std::string szOutPath = "";
 	std::uint8_t ubFirstChar = 33;
 	std::string szRemapPath = "";
-	std::int32_t lSize = -1;
+	std::vector<std::int32_t> vSizes;
+	std::uint32_t ulThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	bool isAtlas = false;
 
 	// Search for optional args
 	for(auto ArgIndex = ubMandatoryArgCnt+1; ArgIndex < lArgCount; ++ArgIndex) {
@@ -129,21 +283,52 @@ int main(int lArgCount, const char *pArgs[])
 		}
 		else if(pArgs[ArgIndex] == std::string("-charFile") && ArgIndex < lArgCount - 1) {
 			++ArgIndex;
-			auto File = std::ifstream(pArgs[ArgIndex], std::ios::binary);
-			while(!File.eof()) {
-				char c;
-				File.read(&c, 1);
-				szCharset += c;
+			szCharset += readCharFile(pArgs[ArgIndex]);
+		}
+		else if(pArgs[ArgIndex] == std::string("-charsets") && ArgIndex < lArgCount - 1) {
+			++ArgIndex;
+			for(const auto &szPath: splitList(pArgs[ArgIndex])) {
+				vCharsetPaths.push_back(szPath);
 			}
 		}
 		else if(pArgs[ArgIndex] == std::string("-size") && ArgIndex < lArgCount - 1) {
 			++ArgIndex;
-			lSize = std::stol(pArgs[ArgIndex]);
+			try {
+				for(const auto &szSize: splitList(pArgs[ArgIndex])) {
+					vSizes.push_back(std::stol(szSize));
+				}
+			}
+			catch(std::exception Ex) {
+				nLog::error(
+					"Couldn't parse 'size' param: '{}', expected number list", pArgs[ArgIndex]
+				);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(pArgs[ArgIndex] == std::string("-j") && ArgIndex < lArgCount - 1) {
+			++ArgIndex;
+			try {
+				auto lThreadCount = std::stol(pArgs[ArgIndex]);
+				if(lThreadCount < 1) {
+					nLog::error("Illegal 'j' param: '{}', expected at least 1", lThreadCount);
+					return EXIT_FAILURE;
+				}
+				ulThreadCount = std::uint32_t(lThreadCount);
+			}
+			catch(std::exception Ex) {
+				nLog::error(
+					"Couldn't parse 'j' param: '{}', expected number", pArgs[ArgIndex]
+				);
+				return EXIT_FAILURE;
+			}
 		}
 		else if(pArgs[ArgIndex] == std::string("-remap") && ArgIndex < lArgCount - 1) {
 			++ArgIndex;
 			szRemapPath = pArgs[ArgIndex];
 		}
+		else if(pArgs[ArgIndex] == std::string("-atlas")) {
+			isAtlas = true;
+		}
 		else {
 			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
 			printUsage(pArgs[0]);
@@ -151,45 +336,105 @@ int main(int lArgCount, const char *pArgs[])
 		}
 	}
 
-	if(szCharset.length() == 0) {
+	if(szCharset.length() == 0 && vCharsetPaths.empty()) {
 		szCharset = s_szDefaultCharset;
 	}
-	if(lSize < 0) {
-		lSize = 20;
+	if(vSizes.empty()) {
+		vSizes.push_back(20);
+	}
+
+	// Determine default output path
+	if(szOutPath == "") {
+		szOutPath = szFontPath;
+		auto PosDot = szOutPath.find_last_of(".");
+		if(PosDot != std::string::npos) {
+			szOutPath = szOutPath.substr(0, PosDot);
+		}
+	}
+
+	// Prepare job for each size & charset combination
+	std::vector<tFontJob> vJobs;
+	bool isSuffixSize = vSizes.size() > 1;
+	bool isSuffixCharset = vCharsetPaths.size() > 1;
+	std::string szOutBase = szOutPath;
+	if(isSuffixSize || isSuffixCharset) {
+		auto szExt = nFs::getExt(szOutBase);
+		if(szExt == "fnt" || szExt == "png") {
+			szOutBase = nFs::removeExt(szOutBase);
+		}
+	}
+	for(auto lSize: vSizes) {
+		if(lSize <= 0 || lSize > 255) {
+			nLog::error("Invalid font size: {}", lSize);
+			return EXIT_FAILURE;
+		}
+		auto CharsetCount = vCharsetPaths.empty() ? 1 : vCharsetPaths.size();
+		for(std::size_t i = 0; i < CharsetCount; ++i) {
+			tFontJob Job;
+			Job.ubSize = std::uint8_t(lSize);
+			Job.szCharset = szCharset;
+			Job.szOutPath = szOutBase;
+			if(isSuffixSize) {
+				Job.szOutPath += fmt::format("_{}", lSize);
+			}
+			if(!vCharsetPaths.empty()) {
+				Job.szCharset += readCharFile(vCharsetPaths[i]);
+				if(isSuffixCharset) {
+					Job.szOutPath += "_" + getCharsetName(vCharsetPaths[i]);
+				}
+			}
+			vJobs.push_back(std::move(Job));
+		}
 	}
 
 	// Load glyphs from input file
-	tGlyphSet mGlyphs;
 	tFontFormat eInType = tFontFormat::INVALID;
 	if(szFontPath.find(".ttf") != std::string::npos) {
-		mGlyphs = tGlyphSet::fromTtf(szFontPath, lSize, szCharset, 128);
+		fmt::print(
+			"Rasterizing {} font(s) using {} thread(s)...\n",
+			vJobs.size(), std::min<std::size_t>(ulThreadCount, vJobs.size())
+		);
+		rasterizeJobs(vJobs, szFontPath, ulThreadCount);
 		eInType = tFontFormat::TTF;
 	}
-	else if(nFs::isDir(szFontPath)) {
-		mGlyphs = tGlyphSet::fromDir(szFontPath);
-		if(!mGlyphs.isOk()) {
-			nLog::error("Loading glyphs from dir '{}' failed", szFontPath);
+	else {
+		if(vJobs.size() > 1) {
+			nLog::error("Multiple sizes and charsets are supported only for TTF input");
+			return EXIT_FAILURE;
+		}
+		auto &Glyphs = vJobs.front().Glyphs;
+		if(nFs::isDir(szFontPath)) {
+			Glyphs = tGlyphSet::fromDir(szFontPath);
+			if(!Glyphs.isOk()) {
+				nLog::error("Loading glyphs from dir '{}' failed", szFontPath);
+				return EXIT_FAILURE;
+			}
+			eInType = tFontFormat::DIR;
+		}
+		else if(szFontPath.find(".png") != std::string::npos) {
+			// TODO param for determining whether png is pmng-format or ace format
+			Glyphs = tGlyphSet::fromPmng(szFontPath, ubFirstChar);
+			eInType = tFontFormat::PMNG;
+		}
+		else if(szFontPath.find(".fnt") != std::string::npos) {
+			Glyphs = tGlyphSet::fromAceFont(szFontPath);
+			eInType = tFontFormat::FNT;
+		}
+		else {
+			nLog::error("Unsupported font source: '{}'", pArgs[1]);
 			return EXIT_FAILURE;
 		}
-		eInType = tFontFormat::DIR;
-	}
-	else if(szFontPath.find(".png") != std::string::npos) {
-		// TODO param for determining whether png is pmng-format or ace format
-		mGlyphs = tGlyphSet::fromPmng(szFontPath, ubFirstChar);
-		eInType = tFontFormat::PMNG;
-	}
-	else if(szFontPath.find(".fnt") != std::string::npos) {
-		mGlyphs = tGlyphSet::fromAceFont(szFontPath);
-		eInType = tFontFormat::FNT;
-	}
-	else {
-		nLog::error("Unsupported font source: '{}'", pArgs[1]);
-		return EXIT_FAILURE;
 	}
-	if(eInType == tFontFormat::INVALID || !mGlyphs.isOk()) {
+	if(eInType == tFontFormat::INVALID) {
 		nLog::error("Couldn't read any font glyphs");
 		return EXIT_FAILURE;
 	}
+	for(auto &Job: vJobs) {
+		if(!Job.Glyphs.isOk()) {
+			nLog::error("Couldn't read any font glyphs for '{}'", Job.szOutPath);
+			return EXIT_FAILURE;
+		}
+	}
 
 	// Remap chars accordingly
 	if(!szRemapPath.empty()) {
@@ -210,44 +455,21 @@ int main(int lArgCount, const char *pArgs[])
 			fmt::print("Remapping {} => {}\n", From, To);
 			vFromTo.push_back({std::move(From), std::move(To)});
 		}
-		mGlyphs.remapGlyphs(vFromTo);
-	}
-
-	// Determine default output path
-	if(szOutPath == "") {
-		szOutPath = szFontPath;
-		auto PosDot = szOutPath.find_last_of(".");
-		if(PosDot != std::string::npos) {
-			szOutPath = szOutPath.substr(0, PosDot);
+		for(auto &Job: vJobs) {
+			Job.Glyphs.remapGlyphs(vFromTo);
 		}
 	}
-	if(eInType == eOutType) {
+
+	if(eInType == eOutType && !(eOutType == tFontFormat::FNT && isAtlas)) {
 		nLog::error("Output file type can't be same as input");
 		return EXIT_FAILURE;
 	}
 
-	if(eOutType == tFontFormat::DIR) {
-		if(szOutPath == szFontPath) {
-			szOutPath += ".dir";
+	for(auto &Job: vJobs) {
+		if(vJobs.size() > 1) {
+			fmt::print("Writing '{}'...\n", Job.szOutPath);
 		}
-		mGlyphs.toDir(szOutPath);
-	}
-	else {
-		if(eOutType == tFontFormat::PNG) {
-			tChunkyBitmap FontChunky = mGlyphs.toPackedBitmap(true);
-			if(szOutPath.substr(szOutPath.length() - 4) != ".png") {
-				szOutPath += ".png";
-			}
-			FontChunky.toPng(szOutPath);
-		}
-		else if(eOutType == tFontFormat::FNT) {
-			if(szOutPath.substr(szOutPath.length() - 4) != ".fnt") {
-				szOutPath += ".fnt";
-			}
-			mGlyphs.toAceFont(szOutPath);
-		}
-		else {
-			nLog::error("Unsupported output type");
+		if(!writeGlyphSet(Job.Glyphs, eOutType, Job.szOutPath, szFontPath, isAtlas)) {
 			return EXIT_FAILURE;
 		}
 	}
@@ -0,0 +1,342 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "common/endian.h"
+#include "common/logging.h"
+
+// Must match ACE's log.h
+static constexpr std::uint8_t s_ubLogVersion = 1;
+static constexpr std::uint8_t s_ubRecordFormat = 1;
+static constexpr std::uint8_t s_ubRecordMessage = 2;
+static constexpr std::uint8_t s_ubRecordText = 3;
+static constexpr std::uint8_t s_ubRecordBlockEnd = 4;
+static constexpr std::uint8_t s_ubRecordLost = 5;
+static constexpr std::uint8_t s_ubHeaderSize = 8;
+
+class tReader {
+public:
+	tReader(const std::uint8_t *pData, std::size_t Size):
+		m_pData(pData), m_Size(Size)
+	{ }
+
+	bool isOk(void) const { return m_isOk; }
+
+	std::uint16_t readWord(void) {
+		std::uint16_t uwBig = 0;
+		readRaw(&uwBig, sizeof(uwBig));
+		return nEndian::fromBig16(uwBig);
+	}
+
+	std::uint32_t readLong(void) {
+		std::uint32_t ulBig = 0;
+		readRaw(&ulBig, sizeof(ulBig));
+		return nEndian::fromBig32(ulBig);
+	}
+
+	std::uint64_t readQuad(void) {
+		std::uint64_t ullHi = readLong();
+		return (ullHi << 32) | readLong();
+	}
+
+	std::string readString(void) {
+		// Strings are null-terminated and padded to even size
+		const auto *pStart = reinterpret_cast<const char*>(&m_pData[m_Pos]);
+		auto Length = strnlen(pStart, m_Size - m_Pos);
+		if(m_Pos + Length >= m_Size) {
+			m_isOk = false;
+			m_Pos = m_Size;
+			return "";
+		}
+		m_Pos = std::min(m_Size, m_Pos + ((Length + 2) & ~std::size_t(1)));
+		return std::string(pStart, Length);
+	}
+
+private:
+	void readRaw(void *pDst, std::size_t Size) {
+		if(m_Pos + Size > m_Size) {
+			m_isOk = false;
+			m_Pos = m_Size;
+			return;
+		}
+		std::memcpy(pDst, &m_pData[m_Pos], Size);
+		m_Pos += Size;
+	}
+
+	const std::uint8_t *m_pData;
+	std::size_t m_Size;
+	std::size_t m_Pos = 0;
+	bool m_isOk = true;
+};
+
+static std::string formatPrec(std::uint32_t ulPrecTime)
+{
+	// Same as ACE's timerFormatPrec()
+	if(ulPrecTime > 0xFFFFFFFF >> 2) {
+		return ">7min";
+	}
+	std::uint32_t ulResult = ulPrecTime * 4;
+	std::uint32_t ulRest = ulResult % 10;
+	ulResult /= 10;
+	if(ulResult < 1000) {
+		return fmt::format("{:3}.{:01} us", ulResult, ulRest);
+	}
+	ulRest = ulResult % 1000;
+	ulResult /= 1000;
+	if(ulResult < 1000) {
+		return fmt::format("{:3}.{:03} ms", ulResult, ulRest);
+	}
+	ulRest = ulResult % 1000;
+	ulResult /= 1000;
+	return fmt::format("{}.{:03} s", ulResult, ulRest);
+}
+
+template<typename... t_tArgs>
+static std::string sprintfToString(const std::string &szSpec, t_tArgs... Args)
+{
+	char szBuffer[1024];
+	std::snprintf(szBuffer, sizeof(szBuffer), szSpec.c_str(), Args...);
+	return szBuffer;
+}
+
+static std::string formatMessage(const std::string &szFormat, tReader &Args)
+{
+	// Arg sizes follow Amiga's ABI: all ints are 32-bit, unless with "ll"
+	std::string szOut;
+	for(std::size_t i = 0; i < szFormat.size(); ++i) {
+		if(szFormat[i] != '%') {
+			szOut += szFormat[i];
+			continue;
+		}
+		if(++i < szFormat.size() && szFormat[i] == '%') {
+			szOut += '%';
+			continue;
+		}
+
+		std::string szSpec = "%";
+		while(i < szFormat.size() && std::strchr("-+ #0", szFormat[i])) {
+			szSpec += szFormat[i++];
+		}
+		while(
+			i < szFormat.size() &&
+			(std::isdigit(szFormat[i]) || szFormat[i] == '.' || szFormat[i] == '*')
+		) {
+			if(szFormat[i] == '*') {
+				szSpec += std::to_string(std::int32_t(Args.readLong()));
+			}
+			else {
+				szSpec += szFormat[i];
+			}
+			++i;
+		}
+		std::uint8_t ubLongCount = 0, ubShortCount = 0;
+		while(i < szFormat.size() && std::strchr("hlLqjzt", szFormat[i])) {
+			ubLongCount += (szFormat[i] == 'l');
+			ubShortCount += (szFormat[i] == 'h');
+			++i;
+		}
+		if(i >= szFormat.size()) {
+			break;
+		}
+
+		char cConversion = szFormat[i];
+		switch(cConversion) {
+			case 's':
+				szOut += sprintfToString(szSpec + 's', Args.readString().c_str());
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+				std::uint64_t ullBits = Args.readQuad();
+				double fValue;
+				std::memcpy(&fValue, &ullBits, sizeof(fValue));
+				szOut += sprintfToString(szSpec + cConversion, fValue);
+			} break;
+			case 'p':
+				// ACE's printf prints pointers as 8 uppercase hex digits
+				szOut += sprintfToString("%08X", Args.readLong());
+				break;
+			case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': {
+				bool isSigned = (cConversion == 'd' || cConversion == 'i');
+				if(ubLongCount >= 2) {
+					auto ullValue = Args.readQuad();
+					szOut += sprintfToString(
+						szSpec + "ll" + cConversion,
+						isSigned ? static_cast<long long>(ullValue) : ullValue
+					);
+					break;
+				}
+				std::uint32_t ulValue = Args.readLong();
+				if(ubShortCount == 1) {
+					ulValue = isSigned ? std::uint32_t(std::int16_t(ulValue)) : std::uint16_t(ulValue);
+				}
+				else if(ubShortCount >= 2) {
+					ulValue = isSigned ? std::uint32_t(std::int8_t(ulValue)) : std::uint8_t(ulValue);
+				}
+				szOut += sprintfToString(szSpec + cConversion, ulValue);
+			} break;
+			default:
+				szOut += szSpec + cConversion;
+		}
+	}
+	return szOut;
+}
+
+static void printUsage(const std::string &szAppName) {
+	using fmt::print;
+	print("Usage:\n\t{} inPath [outPath] [extraOpts]\n\n", szAppName);
+	print("Converts binary log written by ACE after logOpenBinary() to text.\n");
+	print("If outPath is omitted, text is written to stdout.\n\n");
+	print("Extra options:\n");
+	print("\t-time    Prefix each line with time elapsed since first record\n");
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	if(lArgCount < 2) {
+		nLog::error("Too few arguments");
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string szInPath = pArgs[1];
+	std::string szOutPath;
+	bool isTime = false;
+	for(auto ArgIndex = 2; ArgIndex < lArgCount; ++ArgIndex) {
+		std::string szArg = pArgs[ArgIndex];
+		if(szArg == "-time") {
+			isTime = true;
+		}
+		else if(szArg[0] != '-' && szOutPath.empty()) {
+			szOutPath = szArg;
+		}
+		else {
+			nLog::error("Unknown argument: '{}'", szArg);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::ifstream FileIn(szInPath, std::ios::binary);
+	if(!FileIn.good()) {
+		nLog::error("Couldn't open '{}'", szInPath);
+		return EXIT_FAILURE;
+	}
+	std::vector<std::uint8_t> vData(
+		(std::istreambuf_iterator<char>(FileIn)), std::istreambuf_iterator<char>()
+	);
+	if(
+		vData.size() < s_ubHeaderSize ||
+		std::string(reinterpret_cast<char*>(vData.data()), 4) != "ALOG"
+	) {
+		nLog::error("'{}' is not a binary ACE log", szInPath);
+		return EXIT_FAILURE;
+	}
+	if(vData[4] != s_ubLogVersion) {
+		nLog::error("Unsupported binary log version: {}", vData[4]);
+		return EXIT_FAILURE;
+	}
+
+	std::map<std::uint16_t, std::string> mFormats;
+	std::string szOut;
+	bool wasLastInline = false;
+	bool isFirstRecord = true;
+	std::uint32_t ulStartTime = 0;
+	std::size_t Pos = s_ubHeaderSize;
+	while(Pos < vData.size()) {
+		tReader Header(&vData[Pos], vData.size() - Pos);
+		std::uint16_t uwSize = Header.readWord();
+		std::uint8_t ubType = std::uint8_t(Header.readWord() >> 8);
+		std::uint8_t ubIndent = vData[Pos + 3];
+		std::uint32_t ulTime = Header.readLong();
+		if(!Header.isOk() || uwSize < s_ubHeaderSize || Pos + uwSize > vData.size()) {
+			nLog::warn("Log is truncated at offset {}", Pos);
+			break;
+		}
+		tReader Payload(&vData[Pos + s_ubHeaderSize], uwSize - s_ubHeaderSize);
+		Pos += uwSize;
+		if(isFirstRecord) {
+			ulStartTime = ulTime;
+			isFirstRecord = false;
+		}
+
+		std::string szText;
+		bool isIndented = !wasLastInline;
+		switch(ubType) {
+			case s_ubRecordFormat: {
+				auto uwId = Payload.readWord();
+				mFormats[uwId] = Payload.readString();
+			} continue;
+			case s_ubRecordMessage: {
+				auto uwId = Payload.readWord();
+				auto It = mFormats.find(uwId);
+				if(It == mFormats.end()) {
+					szText = fmt::format("<unknown format {}>\n", uwId);
+				}
+				else {
+					szText = formatMessage(It->second, Payload);
+				}
+			} break;
+			case s_ubRecordText:
+				szText = Payload.readString();
+				break;
+			case s_ubRecordBlockEnd: {
+				auto ulDelta = Payload.readLong();
+				bool isEmpty = (Payload.readWord() >> 8) != 0;
+				auto szName = Payload.readString();
+				if(isEmpty) {
+					// Collapse empty block to single line, same as text log does
+					if(!szOut.empty() && szOut.back() == '\n') {
+						szOut.pop_back();
+					}
+					isIndented = false;
+					szText = fmt::format("...OK, time: {}\n", formatPrec(ulDelta));
+				}
+				else {
+					szText = fmt::format(
+						"Block end: {}, time: {}\n", szName, formatPrec(ulDelta)
+					);
+				}
+			} break;
+			case s_ubRecordLost:
+				szText = fmt::format(
+					"ERR: {} log records lost, buffer full\n", Payload.readLong()
+				);
+				break;
+			default:
+				nLog::warn("Unknown record type {} at offset {}", ubType, Pos - uwSize);
+				continue;
+		}
+		if(!Payload.isOk()) {
+			nLog::warn("Record at offset {} is malformed", Pos - uwSize);
+		}
+
+		if(isIndented) {
+			if(isTime) {
+				szOut += fmt::format("[{:>10}] ", formatPrec(ulTime - ulStartTime));
+			}
+			szOut += std::string(ubIndent, '\t');
+		}
+		szOut += szText;
+		wasLastInline = !szText.empty() && szText.back() != '\n';
+	}
+
+	if(szOutPath.empty()) {
+		fmt::print("{}", szOut);
+	}
+	else {
+		std::ofstream FileOut(szOutPath, std::ios::binary);
+		FileOut << szOut;
+		if(!FileOut.good()) {
+			nLog::error("Couldn't write to '{}'", szOutPath);
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,392 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "common/endian.h"
+#include "common/logging.h"
+#include "common/parse.h"
+
+// Must match ACE's memory.h
+static constexpr std::uint8_t s_ubDumpVersion = 1;
+static constexpr std::uint8_t s_ubRecordTag = 1;
+static constexpr std::uint8_t s_ubRecordAlloc = 2;
+static constexpr std::uint8_t s_ubRecordFree = 3;
+static constexpr std::uint8_t s_ubMemChip = 2; // MEMF_CHIP
+static constexpr std::uint32_t s_ulRecordSize = 16;
+
+static constexpr std::uint8_t s_ubMapMaxRows = 16;
+
+struct tEvent {
+	std::uint32_t ulTime;
+	std::uint32_t ulAddr;
+	std::uint32_t ulSize;
+	std::uint8_t ubTag;
+	bool isAlloc;
+	bool isChip;
+};
+
+struct tProfile {
+	std::vector<std::string> vTags;
+	std::vector<tEvent> vEvents;
+	bool isTimeInFrames;
+};
+
+struct tUsage {
+	std::uint32_t ulChip = 0;
+	std::uint32_t ulChipPeak = 0;
+	std::uint32_t ulFast = 0;
+	std::uint32_t ulFastPeak = 0;
+	std::uint32_t ulAllocCount = 0;
+};
+
+static bool readDump(const std::string &szPath, tProfile &Profile)
+{
+	std::ifstream FileIn(szPath, std::ios::binary);
+	std::vector<std::uint8_t> vData(
+		(std::istreambuf_iterator<char>(FileIn)), std::istreambuf_iterator<char>()
+	);
+	if(vData.size() < 8 || vData[4] != s_ubDumpVersion) {
+		nLog::error("Unsupported dump version");
+		return false;
+	}
+
+	auto readLong = [&vData](std::size_t Pos) {
+		std::uint32_t ulBig;
+		std::copy_n(&vData[Pos], sizeof(ulBig), reinterpret_cast<std::uint8_t*>(&ulBig));
+		return nEndian::fromBig32(ulBig);
+	};
+
+	Profile.isTimeInFrames = true;
+	std::size_t Pos = 8;
+	while(Pos + s_ulRecordSize <= vData.size()) {
+		std::uint8_t ubType = vData[Pos];
+		std::uint8_t ubTag = vData[Pos + 1];
+		tEvent Event = {
+			.ulTime = readLong(Pos + 4), .ulAddr = readLong(Pos + 8),
+			.ulSize = readLong(Pos + 12), .ubTag = ubTag,
+			.isAlloc = (ubType == s_ubRecordAlloc),
+			.isChip = (vData[Pos + 2] & s_ubMemChip) != 0
+		};
+		Pos += s_ulRecordSize;
+		if(ubType == s_ubRecordTag) {
+			if(Pos + Event.ulSize > vData.size()) {
+				break;
+			}
+			if(Profile.vTags.size() <= ubTag) {
+				Profile.vTags.resize(ubTag + 1);
+			}
+			Profile.vTags[ubTag] = std::string(
+				reinterpret_cast<const char*>(&vData[Pos]), Event.ulSize
+			);
+			Pos += Event.ulSize;
+		}
+		else if(ubType == s_ubRecordAlloc || ubType == s_ubRecordFree) {
+			Profile.vEvents.push_back(Event);
+		}
+		else {
+			nLog::error("Unknown record type {} at offset {}", ubType, Pos - s_ulRecordSize);
+			return false;
+		}
+	}
+	if(Pos != vData.size()) {
+		nLog::warn("Dump is truncated, was memDumpStop() called?");
+	}
+	return true;
+}
+
+static bool readLog(const std::string &szPath, tProfile &Profile)
+{
+	// Log has no timestamps, so event index is used as time. Allocations
+	// without tag are tagged with source file name.
+	static const std::regex s_RegexAlloc(
+		R"(\[MEM\] Allocated (CHIP|FAST) memory \d+@(?:0x)?([0-9a-fA-F]+), size (\d+)(?:, tag (.+))? \(([^()]*):\d+\))"
+	);
+	static const std::regex s_RegexFree(
+		R"(\[MEM\] Freed memory \d+@(?:0x)?([0-9a-fA-F]+), size \d+)"
+	);
+	std::ifstream FileIn(szPath);
+	std::map<std::string, std::uint8_t> mTagIndices;
+	std::map<std::uint32_t, tEvent> mLive;
+	std::string szLine;
+	Profile.isTimeInFrames = false;
+	std::uint32_t ulTime = 0;
+	while(std::getline(FileIn, szLine)) {
+		std::smatch Match;
+		if(std::regex_search(szLine, Match, s_RegexAlloc)) {
+			std::string szTag = Match[4].matched ? Match[4].str() : Match[5].str();
+			auto It = mTagIndices.find(szTag);
+			if(It == mTagIndices.end()) {
+				It = mTagIndices.emplace(szTag, std::uint8_t(Profile.vTags.size())).first;
+				Profile.vTags.push_back(szTag);
+			}
+			tEvent Event = {
+				.ulTime = ulTime++,
+				.ulAddr = std::uint32_t(std::stoul(Match[2].str(), nullptr, 16)),
+				.ulSize = std::uint32_t(std::stoul(Match[3].str())),
+				.ubTag = It->second, .isAlloc = true, .isChip = Match[1] == "CHIP"
+			};
+			mLive[Event.ulAddr] = Event;
+			Profile.vEvents.push_back(Event);
+		}
+		else if(std::regex_search(szLine, Match, s_RegexFree)) {
+			auto ulAddr = std::uint32_t(std::stoul(Match[1].str(), nullptr, 16));
+			auto It = mLive.find(ulAddr);
+			if(It == mLive.end()) {
+				continue;
+			}
+			tEvent Event = It->second;
+			Event.ulTime = ulTime++;
+			Event.isAlloc = false;
+			mLive.erase(It);
+			Profile.vEvents.push_back(Event);
+		}
+	}
+	if(Profile.vTags.size() > 256) {
+		nLog::error("Too many distinct tags in log");
+		return false;
+	}
+	return true;
+}
+
+static void printFragmentationMap(
+	const std::vector<tEvent> &vBlocks, std::uint8_t ubWidth
+)
+{
+	if(vBlocks.empty()) {
+		fmt::print("No CHIP allocations\n");
+		return;
+	}
+
+	std::uint32_t ulStart = vBlocks.front().ulAddr;
+	std::uint32_t ulEnd = 0;
+	std::uint32_t ulGapTotal = 0, ulGapLargest = 0, ulGapCount = 0;
+	for(const auto &Block: vBlocks) {
+		if(ulEnd && Block.ulAddr > ulEnd) {
+			auto ulGap = Block.ulAddr - ulEnd;
+			ulGapTotal += ulGap;
+			ulGapLargest = std::max(ulGapLargest, ulGap);
+			++ulGapCount;
+		}
+		ulEnd = std::max(ulEnd, Block.ulAddr + Block.ulSize);
+	}
+
+	std::uint32_t ulCellCount = ubWidth * s_ubMapMaxRows;
+	// Keep cells 8-byte aligned so that row addresses are readable
+	std::uint32_t ulCellSize = std::max<std::uint32_t>(
+		8, (((ulEnd - ulStart + ulCellCount - 1) / ulCellCount) + 7) & ~7u
+	);
+	std::vector<std::uint32_t> vCellUse((ulEnd - ulStart + ulCellSize - 1) / ulCellSize, 0);
+	for(const auto &Block: vBlocks) {
+		// Add block's bytes to each cell it overlaps
+		for(auto ulPos = Block.ulAddr; ulPos < Block.ulAddr + Block.ulSize;) {
+			auto ulCell = (ulPos - ulStart) / ulCellSize;
+			auto ulCellEnd = ulStart + (ulCell + 1) * ulCellSize;
+			auto ulPart = std::min(ulCellEnd, Block.ulAddr + Block.ulSize) - ulPos;
+			vCellUse[ulCell] += ulPart;
+			ulPos += ulPart;
+		}
+	}
+
+	fmt::print(
+		"CHIP map {:08X}..{:08X}, {} bytes per char ('#' full, '+' over half, '-' partial, '.' free):\n",
+		ulStart, ulEnd, ulCellSize
+	);
+	for(std::size_t i = 0; i < vCellUse.size(); ++i) {
+		if(i % ubWidth == 0) {
+			fmt::print("{}{:08X} ", i ? "\n" : "", ulStart + i * ulCellSize);
+		}
+		auto ulUse = std::min(vCellUse[i], ulCellSize);
+		char cCell = (
+			ulUse == ulCellSize ? '#' : (ulUse * 2 >= ulCellSize ? '+' : (ulUse ? '-' : '.'))
+		);
+		fmt::print("{}", cCell);
+	}
+	fmt::print("\n");
+	fmt::print(
+		"Gaps between blocks: {} totalling {} bytes, largest: {}, fragmentation: {}%\n",
+		ulGapCount, ulGapTotal, ulGapLargest,
+		ulGapTotal ? 100 - std::uint64_t(ulGapLargest) * 100 / ulGapTotal : 0
+	);
+}
+
+static void printUsage(const std::string &szAppName) {
+	using fmt::print;
+	print("Usage:\n\t{} inPath [extraOpts]\n\n", szAppName);
+	print("Analyzes ACE's memory use. inPath may be either binary dump written after\n");
+	print("memDumpStart() or log of ACE_DEBUG build.\n\n");
+	print("Extra options:\n");
+	print("\t-timeline path  Write CHIP/FAST usage timeline of each tag as CSV\n");
+	print("\t-map            Print CHIP fragmentation map at CHIP usage peak\n");
+	print("\t-width N        Fragmentation map width, in chars. Default: 64\n");
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	if(lArgCount < 2) {
+		nLog::error("Too few arguments");
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string szInPath = pArgs[1];
+	std::string szTimelinePath;
+	bool isMap = false;
+	std::int32_t lMapWidth = 64;
+	for(auto ArgIndex = 2; ArgIndex < lArgCount; ++ArgIndex) {
+		std::string szArg = pArgs[ArgIndex];
+		bool isLast = (ArgIndex + 1 >= lArgCount);
+		if(szArg == "-timeline" && !isLast) {
+			szTimelinePath = pArgs[++ArgIndex];
+		}
+		else if(szArg == "-map") {
+			isMap = true;
+		}
+		else if(szArg == "-width" && !isLast) {
+			if(!nParse::toInt32(pArgs[++ArgIndex], "-width", lMapWidth)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else {
+			nLog::error("Unknown argument: '{}'", szArg);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(lMapWidth <= 0 || lMapWidth > 255) {
+		nLog::error("Map width must be in 1..255 range");
+		return EXIT_FAILURE;
+	}
+
+	std::ifstream FileIn(szInPath, std::ios::binary);
+	if(!FileIn.good()) {
+		nLog::error("Couldn't open '{}'", szInPath);
+		return EXIT_FAILURE;
+	}
+	char pMagic[4] = {0};
+	FileIn.read(pMagic, sizeof(pMagic));
+	FileIn.close();
+
+	tProfile Profile;
+	bool isDump = std::string(pMagic, sizeof(pMagic)) == "AMEM";
+	if(!(isDump ? readDump(szInPath, Profile) : readLog(szInPath, Profile))) {
+		return EXIT_FAILURE;
+	}
+	if(Profile.vEvents.empty()) {
+		nLog::error("No allocations found in '{}'", szInPath);
+		return EXIT_FAILURE;
+	}
+	for(const auto &Event: Profile.vEvents) {
+		if(Profile.vTags.size() <= Event.ubTag) {
+			Profile.vTags.resize(Event.ubTag + 1);
+		}
+	}
+	for(std::size_t i = 0; i < Profile.vTags.size(); ++i) {
+		if(Profile.vTags[i].empty()) {
+			Profile.vTags[i] = fmt::format("tag{}", i);
+		}
+	}
+
+	std::ofstream FileTimeline;
+	if(!szTimelinePath.empty()) {
+		FileTimeline.open(szTimelinePath);
+		FileTimeline << (Profile.isTimeInFrames ? "frame" : "event") << ",chip,fast";
+		for(const auto &szTag: Profile.vTags) {
+			FileTimeline << fmt::format(",{0} chip,{0} fast", szTag);
+		}
+		FileTimeline << "\n";
+	}
+
+	// Replay all events, noting CHIP peak and its per-tag breakdown
+	std::vector<tUsage> vTagUsage(Profile.vTags.size());
+	tUsage Total;
+	std::vector<std::uint32_t> vChipAtPeak(Profile.vTags.size(), 0);
+	std::size_t PeakEventIndex = 0;
+	for(std::size_t i = 0; i < Profile.vEvents.size(); ++i) {
+		const auto &Event = Profile.vEvents[i];
+		auto &Tag = vTagUsage[Event.ubTag];
+		for(auto *pUsage: {&Tag, &Total}) {
+			auto &ulUsage = Event.isChip ? pUsage->ulChip : pUsage->ulFast;
+			auto &ulPeak = Event.isChip ? pUsage->ulChipPeak : pUsage->ulFastPeak;
+			if(Event.isAlloc) {
+				ulUsage += Event.ulSize;
+				ulPeak = std::max(ulPeak, ulUsage);
+				++pUsage->ulAllocCount;
+			}
+			else {
+				ulUsage -= Event.ulSize;
+			}
+		}
+		if(Event.isChip && Event.isAlloc && Total.ulChip == Total.ulChipPeak) {
+			PeakEventIndex = i;
+			for(std::size_t t = 0; t < vTagUsage.size(); ++t) {
+				vChipAtPeak[t] = vTagUsage[t].ulChip;
+			}
+		}
+
+		bool isLastOfTime = (
+			i + 1 == Profile.vEvents.size() ||
+			Profile.vEvents[i + 1].ulTime != Event.ulTime
+		);
+		if(FileTimeline.is_open() && isLastOfTime) {
+			FileTimeline << fmt::format("{},{},{}", Event.ulTime, Total.ulChip, Total.ulFast);
+			for(const auto &Usage: vTagUsage) {
+				FileTimeline << fmt::format(",{},{}", Usage.ulChip, Usage.ulFast);
+			}
+			FileTimeline << "\n";
+		}
+	}
+
+	fmt::print(
+		"{:<20} {:>10} {:>10} {:>10} {:>10} {:>10} {:>8}\n",
+		"Tag", "CHIP peak", "CHIP@peak", "CHIP end", "FAST peak", "FAST end", "Allocs"
+	);
+	for(std::size_t t = 0; t < vTagUsage.size(); ++t) {
+		const auto &Usage = vTagUsage[t];
+		fmt::print(
+			"{:<20} {:>10} {:>10} {:>10} {:>10} {:>10} {:>8}\n",
+			Profile.vTags[t], Usage.ulChipPeak, vChipAtPeak[t], Usage.ulChip,
+			Usage.ulFastPeak, Usage.ulFast, Usage.ulAllocCount
+		);
+	}
+	fmt::print(
+		"{:<20} {:>10} {:>10} {:>10} {:>10} {:>10} {:>8}\n",
+		"total", Total.ulChipPeak, Total.ulChipPeak, Total.ulChip,
+		Total.ulFastPeak, Total.ulFast, Total.ulAllocCount
+	);
+	fmt::print(
+		"CHIP peak reached at {} {}\n",
+		Profile.isTimeInFrames ? "frame" : "event",
+		Profile.vEvents[PeakEventIndex].ulTime
+	);
+
+	if(isMap) {
+		// Replay up to the peak again to get live CHIP blocks at that moment
+		std::map<std::uint32_t, tEvent> mLive;
+		for(std::size_t i = 0; i <= PeakEventIndex; ++i) {
+			const auto &Event = Profile.vEvents[i];
+			if(!Event.isChip) {
+				continue;
+			}
+			if(Event.isAlloc) {
+				mLive[Event.ulAddr] = Event;
+			}
+			else {
+				mLive.erase(Event.ulAddr);
+			}
+		}
+		std::vector<tEvent> vBlocks;
+		for(const auto &[ulAddr, Block]: mLive) {
+			vBlocks.push_back(Block);
+		}
+		printFragmentationMap(vBlocks, std::uint8_t(lMapWidth));
+	}
+
+	return EXIT_SUCCESS;
+}
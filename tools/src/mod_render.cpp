@@ -0,0 +1,588 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include "common/logging.h"
+#include "common/parse.h"
+#include "ptplayer_host/ace_host.h"
+
+// Paula clock is exactly 5 times faster than CIA's E clock
+static constexpr std::uint32_t s_ulPaulaClockPal = 3546895;
+static constexpr std::uint32_t s_ulPaulaClockNtsc = 3579545;
+static constexpr std::uint8_t s_ubPaulaClocksPerCiaTick = 5;
+
+// Lowest period which Paula can fetch samples with using DMA
+static constexpr std::uint16_t s_uwMinPeriod = 124;
+
+static constexpr std::uint8_t s_ubChannelCount = 4;
+
+// Render hash of module built by createSelfTestMod(), at s_ulSelfTestRate.
+// Update it only after verifying that the render change was intended.
+static constexpr std::uint64_t s_ullSelfTestHash = 0xFDF60924AEC77FB9;
+static constexpr std::uint32_t s_ulSelfTestRate = 22050;
+
+static const char *s_pFxNames[PTPLAYER_FX_COUNT] = {
+	"0 arpeggio", "1 porta up", "2 porta down", "3 tone porta",
+	"4 vibrato", "5 tone porta + vol slide", "6 vibrato + vol slide", "7 tremolo",
+	"8 unused", "9 sample offset", "A vol slide", "B position jump",
+	"C set volume", "D pattern break", "E extended", "F set speed",
+	"E0 filter", "E1 fine porta up", "E2 fine porta down", "E3 glissando",
+	"E4 vibrato waveform", "E5 finetune", "E6 pattern loop", "E7 tremolo waveform",
+	"E8 sync", "E9 retrigger", "EA fine vol up", "EB fine vol down",
+	"EC note cut", "ED note delay", "EE pattern delay", "EF invert loop",
+};
+
+/**
+ * @brief Emulates Paula's audio DMA on registers written by ptplayer.
+ * Output of each channel is averaged over the output sample's duration,
+ * which is enough for regression tests - it's not meant to sound like A500.
+ */
+class tPaula {
+public:
+	tPaula(std::uint32_t ulClock, std::uint32_t ulRate):
+		m_fClocksPerSample(double(ulClock) / ulRate)
+	{
+	}
+
+	/**
+	 * @brief Picks up DMA changes made by interrupt handlers.
+	 * Channels get sample location from their registers when DMA gets enabled.
+	 */
+	void updateDma(void) {
+		for(std::uint8_t i = 0; i < s_ubChannelCount; ++i) {
+			auto &Channel = m_pChannels[i];
+			bool isEnabled = (g_sAceHost.uwDmaCon & (DMAF_AUD0 << i)) != 0;
+			if(isEnabled && !Channel.isEnabled) {
+				latchLocation(i);
+				Channel.fClocksToFetch = 0;
+			}
+			else if(!isEnabled) {
+				Channel.bSample = 0;
+			}
+			Channel.isEnabled = isEnabled;
+		}
+	}
+
+	/**
+	 * @brief Renders output until given time.
+	 *
+	 * @param ullClock Time in Paula clocks.
+	 * @param vOut Output for interleaved 16-bit stereo samples.
+	 */
+	void renderUntil(std::uint64_t ullClock, std::vector<std::int16_t> &vOut) {
+		while(m_fClock < ullClock) {
+			double fStep = std::min(double(ullClock) - m_fClock, m_fClocksToOutput);
+			for(std::uint8_t i = 0; i < s_ubChannelCount; ++i) {
+				m_pAccumulators[i] += integrate(i, fStep);
+			}
+			m_fClock += fStep;
+			m_fClocksToOutput -= fStep;
+			if(m_fClocksToOutput <= 0) {
+				// Amiga's hard stereo: channels 0 and 3 left, 1 and 2 right
+				double fScale = 2.0 / m_fClocksPerSample;
+				double fLeft = (m_pAccumulators[0] + m_pAccumulators[3]) * fScale;
+				double fRight = (m_pAccumulators[1] + m_pAccumulators[2]) * fScale;
+				vOut.push_back(std::int16_t(std::clamp(fLeft, -32768.0, 32767.0)));
+				vOut.push_back(std::int16_t(std::clamp(fRight, -32768.0, 32767.0)));
+				m_pAccumulators.fill(0);
+				m_fClocksToOutput += m_fClocksPerSample;
+			}
+		}
+	}
+
+private:
+	struct tChannel {
+		const std::int8_t *pData = nullptr;
+		std::uint32_t ulBytesLeft = 0;
+		double fClocksToFetch = 0;
+		std::int8_t bSample = 0;
+		bool isEnabled = false;
+	};
+
+	void latchLocation(std::uint8_t ubChannel) {
+		auto &Channel = m_pChannels[ubChannel];
+		const auto &Regs = g_pCustom->aud[ubChannel];
+		Channel.pData = reinterpret_cast<const std::int8_t*>(Regs.ac_ptr);
+		// Zero length is the longest one
+		Channel.ulBytesLeft = (Regs.ac_len ? Regs.ac_len : 0x10000) * 2;
+		// Paula raises audio interrupt each time it latches new location
+		g_pCustom->intreqr = g_pCustom->intreqr | (INTF_AUD0 << ubChannel);
+		const auto &AudioInt = g_sAceHost.pAudioInts[ubChannel];
+		if(AudioInt.cbHandler) {
+			// Handled right away, then acknowledged like ACE's ISR does
+			AudioInt.cbHandler(g_pCustom, AudioInt.pHandlerData);
+			aceHostProcessIntReq();
+			g_pCustom->intreqr = g_pCustom->intreqr & ~(INTF_AUD0 << ubChannel);
+		}
+	}
+
+	double integrate(std::uint8_t ubChannel, double fClocks) {
+		auto &Channel = m_pChannels[ubChannel];
+		if(!Channel.isEnabled) {
+			return 0;
+		}
+		const auto &Regs = g_pCustom->aud[ubChannel];
+		std::uint16_t uwVolume = Regs.ac_vol, uwPeriod = Regs.ac_per;
+		double fVolume = std::min<std::uint16_t>(uwVolume, PTPLAYER_VOLUME_MAX);
+		double fPeriod = std::max(uwPeriod, s_uwMinPeriod);
+		double fSum = 0;
+		while(fClocks > 0) {
+			if(Channel.fClocksToFetch <= 0) {
+				if(!Channel.ulBytesLeft) {
+					latchLocation(ubChannel);
+				}
+				Channel.bSample = Channel.pData ? *(Channel.pData++) : 0;
+				--Channel.ulBytesLeft;
+				Channel.fClocksToFetch += fPeriod;
+			}
+			double fStep = std::min(fClocks, Channel.fClocksToFetch);
+			fSum += Channel.bSample * fVolume * fStep;
+			Channel.fClocksToFetch -= fStep;
+			fClocks -= fStep;
+		}
+		return fSum;
+	}
+
+	std::array<tChannel, s_ubChannelCount> m_pChannels;
+	std::array<double, s_ubChannelCount> m_pAccumulators = {0};
+	double m_fClocksPerSample;
+	double m_fClocksToOutput = m_fClocksPerSample;
+	double m_fClock = 0;
+};
+
+struct tTickStats {
+	std::uint64_t ullCiaTime;
+	std::uint32_t ulFxCount;
+	std::uint32_t ulRegWrites;
+	std::uint32_t ulHostNs; ///< Filled only with -hostTime, varies between runs.
+};
+
+/**
+ * @brief Calculates FNV-1a hash of rendered samples and deterministic
+ * per-tick stats, for comparing renders between builds.
+ */
+static std::uint64_t getRenderHash(
+	const std::vector<std::int16_t> &vSamples, const std::vector<tTickStats> &vTicks
+) {
+	std::uint64_t ullHash = 0xCBF29CE484222325;
+	auto addValue = [&ullHash](std::uint64_t ullValue, std::uint8_t ubBytes) {
+		for(std::uint8_t i = 0; i < ubBytes; ++i) {
+			ullHash = (ullHash ^ ((ullValue >> (i * 8)) & 0xFF)) * 0x100000001B3;
+		}
+	};
+	for(auto Sample: vSamples) {
+		addValue(std::uint16_t(Sample), 2);
+	}
+	for(const auto &Tick: vTicks) {
+		addValue(Tick.ullCiaTime, 8);
+		addValue(Tick.ulFxCount, 4);
+		addValue(Tick.ulRegWrites, 4);
+	}
+	return ullHash;
+}
+
+/**
+ * @brief Builds small M.K. module which exercises the most common effects,
+ * used as fixture by -selftest. Song ends after its only pattern.
+ */
+static std::vector<std::uint8_t> createSelfTestMod(void) {
+	std::vector<std::uint8_t> vMod;
+	auto writeWord = [&vMod](std::uint16_t uwValue) {
+		vMod.push_back(std::uint8_t(uwValue >> 8));
+		vMod.push_back(std::uint8_t(uwValue & 0xFF));
+	};
+	auto writeName = [&vMod](const std::string &szName, std::uint8_t ubLength) {
+		for(std::uint8_t i = 0; i < ubLength; ++i) {
+			vMod.push_back(i < szName.size() ? std::uint8_t(szName[i]) : 0);
+		}
+	};
+
+	// Looped square and one-shot saw, both starting with empty word.
+	// ptplayer plays whole sample length after 9xx offset, so silent third
+	// sample keeps it from reading past module's data.
+	std::vector<std::int8_t> vSquare(32, 0), vSaw(512, 0), vSilence(512, 0);
+	for(std::uint8_t i = 2; i < vSquare.size(); ++i) {
+		vSquare[i] = (i < 17) ? 64 : -64;
+	}
+	for(std::uint16_t i = 2; i < vSaw.size(); ++i) {
+		vSaw[i] = std::int8_t(i * 5);
+	}
+
+	writeName("mod_render selftest", 20);
+	for(std::uint8_t i = 0; i < 31; ++i) {
+		writeName("", 22);
+		if(i == 0) {
+			writeWord(std::uint16_t(vSquare.size() / 2));
+			vMod.push_back(0); // Finetune
+			vMod.push_back(48); // Volume
+			writeWord(1); // Repeat start, in words
+			writeWord(std::uint16_t(vSquare.size() / 2 - 1));
+		}
+		else if(i == 1) {
+			writeWord(std::uint16_t(vSaw.size() / 2));
+			vMod.push_back(0);
+			vMod.push_back(64);
+			writeWord(0);
+			writeWord(1);
+		}
+		else if(i == 2) {
+			writeWord(std::uint16_t(vSilence.size() / 2));
+			vMod.push_back(0);
+			vMod.push_back(0);
+			writeWord(0);
+			writeWord(1);
+		}
+		else {
+			writeWord(0);
+			vMod.push_back(0);
+			vMod.push_back(0);
+			writeWord(0);
+			writeWord(1);
+		}
+	}
+	vMod.push_back(1); // Song length
+	vMod.push_back(127);
+	for(std::uint8_t i = 0; i < 128; ++i) {
+		vMod.push_back(0);
+	}
+	writeName("M.K.", 4);
+
+	// Pattern as [row][channel] = {period, sample, cmd, arg}
+	std::array<std::array<std::array<std::uint16_t, 4>, 4>, 64> Pattern = {};
+	Pattern[0] = {{{428, 1, 0xF, 0x03}, {214, 2, 0xC, 0x20}, {285, 1, 0x0, 0x37}, {339, 2, 0x0, 0x00}}};
+	Pattern[4] = {{{0, 0, 0x1, 0x20}, {254, 0, 0x3, 0x05}, {0, 0, 0x4, 0x46}, {428, 2, 0x9, 0x01}}};
+	Pattern[8] = {{{0, 0, 0xA, 0x04}, {0, 0, 0xE, 0x93}, {381, 1, 0x7, 0x44}, {214, 1, 0xE, 0xD1}}};
+	Pattern[12] = {{{0, 0, 0xE, 0xC1}, {0, 0, 0x2, 0x20}, {0, 0, 0xA, 0x40}, {0, 0, 0x6, 0x02}}};
+	Pattern[15] = {{{0, 0, 0xD, 0x00}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}};
+	for(const auto &Row: Pattern) {
+		for(const auto &Note: Row) {
+			vMod.push_back(std::uint8_t((Note[1] & 0xF0) | (Note[0] >> 8)));
+			vMod.push_back(std::uint8_t(Note[0] & 0xFF));
+			vMod.push_back(std::uint8_t(((Note[1] & 0x0F) << 4) | Note[2]));
+			vMod.push_back(std::uint8_t(Note[3]));
+		}
+	}
+
+	vMod.insert(vMod.end(), vSquare.begin(), vSquare.end());
+	vMod.insert(vMod.end(), vSaw.begin(), vSaw.end());
+	vMod.insert(vMod.end(), vSilence.begin(), vSilence.end());
+	return vMod;
+}
+
+static bool s_isSongEnd = false;
+
+static void onSongEnd(void) {
+	s_isSongEnd = true;
+}
+
+static bool writeWav(
+	const std::string &szPath, const std::vector<std::int16_t> &vSamples,
+	std::uint32_t ulRate
+) {
+	std::ofstream FileOut(szPath, std::ios::binary);
+	if(!FileOut.good()) {
+		return false;
+	}
+	auto write16 = [&FileOut](std::uint16_t uwValue) {
+		FileOut.put(char(uwValue & 0xFF)).put(char(uwValue >> 8));
+	};
+	auto write32 = [&write16](std::uint32_t ulValue) {
+		write16(std::uint16_t(ulValue & 0xFFFF));
+		write16(std::uint16_t(ulValue >> 16));
+	};
+
+	std::uint32_t ulDataSize = std::uint32_t(vSamples.size() * sizeof(vSamples[0]));
+	FileOut.write("RIFF", 4);
+	write32(36 + ulDataSize);
+	FileOut.write("WAVEfmt ", 8);
+	write32(16); // fmt chunk size
+	write16(1); // PCM
+	write16(2); // Channel count
+	write32(ulRate);
+	write32(ulRate * 2 * sizeof(std::int16_t)); // Byte rate
+	write16(2 * sizeof(std::int16_t)); // Block align
+	write16(16); // Bits per sample
+	FileOut.write("data", 4);
+	write32(ulDataSize);
+	for(auto Sample: vSamples) {
+		write16(std::uint16_t(Sample));
+	}
+	return FileOut.good();
+}
+
+static void printUsage(const std::string &szAppName) {
+	using fmt::print;
+	print("Usage:\n\t{} inPath.mod outPath.wav [extraOpts]\n", szAppName);
+	print("\t{} -selftest\n\n", szAppName);
+	print("Renders MOD using ptplayer's replay code and reports its per-tick cost.\n");
+	print("Render hash is printed for comparing output between builds.\n");
+	print("-selftest renders built-in fixture module and checks its hash.\n\n");
+	print("Extra options:\n");
+	print("\t-sp path     Use samples from given sample pack, made by mod_tool\n");
+	print("\t-rate N      Output sample rate, in Hz. Default: 44100\n");
+	print("\t-seconds N   Stop after given number of seconds. Default: 600\n");
+	print("\t-ntsc        Use NTSC timings instead of PAL ones\n");
+	print("\t-stats path  Write per-tick cost as CSV to given path\n");
+	print("\t-hostTime    Measure host time spent in handlers. Makes stats vary between runs\n");
+	print("\t-expect hash Fail if render hash differs from given one\n");
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	bool isSelfTest = (lArgCount >= 2 && pArgs[1] == std::string("-selftest"));
+	if(lArgCount < 3 && !isSelfTest) {
+		nLog::error("Too few arguments");
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string szInPath, szOutPath;
+	std::string szSamplePackPath;
+	std::string szStatsPath;
+	std::int32_t lRate = 44100;
+	std::int32_t lSeconds = 600;
+	bool isPal = true;
+	bool isHostTime = false;
+	bool isExpectedHash = false;
+	std::uint64_t ullExpectedHash = 0;
+	if(isSelfTest) {
+		auto TempDir = std::filesystem::temp_directory_path();
+		szInPath = (TempDir / "mod_render_selftest.mod").string();
+		szOutPath = (TempDir / "mod_render_selftest.wav").string();
+		auto vMod = createSelfTestMod();
+		std::ofstream FileMod(szInPath, std::ios::binary);
+		FileMod.write(reinterpret_cast<const char*>(vMod.data()), vMod.size());
+		if(!FileMod.good()) {
+			nLog::error("Couldn't write fixture module: '{}'", szInPath);
+			return EXIT_FAILURE;
+		}
+		lRate = s_ulSelfTestRate;
+		isExpectedHash = true;
+		ullExpectedHash = s_ullSelfTestHash;
+	}
+	else {
+		szInPath = pArgs[1];
+		szOutPath = pArgs[2];
+	}
+	for(auto ArgIndex = isSelfTest ? 2 : 3; ArgIndex < lArgCount; ++ArgIndex) {
+		std::string szArg = pArgs[ArgIndex];
+		bool isLast = (ArgIndex + 1 >= lArgCount);
+		if(szArg == "-sp" && !isLast) {
+			szSamplePackPath = pArgs[++ArgIndex];
+		}
+		else if(szArg == "-stats" && !isLast) {
+			szStatsPath = pArgs[++ArgIndex];
+		}
+		else if(szArg == "-rate" && !isLast) {
+			if(!nParse::toInt32(pArgs[++ArgIndex], "-rate", lRate)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else if(szArg == "-seconds" && !isLast) {
+			if(!nParse::toInt32(pArgs[++ArgIndex], "-seconds", lSeconds)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else if(szArg == "-ntsc") {
+			isPal = false;
+		}
+		else if(szArg == "-hostTime") {
+			isHostTime = true;
+		}
+		else if(szArg == "-expect" && !isLast) {
+			std::string szHash = pArgs[++ArgIndex];
+			try {
+				ullExpectedHash = std::stoull(szHash, nullptr, 16);
+				isExpectedHash = true;
+			}
+			catch(const std::exception &) {
+				nLog::error("Couldn't parse -expect: '{}'", szHash);
+				return EXIT_FAILURE;
+			}
+		}
+		else {
+			nLog::error("Unknown argument: '{}'", szArg);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(lRate <= 0 || lSeconds <= 0) {
+		nLog::error("Rate and duration must be positive");
+		return EXIT_FAILURE;
+	}
+	std::uint32_t ulRate = std::uint32_t(lRate);
+	std::uint32_t ulSeconds = std::uint32_t(lSeconds);
+
+	aceHostReset();
+	ptplayerCreate(isPal);
+	tPtplayerMod *pMod = ptplayerModCreateFromPath(szInPath.c_str());
+	if(!pMod) {
+		nLog::error("Couldn't load MOD: '{}'", szInPath);
+		return EXIT_FAILURE;
+	}
+	tPtplayerSamplePack *pSamplePack = nullptr;
+	if(!szSamplePackPath.empty()) {
+		pSamplePack = ptplayerSampleDataCreateFromPath(szSamplePackPath.c_str());
+		if(!pSamplePack) {
+			nLog::error("Couldn't load sample pack: '{}'", szSamplePackPath);
+			return EXIT_FAILURE;
+		}
+	}
+	ptplayerConfigureSongRepeat(1, onSongEnd);
+	ptplayerLoadMod(pMod, pSamplePack, 0);
+	ptplayerEnableMusic(1);
+
+	std::uint32_t ulPaulaClock = isPal ? s_ulPaulaClockPal : s_ulPaulaClockNtsc;
+	std::uint64_t ullEndTime = std::uint64_t(ulSeconds) * ulPaulaClock / s_ubPaulaClocksPerCiaTick;
+	tPaula Paula(ulPaulaClock, ulRate);
+	std::vector<std::int16_t> vOut;
+	std::vector<tTickStats> vTicks;
+	std::uint32_t ulFxTotalPrev = 0;
+	std::uint32_t ulRegWritesPrev = 0;
+	auto &TimerA = g_sAceHost.pTimers[CIA_B][0];
+	auto &TimerB = g_sAceHost.pTimers[CIA_B][1];
+	while(!s_isSongEnd) {
+		// Advance to next CIA-B underflow, rendering audio in the meantime
+		std::uint64_t ullNext = ullEndTime;
+		if(TimerA.isRunning) {
+			ullNext = std::min(ullNext, TimerA.ullNextUnderflow);
+		}
+		if(TimerB.isRunning) {
+			ullNext = std::min(ullNext, TimerB.ullNextUnderflow);
+		}
+		Paula.renderUntil(ullNext * s_ubPaulaClocksPerCiaTick, vOut);
+		g_sAceHost.ullNow = ullNext;
+		if(ullNext >= ullEndTime) {
+			nLog::warn("Song didn't end in {} seconds, stopping", ulSeconds);
+			break;
+		}
+
+		for(auto *pTimer: {&TimerA, &TimerB}) {
+			if(!pTimer->isRunning || pTimer->ullNextUnderflow != ullNext) {
+				continue;
+			}
+			if(pTimer->isOneShot) {
+				pTimer->isRunning = 0;
+			}
+			else {
+				pTimer->ullNextUnderflow += pTimer->uwLatch;
+			}
+			if(!pTimer->cbHandler) {
+				continue;
+			}
+
+			if(pTimer == &TimerA) {
+				// Each music tick starts with Timer A interrupt
+				vTicks.push_back({.ullCiaTime = ullNext, .ulFxCount = 0, .ulRegWrites = 0, .ulHostNs = 0});
+			}
+			std::chrono::steady_clock::time_point TimeStart, TimeEnd;
+			if(isHostTime) {
+				TimeStart = std::chrono::steady_clock::now();
+			}
+			pTimer->cbHandler(g_pCustom, pTimer->pHandlerData);
+			if(isHostTime) {
+				TimeEnd = std::chrono::steady_clock::now();
+			}
+			aceHostProcessIntReq();
+			Paula.updateDma();
+
+			// Timer B interrupts set up DMA for notes of last tick, so they're
+			// accounted to it
+			if(!vTicks.empty()) {
+				std::uint32_t ulFxTotal = 0;
+				for(auto ulCount: g_sAceHost.pFxCounts) {
+					ulFxTotal += ulCount;
+				}
+				auto &Tick = vTicks.back();
+				Tick.ulFxCount += ulFxTotal - ulFxTotalPrev;
+				Tick.ulRegWrites += g_sAceHost.ulRegWrites - ulRegWritesPrev;
+				Tick.ulHostNs += std::uint32_t(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(TimeEnd - TimeStart).count()
+				);
+				ulFxTotalPrev = ulFxTotal;
+				ulRegWritesPrev = g_sAceHost.ulRegWrites;
+			}
+		}
+	}
+
+	ptplayerStop();
+	ptplayerModDestroy(pMod);
+	if(pSamplePack) {
+		ptplayerSamplePackDestroy(pSamplePack);
+	}
+	ptplayerDestroy();
+
+	if(!writeWav(szOutPath, vOut, ulRate)) {
+		nLog::error("Couldn't write output file: '{}'", szOutPath);
+		return EXIT_FAILURE;
+	}
+
+	if(!szStatsPath.empty()) {
+		std::ofstream FileStats(szStatsPath);
+		// Host time goes last, so that the rest can be diffed between runs
+		FileStats << "tick,timeMs,fxCount,regWrites" << (isHostTime ? ",hostNs\n" : "\n");
+		for(std::size_t i = 0; i < vTicks.size(); ++i) {
+			const auto &Tick = vTicks[i];
+			FileStats << fmt::format(
+				"{},{:.3f},{},{}", i,
+				Tick.ullCiaTime * 1000.0 * s_ubPaulaClocksPerCiaTick / ulPaulaClock,
+				Tick.ulFxCount, Tick.ulRegWrites
+			);
+			FileStats << (isHostTime ? fmt::format(",{}\n", Tick.ulHostNs) : "\n");
+		}
+		if(!FileStats.good()) {
+			nLog::error("Couldn't write stats file: '{}'", szStatsPath);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Summary
+	std::uint32_t ulMaxFx = 0, ulMaxRegWrites = 0, ulMaxHostNs = 0;
+	std::uint64_t ullHostNsTotal = 0;
+	for(const auto &Tick: vTicks) {
+		ulMaxFx = std::max(ulMaxFx, Tick.ulFxCount);
+		ulMaxRegWrites = std::max(ulMaxRegWrites, Tick.ulRegWrites);
+		ulMaxHostNs = std::max(ulMaxHostNs, Tick.ulHostNs);
+		ullHostNsTotal += Tick.ulHostNs;
+	}
+	std::size_t TickCount = std::max<std::size_t>(vTicks.size(), 1);
+	fmt::print(
+		"Rendered {:.2f}s in {} ticks\n",
+		double(vOut.size() / 2) / ulRate, vTicks.size()
+	);
+	fmt::print(
+		"Effects per tick: avg {:.2f}, max {}\n",
+		double(ulFxTotalPrev) / TickCount, ulMaxFx
+	);
+	fmt::print(
+		"Register writes per tick: avg {:.2f}, max {}\n",
+		double(g_sAceHost.ulRegWrites) / TickCount, ulMaxRegWrites
+	);
+	if(isHostTime) {
+		fmt::print(
+			"Host time per tick: avg {}ns, max {}ns\n",
+			ullHostNsTotal / TickCount, ulMaxHostNs
+		);
+	}
+	fmt::print("Effect dispatches:\n");
+	for(std::uint8_t i = 0; i < PTPLAYER_FX_COUNT; ++i) {
+		if(g_sAceHost.pFxCounts[i]) {
+			fmt::print("\t{:<26} {}\n", s_pFxNames[i], g_sAceHost.pFxCounts[i]);
+		}
+	}
+
+	auto ullHash = getRenderHash(vOut, vTicks);
+	fmt::print("Render hash: {:016X}\n", ullHash);
+	if(isExpectedHash && ullHash != ullExpectedHash) {
+		nLog::error("Render hash differs from expected {:016X}", ullExpectedHash);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -3,14 +3,24 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "common/mod.h"
+#include "common/fib_delta.h"
+#include "common/endian.h"
+#include "common/parse.h"
 #include <cstdlib>
 #include <vector>
 #include <memory>
 #include <algorithm>
 #include <fstream>
+#include <unordered_map>
 #include <fmt/format.h>
 
+static constexpr std::uint8_t s_ubMaxSampleCount = 31;
+
 // mod_tool -i ../../../../res/germz1.mod -i ../../../../res/germz2.mod -sp ../../../../build/data/samples.samplepack -o ../../../../build/data/germz1.mod -o ../../../../build/data/germz2.mod
+// Add -pack to store patterns in ptplayer's packed format.
+// Add -opt to remove data which is never played, -entry 0,8 to specify song
+// positions from which game starts playback. Defaults to 0.
+// Add -cmp to write sample pack compressed with 4-bit Fibonacci delta codes.
 int main(int lArgCount, const char *pArgs[])
 {
 	if(lArgCount <= 1) {
@@ -22,6 +32,10 @@ int main(int lArgCount, const char *pArgs[])
 	std::vector<std::string> vOutNames;
 	std::string szSamplePackPath;
 	bool isStripSamples = true;
+	bool isPackPatterns = false;
+	bool isOptimize = false;
+	bool isCompressSamplePack = false;
+	std::vector<std::uint8_t> vEntryPositions;
 
 	for(auto ArgIndex = 0; ArgIndex < lArgCount; ++ArgIndex) {
 		if(pArgs[ArgIndex] == std::string("-i")) {
@@ -33,6 +47,37 @@ int main(int lArgCount, const char *pArgs[])
 		else if(pArgs[ArgIndex] == std::string("-sp")) {
 			szSamplePackPath = pArgs[++ArgIndex];
 		}
+		else if(pArgs[ArgIndex] == std::string("-pack")) {
+			isPackPatterns = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-opt")) {
+			isOptimize = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-cmp")) {
+			isCompressSamplePack = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-entry") && ArgIndex + 1 < lArgCount) {
+			// Comma-separated song positions from which game starts playback
+			std::string szPositions = pArgs[++ArgIndex];
+			std::size_t Start = 0;
+			while(Start < szPositions.size()) {
+				auto End = szPositions.find(',', Start);
+				if(End == std::string::npos) {
+					End = szPositions.size();
+				}
+				auto szPosition = szPositions.substr(Start, End - Start);
+				std::int32_t lPosition;
+				if(!nParse::toInt32(szPosition, "-entry", lPosition)) {
+					return EXIT_FAILURE;
+				}
+				if(lPosition < 0 || lPosition > 127) {
+					fmt::print("ERR: entry position '{}' is not in 0..127 range\n", szPosition);
+					return EXIT_FAILURE;
+				}
+				vEntryPositions.push_back(std::uint8_t(lPosition));
+				Start = End + 1;
+			}
+		}
 	}
 
 	if(vModsIn.size() != vOutNames.size()) {
@@ -43,82 +88,154 @@ int main(int lArgCount, const char *pArgs[])
 		return EXIT_FAILURE;
 	}
 
-	for(const auto &pMod: vModsIn) {
-		const auto &ModSamples = pMod->getSamples();
-		const auto SampleCount = ModSamples.size();
-		for(auto SampleIndex = 0; SampleIndex < SampleCount; ++SampleIndex) {
-			for(auto OtherIndex = SampleIndex + 1; OtherIndex < SampleCount; ++OtherIndex) {
-				if(
-					!ModSamples[SampleIndex].m_szName.empty() &&
-					ModSamples[SampleIndex].m_szName == ModSamples[OtherIndex].m_szName
-				) {
-					fmt::print(
-						"ERR: Mod '{}' has duplicate sample name: '{}'\n",
-						pMod->getSongName(), ModSamples[SampleIndex].m_szName
-					);
-					return EXIT_FAILURE;
+	if(isOptimize) {
+		if(vEntryPositions.empty()) {
+			vEntryPositions.push_back(0);
+		}
+		std::uint32_t ulTotalChipSaved = 0;
+		for(const auto &pMod: vModsIn) {
+			fmt::print("Optimizing {}...\n", pMod->getSongName());
+			auto Report = pMod->optimize(vEntryPositions);
+			if(!Report.vInvalidEntryPositions.empty()) {
+				for(const auto ubEntryPos: Report.vInvalidEntryPositions) {
+					fmt::print("ERR: entry position {} is past arrangement end\n", ubEntryPos);
+				}
+				return EXIT_FAILURE;
+			}
+			fmt::print(
+				"Removed {} positions, {} patterns, {} samples, cleared {} unreachable rows\n",
+				Report.ubPositionsRemoved, Report.ubPatternsRemoved,
+				Report.ubSamplesRemoved, Report.ulRowsCleared
+			);
+			fmt::print(
+				"Saved {} bytes of chip RAM in samples, {} bytes in patterns\n",
+				Report.ulSampleBytesSaved, Report.ulPatternBytesSaved
+			);
+			if(Report.ubPositionsRemoved) {
+				for(std::size_t i = 0; i < vEntryPositions.size(); ++i) {
+					if(vEntryPositions[i] != Report.vEntryPositions[i]) {
+						fmt::print(
+							"WARN: entry position {} is now {}\n",
+							vEntryPositions[i], Report.vEntryPositions[i]
+						);
+					}
 				}
 			}
+			ulTotalChipSaved += Report.ulSampleBytesSaved;
 		}
+		fmt::print("Total chip RAM saved: {} bytes\n", ulTotalChipSaved);
 	}
 
-	// Get the collection of unique samples
+	// Get the collection of unique samples. Samples are matched by contents
+	// rather than names, so that same sample saved under different names
+	// takes samplepack space only once.
 	std::vector<tSample> vMergedSamples;
+	std::unordered_multimap<std::uint64_t, std::size_t> mHashToMerged;
+	std::vector<std::vector<std::uint8_t>> vModReorders; // [idxMod][idxOld] = idxNew
 	for(const auto &pMod: vModsIn) {
-		const auto &ModSamples = pMod->getSamples();
-		for(const auto &ModSample: ModSamples) {
+		std::vector<std::uint8_t> vReorder;
+		// Volume is stored in module's sample defs, so within single module
+		// samples with different volumes need separate slots
+		std::unordered_map<std::size_t, std::uint8_t> mMergedToVolume;
+		for(const auto &ModSample: pMod->getSamples()) {
 			if(ModSample.m_vData.empty()) {
+				vReorder.push_back(tMod::s_ubSampleUnused);
 				continue;
 			}
 
-			// Check if sample is on the list
-			auto FoundMergedSample = std::find_if(
-				vMergedSamples.begin(), vMergedSamples.end(),
-				[&ModSample](const tSample &RefSample) -> bool {
-					bool isSameName = (RefSample.m_szName == ModSample.m_szName);
-					return isSameName;
+			// Check if sample is on the list - hash matches need full compare
+			auto Hash = ModSample.getSoundHash();
+			auto [itBegin, itEnd] = mHashToMerged.equal_range(Hash);
+			auto itFound = std::find_if(itBegin, itEnd, [&](const auto &HashEntry) {
+				auto itVolume = mMergedToVolume.find(HashEntry.second);
+				return (
+					vMergedSamples[HashEntry.second].isSameSound(ModSample) &&
+					(itVolume == mMergedToVolume.end() || itVolume->second == ModSample.m_ubVolume)
+				);
+			});
+			if(itFound != itEnd) {
+				const auto &MergedSample = vMergedSamples[itFound->second];
+				if(MergedSample.m_szName != ModSample.m_szName) {
+					fmt::print(
+						FMT_STRING("Merging sample '{}' from mod '{}' with '{}' at index {}\n"),
+						ModSample.m_szName, pMod->getSongName(), MergedSample.m_szName,
+						itFound->second
+					);
 				}
-			);
-			if(FoundMergedSample == vMergedSamples.end()) {
+				vReorder.push_back(std::uint8_t(itFound->second));
+				mMergedToVolume.emplace(itFound->second, ModSample.m_ubVolume);
+			}
+			else {
 				// Sample not on the list - add it
 				fmt::print(FMT_STRING("Adding sample '{}' at index {}\n"), ModSample.m_szName, vMergedSamples.size());
+				mHashToMerged.emplace(Hash, vMergedSamples.size());
+				mMergedToVolume.emplace(vMergedSamples.size(), ModSample.m_ubVolume);
+				vReorder.push_back(std::uint8_t(vMergedSamples.size()));
 				vMergedSamples.push_back(ModSample);
 			}
-			else {
-				// Verify that Samples are exactly the same
-				if(ModSample != *FoundMergedSample) {
-					fmt::print(
-						"ERR: sample {} '{}' have different contents in mod '{}' than in others\n",
-						(&ModSample - ModSamples.data()), ModSample.m_szName, pMod->getSongName()
-					);
-					return EXIT_FAILURE;
-				}
-			}
 		}
+		vModReorders.push_back(std::move(vReorder));
+	}
+
+	if(vMergedSamples.size() > s_ubMaxSampleCount) {
+		fmt::print(
+			"ERR: Too many unique samples: {}, max is {}\n",
+			vMergedSamples.size(), s_ubMaxSampleCount
+		);
+		return EXIT_FAILURE;
 	}
 
 	// Change the sample indices in modules so that they can be used with the samplepack
-	for(const auto &pMod: vModsIn) {
-		// Scan the samples to get the reorder table
-		std::vector<uint8_t> vReorder; // [idxOld] = idxNew
-		for(const auto ModSample: pMod->getSamples()) {
-			std::uint8_t ubIdxNew = 0;
-			if(!ModSample.m_szName.empty()) {
-				// Find the sample index in new samplepack
-				auto SampleNew = std::find_if(
-					vMergedSamples.begin(), vMergedSamples.end(),
-					[&ModSample](const tSample &MergedSample) -> bool {
-						bool isSame = MergedSample.m_szName == ModSample.m_szName;
-						return isSame;
-					}
+	for(std::size_t ModIndex = 0; ModIndex < vModsIn.size(); ++ModIndex) {
+		auto &pMod = vModsIn[ModIndex];
+		auto &vReorder = vModReorders[ModIndex];
+
+		// Each module needs definitions of all samplepack's samples, since
+		// ptplayer calculates sample positions in pack from their lengths.
+		// Names and volumes are taken from module's own samples, if it uses them.
+		std::vector<tSample> vSamplesNew = vMergedSamples;
+		std::vector<bool> vIsSlotUsed(vSamplesNew.size(), false);
+		const auto &ModSamples = pMod->getSamples();
+		for(std::size_t OldIndex = 0; OldIndex < ModSamples.size(); ++OldIndex) {
+			auto ubIdxNew = vReorder[OldIndex];
+			if(ubIdxNew == tMod::s_ubSampleUnused) {
+				continue;
+			}
+			// Slots are shared only by samples with same volume
+			if(!vIsSlotUsed[ubIdxNew]) {
+				auto &SampleNew = vSamplesNew[ubIdxNew];
+				SampleNew.m_szName = ModSamples[OldIndex].m_szName;
+				SampleNew.m_ubVolume = ModSamples[OldIndex].m_ubVolume;
+				vIsSlotUsed[ubIdxNew] = true;
+			}
+		}
+
+		// Notes using empty samples need to point to an empty slot
+		auto vIsReferenced = pMod->getReferencedSamples();
+		bool isEmptyReferenced = false;
+		for(std::size_t OldIndex = 0; OldIndex < vReorder.size(); ++OldIndex) {
+			if(vReorder[OldIndex] == tMod::s_ubSampleUnused && vIsReferenced[OldIndex]) {
+				isEmptyReferenced = true;
+			}
+		}
+		if(isEmptyReferenced) {
+			if(vMergedSamples.size() >= s_ubMaxSampleCount) {
+				fmt::print(
+					"ERR: Mod '{}' plays empty samples, but there's no empty slot left for them\n",
+					pMod->getSongName()
 				);
-				ubIdxNew = uint8_t(std::distance(vMergedSamples.begin(), SampleNew));
+				return EXIT_FAILURE;
+			}
+			for(auto &ubIdxNew: vReorder) {
+				if(ubIdxNew == tMod::s_ubSampleUnused) {
+					ubIdxNew = std::uint8_t(vMergedSamples.size());
+				}
 			}
-			vReorder.push_back(ubIdxNew);
 		}
 
-		// Reorder samples, replace sample indices in notes
+		// Replace sample indices in notes, then set final sample defs
 		pMod->reorderSamples(vReorder);
+		pMod->setSamples(vSamplesNew);
 
 		// Trim sample data - Don't do it or sample defs will have data length 0
 		// pMod->clearSampleData();
@@ -128,18 +245,54 @@ int main(int lArgCount, const char *pArgs[])
 		fmt::print("Writing sample pack to {}...\n", szSamplePackPath);
 		std::ofstream FileSamplePack;
 		FileSamplePack.open(szSamplePackPath, std::ios::binary);
-		for(const auto &Sample: vMergedSamples) {
-			FileSamplePack.write(
-				reinterpret_cast<const char*>(Sample.m_vData.data()),
-				Sample.m_vData.size() * sizeof(Sample.m_vData[0])
-			);
+		if(!isCompressSamplePack) {
+			for(const auto &Sample: vMergedSamples) {
+				FileSamplePack.write(
+					reinterpret_cast<const char*>(Sample.m_vData.data()),
+					Sample.m_vData.size() * sizeof(Sample.m_vData[0])
+				);
+			}
+		}
+		else {
+			// Tag, version, compression type, sample count, word length
+			// of each sample, then each sample's codes. Samples are encoded
+			// separately, so that decoding errors don't spill over to next ones.
+			static constexpr std::uint8_t ubVersion = 1;
+			static constexpr std::uint8_t ubCompression = 1; // Fibonacci delta
+			std::uint16_t uwSampleCount = nEndian::toBig16(std::uint16_t(vMergedSamples.size()));
+			FileSamplePack.write("ACSP", 4);
+			FileSamplePack.write(reinterpret_cast<const char*>(&ubVersion), sizeof(ubVersion));
+			FileSamplePack.write(reinterpret_cast<const char*>(&ubCompression), sizeof(ubCompression));
+			FileSamplePack.write(reinterpret_cast<const char*>(&uwSampleCount), sizeof(uwSampleCount));
+			for(const auto &Sample: vMergedSamples) {
+				std::uint16_t uwWordLength = nEndian::toBig16(std::uint16_t(Sample.m_vData.size()));
+				FileSamplePack.write(reinterpret_cast<const char*>(&uwWordLength), sizeof(uwWordLength));
+			}
+
+			std::uint32_t ulRawSize = 0, ulEncodedSize = 0;
+			for(const auto &Sample: vMergedSamples) {
+				const auto *pBytes = reinterpret_cast<const std::int8_t*>(Sample.m_vData.data());
+				std::vector<std::int8_t> vBytes(pBytes, pBytes + Sample.m_vData.size() * sizeof(Sample.m_vData[0]));
+				auto vEncoded = nFibDelta::encode(vBytes);
+				FileSamplePack.write(reinterpret_cast<const char*>(vEncoded.data()), vEncoded.size());
+				ulRawSize += std::uint32_t(vBytes.size());
+				ulEncodedSize += std::uint32_t(vEncoded.size());
+			}
+			fmt::print("Compressed sample pack: {} -> {} bytes\n", ulRawSize, ulEncodedSize);
 		}
 	}
 
 	std::uint32_t ulIdx = 0;
 	for(const auto &pMod: vModsIn) {
 		fmt::print("Writing {} to {}...\n", pMod->getSongName(), vOutNames[ulIdx]);
-		pMod->toMod(vOutNames[ulIdx], isStripSamples);
+		auto ulRawSize = pMod->getRawPatternsSize();
+		auto ulWrittenSize = pMod->toMod(vOutNames[ulIdx], isStripSamples, isPackPatterns);
+		if(isPackPatterns) {
+			fmt::print(
+				"Packed patterns: {} -> {} bytes, saved {} bytes of RAM\n",
+				ulRawSize, ulWrittenSize, std::int32_t(ulRawSize - ulWrittenSize)
+			);
+		}
 		++ulIdx;
 	}
 
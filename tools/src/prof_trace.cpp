@@ -0,0 +1,225 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "common/endian.h"
+#include "common/logging.h"
+
+// Must match ACE's profiler.h
+static constexpr std::uint8_t s_ubDumpVersion = 1;
+static constexpr std::uint8_t s_ubEventBegin = 1;
+static constexpr std::uint8_t s_ubEventEnd = 2;
+static constexpr std::uint8_t s_ubEventFrame = 3;
+static constexpr std::uint8_t s_ubEventSize = 6; // m68k aligns ULONG to 2 bytes
+
+// Same as in ACE's timerGetPrec()
+static constexpr std::uint32_t s_ulTicksPerLine = 160;
+static constexpr std::uint32_t s_ulTicksPerFrame = s_ulTicksPerLine * 313;
+static constexpr double s_fUsPerTick = 0.4;
+
+struct tEvent {
+	std::uint32_t ulTime;
+	std::uint8_t ubType;
+	std::uint8_t ubZone;
+};
+
+struct tZoneStats {
+	std::uint64_t ullTotal = 0;
+	std::uint32_t ulMaxPerFrame = 0;
+	std::uint32_t ulCurrFrame = 0;
+	std::uint32_t ulCount = 0;
+};
+
+static std::string escapeJson(const std::string &szIn)
+{
+	std::string szOut;
+	for(char c: szIn) {
+		if(c == '"' || c == '\\') {
+			szOut += '\\';
+		}
+		szOut += c;
+	}
+	return szOut;
+}
+
+static void printUsage(const std::string &szAppName) {
+	using fmt::print;
+	print("Usage:\n\t{} inPath outPath\n\n", szAppName);
+	print("Converts ACE profiler dump written by profilerDump() to Chrome trace JSON,\n");
+	print("viewable in chrome://tracing or ui.perfetto.dev.\n");
+	print("Also prints per-zone time statistics.\n");
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	if(lArgCount != 3) {
+		nLog::error("Invalid number of arguments");
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+	std::string szInPath = pArgs[1];
+	std::string szOutPath = pArgs[2];
+
+	std::ifstream FileIn(szInPath, std::ios::binary);
+	if(!FileIn.good()) {
+		nLog::error("Couldn't open '{}'", szInPath);
+		return EXIT_FAILURE;
+	}
+	std::vector<std::uint8_t> vData(
+		(std::istreambuf_iterator<char>(FileIn)), std::istreambuf_iterator<char>()
+	);
+	if(
+		vData.size() < 8 ||
+		std::string(reinterpret_cast<char*>(vData.data()), 4) != "APRF"
+	) {
+		nLog::error("'{}' is not an ACE profiler dump", szInPath);
+		return EXIT_FAILURE;
+	}
+	if(vData[4] != s_ubDumpVersion) {
+		nLog::error("Unsupported dump version: {}", vData[4]);
+		return EXIT_FAILURE;
+	}
+
+	auto readLong = [&vData](std::size_t Pos) {
+		std::uint32_t ulBig;
+		std::memcpy(&ulBig, &vData[Pos], sizeof(ulBig));
+		return nEndian::fromBig32(ulBig);
+	};
+
+	std::size_t Pos = 8;
+	std::vector<std::string> vZoneNames;
+	for(std::uint8_t i = 0; i < vData[5]; ++i) {
+		auto pName = reinterpret_cast<const char*>(&vData[Pos]);
+		auto Length = strnlen(pName, vData.size() - Pos);
+		vZoneNames.push_back(std::string(pName, Length));
+		Pos += (Length + 2) & ~std::size_t(1);
+	}
+	if(Pos + sizeof(std::uint32_t) > vData.size()) {
+		nLog::error("Dump is truncated");
+		return EXIT_FAILURE;
+	}
+	std::uint32_t ulEventCount = readLong(Pos);
+	Pos += sizeof(std::uint32_t);
+	if(Pos + ulEventCount * s_ubEventSize > vData.size()) {
+		nLog::error("Dump is truncated");
+		return EXIT_FAILURE;
+	}
+	std::vector<tEvent> vEvents;
+	for(std::uint32_t i = 0; i < ulEventCount; ++i, Pos += s_ubEventSize) {
+		vEvents.push_back({readLong(Pos), vData[Pos + 4], vData[Pos + 5]});
+	}
+	if(vEvents.empty()) {
+		nLog::error("No events in '{}'", szInPath);
+		return EXIT_FAILURE;
+	}
+
+	// Ring may start in the middle of zones, so skip their ends. Zones which
+	// are still open at the end get closed at last event's time.
+	std::string szJson = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	std::vector<std::uint8_t> vStack;
+	std::vector<std::uint32_t> vStackStart;
+	std::vector<tZoneStats> vStats(vZoneNames.size());
+	std::uint32_t ulStart = vEvents.front().ulTime;
+	std::uint32_t ulFrameCount = 0;
+	bool isFirst = true;
+	auto addJsonEvent = [&](
+		const std::string &szName, char cPhase, std::uint32_t ulTime,
+		const std::string &szExtra
+	) {
+		double fTs = std::int32_t(ulTime - ulStart) * s_fUsPerTick;
+		std::uint32_t ulLine = (ulTime % s_ulTicksPerFrame) / s_ulTicksPerLine;
+		szJson += fmt::format(
+			"{}{{\"name\": \"{}\", \"ph\": \"{}\", \"ts\": {:.1f}, \"pid\": 0, \"tid\": 0, "
+			"\"args\": {{\"line\": {}}}{}}}",
+			isFirst ? "" : ",\n", escapeJson(szName), cPhase, fTs, ulLine, szExtra
+		);
+		isFirst = false;
+	};
+	auto closeFrameStats = [&vStats]() {
+		for(auto &Stats: vStats) {
+			Stats.ulMaxPerFrame = std::max(Stats.ulMaxPerFrame, Stats.ulCurrFrame);
+			Stats.ulCurrFrame = 0;
+		}
+	};
+
+	auto getZoneName = [&vZoneNames](std::uint8_t ubZone) {
+		return (ubZone < vZoneNames.size()) ?
+			vZoneNames[ubZone] : fmt::format("zone{}", ubZone);
+	};
+
+	for(const auto &Event: vEvents) {
+		auto szZone = getZoneName(Event.ubZone);
+		if(Event.ubType == s_ubEventBegin) {
+			vStack.push_back(Event.ubZone);
+			vStackStart.push_back(Event.ulTime);
+			addJsonEvent(szZone, 'B', Event.ulTime, "");
+		}
+		else if(Event.ubType == s_ubEventEnd) {
+			if(vStack.empty()) {
+				continue;
+			}
+			if(vStack.back() != Event.ubZone) {
+				nLog::warn("Zone '{}' ended while other one is open", szZone);
+			}
+			if(Event.ubZone < vStats.size()) {
+				auto ulDelta = Event.ulTime - vStackStart.back();
+				auto &Stats = vStats[Event.ubZone];
+				Stats.ullTotal += ulDelta;
+				Stats.ulCurrFrame += ulDelta;
+				++Stats.ulCount;
+			}
+			vStack.pop_back();
+			vStackStart.pop_back();
+			addJsonEvent(szZone, 'E', Event.ulTime, "");
+		}
+		else if(Event.ubType == s_ubEventFrame) {
+			if(ulFrameCount) {
+				closeFrameStats();
+			}
+			++ulFrameCount;
+			addJsonEvent(
+				fmt::format("frame {}", ulFrameCount), 'i', Event.ulTime, ", \"s\": \"g\""
+			);
+		}
+	}
+	while(!vStack.empty()) {
+		addJsonEvent(getZoneName(vStack.back()), 'E', vEvents.back().ulTime, "");
+		vStack.pop_back();
+	}
+	closeFrameStats();
+	szJson += "\n]}\n";
+
+	std::ofstream FileOut(szOutPath, std::ios::binary);
+	FileOut << szJson;
+	if(!FileOut.good()) {
+		nLog::error("Couldn't write to '{}'", szOutPath);
+		return EXIT_FAILURE;
+	}
+
+	std::uint32_t ulFrameDiv = std::max<std::uint32_t>(1, ulFrameCount);
+	fmt::print(
+		"{} events, {} frames, {:.1f} ms\n", vEvents.size(), ulFrameCount,
+		(vEvents.back().ulTime - ulStart) * s_fUsPerTick / 1000
+	);
+	fmt::print(
+		"{:<20} {:>8} {:>12} {:>12}\n", "Zone", "Count", "Avg/frame", "Max/frame"
+	);
+	for(std::size_t i = 0; i < vStats.size(); ++i) {
+		const auto &Stats = vStats[i];
+		if(!Stats.ulCount) {
+			continue;
+		}
+		fmt::print(
+			"{:<20} {:>8} {:>9.1f} us {:>9.1f} us\n", vZoneNames[i], Stats.ulCount,
+			Stats.ullTotal * s_fUsPerTick / ulFrameDiv,
+			Stats.ulMaxPerFrame * s_fUsPerTick
+		);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ace_host.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ace/managers/memory.h>
+#include <ace/utils/custom.h>
+
+static tCustom s_sCustom;
+static tCia s_pCias[CIA_COUNT];
+
+tCustom FAR REGPTR g_pCustom = &s_sCustom;
+tCia FAR REGPTR g_pCia[CIA_COUNT] = {&s_pCias[CIA_A], &s_pCias[CIA_B]};
+tAceHost g_sAceHost;
+
+void aceHostReset(void) {
+	memset(&s_sCustom, 0, sizeof(s_sCustom));
+	memset(s_pCias, 0, sizeof(s_pCias));
+	memset(&g_sAceHost, 0, sizeof(g_sAceHost));
+}
+
+void aceHostProcessIntReq(void) {
+	UWORD uwIntReq = s_sCustom.intreq;
+	if(!uwIntReq) {
+		return;
+	}
+	if(uwIntReq & INTF_SETCLR) {
+		s_sCustom.intreqr |= uwIntReq & ~INTF_SETCLR;
+	}
+	else {
+		s_sCustom.intreqr &= ~uwIntReq;
+	}
+	s_sCustom.intreq = 0;
+}
+
+//---------------------------------------------------------------------- SYSTEM
+
+void systemUse(void) {
+}
+
+void systemUnuse(void) {
+}
+
+void systemGetBlitterFromOs(void) {
+}
+
+void systemReleaseBlitterToOs(void) {
+}
+
+void systemSetInt(
+	UBYTE ubIntNumber, tAceIntHandler pHandler, void *pIntData
+) {
+	// Only audio interrupts are supported, VBL-based playback isn't
+	if(INTB_AUD0 <= ubIntNumber && ubIntNumber <= INTB_AUD3) {
+		tAceHostAudioInt *pInt = &g_sAceHost.pAudioInts[ubIntNumber - INTB_AUD0];
+		pInt->cbHandler = pHandler;
+		pInt->pHandlerData = pIntData;
+	}
+}
+
+void systemSetCiaInt(
+	UBYTE ubCia, UBYTE ubIntBit, tAceIntHandler pHandler, void *pIntData
+) {
+	if(ubIntBit < ACE_HOST_CIA_TIMER_COUNT) {
+		tAceHostTimer *pTimer = &g_sAceHost.pTimers[ubCia][ubIntBit];
+		pTimer->cbHandler = pHandler;
+		pTimer->pHandlerData = pIntData;
+	}
+}
+
+void systemSetCiaCr(UBYTE ubCia, UBYTE isCrB, UBYTE ubCrValue) {
+	// CRA and CRB share the bits used here
+	tAceHostTimer *pTimer = &g_sAceHost.pTimers[ubCia][isCrB];
+	pTimer->isOneShot = (ubCrValue & CIACRA_RUNMODE) != 0;
+	if(!(ubCrValue & CIACRA_START)) {
+		pTimer->isRunning = 0;
+	}
+	else if((ubCrValue & CIACRA_LOAD) || !pTimer->isRunning) {
+		pTimer->isRunning = 1;
+		pTimer->ullNextUnderflow = g_sAceHost.ullNow + pTimer->uwLatch;
+	}
+}
+
+void systemSetDmaMask(UWORD uwDmaMask, UBYTE isEnabled) {
+	if(isEnabled) {
+		g_sAceHost.uwDmaCon |= uwDmaMask;
+	}
+	else {
+		g_sAceHost.uwDmaCon &= ~uwDmaMask;
+	}
+}
+
+void systemSetTimer(UBYTE ubCia, UBYTE ubTimer, UWORD uwTicks) {
+	// Running timer picks up new latch value on next underflow
+	g_sAceHost.pTimers[ubCia][ubTimer].uwLatch = uwTicks;
+}
+
+//---------------------------------------------------------------------- MEMORY
+
+UBYTE memType(UNUSED_ARG const void *pMem) {
+	// There's no distinction on host, so all memory is usable by Paula
+	return MEMF_CHIP;
+}
+
+void *_memAllocRls(ULONG ulSize, ULONG ulFlags) {
+	if(ulFlags & MEMF_CLEAR) {
+		return calloc(1, ulSize);
+	}
+	return malloc(ulSize);
+}
+
+void _memFreeRls(void *pMem, UNUSED_ARG ULONG ulSize) {
+	free(pMem);
+}
+
+//-------------------------------------------------------------------- PTPLAYER
+
+void ptplayerHostOnRegWrite(void) {
+	++g_sAceHost.ulRegWrites;
+}
+
+void ptplayerHostOnFx(UBYTE ubFx) {
+	++g_sAceHost.pFxCounts[ubFx];
+}
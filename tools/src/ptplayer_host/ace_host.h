@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_PTPLAYER_HOST_ACE_HOST_H_
+#define _ACE_TOOLS_PTPLAYER_HOST_ACE_HOST_H_
+
+/**
+ * @brief Minimal implementation of ACE's system & memory managers for running
+ * ptplayer on PC. Custom chip registers are plain memory and CIA timers
+ * are just bookkeeping - the program using it is responsible for advancing
+ * time, calling interrupt handlers and emulating Paula.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <ace/types.h>
+#include <ace/managers/system.h>
+#include <ace/managers/ptplayer.h>
+
+#define ACE_HOST_CIA_TIMER_COUNT 2
+
+typedef struct tAceHostTimer {
+	tAceIntHandler cbHandler;
+	void *pHandlerData;
+	uint64_t ullNextUnderflow; ///< In CIA ticks, valid if isRunning is set.
+	UWORD uwLatch;
+	UBYTE isRunning;
+	UBYTE isOneShot;
+} tAceHostTimer;
+
+typedef struct tAceHostAudioInt {
+	tAceIntHandler cbHandler;
+	void *pHandlerData;
+} tAceHostAudioInt;
+
+typedef struct tAceHost {
+	uint64_t ullNow; ///< Current time in CIA ticks, advanced by host program.
+	tAceHostTimer pTimers[CIA_COUNT][ACE_HOST_CIA_TIMER_COUNT];
+	tAceHostAudioInt pAudioInts[4]; ///< Audio interrupt handlers, per channel.
+	UWORD uwDmaCon; ///< Enabled DMA channels, as set by systemSetDmaMask().
+	ULONG ulRegWrites; ///< Total number of Paula register writes.
+	ULONG pFxCounts[PTPLAYER_FX_COUNT]; ///< Total dispatches of each effect.
+} tAceHost;
+
+extern tAceHost g_sAceHost;
+
+/**
+ * @brief Resets host state, clearing custom registers, timers and counters.
+ */
+void aceHostReset(void);
+
+/**
+ * @brief Processes value written to INTREQ by interrupt handlers,
+ * updating INTREQR accordingly. Should be called after each handler call.
+ */
+void aceHostProcessIntReq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_TOOLS_PTPLAYER_HOST_ACE_HOST_H_